@@ -31,7 +31,7 @@ public:
     ~Bam();
     void for_alignment_in_bam(const function<void(const string& ref_name, const string& query_name, uint8_t map_quality, uint16_t flag)>& f);
     void for_alignment_in_bam(bool get_cigar, const function<void(SamElement& alignment)>& f);
-    void for_alignment_in_bam(const function<void(FullAlignmentBlock& a)>& f);
+    void for_alignment_in_bam(bool get_cigar, const function<void(FullAlignmentBlock& a)>& f);
     void for_ref_in_header(const function<void(const string& ref_name, uint32_t length)>& f) const;
     static bool is_first_mate(uint16_t flag);
     static bool is_second_mate(uint16_t flag);
@@ -47,6 +47,14 @@ template <class T> void update_contact_map(
         IncrementalIdMap<string>& id_map);
 
 
+/// Same as above, for the subset of alignments at the given indexes, so a filtered chain need not be copied
+template <class T> void update_contact_map(
+        const vector<T>& alignments,
+        const vector<size_t>& indexes,
+        MultiContactGraph& contact_graph,
+        IncrementalIdMap<string>& id_map);
+
+
 void parse_unpaired_bam_file(
         path bam_path,
         MultiContactGraph& contact_graph,
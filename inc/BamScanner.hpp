@@ -0,0 +1,133 @@
+#ifndef GFASE_BAMSCANNER_HPP
+#define GFASE_BAMSCANNER_HPP
+
+#include "StratifiedContactMap.hpp"
+#include "MultiContactGraph.hpp"
+#include "IncrementalIdMap.hpp"
+#include "Filesystem.hpp"
+#include "Sam.hpp"
+
+using ghc::filesystem::path;
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::map;
+
+
+namespace gfase {
+
+
+using read_chain_batch_t = vector<FullAlignmentChain>;
+
+
+/// An analysis that consumes the read chains of a BAM. Each plugin is run on its own thread and is given every batch
+/// in file order, so a plugin needs no locking for its own state, but must not mutate anything shared with another
+/// plugin registered in the same scan.
+class ReadChainPlugin{
+public:
+    virtual ~ReadChainPlugin()=default;
+
+    // Called once per read (group of consecutive records with the same query name), in file order
+    virtual void process(const FullAlignmentChain& read_alignments)=0;
+
+    // Called after the last read has been processed
+    virtual void finish(){}
+
+    // Whether this plugin reads the CIGAR or any of the fields derived from it (ref_stop, query_start, query_stop and
+    // the match/mismatch/indel counts). If no registered plugin does, the scanner skips decoding CIGARs entirely.
+    virtual bool needs_cigar() const{
+        return true;
+    }
+};
+
+
+/// Decodes each record of a BAM once, groups consecutive records by query name into read chains, and hands batches of
+/// chains to every registered plugin concurrently, with one consumer thread per plugin.
+class BamScanner{
+    path bam_path;
+    vector<ReadChainPlugin*> plugins;
+
+    // Number of read chains per batch
+    size_t batch_size;
+
+    // Maximum number of batches that may be waiting for the slowest plugin before decoding is paused
+    size_t max_queued_batches;
+
+public:
+    BamScanner(path bam_path, size_t batch_size=4096, size_t max_queued_batches=16);
+
+    void add_plugin(ReadChainPlugin& plugin);
+    void scan();
+};
+
+
+/// Accumulates a contact graph, in the same way as parse_unpaired_bam_file
+class ContactGraphPlugin: public ReadChainPlugin{
+    MultiContactGraph& contact_graph;
+    IncrementalIdMap<string>& id_map;
+    string required_prefix;
+    int8_t min_mapq;
+
+    // Indexes of the usable alignments in the current read chain
+    vector<size_t> indexes;
+
+public:
+    ContactGraphPlugin(
+            MultiContactGraph& contact_graph,
+            IncrementalIdMap<string>& id_map,
+            string required_prefix,
+            int8_t min_mapq);
+
+    void process(const FullAlignmentChain& read_alignments) override;
+    bool needs_cigar() const override;
+};
+
+
+/// Counts the frequency of each MAPQ value
+class MapqDistributionPlugin: public ReadChainPlugin{
+    bool primary_only;
+
+public:
+    map<uint8_t,size_t> distribution;
+
+    MapqDistributionPlugin(bool primary_only);
+
+    void process(const FullAlignmentChain& read_alignments) override;
+    bool needs_cigar() const override;
+    void write_to_csv(path output_path) const;
+};
+
+
+/// Accumulates contact counts stratified by the smaller MAPQ of each pair of alignments in a read
+class StratifiedContactPlugin: public ReadChainPlugin{
+    string required_prefix;
+    int8_t min_mapq;
+
+    vector<int32_t> ref_ids;
+    vector<uint8_t> mapqs;
+
+public:
+    StratifiedContactMap contact_map;
+    IncrementalIdMap<string> id_map;
+
+    StratifiedContactPlugin(string required_prefix, int8_t min_mapq);
+
+    void process(const FullAlignmentChain& read_alignments) override;
+    void finish() override;
+    bool needs_cigar() const override;
+    void write_to_csv(path output_path) const;
+};
+
+
+bool has_prefix(const string& s, const string& prefix);
+
+
+}
+
+#endif //GFASE_BAMSCANNER_HPP
@@ -216,10 +216,129 @@ template <class T> size_t BinarySequence<T>::get_byte_length() const{
 }
 
 
+/// Heap-free alternative to BinarySequence<uint64_t> for kmers of up to 32*N bases, which lives entirely in N inline
+/// words. The packing is identical, so hashing get_byte_length() bytes of either gives the same value.
+/// \tparam N number of 64 bit words available for storage
+template<size_t N> class SmallBinarySequence {
+public:
+    /// Attributes ///
+    array <uint64_t,N> sequence;
+    uint16_t length;
+
+    static constexpr size_t capacity = 32*N;
+
+    /// Methods ///
+    SmallBinarySequence();
+    template <class T2> SmallBinarySequence(const T2& s);
+    void push_back(char c);
+    void shift(char c);
+    void clear();
+    void to_string(string& s) const;
+    size_t get_byte_length() const;
+};
+
+
+template <size_t N> bool operator==(const SmallBinarySequence<N>& a, const SmallBinarySequence<N>& b)
+{
+    return a.length == b.length and a.sequence == b.sequence;
+}
+
+
+template<size_t N> SmallBinarySequence<N>::SmallBinarySequence():
+        sequence({}),
+        length(0)
+{}
+
+
+template<size_t N> template <class T2> SmallBinarySequence<N>::SmallBinarySequence(const T2& s):
+        sequence({}),
+        length(0)
+{
+    for (auto& c: s){
+        push_back(c);
+    }
+}
+
+
+template <size_t N> void SmallBinarySequence<N>::push_back(char c){
+    uint64_t bits = (uint8_t(c) < 128) ? BinarySequence<uint64_t>::base_to_index[c] : 4;
+
+    if (bits == 4){
+        throw runtime_error("ERROR: non ACGT character encountered in sequence: " + string(1,c) + " (ord=" + std::to_string(int(c)) + ")");
+    }
+
+    if (length == capacity){
+        throw runtime_error("ERROR: attempting to append to full SmallBinarySequence of length: " + std::to_string(length));
+    }
+
+    for (size_t i=0; i<N; i++){
+        sequence[i] |= (length/32 == i) ? bits << 2*(length % 32) : 0;
+    }
+
+    length++;
+}
+
+
+/// Push a new base but not alter the length of the sequence (as a fixed length queue would). Every word is shifted
+/// regardless of length, so the loop has no data dependent branches and fully unrolls for small N.
+template <size_t N> void SmallBinarySequence<N>::shift(char c){
+    uint64_t bits = (uint8_t(c) < 128) ? BinarySequence<uint64_t>::base_to_index[c] : 4;
+
+    if (bits == 4){
+        throw runtime_error("ERROR: non ACGT character encountered in sequence: " + string(1,c) + " (ord=" + std::to_string(int(c)) + ")");
+    }
+
+    size_t p = length - 1;
+
+    // Words are only ever indexed by constants, so that they can stay in registers
+    for (size_t i=0; i<N; i++){
+        sequence[i] >>= 2;
+
+        if (i + 1 < N){
+            sequence[i] |= sequence[i+1] << 62;
+        }
+
+        sequence[i] |= (p/32 == i) ? bits << 2*(p % 32) : 0;
+    }
+}
+
+
+template <size_t N> void SmallBinarySequence<N>::clear(){
+    sequence = {};
+    length = 0;
+}
+
+
+template<size_t N> void SmallBinarySequence<N>::to_string(string& s) const{
+    s.clear();
+
+    for (size_t i=0; i<length; i++){
+        s += BinarySequence<uint64_t>::index_to_base[(sequence[i/32] >> 2*(i % 32)) & 3];
+    }
+}
+
+
+template <size_t N> size_t SmallBinarySequence<N>::get_byte_length() const{
+    size_t bit_length = size_t(length)*2;
+    size_t byte_length = bit_length/8 + (bit_length % 8 != 0);
+
+    return byte_length;
+}
+
+
 }
 
 
 namespace std {
+template<size_t N>
+class hash<gfase::SmallBinarySequence<N> > {
+public:
+    size_t operator()(const gfase::SmallBinarySequence<N>& s) const {
+        return MurmurHash64A(s.sequence.data(), int(s.get_byte_length()), 14741);
+    }
+};
+
+
 template<>
 class hash<gfase::BinarySequence<uint64_t> > {
 public:
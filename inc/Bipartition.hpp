@@ -13,7 +13,9 @@
 
 #include <unordered_set>
 #include <functional>
+#include <utility>
 #include <fstream>
+#include <vector>
 #include <array>
 
 using handlegraph::PathHandleGraph;
@@ -28,7 +30,9 @@ using spp::sparse_hash_map;
 using std::unordered_set;
 using std::function;
 using std::ostream;
+using std::vector;
 using std::array;
+using std::pair;
 
 
 namespace gfase{
@@ -45,6 +49,18 @@ private:
     unordered_set<nid_t> node_subset;
     size_t max_id = 0;
 
+    // Union-find over the subgraph indices assigned by partition(), so that a node keeps its original index in
+    // node_to_subgraph and is resolved to its merged subgraph on lookup. Trees are linked by size, and each root
+    // carries the index of the subgraph that survived the merge.
+    vector<size_t> merge_parents;
+    vector<size_t> merge_sizes;
+    vector<size_t> merge_labels;
+
+    size_t find_merge_root(size_t subgraph_index) const;
+    void link_subgraphs(size_t subgraph_index_a, size_t subgraph_index_b);
+    void move_subgraph_edges(size_t absorbed_index);
+    void move_subgraph_nodes(size_t absorbed_index);
+
 public:
     HashGraph metagraph;
 
@@ -61,6 +77,11 @@ public:
     size_t get_degree_of_parent_handle(const handle_t& h, bool left) const;
     string get_name_of_parent_node(nid_t id);
     void merge_subgraphs(size_t subgraph_index_a, size_t subgraph_index_b);
+
+    /// Merge many pairs of subgraphs at once. For each pair (a,b), b is absorbed into whichever subgraph a belongs to
+    /// at that point in the batch. The membership is resolved with a union-find, and then the nodes and metagraph edges
+    /// of each absorbed subgraph are moved exactly once, always moving the smaller node set into the larger.
+    void merge_subgraphs(const vector <pair <size_t,size_t> >& to_be_merged);
     void partition();
     size_t get_subgraph_size(size_t subgraph_index) const;
     size_t get_subgraph_index_of_parent_node(nid_t id) const;
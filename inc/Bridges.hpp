@@ -3,21 +3,71 @@
 
 #include "bdsg/hash_graph.hpp"
 
+#include <unordered_set>
+#include <cstdint>
 #include <vector>
 #include <functional>
 
 using bdsg::HandleGraph;
 using handlegraph::handle_t;
+using handlegraph::nid_t;
 
+using std::unordered_set;
 using std::vector;
 using std::function;
 using std::pair;
 
 namespace gfase {
 
-// return the bridge nodes of the handle graph using Schmidt's (2013)
-// algorithm. assumes that graph is connected. the returned bridges are
-// all in the forward orientation.
+/*
+ * A dense, immutable index of a handle graph in the bi-edged formalism. Each node
+ * has two sides, numbered 2 * (node index) + (is reverse), and the edges of every
+ * side are stored contiguously, so that traversals need no hashing and no per-node
+ * allocation. The first neighbor of every side is the other side of the same node.
+ */
+class BiedgedIndex {
+public:
+    BiedgedIndex(const HandleGraph& graph);
+    BiedgedIndex() = delete;
+    
+    size_t node_count() const;
+    size_t side_count() const;
+    
+    // the side that a handle points out of
+    uint32_t get_side(const handle_t& handle) const;
+    handle_t get_handle(uint32_t side) const;
+    nid_t get_id(uint32_t side) const;
+    
+    // the neighbors of a side, beginning with the across-node edge
+    const uint32_t* neighbors_begin(uint32_t side) const;
+    const uint32_t* neighbors_end(uint32_t side) const;
+    
+    // the number of edges on a side, not counting the across-node edge
+    size_t get_degree(uint32_t side) const;
+    
+    // the indexes of the nodes whose across-node edge is a bridge, in ascending order.
+    // unlike bridge_nodes, the graph does not need to be connected
+    vector<uint32_t> find_bridge_nodes() const;
+    
+private:
+    
+    const HandleGraph& graph;
+    
+    // sorted node ids, the index of a node is its position in this vector
+    vector<nid_t> ids;
+    bool ids_are_contiguous;
+    
+    // edges of side s are targets[offsets[s]] to targets[offsets[s + 1]]
+    vector<uint32_t> offsets;
+    vector<uint32_t> targets;
+    
+    uint32_t get_node_index(nid_t id) const;
+};
+
+// return the bridge nodes of the handle graph, i.e. the nodes whose removal would
+// disconnect the bi-edged graph, using a low-link DFS over a BiedgedIndex. the graph
+// does not need to be connected. the returned bridges are all in the forward
+// orientation, in ascending order of ID.
 vector<handle_t> bridge_nodes(const HandleGraph& graph);
 
 // consolidate runs of non-branching bridges into multi-node unipath bridges.
@@ -38,6 +88,14 @@ void for_each_bridge_component(const HandleGraph& graph,
                                const function<void(const HandleGraph&,
                                                    const vector<pair<size_t, bool>>&)>& f);
 
+// collect the node sets and incident bridges of the bridge components, in the same order that
+// for_each_bridge_component visits them, so that the components can be processed independently
+// (e.g. in parallel) with SubgraphOverlays of the node sets.
+void get_bridge_components(const HandleGraph& graph,
+                           const vector<vector<handle_t>>& bridges,
+                           vector<unordered_set<nid_t>>& components,
+                           vector<vector<pair<size_t, bool>>>& incident_bridges);
+
 
 }
 
@@ -0,0 +1,88 @@
+#ifndef GFASE_BUBBLEFINDER_HPP
+#define GFASE_BUBBLEFINDER_HPP
+
+#include "handle_graph.hpp"
+
+using handlegraph::HandleGraph;
+using handlegraph::handle_t;
+using handlegraph::nid_t;
+
+#include <functional>
+#include <utility>
+#include <vector>
+#include <array>
+
+using std::function;
+using std::vector;
+using std::array;
+using std::pair;
+
+
+namespace gfase {
+
+
+/// Sorted set of node ids which is stored inline while it is small, and only spills to the heap for unusually high
+/// degree nodes. Clearing keeps the spilled capacity, so a reused set stops allocating after the first few nodes.
+class SmallIdSet {
+    static const size_t inline_capacity = 4;
+
+    array<nid_t, inline_capacity> inline_ids;
+    vector<nid_t> overflow_ids;
+    size_t length;
+
+public:
+    SmallIdSet();
+
+    void insert(nid_t id);
+    void clear();
+
+    const nid_t* begin() const;
+    const nid_t* end() const;
+    nid_t front() const;
+    size_t size() const;
+    bool empty() const;
+
+    bool operator==(const SmallIdSet& other) const;
+    bool operator!=(const SmallIdSet& other) const;
+};
+
+
+/// The first and second degree neighbors of a node, found by a two-edge walk right/left and left/right. The node itself
+/// is excluded from all of the sets, and a self edge is reported separately.
+class NodeNeighborhood {
+public:
+    nid_t id;
+
+    SmallIdSet left_first_degree;
+    SmallIdSet right_first_degree;
+    SmallIdSet left_second_degree;
+    SmallIdSet right_second_degree;
+
+    bool has_self_edge;
+
+    NodeNeighborhood();
+    void clear();
+};
+
+
+void get_neighborhood(const HandleGraph& graph, const handle_t& h0, NodeNeighborhood& neighborhood);
+
+/// Number of chunks of the node id range that for_each_neighborhood_in_parallel distributes over its threads
+size_t get_neighborhood_chunk_count(const HandleGraph& graph);
+
+/// Visit every node's neighborhood, splitting the node id range into chunks which are distributed over n_threads.
+/// The callback is called concurrently, and is given the index of the chunk (less than get_neighborhood_chunk_count)
+/// so that results can be collected without locking. The first exception thrown by the callback is rethrown here.
+void for_each_neighborhood_in_parallel(
+        const HandleGraph& graph,
+        size_t n_threads,
+        const function<void(const NodeNeighborhood& neighborhood, size_t chunk_index)>& f);
+
+/// Find all pairs of nodes that form a diploid bubble with symmetrical neighbors on both sides. Each pair is reported
+/// once, as (smaller id, larger id), in sorted order regardless of the number of threads.
+void find_diploid_bubbles(const HandleGraph& graph, vector <pair <nid_t, nid_t> >& bubbles, size_t n_threads);
+
+
+}
+
+#endif //GFASE_BUBBLEFINDER_HPP
@@ -2,6 +2,7 @@
 #define GFASE_BUBBLEGRAPH_HPP
 
 #include "IncrementalIdMap.hpp"
+#include "Random.hpp"
 #include "handle_graph.hpp"
 #include "bdsg/internal/hash_map.hpp"
 #include "sparsepp/spp.h"
@@ -33,7 +34,6 @@ namespace gfase {
 using paired_mappings_t = sparse_hash_map <string, array <set <SamElement>, 2> >;
 using unpaired_mappings_t = sparse_hash_map <string, set <SamElement> >;
 using contact_map_t = sparse_hash_map <int32_t, sparse_hash_map<int32_t, int32_t> >;
-using weighted_contact_map_t = sparse_hash_map <int32_t, sparse_hash_map<int32_t, map <uint8_t, int32_t> > >;
 
 
 template <class T> class Bubble {
@@ -159,12 +159,12 @@ public:
     BubbleGraph();
     BubbleGraph(IncrementalIdMap<string>& id_map, const contact_map_t& contact_map);
     BubbleGraph(IncrementalIdMap<string>& id_map);
-    BubbleGraph(const HandleGraph& graph, const contact_map_t& contact_map);
-    BubbleGraph(const HandleGraph& graph);
+    BubbleGraph(const HandleGraph& graph, const contact_map_t& contact_map, size_t n_threads=1);
+    BubbleGraph(const HandleGraph& graph, size_t n_threads=1);
     BubbleGraph(path csv_path, IncrementalIdMap<string>& id_map);
     void generate_bubble_adjacency_from_contact_map(const contact_map_t& contact_map);
     void generate_bubbles_from_shasta_names(IncrementalIdMap <string>& id_map);
-    void generate_diploid_symmetrical_bubbles_from_graph(const HandleGraph& graph);
+    void generate_diploid_symmetrical_bubbles_from_graph(const HandleGraph& graph, size_t n_threads=1);
     void generate_bubbles_from_csv(path csv_path, IncrementalIdMap<string>& id_map);
 
     // Iterating contents
@@ -212,14 +212,16 @@ void random_phase_search(
         atomic<int64_t>& best_score,
         atomic<size_t>& job_index,
         mutex& phase_mutex,
-        size_t m_iterations
+        size_t m_iterations,
+        SplitMix64 rng
 );
 
 void phase_contacts(
         const contact_map_t& contact_map,
         const IncrementalIdMap<string>& id_map,
         BubbleGraph& bubbles,
-        size_t n_threads
+        size_t n_threads,
+        uint64_t seed
 );
 
 
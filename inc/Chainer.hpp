@@ -7,10 +7,8 @@
 #include "Filesystem.hpp"
 
 #include "hash_graph.hpp"
-#include "bdsg/overlays/packed_subgraph_overlay.hpp"
 
 using bdsg::MutablePathDeletableHandleGraph;
-using bdsg::PackedSubgraphOverlay;
 using bdsg::MutableHandleGraph;
 using bdsg::PathHandleGraph;
 using bdsg::HandleGraph;
@@ -79,6 +77,64 @@ public:
 };
 
 
+/// Dense remap of the node ids of a graph to [0, n), in ascending order of id, for the chainer's traversals. Each node
+/// (and each side of a node) has a visited stamp, and a new traversal only has to increment the epoch, so neither a hash
+/// set nor a clear is needed per chain. The chainable nodes are annotated by index so the BFS doesn't hash either.
+class ChainTraversalContext {
+    vector<nid_t> ids;
+    bool is_contiguous;
+
+    vector<uint32_t> node_epochs;
+    vector<uint32_t> handle_epochs;
+    uint32_t epoch;
+
+    // 0 = not chainable, 1 = haploid, 2 = diploid
+    vector<int8_t> ploidy;
+    vector<uint32_t> alts;
+
+public:
+    explicit ChainTraversalContext(const HandleGraph& graph);
+
+    size_t size() const;
+    size_t get_index(nid_t id) const;
+    size_t get_index(const HandleGraph& graph, const handle_t& h) const;
+    nid_t get_id(size_t index) const;
+
+    // Forget everything visited so far, in O(1)
+    void next_epoch();
+
+    // Returns true if the node (or oriented handle) had not been visited yet in this epoch, and marks it
+    bool visit(size_t index);
+    bool visit(const HandleGraph& graph, const handle_t& h);
+    bool is_visited(size_t index) const;
+
+    void set_haploid(size_t index);
+    void set_diploid(size_t index, size_t alt_index);
+    int8_t get_ploidy(size_t index) const;
+    size_t get_alt(size_t index) const;
+};
+
+
+/// Many small sets of node indexes stored back to back in one flat array, where span i is [offsets[i], offsets[i+1])
+class IndexSpans {
+    vector<uint32_t> items;
+    vector<size_t> offsets;
+
+public:
+    IndexSpans();
+
+    // Append an item to the span that is currently open
+    void add(uint32_t item);
+
+    // Close the open span, returning false (and discarding nothing) if it is empty
+    bool close_span();
+
+    size_t size() const;
+    const uint32_t* begin(size_t i) const;
+    const uint32_t* end(size_t i) const;
+};
+
+
 class Chainer : public AbstractChainer {
     unordered_map<string,int8_t> path_phases;
     unordered_map<nid_t,nid_t> node_pairs;
@@ -87,6 +143,9 @@ class Chainer : public AbstractChainer {
     unordered_set<nid_t> haploid_nodes;
 
 public:
+    // Threads used to classify chainable nodes in generate_chain_paths
+    size_t n_threads = 1;
+
     // Constructor
     Chainer()=default;
 
@@ -95,7 +154,7 @@ public:
     size_t get_path_length(const PathHandleGraph& graph, const path_handle_t& p) const;
 
     // Chaining
-    void find_chainable_nodes(const HandleGraph& graph, const IncrementalIdMap<string>& id_map);
+    void find_chainable_nodes(const HandleGraph& graph, const IncrementalIdMap<string>& id_map, size_t n_threads=1);
     void process_haploid_chain_element(
             const set<nid_t>& chain_element,
             array<path_handle_t,2>& paths,
@@ -107,28 +166,40 @@ public:
             MutablePathDeletableHandleGraph& graph,
             const MultiContactGraph& contact_graph);
 
+    // Copy the chainable node annotations (found by find_chainable_nodes) into a traversal context
+    void index_chainable_nodes(ChainTraversalContext& context) const;
+
     void get_chain(
             const HandleGraph& graph,
+            ChainTraversalContext& context,
             const nid_t& start_node,
             deque <set <nid_t> >& chain);
 
+    // Append the chainable nodes reachable from start_node to the open span, skipping any node already visited in the
+    // context's current epoch
     void get_undirected_chain_subgraph(
             const HandleGraph& graph,
+            ChainTraversalContext& context,
             const nid_t& start_node,
-            PackedSubgraphOverlay& subgraph);
+            IndexSpans& subgraphs);
 
+    // Split the nodes of a subgraph span by their orientation relative to its smallest node, following only edges
+    // within the span. A node that is reachable in both orientations is reported in both.
     void get_oriented_subgraph(
             const HandleGraph& graph,
-            const nid_t& start_node,
-            array <PackedSubgraphOverlay, 2>& colored_subgraphs);
+            ChainTraversalContext& context,
+            const uint32_t* begin,
+            const uint32_t* end,
+            array <vector <uint32_t>, 2>& oriented_subgraphs);
 
     void for_each_chain(
             HandleGraph& graph,
             const function<void(chain_t& chain)>& f);
 
     void for_each_chain_subgraph(
-            HandleGraph& graph,
-            const function<void(PackedSubgraphOverlay& chain)>& f);
+            const HandleGraph& graph,
+            ChainTraversalContext& context,
+            const function<void(const uint32_t* begin, const uint32_t* end)>& f);
 
     void generate_chain_paths(
             MutablePathDeletableHandleGraph& graph,
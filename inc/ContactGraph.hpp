@@ -2,6 +2,7 @@
 #define GFASE_CONTACTGRAPH_HPP
 
 #include "IncrementalIdMap.hpp"
+#include "Random.hpp"
 #include "handlegraph/handle_graph.hpp"
 #include "bdsg/hash_graph.hpp"
 #include "sparsepp/spp.h"
@@ -116,7 +117,7 @@ public:
     double compute_consistency_score(int32_t id) const;
     void get_partitions(vector <pair <int32_t,int8_t> >& partitions) const;
     void set_partitions(const vector <pair <int32_t,int8_t> >& partitions);
-    void randomize_partitions();
+    void randomize_partitions(SplitMix64& rng);
 
     // Misc
     void write_bandage_csv(path output_path, IncrementalIdMap<string>& id_map) const;
@@ -134,7 +135,8 @@ void random_phase_search(
         atomic<double>& best_score,
         atomic<size_t>& job_index,
         mutex& phase_mutex,
-        size_t m_iterations);
+        size_t m_iterations,
+        SplitMix64 rng);
 
 }
 
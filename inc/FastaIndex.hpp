@@ -0,0 +1,85 @@
+#ifndef GFASE_FASTAINDEX_HPP
+#define GFASE_FASTAINDEX_HPP
+
+#include "Filesystem.hpp"
+
+using ghc::filesystem::path;
+
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::unordered_map;
+using std::function;
+using std::string;
+using std::vector;
+
+
+namespace gfase{
+
+
+/// One line of a samtools-style .fai index, plus the number of bytes that the sequence occupies in the FASTA
+class FastaRecord{
+public:
+    string name;
+
+    // Number of bases in the sequence
+    uint64_t length;
+
+    // Byte offset of the first base
+    uint64_t offset;
+
+    // Bases per line, and bytes per line including the line terminator
+    uint64_t line_bases;
+    uint64_t line_width;
+
+    // Bytes from the first base to the end of the last line of sequence, including its terminator (if any)
+    uint64_t n_bytes;
+
+    FastaRecord();
+};
+
+
+/// Index of the records in a FASTA. It is loaded from an existing .fai if one is newer than the FASTA, otherwise it is
+/// built by scanning the memory-mapped FASTA over n_threads. Records can be copied to other files as raw byte ranges,
+/// so sequences are never parsed or held in memory.
+class FastaIndex{
+    path fasta_path;
+    vector<FastaRecord> records;
+    unordered_map<string,size_t> record_indexes;
+
+    // Every record has lines of the same width (except its last line), which is required to write a .fai
+    bool is_uniform;
+
+    void build(size_t n_threads);
+    void add_record(FastaRecord& record);
+
+public:
+    /// \param fasta_path
+    /// \param n_threads Number of threads used to scan the FASTA, if there is no usable .fai
+    /// \param save_fai Save the index next to the FASTA after building it, so that it can be reused
+    FastaIndex(path fasta_path, size_t n_threads=1, bool save_fai=true);
+
+    static path get_fai_path(path fasta_path);
+
+    void load_fai(path fai_path);
+    void write_fai(path fai_path) const;
+
+    size_t size() const;
+    bool has_record(const string& name) const;
+    const FastaRecord& get_record(const string& name) const;
+
+    /// Iterate the records in the order they appear in the FASTA
+    void for_each_record(const function<void(const FastaRecord& record)>& f) const;
+
+    /// Copy every (non-empty) record that passes the filter to a new FASTA, in the order they appear in this one. The
+    /// header is reduced to the name, and the sequence lines are copied byte-for-byte by the kernel where possible.
+    void write_records(path output_path, const function<bool(const FastaRecord& record)>& filter) const;
+};
+
+
+}
+
+#endif //GFASE_FASTAINDEX_HPP
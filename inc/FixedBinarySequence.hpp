@@ -6,6 +6,7 @@
 #include "MurmurHash2.hpp"
 
 #include <type_traits>
+#include <cstring>
 #include <ostream>
 #include <vector>
 #include <bitset>
@@ -19,6 +20,7 @@ using std::runtime_error;
 using std::is_integral;
 using std::to_string;
 using std::ostream;
+using std::memcpy;
 using std::vector;
 using std::bitset;
 using std::string;
@@ -30,6 +32,32 @@ using std::cerr;
 
 namespace gfase {
 
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "ERROR: packed sequence kernels assume a little endian target");
+#endif
+
+
+/// Pack n bases of uppercase ACGT into 2-bit codes, 32 per word starting from the least significant bits, which on a
+/// little endian machine is the same memory layout as FixedBinarySequence for any word type. Uses AVX2 or SSSE3 when
+/// the build targets them. Writes ceil(n/32) words and returns the index of the first non-ACGT character, or n if
+/// there is none, in which case the codes from that index onwards are unspecified.
+size_t encode_bases(const char* sequence, size_t n, uint64_t* words);
+
+/// Reverse complement `length` packed bases into ceil(length/32) words of `result`, which must not overlap `words`.
+/// Padding bits past the end of the input are ignored and padding in the result is zeroed.
+void reverse_complement_bases(const uint64_t* words, size_t length, uint64_t* result);
+
+
+/// Reverse complement all 32 bases of a packed word: complement every code and reverse the order of the 2-bit fields
+inline uint64_t reverse_complement_word(uint64_t word){
+    word = ~word;
+    word = ((word >> 2) & 0x3333333333333333) | ((word & 0x3333333333333333) << 2);
+    word = ((word >> 4) & 0x0F0F0F0F0F0F0F0F) | ((word & 0x0F0F0F0F0F0F0F0F) << 4);
+
+    return __builtin_bswap64(word);
+}
+
+
 /// For any operation involving "length", length must be less than 2*bitcount(T)*T2 because each
 /// nucleotide takes two bits to store in binary.
 /// \tparam T integer type to use as word storage
@@ -42,9 +70,14 @@ public:
     static const array<char,4> index_to_base;
     static const array<uint16_t,128> base_to_index;
 
+    /// Max number of bases, and the number of 64-bit words spanned by the storage array (for the packed kernels)
+    static constexpr size_t capacity = sizeof(T)*T2*4;
+    static constexpr size_t n_packed_words = (sizeof(T)*T2 + 7)/8;
+
     /// Methods ///
     FixedBinarySequence();
     FixedBinarySequence(const FixedBinarySequence& s);
+    FixedBinarySequence(const string& s);
     template <class T3> FixedBinarySequence(const T3& s);
     template <class T3> FixedBinarySequence(const BinarySequence<T3>& s, size_t fixed_length);
     void get_reverse_complement(FixedBinarySequence<T,T2>& rc, size_t length) const;
@@ -96,6 +129,27 @@ template <class T, size_t T2> FixedBinarySequence<T,T2>::FixedBinarySequence(con
 {}
 
 
+/// Contiguous sequences are encoded in bulk, see encode_bases
+template<class T, size_t T2> FixedBinarySequence<T,T2>::FixedBinarySequence(const string& s):
+    sequence({})
+{
+    static_assert(is_integral<T>::value, "ERROR: provided type for FixedBinarySequence is not integer");
+
+    if (s.size() > capacity){
+        throw runtime_error("ERROR: sequence of length " + std::to_string(s.size()) + " exceeds FixedBinarySequence capacity of " + std::to_string(capacity));
+    }
+
+    array<uint64_t,n_packed_words> words = {};
+    auto i = encode_bases(s.data(), s.size(), words.data());
+
+    if (i < s.size()){
+        throw runtime_error("ERROR: non ACGT character encountered in sequence: " + string(1,s[i]) + " (ord=" + std::to_string(int(s[i])) + ")");
+    }
+
+    memcpy(sequence.data(), words.data(), sizeof(sequence));
+}
+
+
 template<class T, size_t T2> template <class T3> FixedBinarySequence<T,T2>::FixedBinarySequence(const T3& s):
     sequence({})  // Bracket initializer ensures the array is filled with zeros
 {
@@ -171,74 +225,46 @@ template<class T, size_t T2> template <class T3> FixedBinarySequence<T,T2>::Fixe
 /// \tparam T
 /// \param c
 template <class T, size_t T2> void FixedBinarySequence<T,T2>::shift(char c, size_t length){
-    T bits = base_to_index.at(c);
+    uint64_t bits = (uint8_t(c) < base_to_index.size()) ? base_to_index[c] : 4;
 
     if (bits == 4){
         throw runtime_error("ERROR: non ACGT character encountered in sequence: " + string(1,c) + " (ord=" + std::to_string(int(c)) + ")");
     }
 
-    for (size_t i=0; i<sequence.size(); i++){
-        if (i > 0) {
-            T mask = 3;
-//            cerr << bitset<sizeof(T)*8>(mask) << '\n';
-//            cerr << '\n';
+    // Shift the whole array down by one base as 64-bit words, regardless of T
+    array<uint64_t,n_packed_words> words = {};
+    memcpy(words.data(), sequence.data(), sizeof(sequence));
 
-            T leftover = sequence[i] & mask;
-//            cerr << bitset<sizeof(T)*8>(sequence[i]) << '\n';
-//            cerr << bitset<sizeof(T)*8>(leftover) << '\n';
-
-            leftover <<= sizeof(T)*8 - 2;
-//            cerr << bitset<sizeof(T)*8>(leftover) << '\n';
-//            cerr << '\n';
-//
-//            cerr << bitset<sizeof(T)*8>(sequence[i-1]) << '\n';
-//            cerr << bitset<sizeof(T)*8>(T(pow(2,sizeof(T)*8 - 2) - 1)) << '\n';
-            sequence[i-1] &= T(pow(2,sizeof(T)*8 - 2) - 1);
-//            cerr << bitset<sizeof(T)*8>(sequence[i-1]) << '\n';
-
-            sequence[i-1] |= leftover;
-//            cerr << bitset<sizeof(T)*8>(sequence[i-1]) << '\n';
-//
-//            cerr << '\n';
-//            cerr << '\n';
+    for (size_t i=0; i<words.size(); i++){
+        words[i] >>= 2;
 
+        if (i + 1 < words.size()){
+            words[i] |= words[i+1] << 62;
         }
-        sequence[i] >>= 2;
     }
 
-    uint8_t shift_size = (2*(length-1)) % (sizeof(T)*8);
+    words[(length-1)/32] |= bits << 2*((length-1) % 32);
 
-    bits <<= shift_size;
-
-    sequence.back() |= bits;
+    memcpy(sequence.data(), words.data(), sizeof(sequence));
 }
 
 
 /// Make a new binary sequence with the reverse complement of this one
 template <class T, size_t T2> void FixedBinarySequence<T,T2>::get_reverse_complement(FixedBinarySequence<T,T2>& rc, size_t length) const{
-    if (sequence.empty()){
+    if (length == 0){
         return;
     }
 
-    T mask = 3;
-    size_t bp_per_word = (sizeof(T)*8)/2;
-    T word;
-
-    for (size_t i=0; i<length; i++){
-        if (i % bp_per_word == 0) {
-            word = sequence[i/bp_per_word];
-        }
-
-        // Get the last 2 bits
-        auto bits = word & mask;
+    if (length > capacity){
+        throw runtime_error("ERROR: cannot reverse complement " + std::to_string(length) + " bases in FixedBinarySequence with capacity " + std::to_string(capacity));
+    }
 
-        // Shift the RC bits over and add the complement of the forward bits
-        rc.sequence[(length - i - 1)/bp_per_word] <<= 2;
-        rc.sequence[(length - i - 1)/bp_per_word] |= 3 - bits;
+    array<uint64_t,n_packed_words> words = {};
+    array<uint64_t,n_packed_words> result = {};
 
-        // Advance the bits of the forward complement
-        word >>= 2;
-    }
+    memcpy(words.data(), sequence.data(), sizeof(sequence));
+    reverse_complement_bases(words.data(), length, result.data());
+    memcpy(rc.sequence.data(), result.data(), sizeof(sequence));
 }
 
 
@@ -275,6 +301,68 @@ template<class T, size_t T2> void get_reverse_complement(const FixedBinarySequen
 }
 
 
+/// Encode every kmer of a sequence by packing the sequence once and then slicing each kmer out of the packed words,
+/// instead of encoding it base by base. Windows which contain a non-ACGT character are skipped. Kmers are appended to
+/// `kmers` and their start indexes in the sequence to `positions`.
+template<class T, size_t T2> void extract_kmers(
+        const string& sequence,
+        size_t k,
+        vector<FixedBinarySequence<T,T2> >& kmers,
+        vector<size_t>& positions){
+
+    using Kmer = FixedBinarySequence<T,T2>;
+
+    if (k == 0 or k > Kmer::capacity){
+        throw runtime_error("ERROR: cannot extract kmers of length " + std::to_string(k) + " into FixedBinarySequence with capacity " + std::to_string(Kmer::capacity));
+    }
+
+    // Extra words so that the last kmer can always be read as n_packed_words + 1 words
+    vector<uint64_t> words(sequence.size()/32 + Kmer::n_packed_words + 1, 0);
+    array<uint64_t,Kmer::n_packed_words> kmer_words;
+
+    size_t start = 0;
+
+    while (start + k <= sequence.size()){
+        // Encode up to the next non-ACGT character
+        size_t stop = start + encode_bases(sequence.data() + start, sequence.size() - start, words.data());
+
+        for (size_t i=start; i + k <= stop; i++){
+            size_t offset = 2*(i - start);
+            size_t p = offset/64;
+            size_t b = offset%64;
+
+            for (size_t w=0; w<kmer_words.size(); w++){
+                kmer_words[w] = words[p + w] >> b;
+
+                if (b > 0){
+                    kmer_words[w] |= words[p + w + 1] << (64 - b);
+                }
+
+                // Clear anything past the end of the kmer
+                if (2*k <= 64*w){
+                    kmer_words[w] = 0;
+                }
+                else if (2*k < 64*(w + 1)){
+                    kmer_words[w] &= (uint64_t(1) << (2*k - 64*w)) - 1;
+                }
+            }
+
+            kmers.emplace_back();
+            memcpy(kmers.back().sequence.data(), kmer_words.data(), sizeof(kmers.back().sequence));
+            positions.emplace_back(i);
+        }
+
+        start = stop + 1;
+    }
+}
+
+
+template<class T, size_t T2> void extract_kmers(const string& sequence, size_t k, vector<FixedBinarySequence<T,T2> >& kmers){
+    vector<size_t> positions;
+    extract_kmers(sequence, k, kmers, positions);
+}
+
+
 }
 
 
@@ -25,6 +25,8 @@ using std::string;
 
 namespace gfase {
 
+struct ChainableComponentPlan;
+
 class HamiltonianChainer : public AbstractChainer {
 public:
     
@@ -51,6 +53,10 @@ public:
     // phased haploid sequence
     double min_haploid_proportion = 0.1;
     
+    // the number of threads used to find bridges and analyze bridge components. the paths
+    // are still added to the graph on a single thread
+    size_t n_threads = 1;
+    
 private:
     
     // keep track of which of the paths are the phase paths we added
@@ -75,6 +81,15 @@ private:
                                                                         const unordered_set<handle_t>& ends,
                                                                         bool& resolved_hamiltonian) const;
     
+    // find the chainable components within one bridge component, without modifying the graph
+    void analyze_bridge_component(const HandleGraph& graph,
+                                  const HandleGraph& bridge_component,
+                                  const vector<pair<size_t, bool>>& incident_bridges,
+                                  const vector<vector<handle_t>>& unipath_bridges,
+                                  const IncrementalIdMap<string>& id_map,
+                                  const MultiContactGraph& contact_graph,
+                                  ChainableComponentPlan& plan) const;
+    
     // generate the path names we use to mark haplotypes
     static string phase_path_name(int haplotype, int path_id);
     
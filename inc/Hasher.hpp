@@ -92,7 +92,7 @@ private:
 
 public:
     Hasher(size_t k, double sample_rate, size_t n_iterations, size_t n_threads);
-    static uint64_t hash(const BinarySequence<uint64_t>& kmer, size_t seed_index);
+    static uint64_t hash(const SmallBinarySequence<1>& kmer, size_t seed_index);
     void write_hash_frequency_distribution(const hash_bins_t& bins) const;
     void hash_sequences(const vector<Sequence>& sequences, atomic<size_t>& job_index);
     void hash(const vector<Sequence>& sequences);
@@ -123,7 +123,7 @@ public:
     Hasher2(size_t k, double sample_rate, size_t n_iterations, size_t n_threads);
 
     // Main algorithm
-    uint64_t hash(const BinarySequence<uint64_t>& kmer, size_t seed_index) const;
+    uint64_t hash(const SmallBinarySequence<1>& kmer, size_t seed_index) const;
     void hash_sequences(const vector<Sequence>& sequences, atomic<size_t>& job_index, size_t hash_index);
     void hash(const vector<Sequence>& sequences);
     void hash(const HandleGraph& graph, const IncrementalIdMap<string>& id_map);
@@ -5,6 +5,8 @@
 
 using ghc::filesystem::path;
 
+#include <string_view>
+#include <functional>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -12,6 +14,8 @@ using ghc::filesystem::path;
 #include <unordered_map>
 #include <memory>
 
+using std::string_view;
+using std::function;
 using std::ofstream;
 using std::ifstream;
 using std::string;
@@ -195,5 +199,64 @@ template<class T> T IncrementalIdMap<T>::get_name(int64_t id) const{
 }
 
 
+/// Specialization for string names, which is what every GFAse tool uses. Each name is stored once, in one contiguous
+/// arena, and the reverse mapping is an open addressing table of indexes into that arena, so names can be looked up
+/// and returned as string_view without allocating. The binary file written by write_to_binary has the same layout as
+/// the map in memory (with 8-byte aligned sections), so it loads without rehashing and can be memory-mapped directly.
+template <> class IncrementalIdMap<string> {
+    // All names, back to back, where name i occupies [offsets[i], offsets[i+1])
+    vector<char> arena;
+    vector<uint64_t> offsets;
+
+    // Hash table of name index + 1, or 0 for an empty slot. Size is a power of 2 and at most half full.
+    vector<uint32_t> slots;
+
+    static const uint64_t seed = 14741;
+    static const uint64_t version = 1;
+    static const char magic[8];
+
+    static uint64_t hash(string_view name);
+    size_t find_slot(string_view name) const;
+    void grow();
+
+    void load_csv(path csv_path);
+
+public:
+    /// Attributes ///
+
+    bool zero_based;
+
+    /// Methods ///
+
+    IncrementalIdMap(bool zero_based=false);
+
+    // Reads either a CSV written by write_to_csv or a binary file written by write_to_binary
+    IncrementalIdMap(path input_path);
+
+    // Add a node ID to the running list, do whatever needs to be done to make sure the mapping is reversible, and then
+    // return its incremental ID, based on the number of nodes added so far
+    int64_t insert(string_view s);
+    int64_t try_insert(string_view s);
+    int64_t do_insert(string_view s);
+
+    // Find the original node ID from its integer ID. The view is invalidated by any later insert.
+    string get_name(int64_t id) const;
+    string_view get_name_view(int64_t id) const;
+    int64_t get_id(string_view name) const;
+
+    // Check if key/value has been added already, returns true if it exists
+    bool exists(string_view name) const;
+    bool exists(int64_t id) const;
+
+    // Iterate names in order of insertion. If f inserts names, they are also visited, and any view it holds is invalidated.
+    void for_each_name(const function<void(string_view name, int64_t id)>& f) const;
+
+    void write_to_csv(path output_path) const;
+    void write_to_binary(path output_path) const;
+    void load_binary(path input_path);
+    size_t size() const;
+};
+
+
 }
 #endif //GFASE_INCREMENTALID_HPP
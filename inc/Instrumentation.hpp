@@ -0,0 +1,110 @@
+#ifndef GFASE_INSTRUMENTATION_HPP
+#define GFASE_INSTRUMENTATION_HPP
+
+#include "Filesystem.hpp"
+#include "Timer.hpp"
+
+using ghc::filesystem::path;
+
+#include <condition_variable>
+#include <iostream>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <map>
+
+using std::condition_variable;
+using std::atomic;
+using std::string;
+using std::thread;
+using std::vector;
+using std::mutex;
+using std::map;
+
+
+namespace gfase{
+
+
+class SpanRecord{
+public:
+    string name;
+
+    // Number of spans that were open when this one started
+    size_t depth;
+
+    // Seconds since the Instrumentation was constructed
+    double start;
+    double elapsed;
+
+    bool is_open;
+
+    SpanRecord(const string& name, size_t depth, double start);
+};
+
+
+/// Named timing spans, counters and gauges for a whole pipeline run, so that stages can be compared across runs.
+/// Counters are atomic and can be fetched once and then incremented from any thread without locking. One process-wide
+/// instance is available with Instrumentation::global(), so library code can count work without extra parameters.
+class Instrumentation{
+    Timer timer;
+    steady_clock::time_point start;
+
+    mutable mutex m;
+
+    // std::map nodes are never moved, so references to the atomics remain valid as counters are added
+    map <string, atomic<uint64_t> > counters;
+    map <string, double> gauges;
+
+    vector <SpanRecord> spans;
+
+    // Indexes (in spans) of the spans that are currently open, innermost last
+    vector <size_t> open_spans;
+
+    // Periodic progress reporting
+    thread progress_thread;
+    condition_variable progress_condition;
+    bool stop_requested;
+
+    double get_seconds() const;
+    void print_progress(map<string,uint64_t>& prev_counts, double interval);
+
+public:
+    Instrumentation();
+    ~Instrumentation();
+
+    static Instrumentation& global();
+
+    atomic<uint64_t>& get_counter(const string& name);
+    void increment(const string& name, uint64_t n=1);
+    void set_gauge(const string& name, double value);
+
+    size_t begin_span(const string& name);
+    void end_span(size_t index);
+
+    void start_progress(double interval_seconds);
+    void stop_progress();
+
+    void write_json(path output_path) const;
+    void write_tsv(path output_path) const;
+    void write_report(path output_dir) const;
+
+    void clear();
+};
+
+
+/// Opens a span on construction and closes it when it goes out of scope
+class ScopedSpan{
+    Instrumentation& instrumentation;
+    size_t index;
+
+public:
+    ScopedSpan(const string& name, Instrumentation& instrumentation=Instrumentation::global());
+    ~ScopedSpan();
+};
+
+
+}
+
+#endif //GFASE_INSTRUMENTATION_HPP
@@ -2,6 +2,7 @@
 #define GFASE_MULTICONTACTGRAPH_HPP
 
 #include "IncrementalIdMap.hpp"
+#include "Random.hpp"
 
 #include "handlegraph/handle_graph.hpp"
 #include "bdsg/hash_graph.hpp"
@@ -151,7 +152,7 @@ public:
     double compute_consistency_score(alt_component_t& component) const;
     void get_partitions(vector <pair <int32_t,int8_t> >& partitions) const;
     void set_partitions(const vector <pair <int32_t,int8_t> >& partitions);
-    void randomize_partitions();
+    void randomize_partitions(SplitMix64& rng);
 
     // IO
     void write_contact_map(path output_path, const IncrementalIdMap<string>& id_map) const;
@@ -0,0 +1,75 @@
+#ifndef GFASE_OVERLAPMATCHER_HPP
+#define GFASE_OVERLAPMATCHER_HPP
+
+#include "MultiContactGraph.hpp"
+
+#include <functional>
+#include <cstdint>
+#include <vector>
+#include <queue>
+
+using std::priority_queue;
+using std::function;
+using std::greater;
+using std::vector;
+
+
+namespace gfase {
+
+
+/// Greedy symmetrical matching of an alignment graph, as used by get_best_overlaps. Edges are visited in passes, in
+/// order of descending weight. An edge is accepted if each endpoint is the other's heaviest uncovered neighbor and the
+/// alignment fits within both nodes' lengths. Accepted edges add their weight to both nodes' coverage, and are removed
+/// from the graph at the end of the pass. Passes repeat until one accepts nothing.
+///
+/// Rather than rescanning every edge in every pass, the edges are sorted once, and each node's neighbors are kept in
+/// order of weight behind a cursor which skips entries that can never be its best again (removed edges and covered
+/// neighbors). A pass only revisits the mutually-best edges whose endpoints changed since they were last tested, so
+/// the total work is O(E log E). The accepted edges are the same, and in the same order, as in the full rescan.
+class OverlapMatcher {
+    // Node attributes, indexed by rank of node id
+    vector<int32_t> ids;
+    vector<int32_t> lengths;
+    vector<int64_t> coverages;
+
+    // Edges as (smaller id index, larger id index), sorted by descending weight, then ascending ids
+    vector <pair <uint32_t, uint32_t> > edges;
+    vector<int32_t> weights;
+    vector<char> is_alive;
+
+    // Each node's edges sorted by descending weight, then ascending neighbor id, as a flattened adjacency list
+    vector<size_t> incident_offsets;
+    vector<uint32_t> incident_edges;
+    vector<size_t> cursors;
+
+    // Edges to (re)test in this pass and the next, by position in the sorted order
+    priority_queue <uint32_t, vector<uint32_t>, greater<uint32_t> > current_queue;
+    priority_queue <uint32_t, vector<uint32_t>, greater<uint32_t> > next_queue;
+    vector<uint64_t> queued_pass;
+    uint64_t pass;
+    int64_t position;
+
+    static const uint32_t none = UINT32_MAX;
+
+    uint32_t get_other(uint32_t e, uint32_t n) const;
+    bool is_covered(uint32_t n) const;
+    uint32_t get_best_edge(uint32_t n);
+    void enqueue(uint32_t e);
+    void enqueue_best_edge(uint32_t n);
+
+public:
+    explicit OverlapMatcher(const MultiContactGraph& alignment_graph);
+
+    /// Run all passes, calling f for each accepted edge in order, where a is the longer node (or the larger id if the
+    /// lengths are equal). The alignment graph itself is not modified.
+    void match(
+            double min_similarity,
+            double overflow_tolerance,
+            double first_node_penalty,
+            const function<void(int32_t a, int32_t b, int32_t weight)>& f);
+};
+
+
+}
+
+#endif //GFASE_OVERLAPMATCHER_HPP
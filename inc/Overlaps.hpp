@@ -59,6 +59,8 @@ class Cigar {
 public:
     // parse a CIGAR string
     Cigar(const string& cigar_string);
+    // copy a range of operations
+    Cigar(std::vector<CigarOperation>::const_iterator begin, std::vector<CigarOperation>::const_iterator end);
     Cigar() = default;
     ~Cigar() = default;
     
@@ -90,11 +92,13 @@ private:
 };
 
 /*
- * Records overlaps between nodes of a graph
+ * Records overlaps between nodes of a graph. Blunt edges are not stored at all. The rest are keyed by a packed 64-bit
+ * edge id, and a simple overlap (a single M operation) is stored inline as its length. Any other CIGAR is stored as a
+ * range of operations in a shared arena.
  */
 class Overlaps {
 public:
-    Overlaps() = default;
+    Overlaps();
     ~Overlaps() = default;
     
     // record an overlap, ignores "*" and "0M" alignments
@@ -114,9 +118,32 @@ public:
     // recorded, then returns an empty CIGAR
     Cigar get_overlap(const HandleGraph& graph, handle_t a, handle_t b) const;
     
+    // the length in a and b of the (oriented) overlap of a onto b, same as
+    // get_overlap(graph, a, b).aligned_length() but without building the CIGAR
+    pair<size_t, size_t> get_aligned_length(const HandleGraph& graph, handle_t a, handle_t b) const;
+    
 private:
     
-    unordered_map<edge_t, Cigar> overlaps;
+    // The high bit of a value marks a CIGAR in the arena, with its offset in the lower 40 bits and its number of
+    // operations in the next 22. The next bit is set if it was recorded in the opposite orientation to the key.
+    // Otherwise the value is the length of a single M operation, which is the same in both orientations.
+    static const uint64_t arena_flag = uint64_t(1) << 63;
+    static const uint64_t reversal_flag = uint64_t(1) << 62;
+    static const uint64_t offset_mask = (uint64_t(1) << 40) - 1;
+    static const uint64_t count_mask = (uint64_t(1) << 22) - 1;
+    
+    // pack an edge, in the canonical orientation given by edge_handle, into one integer
+    static uint64_t get_key(const HandleGraph& graph, const edge_t& edge);
+    
+    // true if the overlap of a onto b has to be reversed from how it is stored
+    bool is_reversed(const HandleGraph& graph, handle_t a, handle_t b, uint64_t value) const;
+    
+    void set_value(uint64_t key, uint64_t value);
+    void compact();
+    
+    unordered_map<uint64_t, uint64_t> overlaps;
+    vector<CigarOperation> operations;
+    size_t n_dead_operations;
 };
 
 
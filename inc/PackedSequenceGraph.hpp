@@ -0,0 +1,78 @@
+#ifndef GFASE_PACKEDSEQUENCEGRAPH_HPP
+#define GFASE_PACKEDSEQUENCEGRAPH_HPP
+
+#include "PackedSequenceStore.hpp"
+
+#include "bdsg/hash_graph.hpp"
+
+#include <string>
+#include <vector>
+
+using bdsg::HashGraph;
+using bdsg::handle_t;
+using bdsg::nid_t;
+using std::string;
+using std::vector;
+
+
+namespace gfase {
+
+
+/**
+ * A HashGraph whose node sequences are held 2-bit packed in a PackedSequenceStore instead of one std::string per
+ * node. Topology and paths are untouched, so it can be used anywhere a HashGraph or handle graph interface is
+ * expected. Node IDs are used as keys in the store, so they must stay dense (as assigned by IncrementalIdMap), and
+ * methods which renumber nodes are not supported. Unlike HashGraph, reverse strand sequence is complemented with
+ * PackedSequenceStore::complement, so lowercase and IUPAC codes keep their case and complement instead of becoming N.
+ */
+class PackedSequenceGraph : public HashGraph {
+    PackedSequenceStore sequences;
+
+public:
+    PackedSequenceGraph() = default;
+
+    /// Create a new node with the given sequence and return the handle
+    handle_t create_handle(const string& sequence) override;
+
+    /// Create a new node with the given id and sequence, then return the handle
+    handle_t create_handle(const string& sequence, const nid_t& id) override;
+
+    /// Remove the node belonging to the given handle and all of its edges
+    void destroy_handle(const handle_t& handle) override;
+
+    /// Alter the node that the given handle corresponds to so the orientation indicated by the handle becomes the
+    /// node's local forward orientation, and return the new handle
+    handle_t apply_orientation(const handle_t& handle) override;
+
+    /// Not supported, throws
+    vector<handle_t> divide_handle(const handle_t& handle, const vector<size_t>& offsets) override;
+    using HashGraph::divide_handle;
+
+    /// Remove all nodes, edges and paths
+    void clear() override;
+
+    /// Get the length of a node
+    size_t get_length(const handle_t& handle) const override;
+
+    /// Get the sequence of a node, presented in the handle's local forward orientation
+    string get_sequence(const handle_t& handle) const override;
+
+    /// Get a single base of the sequence, in the handle's local forward orientation
+    char get_base(const handle_t& handle, size_t index) const override;
+
+    /// Get up to size bases starting at index, in the handle's local forward orientation
+    string get_subsequence(const handle_t& handle, size_t index, size_t size) const override;
+
+    /// Zero-copy access to the packed forward sequence of a node, valid until the graph is modified
+    PackedSequenceView get_packed_sequence(const handle_t& handle) const;
+
+    /// Append the sequence of a node to s, in the handle's local forward orientation, so that a buffer can be reused
+    void decode_sequence(const handle_t& handle, string& s) const;
+
+    const PackedSequenceStore& get_sequence_store() const;
+};
+
+
+}
+
+#endif //GFASE_PACKEDSEQUENCEGRAPH_HPP
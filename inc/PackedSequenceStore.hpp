@@ -0,0 +1,120 @@
+#ifndef GFASE_PACKEDSEQUENCESTORE_HPP
+#define GFASE_PACKEDSEQUENCESTORE_HPP
+
+#include <string_view>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+
+using std::string_view;
+using std::string;
+using std::vector;
+using std::array;
+
+
+namespace gfase {
+
+
+class PackedSequenceStore;
+
+
+/// A run of identical positions in the packed arena, used for bases that can't be represented with 2 bits
+class PackedRun {
+public:
+    uint64_t start;
+    uint64_t length;
+    char c;
+
+    uint64_t stop() const;
+};
+
+
+/// A non-owning view of one packed sequence. It is valid until the store that it came from is modified.
+class PackedSequenceView {
+    const PackedSequenceStore* store;
+    uint64_t start;
+    uint64_t length;
+
+public:
+    PackedSequenceView(const PackedSequenceStore* store, uint64_t start, uint64_t length);
+
+    size_t size() const;
+
+    // The raw 2-bit packing, in the same A=0,C=1,G=2,T=3 order as BinarySequence: with p = get_bit_offset()/2 + i,
+    // base i is at bit 2*(p%32) of get_words()[p/32]. Exceptions (anything other than ACGT/acgt) are packed as A.
+    const uint64_t* get_words() const;
+    uint64_t get_bit_offset() const;
+    uint8_t get_base_index(size_t index) const;
+
+    // True if the 2-bit codes alone describe the sequence (up to case)
+    bool is_acgt() const;
+
+    // Single base, including exceptions and case
+    char operator[](size_t index) const;
+
+    // Bulk decoding, appended to s
+    void decode(string& s, size_t index, size_t n, bool reverse_complement=false) const;
+    void decode(string& s, bool reverse_complement=false) const;
+};
+
+
+/// Node sequences packed at 2 bits per base in one shared arena, with run length encoded exception lists for anything
+/// that isn't ACGT (N, IUPAC codes, etc.) and for soft-masked (lowercase) bases, so that every sequence round trips
+/// exactly. Sequences are keyed by a dense non-negative id, as assigned by IncrementalIdMap. Replaced or removed
+/// sequences leave garbage in the arena, which is compacted once it outweighs the live sequence.
+class PackedSequenceStore {
+    friend class PackedSequenceView;
+
+    class Record {
+    public:
+        uint64_t start;
+        uint64_t length;
+    };
+
+    static const uint64_t absent = UINT64_MAX;
+
+    vector<uint64_t> words;
+    uint64_t n_bases;
+
+    // Sorted and non-overlapping, by position in the arena
+    vector<PackedRun> exceptions;
+    vector<PackedRun> lowercase;
+
+    vector<Record> records;
+    size_t n_sequences;
+    uint64_t n_dead_bases;
+
+    void append_base(uint8_t code);
+    void append_code_word(uint64_t word, size_t n);
+    uint64_t get_code_word(uint64_t position) const;
+    void compact();
+
+public:
+    static const array<uint8_t,256> base_to_code;
+    static const array<char,256> complement;
+
+    PackedSequenceStore();
+
+    // Add a sequence, replacing any existing sequence with this id
+    void insert(int64_t id, string_view sequence);
+    void remove(int64_t id);
+    void clear();
+
+    bool has_sequence(int64_t id) const;
+    size_t get_length(int64_t id) const;
+    PackedSequenceView get_view(int64_t id) const;
+
+    // Replaces the contents of s
+    void get_sequence(int64_t id, string& s, bool reverse_complement=false) const;
+
+    size_t size() const;
+
+    // Heap memory used by the arena, exceptions and records
+    size_t get_byte_size() const;
+};
+
+
+}
+
+#endif //GFASE_PACKEDSEQUENCESTORE_HPP
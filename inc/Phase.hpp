@@ -392,21 +392,19 @@ void phase(path gfa_path, size_t k, path paternal_kmers, path maternal_kmers, pa
     sparse_hash_map <FixedBinarySequence<T,T2>, size_t> unphased_kmer_counts;
     Coolwarm colormap;
 
+    vector <FixedBinarySequence<T,T2> > kmers;
+
     // Count k-mers, so we can later eliminate non-unique ones
     for (size_t c=0; c<connected_components.size(); c++){
         auto& cc_graph = connected_components[c];
 
         for (auto& h: unphased_handles_per_component[c]){
-            size_t contig_length = cc_graph.get_length(h);
-
             string sequence = cc_graph.get_sequence(h);
-            string initial_kmer = sequence.substr(0,k);
-            FixedBinarySequence<T,T2> kmer(initial_kmer);
 
-            unphased_kmer_counts[kmer]++;
+            kmers.clear();
+            extract_kmers(sequence, k, kmers);
 
-            for (size_t i = k; i<contig_length; i++){
-                kmer.shift(sequence[i], k);
+            for (auto& kmer: kmers){
                 unphased_kmer_counts[kmer]++;
             }
         }
@@ -438,18 +436,17 @@ void phase(path gfa_path, size_t k, path paternal_kmers, path maternal_kmers, pa
             auto name = cc_id_map.get_name(cc_graph.get_id(h));
 
             string sequence = cc_graph.get_sequence(h);
-            string initial_kmer = sequence.substr(0,k);
-            FixedBinarySequence<T,T2> kmer(initial_kmer);
 
-            double maternal_count = ks.is_maternal(kmer);
-            double paternal_count = ks.is_paternal(kmer);
+            kmers.clear();
+            extract_kmers(sequence, k, kmers);
 
-            double unique_maternal_count = ks.is_maternal(kmer) and unique_kmers.contains(kmer);
-            double unique_paternal_count = ks.is_paternal(kmer) and unique_kmers.contains(kmer);
+            double maternal_count = 0;
+            double paternal_count = 0;
 
-            for (size_t i = k; i<cc_graph.get_length(h); i++){
-                kmer.shift(sequence[i], k);
+            double unique_maternal_count = 0;
+            double unique_paternal_count = 0;
 
+            for (auto& kmer: kmers){
                 bool is_mat = ks.is_maternal(kmer);
                 bool is_pat = ks.is_paternal(kmer);
 
@@ -0,0 +1,91 @@
+#ifndef GFASE_RANDOM_HPP
+#define GFASE_RANDOM_HPP
+
+#include <cstdint>
+#include <limits>
+
+using std::numeric_limits;
+
+
+namespace gfase{
+
+
+/// Stateless SplitMix64 finalizer, used to decorrelate seeds and stream ids
+inline uint64_t mix64(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+/// Counter-based generator (SplitMix64). Each output is a pure function of (seed, stream, counter), so a stream can be
+/// assigned to each sample/replica/component rather than to each thread, which makes results independent of thread
+/// count and scheduling. Satisfies UniformRandomBitGenerator, so it can also be passed to std distributions.
+class SplitMix64{
+    uint64_t state;
+
+public:
+    using result_type = uint64_t;
+
+    static constexpr uint64_t increment = 0x9e3779b97f4a7c15ULL;
+
+    SplitMix64(uint64_t seed, uint64_t stream=0);
+
+    // Generate a new independent generator, seeded by the next output of this one
+    SplitMix64 split();
+
+    static constexpr result_type min() {return numeric_limits<result_type>::min();}
+    static constexpr result_type max() {return numeric_limits<result_type>::max();}
+
+    inline result_type operator()();
+
+    // Uniform integer in [0,n), using Lemire's multiply-shift method (no division in the common case)
+    inline uint64_t bounded(uint64_t n);
+
+    // Uniform double in [0,1)
+    inline double uniform();
+};
+
+
+SplitMix64::result_type SplitMix64::operator()(){
+    state += increment;
+    return mix64(state);
+}
+
+
+uint64_t SplitMix64::bounded(uint64_t n){
+    auto x = (*this)();
+    auto m = __uint128_t(x) * __uint128_t(n);
+    auto l = uint64_t(m);
+
+    if (l < n){
+        // Reject the small biased region at the bottom of the range
+        uint64_t threshold = (0 - n) % n;
+
+        while (l < threshold){
+            x = (*this)();
+            m = __uint128_t(x) * __uint128_t(n);
+            l = uint64_t(m);
+        }
+    }
+
+    return uint64_t(m >> 64);
+}
+
+
+double SplitMix64::uniform(){
+    // Top 53 bits fill the double mantissa exactly
+    return double((*this)() >> 11) * 0x1.0p-53;
+}
+
+
+// Nondeterministic seed for when the user does not provide one
+uint64_t generate_seed();
+
+
+}
+
+#endif //GFASE_RANDOM_HPP
@@ -122,7 +122,17 @@ public:
 };
 
 
-void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f);
+void parse_sam_lines(const char* begin, const char* end, vector<SamElement>& batch);
+
+
+void for_batch_in_sam_file(
+        path sam_path,
+        const function<void(vector<SamElement>& batch)>& f,
+        size_t n_threads=1,
+        size_t block_size=(1 << 24));
+
+
+void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f, size_t n_threads=1);
 
 
 }
@@ -0,0 +1,74 @@
+#ifndef GFASE_STRATIFIEDCONTACTMAP_HPP
+#define GFASE_STRATIFIEDCONTACTMAP_HPP
+
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <vector>
+
+using std::function;
+using std::vector;
+using std::pair;
+
+
+namespace gfase {
+
+
+/// Contact counts per undirected edge, stratified by MAPQ, stored in columns instead of one container per edge.
+///
+/// Edges are packed into 64 bit keys (smaller id in the upper 32 bits) and kept sorted. Each edge owns a contiguous
+/// run of (mapq, count) buckets, containing only the MAPQs that were actually observed, in ascending order of MAPQ.
+/// Updates are appended to an unsorted buffer which is periodically sorted and merged into the columns, so the
+/// amortized cost of an update is a few bytes and a share of a sort.
+///
+/// Queries require that all updates have been merged, so call compress() after the last update.
+class StratifiedContactMap{
+    // Sorted packed edge keys
+    vector<uint64_t> keys;
+
+    // Bucket run of edge i is [offsets[i], offsets[i+1])
+    vector<uint32_t> offsets;
+
+    // Buckets, one column for the MAPQ and one for the number of contacts at that MAPQ
+    vector<uint8_t> mapqs;
+    vector<uint32_t> counts;
+
+    // Updates that haven't been merged into the columns yet
+    vector <pair <uint64_t, uint8_t> > pending;
+
+    static const size_t min_pending_size = 1 << 22;
+
+    void merge_pending();
+    void throw_if_pending() const;
+
+public:
+    StratifiedContactMap();
+
+    static uint64_t pack(int32_t a, int32_t b);
+    static pair<int32_t,int32_t> unpack(uint64_t key);
+
+    void update(int32_t a, int32_t b, uint8_t mapq);
+    void compress();
+
+    size_t edge_count() const;
+    size_t bucket_count() const;
+    size_t find(int32_t a, int32_t b) const;
+
+    // Iterate the edges in sorted order, providing their index for use with the per-edge queries below
+    void for_each_edge(const function<void(const pair<int32_t,int32_t>& edge, size_t index)>& f) const;
+
+    // Iterate the nonzero MAPQ buckets of an edge, in ascending order of MAPQ
+    void for_each_bucket(size_t index, const function<void(uint8_t mapq, uint32_t count)>& f) const;
+
+    // Number of contacts on an edge with at least min_mapq, i.e. the reverse CDF of its MAPQ distribution
+    int64_t get_count(size_t index, uint8_t min_mapq=0) const;
+    int64_t get_count(int32_t a, int32_t b, uint8_t min_mapq=0) const;
+
+    // Fill a reverse CDF for the edge, where cdf[i] is the number of contacts with mapq >= i, up to max_mapq
+    void get_reverse_cdf(size_t index, uint8_t max_mapq, vector<int64_t>& cdf) const;
+};
+
+
+}
+
+#endif //GFASE_STRATIFIEDCONTACTMAP_HPP
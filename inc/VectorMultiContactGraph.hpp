@@ -4,6 +4,7 @@
 
 #include "IncrementalIdMap.hpp"
 #include "MultiContactGraph.hpp"
+#include "Random.hpp"
 
 #include "handlegraph/handle_graph.hpp"
 #include "bdsg/hash_graph.hpp"
@@ -86,6 +87,8 @@ public:
     void for_each_edge(const function<void(const pair<int32_t,int32_t>, int32_t weight)>& f) const;
     void get_alt_component(int32_t id, bool validate, alt_component_t& component) const;
     void get_partitions(vector <pair <int32_t,int8_t> >& partitions) const;
+    void get_partitions(const vector<int32_t>& ids, vector <pair <int32_t,int8_t> >& partitions) const;
+    void get_connected_components(vector <vector <int32_t> >& components) const;
     void get_node_ids(vector<int32_t>& ids) const;
     int8_t get_partition(int32_t id) const;
     size_t edge_count(int32_t id) const;
@@ -96,9 +99,12 @@ public:
     static double get_score(int8_t p_a, int8_t p_b, int32_t weight);
     double compute_consistency_score(int32_t id) const;
     double compute_consistency_score(int32_t id, int8_t p) const;
+    double compute_consistency_coefficient(int32_t id) const;
     double compute_total_consistency_score() const;
+    double compute_total_consistency_score(const vector<int32_t>& ids) const;
     double compare_total_consistency_score(const MultiContactGraph& other_graph) const;
-    void randomize_partitions();
+    void randomize_partitions(SplitMix64& rng);
+    void randomize_partitions(const vector<int32_t>& ids, SplitMix64& rng);
 
     // IO
     void write_alt_components(path output_path, const IncrementalIdMap<string>& id_map) const;
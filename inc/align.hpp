@@ -35,22 +35,89 @@ void print_minimap_alignment_block(
         const string& query);
 
 
+/// Fill in the match/mismatch counts of a block using only the chain (no CIGAR), from minimap2's divergence estimate
+void estimate_matches_from_chain(const mm_reg1_t& region, AlignmentBlock& block);
+
+
+/// Map the query to the target with minimap2 and summarize each primary hit as a block. If base_level is false, only
+/// the chaining step is run, and the match counts are estimated from the anchors, which is much faster for long pairs.
 void map_sequence_pair(
         const string& target_name,
         const string& target_sequence,
         const string& query_name,
         const string& query_sequence,
-        AlignmentChain& result);
-
-
+        AlignmentChain& result,
+        bool base_level=true);
+
+
+/// A candidate pair resolved to ids and lengths, so that it can be filtered and scheduled without touching sequences.
+/// The target (a) is the node that alignment coverage is measured against.
+class AlignmentJob{
+public:
+    int64_t id_a;
+    int64_t id_b;
+    uint64_t length_a;
+    uint64_t length_b;
+
+    AlignmentJob(int64_t id_a, int64_t id_b, uint64_t length_a, uint64_t length_b);
+    AlignmentJob();
+
+    // Alignment time grows with the product of the lengths
+    double get_cost() const;
+};
+
+
+/// Queue of candidate pairs ordered by descending estimated cost, so that the largest pairs are started first and
+/// the many small ones fill in the tail. Pairs whose length ratio makes min_similarity unreachable are rejected up
+/// front. Any number of threads may claim jobs concurrently with next().
+class AlignmentScheduler{
+    vector<AlignmentJob> jobs;
+    atomic<size_t> job_index;
+    size_t n_rejected;
+
+public:
+    AlignmentScheduler(
+            const vector<HashResult>& candidates,
+            const HandleGraph& graph,
+            const IncrementalIdMap<string>& id_map,
+            double min_similarity);
+
+    /// Claim the next job, returns false when there are none left
+    bool next(AlignmentJob& job);
+
+    size_t size() const;
+    size_t get_n_rejected() const;
+};
+
+
+/// One passing alignment, in the form it is added to the alignment graph
+class AlignmentRecord{
+public:
+    int32_t id_a;
+    int32_t id_b;
+    int32_t n_matches;
+    int32_t length_a;
+    int32_t length_b;
+
+    AlignmentRecord(int32_t id_a, int32_t id_b, int32_t n_matches, int32_t length_a, int32_t length_b);
+};
+
+
+/// Align candidate pairs (claimed from the shared scheduler) and append those with enough coverage to results, which
+/// should be owned by the calling thread. With chain_only, matches are estimated from minimap2 chains, and pairs whose
+/// estimated coverage is within refinement_margin of min_similarity are realigned at base level.
 void construct_alignment_graph(
-        const vector<HashResult>& to_be_aligned,
+        AlignmentScheduler& scheduler,
         const HandleGraph& sequences,
         const IncrementalIdMap<string>& id_map,
-        MultiContactGraph& alignment_graph,
+        vector<AlignmentRecord>& results,
         double min_similarity,
-        mutex& output_mutex,
-        atomic<size_t>& global_index);
+        bool chain_only=false,
+        double refinement_margin=0);
+
+
+/// Once all threads are done, add their records to the alignment graph (the per-thread vectors are emptied)
+void build_alignment_graph(vector <vector <AlignmentRecord> >& results_per_thread, MultiContactGraph& alignment_graph);
 
 
 void get_alignment_candidates(
@@ -70,7 +137,6 @@ void get_alignment_candidates(
 
 void get_best_overlaps(
         double min_similarity,
-        const IncrementalIdMap<string>& id_map,
         MultiContactGraph& alignment_graph,
         MultiContactGraph& symmetrical_alignment_graph
         );
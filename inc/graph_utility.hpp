@@ -81,6 +81,37 @@ void for_each_connected_component(HandleGraph& graph, const function<void(unorde
 
 void for_each_connected_component_subgraph(HandleGraph& graph, const function<void(const HandleGraph& subgraph)>& f);
 
+/// Call f(i) for every i in [0, n_jobs), over n_threads (including the calling thread). Jobs are claimed in order from
+/// a shared counter. If any job throws, the remaining jobs are skipped and the first exception is rethrown here.
+void for_each_job_in_parallel(size_t n_jobs, size_t n_threads, const function<void(size_t i)>& f);
+
+/// Sorted neighbor ids of every node (from either side, self edges included) in one flat array, so that adjacency can
+/// be queried with integer ids without touching the graph's own edge storage.
+class AdjacencyIndex {
+    vector<nid_t> ids;
+    vector<size_t> offsets;
+    vector<uint32_t> degrees;
+    vector<nid_t> neighbors;
+    bool is_contiguous;
+
+    // Returns ids.size() if the id is not in the index
+    size_t get_index(nid_t id) const;
+
+public:
+    AdjacencyIndex(const HandleGraph& graph, size_t n_threads=1);
+
+    bool has_node(nid_t id) const;
+    bool has_edge(nid_t a, nid_t b) const;
+    size_t get_degree(nid_t id) const;
+    size_t size() const;
+};
+
+/// Find the connected components of a graph with a concurrent union-find. Each component is a list of node ids in
+/// ascending order, and the components are ordered by their smallest id, so the result does not depend on n_threads.
+void find_connected_components(const HandleGraph& graph, vector <vector <nid_t> >& components, size_t n_threads=1);
+
+/// Copy each connected component into its own graph, id map and overlaps, which are appended to the output vectors.
+/// Components are labeled and then extracted concurrently over n_threads.
 void split_connected_components(
         MutablePathDeletableHandleGraph& graph,
         IncrementalIdMap<string>& id_map,
@@ -88,7 +119,8 @@ void split_connected_components(
         vector<HashGraph>& graphs,
         vector<IncrementalIdMap<string> >& id_maps,
         vector<Overlaps>& comp_overlaps,
-        bool delete_visited_components = false);
+        bool delete_visited_components = false,
+        size_t n_threads = 1);
 
 void split_connected_components(
         MutablePathDeletableHandleGraph& graph,
@@ -106,13 +138,15 @@ void split_connected_components(
         MutablePathDeletableHandleGraph& graph,
         IncrementalIdMap<string>& id_map,
         vector<HashGraph>& graphs,
-        bool delete_visited_components);
+        bool delete_visited_components,
+        size_t n_threads = 1);
 
 void write_connected_components_to_gfas(
         const MutablePathDeletableHandleGraph& graph,
         const IncrementalIdMap<string>& id_map,
         const Overlaps& overlaps,
-        path output_directory);
+        path output_directory,
+        size_t n_threads = 1);
 
 void run_command(string& argument_string);
 
@@ -59,7 +59,8 @@ path align(path output_dir, path ref_path, path query_path, size_t n_threads);
 
 path sam_to_sorted_bam(path sam_path, size_t n_threads, bool remove_sam=true);
 
-void get_query_lengths_from_fasta(path fasta_path, map<string,size_t>& query_lengths);
+/// Lengths are taken from the FASTA's .fai index, which is built (using n_threads) and saved if it doesn't exist yet
+void get_query_lengths_from_fasta(path fasta_path, map<string,size_t>& query_lengths, size_t n_threads=1);
 
 void for_entry_in_csv(path csv_path, const function<void(const vector<string>& tokens, size_t line)>& f);
 
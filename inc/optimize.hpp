@@ -11,6 +11,9 @@ namespace gfase{
 using orientation_edge_t = pair <int32_t,int32_t>;
 using orientation_weight_t = array<int32_t, 2>;
 
+// Composite sort key for an orientation edge: {max orientation count, mean consistency of its two nodes}
+using orientation_rank_t = pair<int32_t, double>;
+
 
 class OrientationDistribution{
 public:
@@ -24,12 +27,42 @@ public:
 };
 
 
-void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterations);
+void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterations, SplitMix64& rng);
+
+
+void random_phase_search(
+        VectorMultiContactGraph& contact_graph,
+        const vector<int32_t>& ids,
+        size_t m_iterations,
+        SplitMix64& rng);
+
+
+size_t get_component_iterations(size_t component_size, size_t core_iterations);
+
+
+void parallel_tempering_phase_search(
+        VectorMultiContactGraph& contact_graph,
+        size_t n_sweeps,
+        SplitMix64& rng,
+        size_t n_replicas=8,
+        double min_temperature=1.0,
+        double max_temperature=10.0,
+        size_t n_threads=1);
 
 
 void sample_with_threads(
         vector<VectorMultiContactGraph>& contact_graphs_per_thread,
         size_t core_iterations,
+        bool use_parallel_tempering,
+        uint64_t seed,
+        atomic<size_t>& job_index);
+
+
+void sample_components_with_threads(
+        vector<VectorMultiContactGraph>& contact_graphs_per_thread,
+        const vector <vector <int32_t> >& components,
+        size_t core_iterations,
+        uint64_t seed,
         atomic<size_t>& job_index);
 
 
@@ -38,10 +71,25 @@ void sample_orientation_distribution(
         MultiContactGraph& contact_graph,
         size_t sample_size,
         size_t n_threads,
-        size_t core_iterations
+        size_t core_iterations,
+        bool use_parallel_tempering=false,
+        bool use_components=false,
+        uint64_t seed=0
 );
 
 
+void compute_consistency_scores(
+        const VectorMultiContactGraph& contact_graph,
+        vector<double>& consistency_scores,
+        size_t n_threads);
+
+
+void rank_orientation_edges(
+        const VectorMultiContactGraph& contact_graph,
+        vector <pair <orientation_edge_t, orientation_weight_t> >& ordered_edges,
+        size_t n_threads);
+
+
 void monte_carlo_phase_contacts(
         MultiContactGraph& contact_graph,
         const IncrementalIdMap<string>& id_map,
@@ -49,7 +97,10 @@ void monte_carlo_phase_contacts(
         size_t sample_size,
         size_t n_rounds,
         size_t n_threads,
-        path output_dir
+        path output_dir,
+        bool use_parallel_tempering=false,
+        bool use_components=false,
+        uint64_t seed=0
 );
 
 
@@ -1,4 +1,6 @@
 #include "Bam.hpp"
+#include "BamScanner.hpp"
+#include "Instrumentation.hpp"
 
 #include <stdexcept>
 #include <iostream>
@@ -31,7 +33,11 @@ Bam::Bam(path bam_path):
 
 
 void Bam::for_alignment_in_bam(const function<void(const string& ref_name, const string& query_name, uint8_t map_quality, uint16_t flag)>& f){
+    auto& n_records = Instrumentation::global().get_counter("bam_records");
+
     while (sam_read1(bam_file, bam_header, alignment) >= 0){
+        n_records.fetch_add(1, std::memory_order_relaxed);
+
         string query_name = bam_get_qname(alignment);
 
         string ref_name;
@@ -47,7 +53,11 @@ void Bam::for_alignment_in_bam(const function<void(const string& ref_name, const
 
 
 void Bam::for_alignment_in_bam(bool get_cigar, const function<void(SamElement& a)>& f){
+    auto& n_records = Instrumentation::global().get_counter("bam_records");
+
     while (sam_read1(bam_file, bam_header, alignment) >= 0){
+        n_records.fetch_add(1, std::memory_order_relaxed);
+
         SamElement e;
         e.query_name = bam_get_qname(alignment);
 
@@ -70,8 +80,14 @@ void Bam::for_alignment_in_bam(bool get_cigar, const function<void(SamElement& a
 }
 
 
-void Bam::for_alignment_in_bam(const function<void(FullAlignmentBlock& a)>& f){
+/// If get_cigar is false, the CIGAR is not decoded, and the fields derived from it (ref_stop, query_start, query_stop
+/// and the operation counts) are left as 0
+void Bam::for_alignment_in_bam(bool get_cigar, const function<void(FullAlignmentBlock& a)>& f){
+    auto& n_records = Instrumentation::global().get_counter("bam_records");
+
     while (sam_read1(bam_file, bam_header, alignment) >= 0){
+        n_records.fetch_add(1, std::memory_order_relaxed);
+
         FullAlignmentBlock e;
 
         // Ref name field might be empty if read is unmapped, in which case the target (aka ref) id might not be in range
@@ -86,6 +102,20 @@ void Bam::for_alignment_in_bam(const function<void(FullAlignmentBlock& a)>& f){
         e.ref_start = alignment->core.pos;
         e.is_reverse = bam_is_rev(alignment);
 
+        if (not get_cigar){
+            e.ref_stop = 0;
+            e.query_start = 0;
+            e.query_stop = 0;
+            e.n_matches = 0;
+            e.n_mismatches = 0;
+            e.n_inserts = 0;
+            e.n_deletes = 0;
+            e.n_n = 0;
+
+            f(e);
+            continue;
+        }
+
         auto n_cigar = alignment->core.n_cigar;
         auto cigar_ptr = bam_get_cigar(alignment);
         e.cigars.assign(cigar_ptr, cigar_ptr + n_cigar);
@@ -217,55 +247,55 @@ template <class T> void update_contact_map(
 }
 
 
-void parse_unpaired_bam_file(
-        path bam_path,
+template <class T> void update_contact_map(
+        const vector<T>& alignments,
+        const vector<size_t>& indexes,
         MultiContactGraph& contact_graph,
-        IncrementalIdMap<string>& id_map,
-        string required_prefix,
-        int8_t min_mapq){
+        IncrementalIdMap<string>& id_map){
 
-    Bam reader(bam_path);
+    for (size_t i=0; i<indexes.size(); i++){
+        auto& a = alignments[indexes[i]];
+        auto ref_id_a = int32_t(id_map.try_insert(a.ref_name));
+        contact_graph.try_insert_node(ref_id_a, 0);
 
-    size_t l = 0;
-    string prev_query_name = "";
-    vector<SamElement> alignments;
+        contact_graph.increment_coverage(ref_id_a, 1);
 
-    reader.for_alignment_in_bam(false, [&](const SamElement& a){
-        if (l == 0){
-            prev_query_name = a.query_name;
+        for (size_t j=i+1; j<indexes.size(); j++) {
+            auto& b = alignments[indexes[j]];
+            auto ref_id_b = int32_t(id_map.try_insert(b.ref_name));
+            contact_graph.try_insert_node(ref_id_b, 0);
+            contact_graph.try_insert_edge(ref_id_a, ref_id_b);
+            contact_graph.increment_edge_weight(ref_id_a, ref_id_b, 1);
         }
+    }
+}
 
-        if (prev_query_name != a.query_name){
-            update_contact_map(alignments, contact_graph, id_map);
-            alignments.clear();
-        }
 
-        // No information about reference contig, this alignment is unusable
-        if (a.ref_name.empty()){
-            return;
-        }
+template void update_contact_map(
+        const vector<SamElement>& alignments,
+        MultiContactGraph& contact_graph,
+        IncrementalIdMap<string>& id_map);
 
-        // Optionally filter by the contig names. E.g. "PR" in shasta
-        bool valid_prefix = true;
-        if (not required_prefix.empty()){
-            for (size_t i=0; i<required_prefix.size(); i++){
-                if (a.ref_name[i] != required_prefix[i]){
-                    valid_prefix = false;
-                    break;
-                }
-            }
-        }
 
-        if (valid_prefix) {
-            // Only allow reads with mapq > min_mapq and not secondary
-            if (a.mapq >= min_mapq and a.is_primary()) {
-                alignments.emplace_back(a);
-            }
-        }
+template void update_contact_map(
+        const vector<FullAlignmentBlock>& alignments,
+        const vector<size_t>& indexes,
+        MultiContactGraph& contact_graph,
+        IncrementalIdMap<string>& id_map);
+
+
+void parse_unpaired_bam_file(
+        path bam_path,
+        MultiContactGraph& contact_graph,
+        IncrementalIdMap<string>& id_map,
+        string required_prefix,
+        int8_t min_mapq){
+
+    BamScanner scanner(bam_path);
+    ContactGraphPlugin contact_graph_plugin(contact_graph, id_map, required_prefix, min_mapq);
 
-        l++;
-        prev_query_name = a.query_name;
-    });
+    scanner.add_plugin(contact_graph_plugin);
+    scanner.scan();
 }
 
 
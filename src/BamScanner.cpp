@@ -0,0 +1,369 @@
+#include "BamScanner.hpp"
+#include "Bam.hpp"
+
+#include <condition_variable>
+#include <stdexcept>
+#include <exception>
+#include <fstream>
+#include <thread>
+#include <deque>
+#include <mutex>
+
+using std::condition_variable;
+using std::exception_ptr;
+using std::runtime_error;
+using std::make_shared;
+using std::unique_lock;
+using std::lock_guard;
+using std::to_string;
+using std::ofstream;
+using std::thread;
+using std::deque;
+using std::mutex;
+using std::min;
+
+
+namespace gfase {
+
+
+bool has_prefix(const string& s, const string& prefix){
+    return s.size() >= prefix.size() and s.compare(0, prefix.size(), prefix) == 0;
+}
+
+
+BamScanner::BamScanner(path bam_path, size_t batch_size, size_t max_queued_batches):
+        bam_path(bam_path),
+        plugins(),
+        batch_size(batch_size),
+        max_queued_batches(max_queued_batches)
+{
+    if (batch_size == 0 or max_queued_batches == 0){
+        throw runtime_error("ERROR: BamScanner batch size and queue length must be greater than 0");
+    }
+}
+
+
+void BamScanner::add_plugin(ReadChainPlugin& plugin){
+    plugins.emplace_back(&plugin);
+}
+
+
+/// Thrown from inside the BAM iteration to stop decoding once a plugin has failed
+class ScanAborted{};
+
+
+/// Decode the BAM once on the calling thread, and run every plugin on its own thread. Each plugin has a queue of
+/// batches which are shared (not copied) between plugins. Decoding pauses when any queue is full, so memory is bounded
+/// by the slowest plugin. If a plugin throws, decoding stops and the exception is rethrown here. CIGARs are only decoded
+/// if at least one plugin needs them.
+void BamScanner::scan(){
+    if (plugins.empty()){
+        return;
+    }
+
+    Bam reader(bam_path);
+
+    bool get_cigar = false;
+    for (auto& plugin: plugins){
+        get_cigar = get_cigar or plugin->needs_cigar();
+    }
+
+    vector <deque <shared_ptr <const read_chain_batch_t> > > queues(plugins.size());
+    vector <exception_ptr> errors(plugins.size());
+
+    mutex m;
+    condition_variable consumer_condition;
+    condition_variable producer_condition;
+    bool done = false;
+    bool failed = false;
+
+    auto consume = [&](size_t p){
+        try {
+            while (true){
+                shared_ptr <const read_chain_batch_t> batch;
+
+                {
+                    unique_lock<mutex> lock(m);
+                    consumer_condition.wait(lock, [&](){ return done or failed or not queues[p].empty(); });
+
+                    if (failed or queues[p].empty()){
+                        break;
+                    }
+
+                    batch = queues[p].front();
+                    queues[p].pop_front();
+                }
+
+                producer_condition.notify_one();
+
+                for (const auto& read_alignments: *batch){
+                    plugins[p]->process(read_alignments);
+                }
+            }
+
+            plugins[p]->finish();
+        }
+        catch (...){
+            lock_guard<mutex> lock(m);
+            errors[p] = std::current_exception();
+            failed = true;
+
+            // Release any other queued batches and wake up the producer
+            for (auto& q: queues){
+                q.clear();
+            }
+
+            producer_condition.notify_all();
+            consumer_condition.notify_all();
+        }
+    };
+
+    auto publish = [&](read_chain_batch_t& batch){
+        auto shared_batch = make_shared<const read_chain_batch_t>(std::move(batch));
+        batch = {};
+
+        unique_lock<mutex> lock(m);
+        producer_condition.wait(lock, [&](){
+            if (failed){
+                return true;
+            }
+            for (auto& q: queues){
+                if (q.size() >= max_queued_batches){
+                    return false;
+                }
+            }
+            return true;
+        });
+
+        if (failed){
+            throw ScanAborted();
+        }
+
+        for (auto& q: queues){
+            q.emplace_back(shared_batch);
+        }
+
+        consumer_condition.notify_all();
+    };
+
+    vector<thread> threads;
+    for (size_t p=0; p<plugins.size(); p++){
+        threads.emplace_back(consume, p);
+    }
+
+    try {
+        read_chain_batch_t batch;
+        FullAlignmentChain read_alignments;
+
+        reader.for_alignment_in_bam(get_cigar, [&](FullAlignmentBlock& a){
+            if (not read_alignments.chain.empty() and read_alignments.chain.back().query_name != a.query_name){
+                batch.emplace_back(std::move(read_alignments));
+                read_alignments = {};
+
+                if (batch.size() == batch_size){
+                    publish(batch);
+                }
+            }
+
+            read_alignments.chain.emplace_back(std::move(a));
+        });
+
+        if (not read_alignments.chain.empty()){
+            batch.emplace_back(std::move(read_alignments));
+        }
+
+        if (not batch.empty()){
+            publish(batch);
+        }
+    }
+    catch (const ScanAborted&){
+        // A plugin failed, its exception is rethrown below
+    }
+    catch (...){
+        // Decoding failed, stop the plugins before propagating
+        {
+            lock_guard<mutex> lock(m);
+            failed = true;
+        }
+        consumer_condition.notify_all();
+
+        for (auto& t: threads){
+            t.join();
+        }
+
+        throw;
+    }
+
+    {
+        lock_guard<mutex> lock(m);
+        done = true;
+    }
+    consumer_condition.notify_all();
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    for (auto& e: errors){
+        if (e){
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+
+ContactGraphPlugin::ContactGraphPlugin(
+        MultiContactGraph& contact_graph,
+        IncrementalIdMap<string>& id_map,
+        string required_prefix,
+        int8_t min_mapq):
+        contact_graph(contact_graph),
+        id_map(id_map),
+        required_prefix(required_prefix),
+        min_mapq(min_mapq)
+{}
+
+
+void ContactGraphPlugin::process(const FullAlignmentChain& read_alignments){
+    indexes.clear();
+
+    for (size_t i=0; i<read_alignments.chain.size(); i++){
+        const auto& a = read_alignments.chain[i];
+
+        // No information about reference contig, this alignment is unusable
+        if (a.ref_name.empty()){
+            continue;
+        }
+
+        // Optionally filter by the contig names. E.g. "PR" in shasta
+        if (not has_prefix(a.ref_name, required_prefix)){
+            continue;
+        }
+
+        // Only allow reads with mapq > min_mapq and not secondary
+        if (a.mapq >= min_mapq and Bam::is_primary(a.flag)) {
+            indexes.emplace_back(i);
+        }
+    }
+
+    update_contact_map(read_alignments.chain, indexes, contact_graph, id_map);
+}
+
+
+bool ContactGraphPlugin::needs_cigar() const{
+    return false;
+}
+
+
+MapqDistributionPlugin::MapqDistributionPlugin(bool primary_only):
+        primary_only(primary_only)
+{}
+
+
+void MapqDistributionPlugin::process(const FullAlignmentChain& read_alignments){
+    for (const auto& a: read_alignments.chain){
+        if (primary_only and Bam::is_not_primary(a.flag)){
+            continue;
+        }
+
+        distribution[a.mapq]++;
+    }
+}
+
+
+bool MapqDistributionPlugin::needs_cigar() const{
+    return false;
+}
+
+
+void MapqDistributionPlugin::write_to_csv(path output_path) const{
+    ofstream file(output_path);
+
+    if ((not file.is_open()) or (not file.good())){
+        throw runtime_error("ERROR: file could not be written: " + output_path.string());
+    }
+
+    for (auto& [key, frequency]: distribution){
+        file << int(key) << ',' << frequency << '\n';
+    }
+}
+
+
+StratifiedContactPlugin::StratifiedContactPlugin(string required_prefix, int8_t min_mapq):
+        required_prefix(required_prefix),
+        min_mapq(min_mapq),
+        id_map(false)
+{}
+
+
+void StratifiedContactPlugin::process(const FullAlignmentChain& read_alignments){
+    ref_ids.clear();
+    mapqs.clear();
+
+    for (const auto& a: read_alignments.chain){
+        if (a.ref_name.empty() or not has_prefix(a.ref_name, required_prefix)){
+            continue;
+        }
+
+        if (a.mapq >= min_mapq and Bam::is_primary(a.flag)) {
+            ref_ids.emplace_back(int32_t(id_map.try_insert(a.ref_name)));
+            mapqs.emplace_back(a.mapq);
+        }
+    }
+
+    // Iterate one triangle of the all-by-all matrix, stratifying each contact by the lesser mapq
+    for (size_t i=0; i<ref_ids.size(); i++){
+        for (size_t j=i+1; j<ref_ids.size(); j++) {
+            auto mapq = min(mapqs[i], mapqs[j]);
+
+            contact_map.update(ref_ids[i], ref_ids[j], mapq);
+
+            // Edges are stored undirected, so self contacts are counted twice, once for each direction
+            if (ref_ids[i] == ref_ids[j]){
+                contact_map.update(ref_ids[i], ref_ids[j], mapq);
+            }
+        }
+    }
+}
+
+
+void StratifiedContactPlugin::finish(){
+    contact_map.compress();
+}
+
+
+bool StratifiedContactPlugin::needs_cigar() const{
+    return false;
+}
+
+
+/// Write one line per direction of each edge: name_a,name_b,mapq:count mapq:count ...
+void StratifiedContactPlugin::write_to_csv(path output_path) const{
+    ofstream output_file(output_path);
+
+    if (not output_file.is_open() or not output_file.good()){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    string weights;
+
+    contact_map.for_each_edge([&](const pair<int32_t,int32_t>& e, size_t index){
+        weights.clear();
+
+        contact_map.for_each_bucket(index, [&](uint8_t q, uint32_t count){
+            if (not weights.empty()){
+                weights += ' ';
+            }
+            weights += to_string(int(q)) + ':' + to_string(count);
+        });
+
+        output_file << id_map.get_name_view(e.first) << ',' << id_map.get_name_view(e.second) << ',' << weights << '\n';
+
+        if (e.first != e.second){
+            output_file << id_map.get_name_view(e.second) << ',' << id_map.get_name_view(e.first) << ',' << weights << '\n';
+        }
+    });
+}
+
+
+}
@@ -1,6 +1,10 @@
 #include "Bipartition.hpp"
 #include "graph_utility.hpp"
 
+#include <algorithm>
+
+using std::sort;
+
 namespace gfase {
 
 
@@ -17,16 +21,21 @@ bool Bipartition::get_partition_of_node(const nid_t& id) const{
 
 
 void Bipartition::partition(){
-    unordered_set<nid_t> all_nodes;
-    unordered_set<edge_t> all_edges;
+    vector<nid_t> ids;
 
     graph.for_each_handle([&](const handle_t& h) {
-        auto n = graph.get_id(h);
-        all_nodes.emplace(n);
+        ids.emplace_back(graph.get_id(h));
     });
 
-    while (not all_nodes.empty()) {
-        auto start_node = *all_nodes.begin();
+    // Visit in order of id so that the subgraph indexes don't depend on hashing
+    sort(ids.begin(), ids.end());
+
+    for (auto start_node: ids) {
+        // Any node that has been assigned to a subgraph was already visited
+        if (node_to_subgraph.count(start_node) > 0){
+            continue;
+        }
+
         bool partition = get_partition_of_node(start_node);
 
         // Skip 0 and start at 1 because the world is already on fire anyway
@@ -40,19 +49,39 @@ void Bipartition::partition(){
 
         metagraph.create_handle("", nid_t(subgraph_index));
 
-        // Enter all the nodes into a subgraph
-        for_node_in_bfs(graph, start_node,
-                [&](const nid_t& id){
-                    return get_partition_of_node(id) == partition;
-                },
-                [&](const handle_t& h) {
-                    subgraphs[subgraph_index].add_node(h);
+        auto& subgraph = subgraphs.at(subgraph_index);
+
+        queue<nid_t> q;
+        q.emplace(start_node);
+        node_to_subgraph.emplace(start_node, subgraph_index);
+
+        // Enter all the nodes into a subgraph, stopping at nodes of the other partition
+        while (not q.empty()){
+            auto h = graph.get_handle(q.front());
+            q.pop();
 
-                    auto id = graph.get_id(h);
-                    node_to_subgraph.emplace(id, subgraph_index);
+            subgraph.add_node(h);
 
-                    all_nodes.erase(id);
+            for (bool go_left: {false, true}){
+                graph.follow_edges(h, go_left, [&](const handle_t& other_handle){
+                    auto other_node = graph.get_id(other_handle);
+
+                    if (get_partition_of_node(other_node) == partition and node_to_subgraph.emplace(other_node, subgraph_index).second){
+                        q.emplace(other_node);
+                    }
                 });
+            }
+        }
+    }
+
+    // Every subgraph starts as its own singleton set
+    merge_parents.resize(max_id + 1);
+    merge_sizes.assign(max_id + 1, 1);
+    merge_labels.resize(max_id + 1);
+
+    for (size_t i=0; i<=max_id; i++){
+        merge_parents[i] = i;
+        merge_labels[i] = i;
     }
 
     graph.for_each_edge([&](const edge_t& e){
@@ -85,56 +114,139 @@ void Bipartition::partition(){
 }
 
 
-void Bipartition::merge_subgraphs(size_t subgraph_index_a, size_t subgraph_index_b){
+size_t Bipartition::find_merge_root(size_t subgraph_index) const{
+    // Linking by size keeps the trees shallow, so no path compression is needed for const lookups
+    while (merge_parents[subgraph_index] != subgraph_index){
+        subgraph_index = merge_parents[subgraph_index];
+    }
+
+    return subgraph_index;
+}
+
+
+void Bipartition::link_subgraphs(size_t subgraph_index_a, size_t subgraph_index_b){
+    if (subgraphs.count(subgraph_index_a) == 0 or subgraphs.count(subgraph_index_b) == 0){
+        throw runtime_error("ERROR: cannot merge subgraphs that do not exist: " + to_string(subgraph_index_a) + "," + to_string(subgraph_index_b));
+    }
 
     if (subgraph_partitions.at(subgraph_index_b) != subgraph_partitions.at(subgraph_index_a)){
         throw runtime_error("ERROR: cannot merge subgraphs of differing partitions");
     }
 
-    subgraphs.at(subgraph_index_b).for_each_handle([&](const handle_t& h){
-        // Add all the b nodes to a
-        subgraphs.at(subgraph_index_a).add_node(h);
+    auto root_a = find_merge_root(subgraph_index_a);
+    auto root_b = find_merge_root(subgraph_index_b);
+
+    if (merge_sizes[root_a] < merge_sizes[root_b]){
+        std::swap(root_a, root_b);
+    }
+
+    merge_parents[root_b] = root_a;
+    merge_sizes[root_a] += merge_sizes[root_b];
+
+    // Whichever tree ends up on top, the merged subgraph is known by the index of a
+    merge_labels[root_a] = subgraph_index_a;
+}
+
+
+void Bipartition::move_subgraph_edges(size_t absorbed_index){
+    auto absorbed_handle = metagraph.get_handle(nid_t(absorbed_index));
 
-        // Overwrite mappings from parent to subgraph
-        node_to_subgraph[graph.get_id(h)] = subgraph_index_a;
+    vector<edge_t> absorbed_edges;
+
+    metagraph.follow_edges(absorbed_handle, true, [&](const handle_t& h){
+        absorbed_edges.emplace_back(metagraph.edge_handle(h, absorbed_handle));
     });
 
-    auto metagraph_handle_b = metagraph.get_handle(nid_t(subgraph_index_b));
-    auto metagraph_handle_a = metagraph.get_handle(nid_t(subgraph_index_a));
+    metagraph.follow_edges(absorbed_handle, false, [&](const handle_t& h){
+        absorbed_edges.emplace_back(metagraph.edge_handle(absorbed_handle, h));
+    });
 
-    unordered_set<edge_t> to_be_deleted;
+    // Translate a metagraph handle into the handle of the subgraph that it has been merged into
+    auto get_merged_handle = [&](const handle_t& h){
+        auto index = merge_labels[find_merge_root(size_t(metagraph.get_id(h)))];
+        return metagraph.get_handle(nid_t(index), metagraph.get_is_reverse(h));
+    };
 
-    // Duplicate the metagraph boundary edges to a and remove the existing ones from b (LEFT)
-    metagraph.follow_edges(metagraph_handle_b, true, [&](const handle_t & h){
-        edge_t e_a = metagraph.edge_handle(h, metagraph_handle_a);
-        edge_t e_b = metagraph.edge_handle(h, metagraph_handle_b);
+    for (auto& e: absorbed_edges){
+        auto result = meta_edge_to_edges.find(e);
 
-        for (auto& parent_edge: meta_edge_to_edges.at(e_b)){
-            meta_edge_to_edges[e_a].emplace(graph.edge_handle(parent_edge.first,parent_edge.second));
+        // Edges between two absorbed subgraphs are found from both ends, but only need to be moved once
+        if (result == meta_edge_to_edges.end()){
+            continue;
         }
 
-        to_be_deleted.emplace(e_b);
-    });
+        auto parent_edges = std::move(result->second);
+        meta_edge_to_edges.erase(result);
+
+        auto merged_edge = metagraph.edge_handle(get_merged_handle(e.first), get_merged_handle(e.second));
 
-    // Duplicate the metagraph boundary edges to a and remove the existing ones from b (RIGHT)
-    metagraph.follow_edges(metagraph_handle_b, false, [&](const handle_t & h){
-        edge_t e_a = metagraph.edge_handle(metagraph_handle_a, h);
-        edge_t e_b = metagraph.edge_handle(metagraph_handle_b, h);
+        if (metagraph.get_id(merged_edge.first) == metagraph.get_id(merged_edge.second)){
+            throw runtime_error("ERROR: direct edge between two subgraphs with the same partition membership");
+        }
+
+        if (not metagraph.has_edge(merged_edge.first, merged_edge.second)){
+            metagraph.create_edge(merged_edge.first, merged_edge.second);
+        }
 
-        for (auto& parent_edge: meta_edge_to_edges.at(e_b)){
-            meta_edge_to_edges[e_a].emplace(graph.edge_handle(parent_edge.first,parent_edge.second));
+        auto& merged_parent_edges = meta_edge_to_edges[merged_edge];
+        for (auto& parent_edge: parent_edges){
+            merged_parent_edges.emplace(parent_edge);
         }
+    }
+
+    metagraph.destroy_handle(absorbed_handle);
+}
+
+
+void Bipartition::move_subgraph_nodes(size_t absorbed_index){
+    auto merged_index = merge_labels[find_merge_root(absorbed_index)];
+
+    auto& merged = subgraphs.at(merged_index);
+    auto& absorbed = subgraphs.at(absorbed_index);
+
+    // Only the smaller population of nodes is ever copied, so a long run of merges into one subgraph is not quadratic
+    if (absorbed.get_node_count() > merged.get_node_count()){
+        std::swap(merged, absorbed);
+    }
 
-        to_be_deleted.emplace(e_b);
+    absorbed.for_each_handle([&](const handle_t& h){
+        merged.add_node(h);
     });
 
-    for (auto& e: to_be_deleted){
-        meta_edge_to_edges.erase(e);
+    subgraphs.erase(absorbed_index);
+    subgraph_partitions.erase(absorbed_index);
+}
+
+
+void Bipartition::merge_subgraphs(const vector <pair <size_t,size_t> >& to_be_merged){
+    vector<size_t> absorbed_indexes;
+
+    for (auto& [a,b]: to_be_merged){
+        auto index_a = merge_labels[find_merge_root(a)];
+        auto index_b = merge_labels[find_merge_root(b)];
+
+        // Already merged earlier in this batch (or a previous one)
+        if (index_a == index_b){
+            continue;
+        }
+
+        link_subgraphs(index_a, index_b);
+        absorbed_indexes.emplace_back(index_b);
     }
 
-    subgraphs.erase(subgraph_index_b);
-    metagraph.destroy_handle(metagraph_handle_b);
-    subgraph_partitions.erase(subgraph_index_b);
+    // Only now that the final membership is known, move each absorbed subgraph's contents exactly once
+    for (auto index: absorbed_indexes){
+        move_subgraph_edges(index);
+    }
+
+    for (auto index: absorbed_indexes){
+        move_subgraph_nodes(index);
+    }
+}
+
+
+void Bipartition::merge_subgraphs(size_t subgraph_index_a, size_t subgraph_index_b){
+    merge_subgraphs({{subgraph_index_a, subgraph_index_b}});
 }
 
 
@@ -151,7 +263,7 @@ size_t Bipartition::get_subgraph_size(size_t subgraph_index) const{
 
 
 size_t Bipartition::get_subgraph_index_of_parent_node(nid_t meta_node) const{
-    return node_to_subgraph.at(meta_node);
+    return merge_labels[find_merge_root(node_to_subgraph.at(meta_node))];
 }
 
 
@@ -174,8 +286,8 @@ void Bipartition::follow_subgraph_edges(size_t subgraph_index, bool go_left, con
         }
 
         for (auto& parent_edge: meta_edge_to_edges.at(e)){
-            auto first_index = node_to_subgraph.at(graph.get_id(parent_edge.first));
-            auto second_index = node_to_subgraph.at(graph.get_id(parent_edge.second));
+            auto first_index = get_subgraph_index_of_parent_node(graph.get_id(parent_edge.first));
+            auto second_index = get_subgraph_index_of_parent_node(graph.get_id(parent_edge.second));
 
             if (first_index == subgraph_index and second_index != subgraph_index){
                 f(parent_edge.second);
@@ -218,8 +330,8 @@ void Bipartition::get_boundary_nodes(size_t subgraph_index, bool left, unordered
 //                     << id_map.get_name(graph.get_id(parent_edge.first)) << (graph.get_is_reverse(parent_edge.first) ? '-' : '+') << " -> "
 //                     << id_map.get_name(graph.get_id(parent_edge.second)) << (graph.get_is_reverse(parent_edge.second) ? '-' : '+') << '\n';
 
-            auto first_index = node_to_subgraph.at(graph.get_id(parent_edge.first));
-            auto second_index = node_to_subgraph.at(graph.get_id(parent_edge.second));
+            auto first_index = get_subgraph_index_of_parent_node(graph.get_id(parent_edge.first));
+            auto second_index = get_subgraph_index_of_parent_node(graph.get_id(parent_edge.second));
 
             if (first_index == subgraph_index and second_index != subgraph_index){
                 // Verify that the edge has the handle-of-interest in the F orientation
@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <utility>
 #include <iostream>
+#include <stdexcept>
+#include <limits>
 
 using std::tuple;
 using std::get;
@@ -16,6 +18,13 @@ using std::tie;
 using std::make_pair;
 using std::make_tuple;
 using std::reverse;
+using std::sort;
+using std::lower_bound;
+using std::min;
+using std::numeric_limits;
+using std::runtime_error;
+using std::to_string;
+using std::move;
 using std::unordered_map;
 using std::unordered_set;
 using std::cerr;
@@ -29,207 +38,179 @@ namespace gfase {
 
 static const bool debug = false;
 
-/*
- * Wrapper for a handle graph that uses the bi-edged formalism instead
- * of a bidirected formalism, which allows a simple undirected graph
- * interface
- */
-class BiedgedGraph {
-public:
-    BiedgedGraph(const HandleGraph& graph);
-    BiedgedGraph() = delete;
+BiedgedIndex::BiedgedIndex(const HandleGraph& graph) : graph(graph) {
     
-    size_t size() const;
-    
-    // returns an invalid handle if graph is empty
-    handle_t get_arbitrary_node() const;
+    ids.reserve(graph.get_node_count());
+    graph.for_each_handle([&](const handle_t& handle) {
+        ids.push_back(graph.get_id(handle));
+    });
+    sort(ids.begin(), ids.end());
     
-    void for_each_node(const function<void(handle_t)>& lambda) const;
-    void for_each_neighbor(handle_t node, const function<void(handle_t)>& lambda) const;
-    bool is_across_node_edge(handle_t node1, handle_t node2) const;
+    if (2 * ids.size() >= numeric_limits<uint32_t>::max()) {
+        throw runtime_error("ERROR: too many nodes for BiedgedIndex: " + to_string(ids.size()));
+    }
     
-private:
+    // graphs loaded from GFA usually have a contiguous range of IDs, which avoids a search per lookup
+    ids_are_contiguous = ids.empty() || (ids.back() - ids.front() + 1 == nid_t(ids.size()));
     
-    const HandleGraph& graph;
+    offsets.reserve(2 * ids.size() + 1);
+    targets.reserve(2 * ids.size());
+    offsets.push_back(0);
     
-};
+    for (uint32_t side = 0; side < 2 * ids.size(); ++side) {
+        targets.push_back(side ^ 1);
+        graph.follow_edges(get_handle(side), false, [&](const handle_t& next) {
+            targets.push_back(get_side(graph.flip(next)));
+        });
+        
+        if (targets.size() >= numeric_limits<uint32_t>::max()) {
+            throw runtime_error("ERROR: too many edges for BiedgedIndex");
+        }
+        offsets.push_back(targets.size());
+    }
+}
 
-BiedgedGraph::BiedgedGraph(const HandleGraph& graph) : graph(graph) {
-    
+size_t BiedgedIndex::node_count() const {
+    return ids.size();
 }
 
-size_t BiedgedGraph::size() const {
-    return 2 * graph.get_node_count();
+size_t BiedgedIndex::side_count() const {
+    return 2 * ids.size();
 }
 
-handle_t BiedgedGraph::get_arbitrary_node() const {
-    handle_t handle = as_handle(-1); // to avoid uninitialized warnings
-    graph.for_each_handle([&handle](const handle_t& h) {
-        handle = h;
-        return false;
-    });
-    return handle;
+uint32_t BiedgedIndex::get_node_index(nid_t id) const {
+    if (ids_are_contiguous) {
+        if (!ids.empty() && id >= ids.front() && id <= ids.back()) {
+            return uint32_t(id - ids.front());
+        }
+    }
+    else {
+        auto it = lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) {
+            return uint32_t(it - ids.begin());
+        }
+    }
+    throw runtime_error("ERROR: node " + to_string(id) + " is not in BiedgedIndex");
 }
 
-void BiedgedGraph::for_each_node(const function<void(handle_t)>& lambda) const {
-    graph.for_each_handle([&](const handle_t& h) {
-        lambda(h);
-        lambda(graph.flip(h));
-    });
+uint32_t BiedgedIndex::get_side(const handle_t& handle) const {
+    return 2 * get_node_index(graph.get_id(handle)) + uint32_t(graph.get_is_reverse(handle));
 }
 
-void BiedgedGraph::for_each_neighbor(handle_t node, const function<void(handle_t)>& lambda) const {
-    
-    lambda(graph.flip(node));
-    graph.follow_edges(node, false, [&](const handle_t& next) {
-        lambda(graph.flip(next));
-    });
+handle_t BiedgedIndex::get_handle(uint32_t side) const {
+    return graph.get_handle(ids[side >> 1], side & 1);
 }
 
-bool BiedgedGraph::is_across_node_edge(handle_t node1, handle_t node2) const {
-    return graph.flip(node1) == node2;
+nid_t BiedgedIndex::get_id(uint32_t side) const {
+    return ids[side >> 1];
 }
 
-vector<handle_t> bridge_nodes(const HandleGraph& graph) {
-    
-    if (debug) {
-        cerr << "finding bridges in graph" << endl;
-        graph.for_each_handle([&](const handle_t& handle) {
-            cerr << graph.get_id(handle) << " " << graph.get_sequence(handle) << endl;
-            graph.follow_edges(handle, true, [&](const handle_t& prev) {
-                cerr << "\t" << graph.get_id(prev) << (graph.get_is_reverse(prev) ? "-" : "+") << " <-" << endl;
-            });
-            graph.follow_edges(handle, false, [&](const handle_t& next) {
-                cerr << "\t-> " << graph.get_id(next)  << (graph.get_is_reverse(next) ? "-" : "+")<< endl;
-            });
-        });
-    }
-    
-    BiedgedGraph undir_graph(graph);
+const uint32_t* BiedgedIndex::neighbors_begin(uint32_t side) const {
+    return targets.data() + offsets[side];
+}
+
+const uint32_t* BiedgedIndex::neighbors_end(uint32_t side) const {
+    return targets.data() + offsets[side + 1];
+}
+
+size_t BiedgedIndex::get_degree(uint32_t side) const {
+    return offsets[side + 1] - offsets[side] - 1;
+}
+
+vector<uint32_t> BiedgedIndex::find_bridge_nodes() const {
     
-    // TODO: should I just make this a class?
-    // records of node -> (parent, traversed upward, dfs index, edges downward)
-    unordered_map<handle_t, tuple<handle_t, bool, size_t, vector<handle_t>>> dfs_tree;
-    vector<handle_t> dfs_order;
+    // iterative Tarjan low-link DFS over the sides. the DFS state is kept on the stack
+    // (rather than per side) so that only the discovery and low-link arrays are full size
+    struct Frame {
+        uint32_t side;
+        uint32_t parent;
+        uint32_t cursor;
+        // a parallel edge to the parent is a cycle, so only one copy of the tree edge is skipped
+        bool skipped_parent;
+    };
     
-    dfs_tree.reserve(undir_graph.size());
-    dfs_order.reserve(undir_graph.size());
+    const uint32_t unvisited = numeric_limits<uint32_t>::max();
     
-    // records of (node, next edge idx, edges)
-    vector<tuple<handle_t, size_t, vector<handle_t>>> stack;
+    vector<uint32_t> discovery(side_count(), unvisited);
+    vector<uint32_t> low(side_count(), unvisited);
+    vector<Frame> stack;
+    vector<uint32_t> bridges;
     
-    // enqueue a non-visited node
-    auto enqueue = [&](handle_t node, handle_t parent) {
-        
-        stack.emplace_back(node, 0, vector<handle_t>());
-        
-        // record the order and initialize the tree edges
-        dfs_tree[node] = make_tuple(parent, false, dfs_order.size(), vector<handle_t>());
-        dfs_order.emplace_back(node);
-        
-        undir_graph.for_each_neighbor(node, [&](handle_t nbr) {
-            get<2>(stack.back()).emplace_back(nbr);
-        });
-    };
+    uint32_t time = 0;
     
-    // DFS
-    handle_t root = undir_graph.get_arbitrary_node();
-    if (debug) {
-        cerr << "beginning DFS from " << graph.get_id(root) << (graph.get_is_reverse(root) ? "L" : "R") << endl;
-    }
-    enqueue(root, root);
-    // note: the root doesn't really have a parent, but we use itself as a sentinel
-    while (!stack.empty()) {
-        
-        auto& top = stack.back();
-        
-        if (get<1>(top) == get<2>(top).size()) {
-            // exhausted edges from this node
-            stack.pop_back();
+    for (uint32_t root = 0; root < side_count(); ++root) {
+        if (discovery[root] != unvisited) {
             continue;
         }
         
-        auto next = get<2>(top)[get<1>(top)++];
+        discovery[root] = low[root] = time++;
+        stack.push_back({root, root, offsets[root], false});
         
-        if (!dfs_tree.count(next)) {
-            // the next node hasn't been visited yet, so we add its edge to
-            // the DFS tree and queue it up
-            get<3>(dfs_tree[get<0>(top)]).emplace_back(next);
-            enqueue(next, get<0>(top));
-        }
-    }
-    
-    if (debug) {
-        cerr << "finished making DFS tree:" << endl;
-        for (const auto& node : dfs_tree) {
-            cerr << graph.get_id(node.first) << (graph.get_is_reverse(node.first) ? "L" : "R") << endl;
-            for (auto next : get<3>(node.second)) {
-                cerr << "\t-> " << graph.get_id(next) << (graph.get_is_reverse(next) ? "L" : "R") << endl;
-            }
-        }
-    }
-    
-    for (size_t i = 0; i < dfs_order.size(); ++i) {
-        
-        handle_t node = dfs_order[i];
-        
-        // get the non-tree edges that will initiate chains
-        vector<handle_t> chain_heads;
-        // note: we count on the edges being iterated in the same order as previously
-        const auto& tree_record = dfs_tree[node];
-        size_t j = 0;
-        if (debug) {
-            cerr << "checking for unused edges from " << graph.get_id(node) << (graph.get_is_reverse(node) ? "L" : "R") << endl;
-        }
-        undir_graph.for_each_neighbor(node, [&](handle_t nbr) {
-            if (debug) {
-                cerr << "\t" << graph.get_id(nbr) << (graph.get_is_reverse(nbr) ? "L" : "R");
-            }
-            if (j < get<3>(tree_record).size() && get<3>(tree_record)[j] == nbr) {
-                // this edge was used in the DFS tree
-                ++j;
-                if (debug) {
-                    cerr << " was used in tree" << endl;
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            
+            if (top.cursor < offsets[top.side + 1]) {
+                uint32_t next = targets[top.cursor++];
+                
+                if (next == top.parent && top.side != top.parent && !top.skipped_parent) {
+                    top.skipped_parent = true;
+                    continue;
                 }
-            }
-            else if (get<2>(dfs_tree[nbr]) > i) {
-                // this edge points down the tree rather than up it
-                chain_heads.emplace_back(nbr);
-                if (debug) {
-                    cerr << " is a downward edge" << endl;
+                
+                if (discovery[next] == unvisited) {
+                    discovery[next] = low[next] = time++;
+                    // note: this invalidates top
+                    stack.push_back({next, top.side, offsets[next], false});
+                }
+                else {
+                    low[top.side] = min(low[top.side], discovery[next]);
                 }
             }
             else {
-                if (debug) {
-                    cerr << " is an upward edge" << endl;
+                Frame finished = top;
+                stack.pop_back();
+                
+                if (finished.side != finished.parent) {
+                    low[finished.parent] = min(low[finished.parent], low[finished.side]);
+                    
+                    // only the across-node edges are of interest
+                    if (low[finished.side] > discovery[finished.parent] && (finished.parent ^ 1) == finished.side) {
+                        bridges.push_back(finished.side >> 1);
+                    }
                 }
             }
-        });
-        
-        // mark nodes in the untraversed portion of this chain's cycle as traversed
-        for (handle_t chain_cursor : chain_heads) {
-            if (debug) {
-                cerr << "beginning upward traversal from " << graph.get_id(chain_cursor) << (graph.get_is_reverse(chain_cursor) ? "L" : "R") << endl;
-            }
-            while (chain_cursor != node && !get<1>(dfs_tree[chain_cursor])) {
-                get<1>(dfs_tree[chain_cursor]) = true;
-                chain_cursor = get<0>(dfs_tree[chain_cursor]);
-            }
         }
     }
     
-    // find the across-node edges that were never traversed in a cycle
-    vector<handle_t> bridges;
+    sort(bridges.begin(), bridges.end());
     
-    for (const auto& tree_record : dfs_tree) {
+    return bridges;
+}
 
-        if (!get<1>(tree_record.second) &&
-            undir_graph.is_across_node_edge(tree_record.first, get<0>(tree_record.second))) {
-            if (debug) {
-                cerr << "marking edge " << graph.get_id(tree_record.first) << " - " << (graph.get_is_reverse(tree_record.first) ? "L" : "R") << " as a bridge node" << endl;
-            }
-            bridges.push_back(graph.forward(tree_record.first));
+vector<handle_t> bridge_nodes(const HandleGraph& graph) {
+    
+    if (debug) {
+        cerr << "finding bridges in graph" << endl;
+        graph.for_each_handle([&](const handle_t& handle) {
+            cerr << graph.get_id(handle) << " " << graph.get_sequence(handle) << endl;
+            graph.follow_edges(handle, true, [&](const handle_t& prev) {
+                cerr << "\t" << graph.get_id(prev) << (graph.get_is_reverse(prev) ? "-" : "+") << " <-" << endl;
+            });
+            graph.follow_edges(handle, false, [&](const handle_t& next) {
+                cerr << "\t-> " << graph.get_id(next)  << (graph.get_is_reverse(next) ? "-" : "+")<< endl;
+            });
+        });
+    }
+    
+    BiedgedIndex index(graph);
+    
+    vector<handle_t> bridges;
+    for (uint32_t node_index : index.find_bridge_nodes()) {
+        handle_t bridge = index.get_handle(2 * node_index);
+        if (debug) {
+            cerr << "marking " << graph.get_id(bridge) << " as a bridge node" << endl;
         }
+        bridges.push_back(bridge);
     }
     
     return bridges;
@@ -238,26 +219,42 @@ vector<handle_t> bridge_nodes(const HandleGraph& graph) {
 vector<vector<handle_t>> consolidate_bridges(const HandleGraph& graph,
                                              const vector<handle_t>& bridges) {
     
+    BiedgedIndex index(graph);
+    
     // return a bool if the node has degree 1 in that direction, and if so also
     // the neighbor node
     auto degree_one_neighbor = [&](handle_t n, bool left_side) {
-        int count = 0;
-        handle_t nbr;
-        graph.follow_edges(n, left_side, [&](const handle_t& next) {
-            ++count;
-            nbr = next;
-            return count <= 1;
-        });
-        return make_pair(count == 1, nbr);
+        uint32_t side = index.get_side(left_side ? graph.flip(n) : n);
+        if (index.get_degree(side) != 1) {
+            return make_pair(false, n);
+        }
+        // the neighbor side faces back toward n, so flip it to match the orientation from follow_edges
+        uint32_t nbr_side = *(index.neighbors_begin(side) + 1);
+        return make_pair(true, index.get_handle(left_side ? nbr_side : nbr_side ^ 1));
+    };
+    
+    vector<bool> remaining(index.node_count(), false);
+    size_t num_remaining = 0;
+    for (handle_t node : bridges) {
+        uint32_t node_index = index.get_side(node) >> 1;
+        if (!remaining[node_index]) {
+            remaining[node_index] = true;
+            ++num_remaining;
+        }
+    }
+    auto is_remaining = [&](handle_t n) {
+        return remaining[index.get_side(n) >> 1];
+    };
+    auto erase = [&](handle_t n) {
+        remaining[index.get_side(n) >> 1] = false;
+        --num_remaining;
     };
-        
-    unordered_set<handle_t> remaining(bridges.begin(), bridges.end());
     
     vector<vector<handle_t>> return_val;
     
     for (handle_t node : bridges) {
         
-        if (!remaining.count(node)) {
+        if (!is_remaining(node)) {
             continue;
         }
         
@@ -265,7 +262,7 @@ vector<vector<handle_t>> consolidate_bridges(const HandleGraph& graph,
         
         return_val.emplace_back(1, node);
         auto& consolidated_bridge = return_val.back();
-        remaining.erase(node);
+        erase(node);
         
         // try to extend the bridge in both directions
         for (bool to_left : {true, false}) {
@@ -275,7 +272,7 @@ vector<vector<handle_t>> consolidate_bridges(const HandleGraph& graph,
                 bool degree_one;
                 handle_t nbr;
                 tie(degree_one, nbr) = degree_one_neighbor(consolidated_bridge.back(), to_left);
-                if (!degree_one || !remaining.count(graph.forward(nbr))) {
+                if (!degree_one || !is_remaining(nbr)) {
                     // there is not a single neighbor, or else it is not a bridge
                     break;
                 }
@@ -284,7 +281,7 @@ vector<vector<handle_t>> consolidate_bridges(const HandleGraph& graph,
                     break;
                 }
                 consolidated_bridge.push_back(nbr);
-                remaining.erase(nbr);
+                erase(nbr);
             }
             
             // when we build leftwards, we need to reverse it to keep the
@@ -295,87 +292,114 @@ vector<vector<handle_t>> consolidate_bridges(const HandleGraph& graph,
         }
     }
     
-    assert(remaining.empty());
+    assert(num_remaining == 0);
     return return_val;
 }
 
 // FIXME: this will not find any bridge-free connected components...
 
-void for_each_bridge_component(const HandleGraph& graph,
-                               const vector<vector<handle_t>>& bridges,
-                               const function<void(const HandleGraph&,
-                                                   const vector<pair<size_t, bool>>&)>& f) {
+// traverse the bridge components, giving the function the node set of each component and its incident bridges.
+// the function may take ownership of its arguments
+static void traverse_bridge_components(const HandleGraph& graph,
+                                       const vector<vector<handle_t>>& bridges,
+                                       const function<void(unordered_set<nid_t>&,
+                                                           vector<pair<size_t, bool>>&)>& f) {
     
     
-    unordered_map<handle_t, pair<size_t, bool>> bridge_ends;
-    unordered_set<handle_t> visited;
+    BiedgedIndex index(graph);
+    
+    // the bridge (index, direction) that each side is the end of, or -1, encoded as 2 * index + direction
+    vector<int64_t> bridge_ends(index.side_count(), -1);
+    vector<bool> visited(index.side_count(), false);
     for (size_t i = 0; i < bridges.size(); ++i) {
         const auto& bridge = bridges[i];
-        bridge_ends[bridge.back()] = make_pair(i, false);
-        bridge_ends[graph.flip(bridge.front())] = make_pair(i, true);
+        bridge_ends[index.get_side(bridge.back())] = 2 * int64_t(i);
+        bridge_ends[index.get_side(graph.flip(bridge.front()))] = 2 * int64_t(i) + 1;
         
         // we pre-mark the sides we don't want to traverse as visited
         for (size_t j = 0; j < bridge.size(); ++j) {
             if (j != 0) {
-                visited.insert(graph.flip(bridge[j]));
+                visited[index.get_side(graph.flip(bridge[j]))] = true;
             }
             if (j + 1 != bridge.size()) {
-                visited.insert(bridge[j]);
+                visited[index.get_side(bridge[j])] = true;
             }
         }
     }
     
+    vector<uint32_t> stack;
     
-    graph.for_each_handle([&](const handle_t& node) {
-        for (bool left_side : {false, true}) {
-            
-            handle_t seed = left_side ? graph.flip(node) : node;
-            if (visited.count(seed)) {
-                // we've already traversed this side's component
-                continue;
-            }
-            
-            visited.insert(seed);
+    for (uint32_t seed = 0; seed < index.side_count(); ++seed) {
+        if (visited[seed]) {
+            // we've already traversed this side's component
+            continue;
+        }
+        
+        visited[seed] = true;
+        
+        vector<pair<size_t, bool>> adjacent_bridges;
+        unordered_set<nid_t> node_ids{index.get_id(seed)};
+        stack.assign(1, seed);
+        
+        while (!stack.empty()) {
             
-            vector<pair<size_t, bool>> adjacent_bridges;
-            unordered_set<nid_t> node_ids{graph.get_id(seed)};
-            vector<handle_t> stack(1, seed);
+            uint32_t side = stack.back();
+            stack.pop_back();
             
-            while (!stack.empty()) {
-                
-                handle_t node = stack.back();
-                stack.pop_back();
-                
-                auto it = bridge_ends.find(node);
-                if (it != bridge_ends.end()) {
-                    // we hit a bridge, don't cross it, but remember which
-                    // bridge it was
-                    adjacent_bridges.push_back(it->second);
-                }
-                else {
-                    // this is not a bridge, we can look at the other side
-                    handle_t across_node = graph.flip(node);
-                    if (!visited.count(across_node)) {
-                        stack.push_back(across_node);
-                        visited.insert(across_node);
-                    }
+            if (bridge_ends[side] >= 0) {
+                // we hit a bridge, don't cross it, but remember which
+                // bridge it was
+                adjacent_bridges.emplace_back(size_t(bridge_ends[side] / 2), bool(bridge_ends[side] % 2));
+            }
+            else {
+                // this is not a bridge, we can look at the other side
+                uint32_t across = side ^ 1;
+                if (!visited[across]) {
+                    stack.push_back(across);
+                    visited[across] = true;
                 }
-                
-                // we can always look across edges
-                graph.follow_edges(node, false, [&](const handle_t& next) {
-                    handle_t adjacent = graph.flip(next);
-                    if (!visited.count(adjacent)) {
-                        node_ids.insert(graph.get_id(adjacent));
-                        visited.insert(adjacent);
-                        stack.push_back(adjacent);
-                    }
-                });
             }
             
-            // make a component subgraph and execute the lambda
-            SubgraphOverlay bridge_component(&graph, &node_ids);
-            f(bridge_component, adjacent_bridges);
+            // we can always look across edges (skipping the across-node edge, which is first)
+            for (auto it = index.neighbors_begin(side) + 1; it != index.neighbors_end(side); ++it) {
+                uint32_t adjacent = *it;
+                if (!visited[adjacent]) {
+                    node_ids.insert(index.get_id(adjacent));
+                    visited[adjacent] = true;
+                    stack.push_back(adjacent);
+                }
+            }
         }
+        
+        f(node_ids, adjacent_bridges);
+    }
+}
+
+void for_each_bridge_component(const HandleGraph& graph,
+                               const vector<vector<handle_t>>& bridges,
+                               const function<void(const HandleGraph&,
+                                                   const vector<pair<size_t, bool>>&)>& f) {
+    
+    traverse_bridge_components(graph, bridges, [&](unordered_set<nid_t>& node_ids,
+                                                    vector<pair<size_t, bool>>& adjacent_bridges) {
+        // make a component subgraph and execute the lambda
+        SubgraphOverlay bridge_component(&graph, &node_ids);
+        f(bridge_component, adjacent_bridges);
+    });
+}
+
+void get_bridge_components(const HandleGraph& graph,
+                           const vector<vector<handle_t>>& bridges,
+                           vector<unordered_set<nid_t>>& components,
+                           vector<vector<pair<size_t, bool>>>& incident_bridges) {
+    
+    components.clear();
+    incident_bridges.clear();
+    
+    traverse_bridge_components(graph, bridges, [&](unordered_set<nid_t>& node_ids,
+                                                    vector<pair<size_t, bool>>& adjacent_bridges) {
+        components.emplace_back(move(node_ids));
+        incident_bridges.emplace_back(move(adjacent_bridges));
     });
 }
 
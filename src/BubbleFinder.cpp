@@ -0,0 +1,210 @@
+#include "BubbleFinder.hpp"
+#include "graph_utility.hpp"
+
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+
+namespace gfase {
+
+
+SmallIdSet::SmallIdSet():
+        inline_ids(),
+        overflow_ids(),
+        length(0)
+{}
+
+
+void SmallIdSet::insert(nid_t id){
+    // Degree is almost always tiny, so a linear scan is cheaper than any search structure
+    size_t i = 0;
+    for (auto iter = begin(); iter != end(); ++iter){
+        if (*iter == id){
+            return;
+        }
+        if (*iter > id){
+            break;
+        }
+        i++;
+    }
+
+    if (overflow_ids.empty() and length < inline_capacity){
+        for (size_t j=length; j>i; j--){
+            inline_ids[j] = inline_ids[j-1];
+        }
+        inline_ids[i] = id;
+    }
+    else {
+        if (overflow_ids.empty()){
+            overflow_ids.assign(inline_ids.begin(), inline_ids.begin() + length);
+        }
+        overflow_ids.insert(overflow_ids.begin() + i, id);
+    }
+
+    length++;
+}
+
+
+void SmallIdSet::clear(){
+    overflow_ids.clear();
+    length = 0;
+}
+
+
+const nid_t* SmallIdSet::begin() const{
+    return overflow_ids.empty() ? inline_ids.data() : overflow_ids.data();
+}
+
+
+const nid_t* SmallIdSet::end() const{
+    return begin() + length;
+}
+
+
+nid_t SmallIdSet::front() const{
+    return *begin();
+}
+
+
+size_t SmallIdSet::size() const{
+    return length;
+}
+
+
+bool SmallIdSet::empty() const{
+    return length == 0;
+}
+
+
+bool SmallIdSet::operator==(const SmallIdSet& other) const{
+    return length == other.length and std::equal(begin(), end(), other.begin());
+}
+
+
+bool SmallIdSet::operator!=(const SmallIdSet& other) const{
+    return not (*this == other);
+}
+
+
+NodeNeighborhood::NodeNeighborhood():
+        id(0),
+        has_self_edge(false)
+{}
+
+
+void NodeNeighborhood::clear(){
+    left_first_degree.clear();
+    right_first_degree.clear();
+    left_second_degree.clear();
+    right_second_degree.clear();
+    has_self_edge = false;
+}
+
+
+void get_neighborhood(const HandleGraph& graph, const handle_t& h0, NodeNeighborhood& neighborhood){
+    neighborhood.clear();
+
+    auto id0 = graph.get_id(h0);
+    neighborhood.id = id0;
+
+    for (bool go_left: {true, false}){
+        auto& first_degree = go_left ? neighborhood.left_first_degree : neighborhood.right_first_degree;
+        auto& second_degree = go_left ? neighborhood.left_second_degree : neighborhood.right_second_degree;
+
+        graph.follow_edges(h0, go_left, [&](const handle_t& h1){
+            auto id1 = graph.get_id(h1);
+
+            if (id0 != id1) {
+                first_degree.insert(id1);
+            }
+            else{
+                neighborhood.has_self_edge = true;
+            }
+
+            graph.follow_edges(h1, not go_left, [&](const handle_t& h2){
+                auto id2 = graph.get_id(h2);
+
+                if (id0 != id2) {
+                    second_degree.insert(id2);
+                }
+            });
+        });
+    }
+}
+
+
+// Small enough to balance the load, large enough that claiming a job isn't contended
+static const nid_t neighborhood_chunk_size = 4096;
+
+
+size_t get_neighborhood_chunk_count(const HandleGraph& graph){
+    if (graph.get_node_count() == 0){
+        return 0;
+    }
+
+    return size_t((graph.max_node_id() - graph.min_node_id()) / neighborhood_chunk_size + 1);
+}
+
+
+void for_each_neighborhood_in_parallel(
+        const HandleGraph& graph,
+        size_t n_threads,
+        const function<void(const NodeNeighborhood& neighborhood, size_t chunk_index)>& f){
+
+    auto n_chunks = get_neighborhood_chunk_count(graph);
+
+    if (n_chunks == 0){
+        return;
+    }
+
+    nid_t min_id = graph.min_node_id();
+    nid_t max_id = graph.max_node_id();
+
+    for_each_job_in_parallel(n_chunks, max(size_t(1), n_threads), [&](size_t c){
+        NodeNeighborhood neighborhood;
+
+        nid_t start = min_id + nid_t(c)*neighborhood_chunk_size;
+        nid_t stop = min(max_id, start + neighborhood_chunk_size - 1);
+
+        for (nid_t id=start; id<=stop; id++){
+            if (not graph.has_node(id)){
+                continue;
+            }
+
+            get_neighborhood(graph, graph.get_handle(id), neighborhood);
+            f(neighborhood, c);
+        }
+    });
+}
+
+
+void find_diploid_bubbles(const HandleGraph& graph, vector <pair <nid_t, nid_t> >& bubbles, size_t n_threads){
+    vector <vector <pair <nid_t, nid_t> > > bubbles_per_chunk(get_neighborhood_chunk_count(graph));
+
+    for_each_neighborhood_in_parallel(graph, n_threads, [&](const NodeNeighborhood& n, size_t chunk_index){
+        bool is_symmetrical_bubble = (n.right_second_degree == n.left_second_degree);
+        bool is_diploid_bubble = (n.right_second_degree.size() == 1);
+
+        if (is_symmetrical_bubble and is_diploid_bubble){
+            auto id_a = n.id;
+            auto id_b = n.left_second_degree.front();
+
+            bubbles_per_chunk[chunk_index].emplace_back(min(id_a, id_b), max(id_a, id_b));
+        }
+    });
+
+    bubbles.clear();
+
+    for (auto& result: bubbles_per_chunk){
+        bubbles.insert(bubbles.end(), result.begin(), result.end());
+    }
+
+    // Both sides of a bubble usually report it, and the chunks finish in arbitrary order
+    std::sort(bubbles.begin(), bubbles.end());
+    bubbles.erase(std::unique(bubbles.begin(), bubbles.end()), bubbles.end());
+}
+
+
+}
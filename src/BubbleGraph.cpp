@@ -1,4 +1,5 @@
 #include "BubbleGraph.hpp"
+#include "BubbleFinder.hpp"
 #include "bdsg/internal/hash_map.hpp"
 #include "IncrementalIdMap.hpp"
 #include "Filesystem.hpp"
@@ -92,23 +93,23 @@ BubbleGraph::BubbleGraph(IncrementalIdMap<string>& id_map) :
 
 
 // Topology based bubble finding
-BubbleGraph::BubbleGraph(const HandleGraph& graph, const contact_map_t& contact_map) :
+BubbleGraph::BubbleGraph(const HandleGraph& graph, const contact_map_t& contact_map, size_t n_threads) :
         bubbles(),
         node_id_to_bubble_id(),
         bubble_to_bubble(),
         bubble_edges() {
-    generate_diploid_symmetrical_bubbles_from_graph(graph);
+    generate_diploid_symmetrical_bubbles_from_graph(graph, n_threads);
     generate_bubble_adjacency_from_contact_map(contact_map);
 }
 
 
 // Topology based bubble finding
-BubbleGraph::BubbleGraph(const HandleGraph& graph) :
+BubbleGraph::BubbleGraph(const HandleGraph& graph, size_t n_threads) :
         bubbles(),
         node_id_to_bubble_id(),
         bubble_to_bubble(),
         bubble_edges() {
-    generate_diploid_symmetrical_bubbles_from_graph(graph);
+    generate_diploid_symmetrical_bubbles_from_graph(graph, n_threads);
 }
 
 
@@ -129,57 +130,14 @@ void BubbleGraph::for_each_node_id(const function<void(const int32_t id)>& f) co
 }
 
 
-void BubbleGraph::generate_diploid_symmetrical_bubbles_from_graph(const HandleGraph& graph){
-    graph.for_each_handle([&](const handle_t& h0) {
-        auto id0 = graph.get_id(h0);
+void BubbleGraph::generate_diploid_symmetrical_bubbles_from_graph(const HandleGraph& graph, size_t n_threads){
+    vector <pair <nid_t, nid_t> > node_pairs;
+    find_diploid_bubbles(graph, node_pairs, n_threads);
 
-        // Do a two-edge walk right/left and left/right
-        unordered_set<nid_t> left_second_degree_neighbors;
-        unordered_set<nid_t> right_second_degree_neighbors;
-
-        unordered_set<nid_t> left_first_degree_neighbors;
-        unordered_set<nid_t> right_first_degree_neighbors;
-
-        graph.follow_edges(h0, true, [&](const handle_t& h1){
-            auto id1 = graph.get_id(h1);
-            left_first_degree_neighbors.emplace(id1);
-
-            graph.follow_edges(h1, false, [&](const handle_t& h2){
-                auto id2 = graph.get_id(h2);
-
-                if (id0 != id2) {
-                    left_second_degree_neighbors.emplace(id2);
-                }
-            });
-        });
-
-        graph.follow_edges(h0, false, [&](const handle_t& h1){
-            auto id1 = graph.get_id(h1);
-            right_first_degree_neighbors.emplace(id1);
-
-            graph.follow_edges(h1, true, [&](const handle_t& h2){
-                auto id2 = graph.get_id(h2);
-
-                if (id0 != id2) {
-                    right_second_degree_neighbors.emplace(id2);
-                }
-            });
-        });
-
-        int32_t result = -1;
-
-        bool is_symmetrical_bubble = (right_second_degree_neighbors == left_second_degree_neighbors);
-        bool is_diploid_bubble = (right_second_degree_neighbors.size() == 1);
-        bool is_chainable = (right_first_degree_neighbors.size() < 3 and left_first_degree_neighbors.size() < 3);
-
-        // If there are no second degree neighbors, this unphased subgraph passes
-        if (is_symmetrical_bubble and is_diploid_bubble){
-            auto id_a = graph.get_id(h0);
-            auto id_b = graph.get_id(graph.get_handle(*left_second_degree_neighbors.begin()));
-
-            result = try_add_bubble(int32_t(id_a), int32_t(id_b));
-        }
-    });
+    // Pairs are sorted, so bubble ids don't depend on the number of threads or the graph's iteration order
+    for (const auto& [id_a, id_b]: node_pairs){
+        try_add_bubble(int32_t(id_a), int32_t(id_b));
+    }
 }
 
 
@@ -429,45 +387,45 @@ void BubbleGraph::flip(size_t b) {
 void BubbleGraph::generate_bubbles_from_shasta_names(IncrementalIdMap<string>& id_map) {
     unordered_set <int32_t> visited;
 
-    for (auto&[name, id]: id_map.ids) {
+    id_map.for_each_name([&](string_view name, int64_t id){
         if (visited.count(int32_t(id)) > 0) {
-            continue;
+            return;
         }
 
         // Skip any "UR" prefixed nodes
         if (name.empty()){
-            continue;
+            return;
         }
         else if (name[0] == 'U'){
-            continue;
+            return;
         }
 
         // Split to find last field, which should be 0/1 for shasta PR segments
         auto i = name.find_last_of('.');
 
         if (i < 2 or i > name.size()) {
-            continue;
+            return;
         }
 
-        auto prefix = name.substr(0, i);
-        int64_t side = stoi(name.substr(i + 1));
+        string prefix(name.substr(0, i));
+        int64_t side = stoi(string(name.substr(i + 1)));
 
         // Cheap test to check for proper syntax
         if (side > 1 or side < 0) {
-            throw std::runtime_error("ERROR: shasta bubble side not 0/1: " + name);
+            throw std::runtime_error("ERROR: shasta bubble side not 0/1: " + string(name));
         }
 
         // Find complement
         string other_name = prefix + '.' + to_string(1 - side);
 
         // Look for the other name in the id_map, add it if it doesn't exist
-        // Later, will need to assume these missing entries in the contact map are 0
+        // Later, will need to assume these missing entries in the contact map are 0 (this invalidates the name view)
         auto other_id = id_map.try_insert(other_name);
         emplace(int32_t(id), int32_t(other_id), 0);
 
         visited.emplace(id);
         visited.emplace(other_id);
-    }
+    });
 }
 
 
@@ -627,17 +585,13 @@ void random_phase_search(
         atomic<int64_t>& best_score,
         atomic<size_t>& job_index,
         mutex& phase_mutex,
-        size_t m_iterations
+        size_t m_iterations,
+        SplitMix64 rng
 ){
 
     size_t m = job_index.fetch_add(1);
 
-    // True random number
-    std::random_device rd;
-
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,int(bubbles.size()-1));
+    auto n_bubbles = bubbles.size();
 
     int64_t total_score;
 
@@ -649,11 +603,11 @@ void random_phase_search(
     while (m < m_iterations) {
         // Randomly perturb
         for (size_t i=0; i < ((bubbles.size()/10) + 1); i++) {
-            bubbles.flip(uniform_distribution(rng));
+            bubbles.flip(rng.bounded(n_bubbles));
         }
 
         for (size_t i=0; i < bubbles.size()*3; i++) {
-            auto b = uniform_distribution(rng);
+            auto b = rng.bounded(n_bubbles);
 
             auto score = compute_consistency_score(bubbles, b, contact_map);
             bubbles.flip(b);
@@ -688,7 +642,8 @@ void phase_contacts(
         const contact_map_t& contact_map,
         const IncrementalIdMap<string>& id_map,
         BubbleGraph& bubbles,
-        size_t n_threads
+        size_t n_threads,
+        uint64_t seed
 ){
 
     vector<bool> best_phases(bubbles.size(), false);
@@ -714,7 +669,8 @@ void phase_contacts(
                     ref(best_score),
                     ref(job_index),
                     ref(phase_mutex),
-                    m_iterations
+                    m_iterations,
+                    SplitMix64(seed, i)
             ));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -1,96 +1,250 @@
 #include "Chainer.hpp"
+#include "BubbleFinder.hpp"
 
+#include <algorithm>
 #include <queue>
 
+using std::lower_bound;
 using std::queue;
+using std::sort;
+using std::fill;
 
 
 namespace gfase{
 
 
+ChainTraversalContext::ChainTraversalContext(const HandleGraph& graph):
+        ids(),
+        is_contiguous(true),
+        node_epochs(),
+        handle_epochs(),
+        epoch(1),
+        ploidy(),
+        alts()
+{
+    ids.reserve(graph.get_node_count());
+
+    graph.for_each_handle([&](const handle_t& h){
+        ids.emplace_back(graph.get_id(h));
+    });
+
+    if (ids.size() > numeric_limits<uint32_t>::max()){
+        throw runtime_error("ERROR: too many nodes for ChainTraversalContext: " + to_string(ids.size()));
+    }
+
+    sort(ids.begin(), ids.end());
+
+    // Most graphs are loaded with consecutive ids, in which case the index is just an offset
+    is_contiguous = ids.empty() or (ids.back() - ids.front() + 1 == nid_t(ids.size()));
+
+    node_epochs.resize(ids.size(), 0);
+    handle_epochs.resize(2*ids.size(), 0);
+    ploidy.resize(ids.size(), 0);
+    alts.resize(ids.size(), 0);
+}
+
+
+size_t ChainTraversalContext::size() const{
+    return ids.size();
+}
+
+
+size_t ChainTraversalContext::get_index(nid_t id) const{
+    if (is_contiguous){
+        return size_t(id - ids.front());
+    }
+
+    return size_t(lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+}
+
+
+size_t ChainTraversalContext::get_index(const HandleGraph& graph, const handle_t& h) const{
+    return get_index(graph.get_id(h));
+}
+
+
+nid_t ChainTraversalContext::get_id(size_t index) const{
+    return ids[index];
+}
+
+
+void ChainTraversalContext::next_epoch(){
+    epoch++;
+
+    // Only after ~4 billion traversals, the stamps have to be cleared for real
+    if (epoch == 0){
+        fill(node_epochs.begin(), node_epochs.end(), 0);
+        fill(handle_epochs.begin(), handle_epochs.end(), 0);
+        epoch = 1;
+    }
+}
+
+
+bool ChainTraversalContext::visit(size_t index){
+    if (node_epochs[index] == epoch){
+        return false;
+    }
+
+    node_epochs[index] = epoch;
+    return true;
+}
+
+
+bool ChainTraversalContext::visit(const HandleGraph& graph, const handle_t& h){
+    auto i = 2*get_index(graph, h) + graph.get_is_reverse(h);
+
+    if (handle_epochs[i] == epoch){
+        return false;
+    }
+
+    handle_epochs[i] = epoch;
+    return true;
+}
+
+
+bool ChainTraversalContext::is_visited(size_t index) const{
+    return node_epochs[index] == epoch;
+}
+
+
+void ChainTraversalContext::set_haploid(size_t index){
+    ploidy[index] = 1;
+}
+
+
+void ChainTraversalContext::set_diploid(size_t index, size_t alt_index){
+    ploidy[index] = 2;
+    alts[index] = uint32_t(alt_index);
+}
+
+
+int8_t ChainTraversalContext::get_ploidy(size_t index) const{
+    return ploidy[index];
+}
+
+
+size_t ChainTraversalContext::get_alt(size_t index) const{
+    return alts[index];
+}
+
+
+IndexSpans::IndexSpans():
+        items(),
+        offsets({0})
+{}
+
+
+void IndexSpans::add(uint32_t item){
+    items.emplace_back(item);
+}
+
+
+bool IndexSpans::close_span(){
+    if (items.size() == offsets.back()){
+        return false;
+    }
+
+    offsets.emplace_back(items.size());
+    return true;
+}
+
+
+size_t IndexSpans::size() const{
+    return offsets.size() - 1;
+}
+
+
+const uint32_t* IndexSpans::begin(size_t i) const{
+    return items.data() + offsets[i];
+}
+
+
+const uint32_t* IndexSpans::end(size_t i) const{
+    return items.data() + offsets[i+1];
+}
+
+
+void Chainer::index_chainable_nodes(ChainTraversalContext& context) const{
+    for (auto id: haploid_nodes){
+        context.set_haploid(context.get_index(id));
+    }
+
+    // Diploid takes precedence over haploid, as it does in the traversals
+    for (auto id: diploid_nodes){
+        context.set_diploid(context.get_index(id), context.get_index(node_pairs.at(id)));
+    }
+}
+
+
 void Chainer::get_chain(
         const HandleGraph& graph,
+        ChainTraversalContext& context,
         const nid_t& start_node,
         deque <set <nid_t> >& chain
         ){
 
-    unordered_set<nid_t> visited;
+    context.next_epoch();
+
     queue <set <nid_t> > q;
 
+    auto start_index = context.get_index(start_node);
+
     // Initialize start node as an item in the chain
     // Only chainable nodes should be considered
-    {
-        bool is_diploid = diploid_nodes.count(start_node);
-        bool is_haploid = haploid_nodes.count(start_node);
+    auto enqueue_start = [&](){
+        auto ploidy = context.get_ploidy(start_index);
 
-        // Check that this has NOT been visited before queuing it
-        if (is_diploid or is_haploid) {
+        if (ploidy > 0) {
             q.emplace();
             q.back().emplace(start_node);
 
             // If this node is diploid, also add the alt/pair but don't bother to queue it.
-            if (is_diploid){
-                auto alt_node = node_pairs.at(start_node);
-                visited.emplace(alt_node);
-                q.back().emplace(alt_node);
+            if (ploidy == 2){
+                auto alt_index = context.get_alt(start_index);
+                context.visit(alt_index);
+                q.back().emplace(context.get_id(alt_index));
             }
         }
-    }
-
-    // Search left
-    while (not q.empty()) {
-        set <nid_t> item = q.front();
-        q.pop();
-
-        chain.emplace_front(item);
-
-        auto h = graph.get_handle(*item.begin());
-
-        graph.follow_edges(h, true, [&](const handle_t& other_handle) {
-            auto next_node = graph.get_id(other_handle);
+    };
 
-            // Attempt to add this to the set of visited nodes
-            auto unvisited = visited.emplace(next_node).second;
+    auto visit_next = [&](const handle_t& other_handle){
+        auto next_index = context.get_index(graph, other_handle);
 
-            // Only chainable nodes should be considered
-            bool is_diploid = diploid_nodes.count(next_node);
-            bool is_haploid = haploid_nodes.count(next_node);
+        // Attempt to add this to the set of visited nodes
+        auto unvisited = context.visit(next_index);
 
-            // Check that this has NOT been visited before queuing it
-            if (unvisited and (is_diploid or is_haploid)) {
-                q.emplace();
-                q.back().emplace(next_node);
-
-                // If this node is diploid, also add the alt/pair but don't bother to queue it.
-                if (is_diploid){
-                    auto alt_node = node_pairs.at(next_node);
-                    visited.emplace(alt_node);
-                    q.back().emplace(alt_node);
-                }
-            }
-        });
-    }
-
-    // Initialize start node as an item in the chain
-    // Only chainable nodes should be considered
-    {
-        bool is_diploid = diploid_nodes.count(start_node);
-        bool is_haploid = haploid_nodes.count(start_node);
+        // Only chainable nodes should be considered
+        auto ploidy = context.get_ploidy(next_index);
 
         // Check that this has NOT been visited before queuing it
-        if (is_diploid or is_haploid) {
+        if (unvisited and ploidy > 0) {
             q.emplace();
-            q.back().emplace(start_node);
+            q.back().emplace(context.get_id(next_index));
 
             // If this node is diploid, also add the alt/pair but don't bother to queue it.
-            if (is_diploid){
-                auto alt_node = node_pairs.at(start_node);
-                visited.emplace(alt_node);
-                q.back().emplace(alt_node);
+            if (ploidy == 2){
+                auto alt_index = context.get_alt(next_index);
+                context.visit(alt_index);
+                q.back().emplace(context.get_id(alt_index));
             }
         }
+    };
+
+    enqueue_start();
+
+    // Search left
+    while (not q.empty()) {
+        set <nid_t> item = q.front();
+        q.pop();
+
+        chain.emplace_front(item);
+
+        auto h = graph.get_handle(*item.begin());
+        graph.follow_edges(h, true, visit_next);
     }
 
+    enqueue_start();
+
     // Search right
     while (not q.empty()) {
         set <nid_t> item = q.front();
@@ -101,132 +255,97 @@ void Chainer::get_chain(
         }
 
         auto h = graph.get_handle(*item.begin());
-
-        graph.follow_edges(h, false, [&](const handle_t& other_handle) {
-            auto next_node = graph.get_id(other_handle);
-
-            // Attempt to add this to the set of visited nodes
-            auto unvisited = visited.emplace(next_node).second;
-
-            // Only chainable nodes should be considered
-            bool is_diploid = diploid_nodes.count(next_node);
-            bool is_haploid = haploid_nodes.count(next_node);
-
-            // Check that this has NOT been visited before queuing it
-            if (unvisited and (is_diploid or is_haploid)) {
-                q.emplace();
-                q.back().emplace(next_node);
-
-                // If this node is diploid, also add the alt/pair but don't bother to queue it.
-                if (is_diploid){
-                    auto alt_node = node_pairs.at(next_node);
-                    visited.emplace(alt_node);
-                    q.back().emplace(alt_node);
-                }
-            }
-        });
+        graph.follow_edges(h, false, visit_next);
     }
 }
 
 
 void Chainer::get_undirected_chain_subgraph(
         const HandleGraph& graph,
+        ChainTraversalContext& context,
         const nid_t& start_node,
-        PackedSubgraphOverlay& subgraph
+        IndexSpans& subgraphs
         ){
 
-    queue <nid_t> q;
+    queue <uint32_t> q;
+
+    auto start_index = context.get_index(start_node);
 
-    // Initialize start node as an item in the chain
     // Only chainable nodes should be considered
-    {
-        bool is_diploid = diploid_nodes.count(start_node);
-        bool is_haploid = haploid_nodes.count(start_node);
+    if (context.get_ploidy(start_index) > 0 and context.visit(start_index)) {
+        q.push(uint32_t(start_index));
+    }
 
-        // Check that this has NOT been visited before queuing it
-        if (is_diploid or is_haploid) {
-            q.push(start_node);
+    auto visit_next = [&](const handle_t& other_handle) {
+        auto next_index = context.get_index(graph, other_handle);
+
+        // Only chainable nodes should be considered, and only queued once
+        if (context.get_ploidy(next_index) > 0 and context.visit(next_index)) {
+            q.emplace(uint32_t(next_index));
         }
-    }
+    };
 
     // Search left and right
     while (not q.empty()) {
-        nid_t n = q.front();
+        auto i = q.front();
         q.pop();
 
-        auto h = graph.get_handle(n);
-
-        subgraph.add_node(h);
-
-        graph.follow_edges(h, true, [&](const handle_t& other_handle) {
-            auto next_node = graph.get_id(other_handle);
-
-            // Attempt to add this to the set of visited nodes
-            auto unvisited = not subgraph.has_node(next_node);
-
-            // Only chainable nodes should be considered
-            bool is_diploid = diploid_nodes.count(next_node);
-            bool is_haploid = haploid_nodes.count(next_node);
-
-            // Check that this has NOT been visited before queuing it
-            if (unvisited and (is_diploid or is_haploid)) {
-                q.emplace(next_node);
-            }
-        });
-        graph.follow_edges(h, false, [&](const handle_t& other_handle) {
-            auto next_node = graph.get_id(other_handle);
-
-            // Attempt to add this to the set of visited nodes
-            auto unvisited = not subgraph.has_node(next_node);
+        subgraphs.add(i);
 
-            // Only chainable nodes should be considered
-            bool is_diploid = diploid_nodes.count(next_node);
-            bool is_haploid = haploid_nodes.count(next_node);
+        auto h = graph.get_handle(context.get_id(i));
 
-            // Check that this has NOT been visited before queuing it
-            if (unvisited and (is_diploid or is_haploid)) {
-                q.emplace(next_node);
-            }
-        });
+        graph.follow_edges(h, true, visit_next);
+        graph.follow_edges(h, false, visit_next);
     }
 }
 
 
 void Chainer::get_oriented_subgraph(
         const HandleGraph& graph,
-        const nid_t& start_node,
-        array <PackedSubgraphOverlay, 2>& oriented_subgraphs
+        ChainTraversalContext& context,
+        const uint32_t* begin,
+        const uint32_t* end,
+        array <vector <uint32_t>, 2>& oriented_subgraphs
         ){
 
+    for (auto& s: oriented_subgraphs){
+        s.clear();
+    }
+
+    if (begin == end){
+        return;
+    }
+
+    // Node stamps mark membership in the subgraph, handle stamps mark the visited orientations
+    context.next_epoch();
+
+    for (auto iter = begin; iter != end; ++iter){
+        context.visit(*iter);
+    }
+
     queue <handle_t> q;
-    unordered_set <handle_t> visited;
 
-    auto start_handle = graph.get_handle(start_node);
+    auto start_handle = graph.get_handle(context.get_id(*std::min_element(begin, end)));
 
     q.emplace(start_handle);
-    visited.emplace(start_handle);
+    context.visit(graph, start_handle);
+
+    auto visit_next = [&](const handle_t& other_handle) {
+        // Only follow edges within the subgraph, and check that this has NOT been visited before queuing it
+        if (context.is_visited(context.get_index(graph, other_handle)) and context.visit(graph, other_handle)) {
+            q.emplace(other_handle);
+        }
+    };
 
     // Search left and right
     while (not q.empty()) {
         auto h = q.front();
         q.pop();
 
-        oriented_subgraphs[graph.get_is_reverse(h)].add_node(h);
+        oriented_subgraphs[graph.get_is_reverse(h)].emplace_back(context.get_index(graph, h));
 
-        graph.follow_edges(h, true, [&](const handle_t& other_handle) {
-            // Check that this has NOT been visited before queuing it
-            if (visited.count(other_handle) == 0) {
-                q.emplace(other_handle);
-                visited.emplace(other_handle);
-            }
-        });
-        graph.follow_edges(h, false, [&](const handle_t& other_handle) {
-            // Check that this has NOT been visited before queuing it
-            if (visited.count(other_handle) == 0) {
-                q.emplace(other_handle);
-                visited.emplace(other_handle);
-            }
-        });
+        graph.follow_edges(h, true, visit_next);
+        graph.follow_edges(h, false, visit_next);
     }
 }
 
@@ -236,60 +355,59 @@ void Chainer::for_each_chain(
         const function<void(chain_t& chain)>& f
         ){
 
-    unordered_set<nid_t> visited;
+    ChainTraversalContext context(graph);
+    index_chainable_nodes(context);
 
-    graph.for_each_handle([&](const handle_t& h){
-        auto id = graph.get_id(h);
+    // Chains may overlap at their ends, so this persists across the per-chain epochs of the context
+    vector<bool> visited(context.size(), false);
 
-        if (visited.count(id)){
-            return;
+    for (size_t i=0; i<context.size(); i++){
+        if (visited[i]){
+            continue;
         }
 
         chain_t chain;
 
-        get_chain(graph, id, chain);
+        get_chain(graph, context, context.get_id(i), chain);
 
         // Mark all the nodes in the chain as visited
         for (auto& item: chain){
             for (auto& n: item){
-                visited.emplace(n);
+                visited[context.get_index(n)] = true;
             }
         }
 
         if (not chain.empty()) {
             f(chain);
         }
-    });
+    }
 }
 
 
 void Chainer::for_each_chain_subgraph(
-        HandleGraph& graph,
-        const function<void(PackedSubgraphOverlay& chain)>& f
+        const HandleGraph& graph,
+        ChainTraversalContext& context,
+        const function<void(const uint32_t* begin, const uint32_t* end)>& f
         ){
 
-    unordered_set<nid_t> visited;
+    IndexSpans subgraphs;
 
-    graph.for_each_handle([&](const handle_t& h){
-        auto id = graph.get_id(h);
+    // Undirected chain subgraphs partition the chainable nodes, so one epoch serves as the visited set for all of them
+    context.next_epoch();
 
-        if (visited.count(id)){
-            return;
+    for (size_t i=0; i<context.size(); i++){
+        if (context.is_visited(i)){
+            continue;
         }
 
-        PackedSubgraphOverlay subgraph(&graph);
-
-        get_undirected_chain_subgraph(graph, id, subgraph);
-
-        // Mark all the nodes in the subgraph as visited
-        subgraph.for_each_handle([&](const handle_t& h){
-            visited.emplace(subgraph.get_id(h));
-        });
+        get_undirected_chain_subgraph(graph, context, context.get_id(i), subgraphs);
+        subgraphs.close_span();
+    }
 
-        if (subgraph.get_node_count() > 0) {
-            f(subgraph);
-        }
-    });
+    // The callback is free to start new epochs, so the spans are only handed out after all of them are found
+    for (size_t s=0; s<subgraphs.size(); s++){
+        f(subgraphs.begin(s), subgraphs.end(s));
+    }
 }
 
 
@@ -377,90 +495,52 @@ void Chainer::process_haploid_chain_element(
 }
 
 
-void Chainer::find_chainable_nodes(const HandleGraph& graph, const IncrementalIdMap<string>& id_map){
-    graph.for_each_handle([&](const handle_t& h0) {
-        auto id0 = graph.get_id(h0);
+void Chainer::find_chainable_nodes(const HandleGraph& graph, const IncrementalIdMap<string>& id_map, size_t n_threads){
+    auto n_chunks = get_neighborhood_chunk_count(graph);
 
-        // Do a two-edge walk right/left and left/right
-        unordered_set<nid_t> left_second_degree_neighbors;
-        unordered_set<nid_t> right_second_degree_neighbors;
+    // Classify in parallel, collecting results per chunk, then insert into the shared sets afterwards
+    vector <vector <nid_t> > haploid_per_chunk(n_chunks);
+    vector <vector <pair <nid_t, nid_t> > > diploid_per_chunk(n_chunks);
+    vector <vector <nid_t> > tip_per_chunk(n_chunks);
 
-        unordered_set<nid_t> left_first_degree_neighbors;
-        unordered_set<nid_t> right_first_degree_neighbors;
+    for_each_neighborhood_in_parallel(graph, n_threads, [&](const NodeNeighborhood& n, size_t chunk_index){
+        bool is_haploid = (n.left_second_degree.empty() and n.right_second_degree.empty());
 
-        bool has_self_edge = false;
+        bool is_symmetrical_bubble = (n.right_second_degree == n.left_second_degree);
+        bool is_diploid_bubble = (n.right_second_degree.size() == 1) and (n.left_second_degree.size() == 1);
 
-        graph.follow_edges(h0, true, [&](const handle_t& h1){
-            auto id1 = graph.get_id(h1);
-            if (id0 != id1) {
-                left_first_degree_neighbors.emplace(id1);
-            }
-            else{
-                has_self_edge = true;
-            }
+        bool is_chainable = (n.left_first_degree.size() < 3) and (n.right_first_degree.size() < 3);
 
-            graph.follow_edges(h1, false, [&](const handle_t& h2){
-                auto id2 = graph.get_id(h2);
-
-                if (id0 != id2) {
-                    left_second_degree_neighbors.emplace(id2);
-                }
-            });
-        });
-
-        graph.follow_edges(h0, false, [&](const handle_t& h1){
-            auto id1 = graph.get_id(h1);
-            if (id0 != id1) {
-                right_first_degree_neighbors.emplace(id1);
-            }
-            else{
-                has_self_edge = true;
-            }
-
-            graph.follow_edges(h1, true, [&](const handle_t& h2){
-                auto id2 = graph.get_id(h2);
-
-                if (id0 != id2) {
-                    right_second_degree_neighbors.emplace(id2);
-                }
-            });
-        });
-
-        bool is_haploid = (left_second_degree_neighbors.empty() and right_second_degree_neighbors.empty());
-
-        bool is_symmetrical_bubble = (right_second_degree_neighbors == left_second_degree_neighbors);
-        bool is_diploid_bubble = (right_second_degree_neighbors.size() == 1) and (left_second_degree_neighbors.size() == 1);
-
-        bool is_chainable = (left_first_degree_neighbors.size() < 3) and (right_first_degree_neighbors.size() < 3);
-
-        bool is_tip = ((left_first_degree_neighbors.empty() and (right_second_degree_neighbors.size() == 1))
-                   or (right_first_degree_neighbors.empty() and (left_second_degree_neighbors.size() == 1)));
+        bool is_tip = ((n.left_first_degree.empty() and (n.right_second_degree.size() == 1))
+                   or (n.right_first_degree.empty() and (n.left_second_degree.size() == 1)));
 
+        if (is_haploid and not n.has_self_edge){
+            haploid_per_chunk[chunk_index].emplace_back(n.id);
+        }
+        else if (is_symmetrical_bubble and is_diploid_bubble and is_chainable and not n.has_self_edge){
+            diploid_per_chunk[chunk_index].emplace_back(n.id, n.left_second_degree.front());
+        }
+        else if (is_tip and is_chainable and not n.has_self_edge){
+            tip_per_chunk[chunk_index].emplace_back(n.id);
+        }
+    });
 
-        if (is_haploid and not has_self_edge){
-            haploid_nodes.emplace(graph.get_id(h0));
+    for (size_t i=0; i<n_chunks; i++){
+        for (auto id: haploid_per_chunk[i]){
+            haploid_nodes.emplace(id);
         }
-        else if (is_symmetrical_bubble and is_diploid_bubble and is_chainable and not has_self_edge){
-            nid_t id_a = graph.get_id(h0);
-            nid_t id_b = *left_second_degree_neighbors.begin();
 
+        for (auto& [id_a, id_b]: diploid_per_chunk[i]){
             diploid_nodes.emplace(id_a);
             diploid_nodes.emplace(id_b);
             node_pairs.emplace(id_a,id_b);
             node_pairs.emplace(id_b,id_a);
         }
-        else if (is_tip and is_chainable and not has_self_edge){
-            nid_t id_a = graph.get_id(h0);
-            diploid_tip_nodes.emplace(id_a);
-        }
 
-//        cerr << id_map.get_name(graph.get_id(h0)) << '\n';
-//        cerr << "is_symmetrical_bubble: " << is_symmetrical_bubble << '\n';
-//        cerr << "is_diploid_bubble: " << is_diploid_bubble << '\n';
-//        cerr << "is_chainable: " << is_chainable << '\n';
-//        cerr << "is_tip: " << is_tip << '\n';
-//        cerr << "is_haploid: " << is_haploid << '\n' << '\n';
-    });
+        for (auto id: tip_per_chunk[i]){
+            diploid_tip_nodes.emplace(id);
+        }
+    }
 }
 
 
@@ -470,7 +550,7 @@ void Chainer::generate_chain_paths(
         const MultiContactGraph& contact_graph
         ){
 
-    find_chainable_nodes(graph, id_map);
+    find_chainable_nodes(graph, id_map, n_threads);
 
     int64_t c = 0;
     for_each_chain(graph, [&](chain_t& chain){
@@ -528,27 +608,26 @@ void Chainer::generate_chain_paths(
 
 
 void Chainer::harmonize_chain_orientations(MutableHandleGraph& graph){
+    ChainTraversalContext context(graph);
+    index_chainable_nodes(context);
+
+    array <vector <uint32_t>, 2> orientations;
+
     // Strictly for strict bubble chains, reorient nodes so they all face the same direction
-    for_each_chain_subgraph(graph, [&](PackedSubgraphOverlay& subgraph){
+    for_each_chain_subgraph(graph, context, [&](const uint32_t* begin, const uint32_t* end){
         cerr << '\n';
-        array <PackedSubgraphOverlay, 2> orientations = {PackedSubgraphOverlay(&graph), PackedSubgraphOverlay(&graph)};
 
         // Get chain subgraphs split into F and R nodes relative to start node
-        get_oriented_subgraph(subgraph, subgraph.min_node_id(), orientations);
-
-        cerr << orientations[0].get_node_count() << ' ' << orientations[1].get_node_count() << '\n';
+        get_oriented_subgraph(graph, context, begin, end, orientations);
 
-        if ((orientations[0].get_node_count() > 0) and (orientations[1].get_node_count() > 0)){
-            bool smaller_index = orientations[0].get_node_count() > orientations[1].get_node_count();
+        cerr << orientations[0].size() << ' ' << orientations[1].size() << '\n';
 
-            vector<handle_t> to_be_flipped;
-            orientations[smaller_index].for_each_handle([&](const handle_t& h){
-                to_be_flipped.emplace_back(h);
-            });
+        if ((orientations[0].size() > 0) and (orientations[1].size() > 0)){
+            bool smaller_index = orientations[0].size() > orientations[1].size();
 
             // Flip the smaller population of nodes
-            for (auto& h: to_be_flipped) {
-                graph.apply_orientation(graph.flip(h));
+            for (auto i: orientations[smaller_index]) {
+                graph.apply_orientation(graph.get_handle(context.get_id(i), true));
             }
         }
     });
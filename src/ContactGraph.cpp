@@ -391,19 +391,12 @@ void ContactGraph::get_partitions(vector <pair <int32_t,int8_t> >& partitions) c
 }
 
 
-void ContactGraph::randomize_partitions(){
-    // True random number
-    std::random_device rd;
-
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,2);
-
+void ContactGraph::randomize_partitions(SplitMix64& rng){
     for (auto& [id,node]: nodes){
         int8_t p;
         if (node.has_alt()){
             // Only allow {1,-1} for known bubbles
-            p = int8_t((uniform_distribution(rng) % 2));
+            p = int8_t(rng.bounded(2));
 
             if (p == 0){
                 p = -1;
@@ -413,7 +406,7 @@ void ContactGraph::randomize_partitions(){
         }
         else{
             // Allow {1,0,-1}
-            p = int8_t((uniform_distribution(rng) % 3) - 1);
+            p = int8_t(int(rng.bounded(3)) - 1);
 
             set_partition(id,p);
         }
@@ -523,17 +516,13 @@ void random_phase_search(
         atomic<double>& best_score,
         atomic<size_t>& job_index,
         mutex& phase_mutex,
-        size_t m_iterations
+        size_t m_iterations,
+        SplitMix64 rng
 ){
 
     size_t m = job_index.fetch_add(1);
 
-    // True random number
-    std::random_device rd;
-
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,int(contact_graph.size()-1));
+    auto n_ids = contact_graph.size();
 
     contact_graph.set_partitions(best_partitions);
 
@@ -542,12 +531,12 @@ void random_phase_search(
     while (m < m_iterations) {
         // Randomly perturb
         for (size_t i=0; i<((contact_graph.size()/30) + 1); i++) {
-            auto r = ids[uniform_distribution(rng)];
+            auto r = ids[rng.bounded(n_ids)];
 
             int8_t p;
             if (contact_graph.has_alt(r)){
                 // Only allow {1,-1}
-                p = int8_t((uniform_distribution(rng) % 2));
+                p = int8_t(rng.bounded(2));
 
                 if (p == 0){
                     p = -1;
@@ -555,14 +544,14 @@ void random_phase_search(
             }
             else{
                 // Allow {1,0,-1}
-                p = int8_t((uniform_distribution(rng) % 3) - 1);
+                p = int8_t(int(rng.bounded(3)) - 1);
             }
 
             contact_graph.set_partition(r, p);
         }
 
         for (size_t i=0; i<contact_graph.size(); i++) {
-            auto n = ids[uniform_distribution(rng)];
+            auto n = ids[rng.bounded(n_ids)];
 
             int64_t max_score = std::numeric_limits<int64_t>::min();
             int8_t p_max = 0;
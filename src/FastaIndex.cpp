@@ -0,0 +1,506 @@
+#include "FastaIndex.hpp"
+#include "graph_utility.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cctype>
+
+using ghc::filesystem::last_write_time;
+using ghc::filesystem::exists;
+using std::runtime_error;
+using std::exception;
+using std::to_string;
+using std::ifstream;
+using std::ofstream;
+using std::cerr;
+using std::min;
+using std::max;
+
+
+namespace gfase{
+
+
+FastaRecord::FastaRecord():
+        name(),
+        length(0),
+        offset(0),
+        line_bases(0),
+        line_width(0),
+        n_bytes(0)
+{}
+
+
+/// Read-only mapping of a whole file, which is unmapped and closed when it goes out of scope
+class MappedFile{
+public:
+    int fd;
+    size_t size;
+    const char* data;
+
+    explicit MappedFile(path file_path);
+    ~MappedFile();
+};
+
+
+MappedFile::MappedFile(path file_path):
+        fd(-1),
+        size(0),
+        data(nullptr)
+{
+    fd = open(file_path.c_str(), O_RDONLY);
+
+    if (fd < 0){
+        throw runtime_error("ERROR: could not read file: " + file_path.string());
+    }
+
+    struct stat s{};
+    if (fstat(fd, &s) != 0){
+        close(fd);
+        throw runtime_error("ERROR: could not stat file: " + file_path.string());
+    }
+
+    size = size_t(s.st_size);
+
+    // Zero length mappings are not allowed
+    if (size == 0){
+        return;
+    }
+
+    void* result = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (result == MAP_FAILED){
+        close(fd);
+        throw runtime_error("ERROR: could not memory-map file: " + file_path.string());
+    }
+
+    data = static_cast<const char*>(result);
+
+    // The scan is a single forward pass
+    madvise(const_cast<char*>(data), size, MADV_SEQUENTIAL);
+}
+
+
+MappedFile::~MappedFile(){
+    if (data != nullptr){
+        munmap(const_cast<char*>(data), size);
+    }
+    if (fd >= 0){
+        close(fd);
+    }
+}
+
+
+/// Find the extent of one record, given the position of its '>' and the position of the next '>' (or end of file).
+/// Returns false if the lines of the sequence are not all the same width.
+static bool scan_record(const char* data, size_t start, size_t stop, FastaRecord& record){
+    auto header_end = static_cast<const char*>(memchr(data + start, '\n', stop - start));
+    size_t sequence_start = (header_end == nullptr) ? stop : size_t(header_end - data) + 1;
+
+    // Trim any trailing tokens from the fasta header, keep only the name
+    size_t name_end = start + 1;
+    while (name_end < sequence_start and not isspace(data[name_end])){
+        name_end++;
+    }
+
+    record.name.assign(data + start + 1, name_end - start - 1);
+    record.offset = sequence_start;
+
+    if (record.name.empty()){
+        throw runtime_error("ERROR: FASTA record with no name at byte " + to_string(start));
+    }
+
+    bool is_uniform = true;
+    bool prev_was_short = false;
+    size_t sequence_end = sequence_start;
+    size_t i = sequence_start;
+
+    while (i < stop){
+        auto line_end = static_cast<const char*>(memchr(data + i, '\n', stop - i));
+        size_t terminator = (line_end == nullptr) ? stop : size_t(line_end - data);
+        size_t next = (line_end == nullptr) ? stop : terminator + 1;
+
+        size_t n_bases = terminator - i;
+        if (n_bases > 0 and data[terminator - 1] == '\r'){
+            n_bases--;
+        }
+
+        if (n_bases > 0){
+            if (record.line_bases == 0){
+                record.line_bases = n_bases;
+                record.line_width = next - i;
+            }
+            else if (prev_was_short or n_bases > record.line_bases){
+                is_uniform = false;
+            }
+            else if (line_end != nullptr and (next - i) - n_bases != record.line_width - record.line_bases){
+                // Mixed line endings (the final line of a file may have none)
+                is_uniform = false;
+            }
+
+            // Only the last line of a record may be shorter than the others
+            prev_was_short = (n_bases < record.line_bases);
+
+            record.length += n_bases;
+            sequence_end = next;
+        }
+        else if (record.line_bases > 0){
+            // Blank lines are only tolerated at the end of a record
+            prev_was_short = true;
+        }
+
+        i = next;
+    }
+
+    record.n_bytes = sequence_end - sequence_start;
+
+    return is_uniform;
+}
+
+
+void FastaIndex::build(size_t n_threads){
+    MappedFile file(fasta_path);
+
+    if (file.size == 0){
+        return;
+    }
+
+    const char* data = file.data;
+
+    size_t first = 0;
+    while (first < file.size and isspace(data[first])){
+        first++;
+    }
+
+    if (first < file.size and (data[first] != '>' or (first > 0 and data[first - 1] != '\n'))){
+        throw runtime_error("ERROR: FASTA does not begin with a '>' header line: " + fasta_path.string());
+    }
+
+    n_threads = max(size_t(1), n_threads);
+
+    // Stage 1: find every header by splitting the file into one chunk per thread, and searching each chunk for line
+    // starts that are '>'
+    size_t chunk_size = (file.size + n_threads - 1) / n_threads;
+    vector <vector <size_t> > starts_per_chunk(n_threads);
+
+    for_each_job_in_parallel(n_threads, n_threads, [&](size_t c){
+        size_t start = c*chunk_size;
+        size_t stop = min(file.size, start + chunk_size);
+
+        if (start >= stop){
+            return;
+        }
+
+        auto& starts = starts_per_chunk[c];
+
+        if (start == 0 and data[0] == '>'){
+            starts.emplace_back(0);
+        }
+
+        // A newline at position p marks a header if p+1 is '>'
+        size_t i = start;
+        while (i < stop){
+            auto newline = static_cast<const char*>(memchr(data + i, '\n', stop - i));
+
+            if (newline == nullptr){
+                break;
+            }
+
+            size_t p = size_t(newline - data);
+
+            if (p + 1 < file.size and data[p + 1] == '>'){
+                starts.emplace_back(p + 1);
+            }
+
+            i = p + 1;
+        }
+    });
+
+    vector<size_t> starts;
+    for (auto& s: starts_per_chunk){
+        starts.insert(starts.end(), s.begin(), s.end());
+    }
+
+    // Stage 2: measure each record between its header and the next one
+    vector<FastaRecord> scanned(starts.size());
+    vector<char> uniform(starts.size(), true);
+
+    for_each_job_in_parallel(starts.size(), n_threads, [&](size_t r){
+        size_t stop = (r + 1 < starts.size()) ? starts[r + 1] : file.size;
+        uniform[r] = scan_record(data, starts[r], stop, scanned[r]);
+    });
+
+    is_uniform = std::all_of(uniform.begin(), uniform.end(), [](char u){ return u; });
+
+    records.reserve(scanned.size());
+    record_indexes.reserve(scanned.size());
+
+    for (auto& record: scanned){
+        add_record(record);
+    }
+}
+
+
+void FastaIndex::add_record(FastaRecord& record){
+    auto result = record_indexes.emplace(record.name, records.size());
+
+    if (not result.second){
+        throw runtime_error("ERROR: duplicate name in FASTA: " + record.name);
+    }
+
+    records.emplace_back(std::move(record));
+}
+
+
+FastaIndex::FastaIndex(path fasta_path, size_t n_threads, bool save_fai):
+        fasta_path(fasta_path),
+        records(),
+        record_indexes(),
+        is_uniform(true)
+{
+    if (not exists(fasta_path)){
+        throw runtime_error("ERROR: FASTA file does not exist: " + fasta_path.string());
+    }
+
+    auto fai_path = get_fai_path(fasta_path);
+
+    // An index is only trusted if it was written after the FASTA was last modified
+    if (exists(fai_path) and last_write_time(fai_path) >= last_write_time(fasta_path)){
+        load_fai(fai_path);
+        return;
+    }
+
+    build(n_threads);
+
+    if (save_fai and is_uniform){
+        try {
+            write_fai(fai_path);
+        }
+        catch (const exception& e){
+            // The index is only a cache, so a read-only directory is not a problem
+            cerr << "WARNING: " << e.what() << '\n';
+        }
+    }
+}
+
+
+path FastaIndex::get_fai_path(path fasta_path){
+    return fasta_path.string() + ".fai";
+}
+
+
+void FastaIndex::load_fai(path fai_path){
+    ifstream file(fai_path);
+
+    if (not file.is_open() or not file.good()){
+        throw runtime_error("ERROR: could not read file: " + fai_path.string());
+    }
+
+    records.clear();
+    record_indexes.clear();
+
+    FastaRecord record;
+
+    while (file >> record.name >> record.length >> record.offset >> record.line_bases >> record.line_width){
+        // The sequence ends partway through a line if the length isn't a multiple of the line length
+        if (record.length > 0){
+            if (record.line_bases == 0 or record.line_width < record.line_bases){
+                throw runtime_error("ERROR: invalid line length in FASTA index for record: " + record.name);
+            }
+
+            auto n_lines = record.length / record.line_bases;
+            auto remainder = record.length % record.line_bases;
+
+            record.n_bytes = n_lines*record.line_width;
+
+            if (remainder > 0){
+                record.n_bytes += remainder + (record.line_width - record.line_bases);
+            }
+        }
+        else{
+            record.n_bytes = 0;
+        }
+
+        add_record(record);
+        record = {};
+    }
+}
+
+
+void FastaIndex::write_fai(path fai_path) const{
+    if (not is_uniform){
+        throw runtime_error("ERROR: cannot write .fai for FASTA with varying line lengths: " + fasta_path.string());
+    }
+
+    ofstream file(fai_path);
+
+    if (not file.is_open() or not file.good()){
+        throw runtime_error("ERROR: could not write to file: " + fai_path.string());
+    }
+
+    for (auto& r: records){
+        file << r.name << '\t' << r.length << '\t' << r.offset << '\t' << r.line_bases << '\t' << r.line_width << '\n';
+    }
+}
+
+
+size_t FastaIndex::size() const{
+    return records.size();
+}
+
+
+bool FastaIndex::has_record(const string& name) const{
+    return record_indexes.find(name) != record_indexes.end();
+}
+
+
+const FastaRecord& FastaIndex::get_record(const string& name) const{
+    auto result = record_indexes.find(name);
+
+    if (result == record_indexes.end()){
+        throw runtime_error("ERROR: record not found in FASTA index: " + name);
+    }
+
+    return records[result->second];
+}
+
+
+void FastaIndex::for_each_record(const function<void(const FastaRecord& record)>& f) const{
+    for (auto& r: records){
+        f(r);
+    }
+}
+
+
+static void write_all(int fd, const char* data, size_t size, const path& output_path){
+    while (size > 0){
+        auto n = write(fd, data, size);
+
+        if (n < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            throw runtime_error("ERROR: could not write to file: " + output_path.string());
+        }
+
+        data += n;
+        size -= size_t(n);
+    }
+}
+
+
+/// Copy a byte range from one file to another, in the kernel if possible
+static void copy_range(int input_fd, int output_fd, off_t offset, size_t size, const path& output_path){
+#ifdef __linux__
+    while (size > 0){
+        auto n = sendfile(output_fd, input_fd, &offset, size);
+
+        if (n < 0 and errno == EINTR){
+            continue;
+        }
+
+        // Some filesystems don't support sendfile, in which case fall through to a buffered copy
+        if (n <= 0){
+            break;
+        }
+
+        size -= size_t(n);
+    }
+#endif
+
+    vector<char> buffer(min(size, size_t(1) << 20));
+
+    while (size > 0){
+        auto n = pread(input_fd, buffer.data(), min(size, buffer.size()), offset);
+
+        if (n < 0 and errno == EINTR){
+            continue;
+        }
+
+        if (n <= 0){
+            throw runtime_error("ERROR: unexpected end of FASTA while copying to: " + output_path.string());
+        }
+
+        write_all(output_fd, buffer.data(), size_t(n), output_path);
+        offset += n;
+        size -= size_t(n);
+    }
+}
+
+
+void FastaIndex::write_records(path output_path, const function<bool(const FastaRecord& record)>& filter) const{
+    int input_fd = open(fasta_path.c_str(), O_RDONLY);
+
+    if (input_fd < 0){
+        throw runtime_error("ERROR: could not read file: " + fasta_path.string());
+    }
+
+    int output_fd = open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (output_fd < 0){
+        close(input_fd);
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    try {
+        struct stat s{};
+        if (fstat(input_fd, &s) != 0){
+            throw runtime_error("ERROR: could not stat file: " + fasta_path.string());
+        }
+
+        auto file_size = uint64_t(s.st_size);
+
+        string header;
+
+        for (auto& r: records){
+            // Empty sequences are not written
+            if (r.length == 0 or not filter(r)){
+                continue;
+            }
+
+            if (r.offset >= file_size){
+                throw runtime_error("ERROR: FASTA index does not match FASTA for record: " + r.name);
+            }
+
+            // A .fai can't describe a missing newline at the end of the file, so its size may be one byte too long
+            auto n_bytes = min(r.n_bytes, file_size - r.offset);
+
+            header = '>' + r.name + '\n';
+            write_all(output_fd, header.data(), header.size(), output_path);
+
+            copy_range(input_fd, output_fd, off_t(r.offset), n_bytes, output_path);
+
+            // The last record in a file might not have a trailing newline
+            char last = '\n';
+            if (pread(input_fd, &last, 1, off_t(r.offset + n_bytes - 1)) == 1 and last != '\n'){
+                write_all(output_fd, "\n", 1, output_path);
+            }
+        }
+    }
+    catch (...){
+        close(input_fd);
+        close(output_fd);
+        throw;
+    }
+
+    close(input_fd);
+
+    if (close(output_fd) != 0){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+}
+
+
+}
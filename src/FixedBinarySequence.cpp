@@ -1,11 +1,196 @@
 #include "FixedBinarySequence.hpp"
 
+#if defined(__AVX2__) || defined(__SSSE3__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 
 namespace gfase {
 
 
+static array<uint8_t,256> make_base_to_code_table(){
+    array<uint8_t,256> table;
+    table.fill(4);
 
+    table['A'] = 0;
+    table['C'] = 1;
+    table['G'] = 2;
+    table['T'] = 3;
 
+    return table;
+}
 
-}
\ No newline at end of file
+
+static const array<uint8_t,256> base_to_code = make_base_to_code_table();
+
+
+/// Bytes of x which are equal to zero get 0x80, all others get 0 (exact, unlike the usual haszero trick)
+static inline uint64_t zero_byte_mask(uint64_t x){
+    const uint64_t low = 0x7F7F7F7F7F7F7F7F;
+    return ~(((x & low) + low) | x | low);
+}
+
+
+/// Encode 8 bases, one byte each, to 16 bits of codes. Returns the index of the first non-ACGT character or 8.
+///
+/// For uppercase ACGT, bit 0 of the code is bit 1 xor bit 2 of the character and bit 1 of the code is bit 2 xor bit 3:
+///     A = 0x41 -> 00,  C = 0x43 -> 01,  G = 0x47 -> 10,  T = 0x54 -> 11
+static inline size_t encode_8(const char* sequence, uint64_t& codes){
+    uint64_t x;
+    memcpy(&x, sequence, 8);
+
+    const uint64_t ones = 0x0101010101010101;
+
+    auto valid = zero_byte_mask(x ^ ('A'*ones))
+               | zero_byte_mask(x ^ ('C'*ones))
+               | zero_byte_mask(x ^ ('G'*ones))
+               | zero_byte_mask(x ^ ('T'*ones));
+
+    codes = ((x >> 1) ^ (x >> 2)) & (3*ones);
+
+#if defined(__BMI2__)
+    codes = _pext_u64(codes, 3*ones);
+#else
+    codes = (codes | (codes >> 6)) & 0x000F000F000F000F;
+    codes = (codes | (codes >> 12)) & 0x000000FF000000FF;
+    codes = (codes | (codes >> 24)) & 0xFFFF;
+#endif
+
+    auto invalid = valid ^ (0x80*ones);
+
+    return invalid ? __builtin_ctzll(invalid)/8 : 8;
+}
+
+
+/// Encode 32 bases to one word of codes. Returns the index of the first non-ACGT character or 32.
+static inline size_t encode_32(const char* sequence, uint64_t& word){
+#if defined(__AVX2__)
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sequence));
+
+    auto valid = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('A')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('C'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('G')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('T'))));
+
+    auto codes = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi16(x, 1), _mm256_srli_epi16(x, 2)), _mm256_set1_epi8(3));
+
+    // Merge 2 codes per 16 bits, then 4 codes per 32 bits, then gather the low byte of each 32 bits in each lane
+    codes = _mm256_maddubs_epi16(codes, _mm256_set1_epi16(0x0401));
+    codes = _mm256_madd_epi16(codes, _mm256_set1_epi32(0x00100001));
+    codes = _mm256_shuffle_epi8(codes, _mm256_setr_epi8(
+            0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+            0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+
+    word = uint64_t(uint32_t(_mm256_extract_epi32(codes, 0))) | (uint64_t(uint32_t(_mm256_extract_epi32(codes, 4))) << 32);
+
+    auto invalid = ~uint32_t(_mm256_movemask_epi8(valid));
+
+    return invalid ? __builtin_ctz(invalid) : 32;
+
+#elif defined(__SSSE3__)
+    word = 0;
+
+    for (size_t i=0; i<32; i+=16){
+        auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sequence + i));
+
+        auto valid = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('A')), _mm_cmpeq_epi8(x, _mm_set1_epi8('C'))),
+                _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('G')), _mm_cmpeq_epi8(x, _mm_set1_epi8('T'))));
+
+        auto codes = _mm_and_si128(_mm_xor_si128(_mm_srli_epi16(x, 1), _mm_srli_epi16(x, 2)), _mm_set1_epi8(3));
+
+        codes = _mm_maddubs_epi16(codes, _mm_set1_epi16(0x0401));
+        codes = _mm_madd_epi16(codes, _mm_set1_epi32(0x00100001));
+        codes = _mm_shuffle_epi8(codes, _mm_setr_epi8(0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1));
+
+        word |= uint64_t(uint32_t(_mm_cvtsi128_si32(codes))) << 2*i;
+
+        auto invalid = ~uint32_t(_mm_movemask_epi8(valid)) & 0xFFFF;
+
+        if (invalid){
+            return i + __builtin_ctz(invalid);
+        }
+    }
+
+    return 32;
+
+#else
+    word = 0;
+
+    for (size_t i=0; i<32; i+=8){
+        uint64_t codes;
+        auto n = encode_8(sequence + i, codes);
+
+        word |= codes << 2*i;
+
+        if (n < 8){
+            return i + n;
+        }
+    }
+
+    return 32;
+#endif
+}
+
+
+size_t encode_bases(const char* sequence, size_t n, uint64_t* words){
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32){
+        auto m = encode_32(sequence + i, words[i/32]);
+
+        if (m < 32){
+            return i + m;
+        }
+    }
+
+    if (i == n){
+        return n;
+    }
+
+    // Remainder, one base at a time
+    uint64_t word = 0;
+
+    for (size_t j=0; i + j < n; j++){
+        uint64_t code = base_to_code[uint8_t(sequence[i + j])];
+
+        if (code == 4){
+            words[i/32] = word;
+            return i + j;
+        }
+
+        word |= code << 2*j;
+    }
+
+    words[i/32] = word;
+
+    return n;
+}
+
+
+void reverse_complement_bases(const uint64_t* words, size_t length, uint64_t* result){
+    size_t n = (length + 31)/32;
+
+    if (n == 0){
+        return;
+    }
+
+    for (size_t i=0; i<n; i++){
+        result[n - 1 - i] = reverse_complement_word(words[i]);
+    }
+
+    // The padding of the last input word is now at the bottom of the first result word, shift it out
+    size_t padding = 64*n - 2*length;
+
+    if (padding > 0){
+        for (size_t i=0; i<n; i++){
+            result[i] >>= padding;
+
+            if (i + 1 < n){
+                result[i] |= result[i + 1] << (64 - padding);
+            }
+        }
+    }
+}
+
+
+}
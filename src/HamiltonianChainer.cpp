@@ -2,6 +2,7 @@
 
 #include "HamiltonianPath.hpp"
 #include "Bridges.hpp"
+#include "SubgraphOverlay.hpp"
 #include "graph_utility.hpp"
 
 #include "handlegraph/util.hpp"
@@ -67,6 +68,23 @@ struct ChainableComponent {
     array<bool, 2> hamiltonian_exists{false, false};
 };
 
+/*
+ * The chainable components found in one bridge component, which are committed to the global
+ * list of chain links after all bridge components have been analyzed
+ */
+struct ChainableComponentPlan {
+    ChainableComponentPlan() = default;
+    ~ChainableComponentPlan() = default;
+    
+    vector<ChainableComponent> links;
+    
+    // boundaries that should be used to look up a link, by the link's index in this plan
+    vector<pair<handle_t, size_t>> boundary_to_link;
+    
+    // the unipath boundaries of simple bubbles, which will be treated like bridges
+    vector<vector<handle_t>> bubble_unipath_boundaries;
+};
+
 bool HamiltonianChainer::has_phase_chain(const string& name) const {
     return (phase_path_names[0].count(name) || phase_path_names[1].count(name));
 }
@@ -99,16 +117,30 @@ void HamiltonianChainer::generate_chain_paths(MutablePathDeletableHandleGraph& g
      * Part 1: find bridges
      */
     
-    // find bridges that are not assigned to one or the other haplotype
+    // find bridges that are not assigned to one or the other haplotype. the connected components are
+    // independent, so they are searched in parallel and the results are concatenated in component order
     vector<handle_t> nonhaploid_bridges;
-    for_each_connected_component_subgraph(graph, [&](const HandleGraph& component) {
-        for (handle_t bridge : bridge_nodes(component)) {
-            if (!contact_graph.has_node(graph.get_id(bridge)) ||
-                !contact_graph.has_alt(graph.get_id(bridge))) {
-                nonhaploid_bridges.push_back(bridge);
+    {
+        vector<unordered_set<nid_t>> connected_components;
+        for_each_connected_component(graph, [&](unordered_set<nid_t>& connected_component) {
+            connected_components.emplace_back(move(connected_component));
+        });
+        
+        vector<vector<handle_t>> component_bridges(connected_components.size());
+        for_each_job_in_parallel(connected_components.size(), n_threads, [&](size_t i) {
+            SubgraphOverlay component(&graph, &connected_components[i]);
+            for (handle_t bridge : bridge_nodes(component)) {
+                if (!contact_graph.has_node(graph.get_id(bridge)) ||
+                    !contact_graph.has_alt(graph.get_id(bridge))) {
+                    component_bridges[i].push_back(bridge);
+                }
             }
+        });
+        
+        for (const auto& bridges : component_bridges) {
+            nonhaploid_bridges.insert(nonhaploid_bridges.end(), bridges.begin(), bridges.end());
         }
-    });
+    }
     
     // merge into unipath bridges
     auto unipath_bridges = consolidate_bridges(graph, nonhaploid_bridges);
@@ -146,342 +178,34 @@ void HamiltonianChainer::generate_chain_paths(MutablePathDeletableHandleGraph& g
     
     vector<vector<handle_t>> bubble_unipath_boundaries;
     
-    for_each_bridge_component(graph, unipath_bridges,
-                              [&](const HandleGraph& bridge_component,
-                                  const vector<pair<size_t, bool>>& incident_bridges) {
+    // the analysis of each bridge component only reads the graph, so the components are analyzed in
+    // parallel, and then their plans are committed in the order that the components were found so that
+    // the result doesn't depend on the number of threads
+    {
+        vector<unordered_set<nid_t>> bridge_components;
+        vector<vector<pair<size_t, bool>>> component_incident_bridges;
+        get_bridge_components(graph, unipath_bridges, bridge_components, component_incident_bridges);
         
-        if (debug) {
-            cerr << "phasing in component bordering bridges:" << endl;
-            for (const auto& bridge_idx : incident_bridges) {
-                cerr << "\trev? " << bridge_idx.second << ": ";
-                const auto& bridge = unipath_bridges[bridge_idx.first];
-                for (size_t i = 0; i < bridge.size(); ++i) {
-                    if (i != 0) {
-                        cerr << ", ";
-                    }
-                    cerr << graph.get_id(bridge[i]) << (graph.get_is_reverse(bridge[i]) ? "-" : "+") << " (" << id_map.get_name(graph.get_id(bridge[i])) << ")";
-                }
-                cerr << endl;
-            }
-            int max_num_print = 10;
-            int num_printed = 0;
-            cerr << "component contains nodes:" << endl;
-            bool completed = bridge_component.for_each_handle([&](const handle_t& h) {
-                if (num_printed >= max_num_print) {
-                    return false;
-                }
-                cerr << "\t" << graph.get_id(h) << " / " << id_map.get_name(graph.get_id(h)) << endl;
-                ++num_printed;
-                return true;
-            });
-            if (!completed) {
-                cerr << "\t... (" << (bridge_component.get_node_count() - num_printed) << " more)" << endl;
-            }
-        }
+        vector<ChainableComponentPlan> plans(bridge_components.size());
+        for_each_job_in_parallel(bridge_components.size(), n_threads, [&](size_t i) {
+            SubgraphOverlay bridge_component(&graph, &bridge_components[i]);
+            analyze_bridge_component(graph, bridge_component, component_incident_bridges[i], unipath_bridges,
+                                     id_map, contact_graph, plans[i]);
+        });
         
-        bool found_allele_success = false;
-        if (incident_bridges.size() <= 2) {
-            if (debug) {
-                cerr << "bridge degree is " << incident_bridges.size() << ", attempting to find hamiltonian alleles" << endl;
-            }
-            
-            // this bridge component is a potentially phaseable unit in itself
-            
-            // check that the bridge component looks like it's capturing two allelic sequences
-            unordered_set<nid_t> phase_0_nodes, phase_1_nodes;
-            bool all_phasable = bridge_component.for_each_handle([&](const handle_t& handle) {
-                
-                nid_t node_id = bridge_component.get_id(handle);
-                if (phase_0_nodes.count(node_id) || phase_1_nodes.count(node_id)) {
-                    // we already processed this node from another node's alt component
-                    return true;
-                }
-                if (contact_graph.has_node(node_id) && contact_graph.has_alt(node_id)) {
-                    alt_component_t alt_component;
-                    contact_graph.get_alt_component(node_id, false, alt_component);
-                    for (auto alt_set : {&alt_component.first, &alt_component.second}) {
-                        for (auto member_id : *alt_set) {
-                            if (!bridge_component.has_node(member_id)) {
-                                if (debug) {
-                                    cerr << "node " << member_id << " of alt component is not present in bridge component" << endl;
-                                }
-                                // a member of this alt set is not found in the bridge component.
-                                // this makes it less likely that the bridge component represents
-                                // a pair of allelic sequences, but we'll still allow it as long as
-                                // the missing sequences are isolated nodes
-                                // TODO: this condition is motivated by patterns we've seen in
-                                // verkko graphs, but it could stand to be a bit more principled
-                                handle_t missing_node = graph.get_handle(member_id);
-                                bool no_edges = graph.follow_edges(missing_node, false, [&](const handle_t& null) {
-                                    if (debug) {
-                                        cerr << "alt has an edge to " << graph.get_id(null) << endl;
-                                    }
-                                    return false;
-                                });
-                                no_edges = no_edges && graph.follow_edges(missing_node, true, [&](const handle_t& null) {
-                                    if (debug) {
-                                        cerr << "alt has an edge to " << graph.get_id(null) << endl;
-                                    }
-                                    return false;
-                                });
-                                if (!no_edges) {
-                                    // this bridge component is not phasable
-                                    return false;
-                                }
-                            }
-                        }
-                    }
-                    // record the phase of the two alt sets (which also marks them as having been processed)
-                    bool order_swapped = (contact_graph.get_partition(*alt_component.first.begin()) > 0);
-                    for (auto alt_allele_id : (order_swapped ? alt_component.second : alt_component.first)) {
-                        if (bridge_component.has_node(alt_allele_id)) {
-                            phase_0_nodes.insert(alt_allele_id);
-                        }
-                    }
-                    for (auto alt_allele_id : (order_swapped ? alt_component.first : alt_component.second)) {
-                        if (bridge_component.has_node(alt_allele_id)) {
-                            phase_1_nodes.insert(alt_allele_id);
-                        }
-                    }
-                }
-                return true;
-            });
-            
-            if (!all_phasable) {
-                // the nodes had alts that are outside this bridge component
-                if (debug) {
-                    cerr << "skipping since all alts are not present" << endl;
-                }
-                return;
-            }
-            if (phase_1_nodes.empty() && phase_0_nodes.empty()) {
-                // there are no phased nodes in this component
-                if (debug) {
-                    cerr << "skipping component is entirely unphased" << endl;
-                }
-                return;
-            }
-            
-            unordered_set<handle_t> start, end;
-            if (incident_bridges.size() >= 1) {
-                // we'll start at the inward side of the bridge, facing into to the component
-                const auto& start_bridge = unipath_bridges[incident_bridges[0].first];
-                if (incident_bridges[0].second) {
-                    start.insert(graph.flip(start_bridge.front()));
-                }
-                else {
-                    start.insert(start_bridge.back());
-                }
-            }
-            if (incident_bridges.size() == 2) {
-                // we'll end at the inward side of the bridge, but facing outward
-                const auto& end_bridge = unipath_bridges[incident_bridges[1].first];
-                if (incident_bridges[1].second) {
-                    end.insert(end_bridge.front());
-                }
-                else {
-                    end.insert(graph.flip(end_bridge.back()));
-                }
+        for (auto& plan : plans) {
+            size_t offset = chain_links.size();
+            for (const auto& boundary : plan.boundary_to_link) {
+                boundary_to_chain_link[boundary.first] = offset + boundary.second;
             }
-            
-            bool resolved_hamiltonian_0;
-            auto phase_0_walks = generate_allelic_semiwalks(bridge_component,
-                                                            id_map,
-                                                            phase_0_nodes,
-                                                            phase_1_nodes,
-                                                            start, end,
-                                                            resolved_hamiltonian_0);
-            
-            bool resolved_hamiltonian_1;
-            auto phase_1_walks = generate_allelic_semiwalks(bridge_component,
-                                                            id_map,
-                                                            phase_1_nodes,
-                                                            phase_0_nodes,
-                                                            start, end,
-                                                            resolved_hamiltonian_1);
-            
-            // we'll consider this bridge component fully solved (even without unique alleles)
-            // if we found a hamiltonian path for either of the phases
-            found_allele_success = (resolved_hamiltonian_0 || resolved_hamiltonian_1);
-            
-            if (found_allele_success) {
-                // TODO: is this the right logic? should i ever add the partial alleles even if
-                // the hamiltonian isn't successful? it's hard to know when to fall back on the
-                // smaller simple bubbles contained in the component...
-                
-                // record the result of the allele identification
-                chain_links.emplace_back();
-                auto& link = chain_links.back();
-                if (!start.empty()) {
-                    link.has_left_side = true;
-                    link.left_side = *start.begin();
-                    boundary_to_chain_link[link.left_side] = chain_links.size() - 1;
-                }
-                if (!end.empty()) {
-                    link.has_right_side = true;
-                    link.right_side = bridge_component.flip(*end.begin());
-                    boundary_to_chain_link[link.right_side] = chain_links.size() - 1;
-                }
-                link.allele_from_left[0] = move(phase_0_walks.first);
-                link.allele_from_right[0] = move(phase_0_walks.second);
-                link.allele_from_left[1] = move(phase_1_walks.first);
-                link.allele_from_right[1] = move(phase_1_walks.second);
-                link.hamiltonian_exists[0] = resolved_hamiltonian_0;
-                link.hamiltonian_exists[1] = resolved_hamiltonian_1;
-                
-                if (debug) {
-                    cerr << "succeeded in finding hamiltonian allele(s), added a chainable component" << endl;
-                    for (auto left : {true, false}) {
-                        cerr << "from " << (left ? "left" : "right") << ":" << endl;
-                        auto alleles = left ? link.allele_from_left : link.allele_from_right;
-                        for (auto allele : alleles) {
-                            for (auto handle : allele) {
-                                cerr << " " << bridge_component.get_id(handle) << "(" << id_map.get_name(bridge_component.get_id(handle)) << ")" << (bridge_component.get_is_reverse(handle) ? "-" : "+");
-                            }
-                            cerr << endl;
-                        }
-                    }
-                }
+            for (auto& link : plan.links) {
+                chain_links.emplace_back(move(link));
             }
-        }
-        
-        if (incident_bridges.size() > 2 || !found_allele_success) {
-            // this bridge component has bridge degree > 2 or else the hamiltonian algorithm failed on both
-            // alleles. we could maybe find phaseable bubbles inside it using a rigid topological motif criterion
-            
-            if (debug) {
-                cerr << "no hamiltonian alleles are possible, attempting to find chainable simple bubbles" << endl;
+            for (auto& boundary : plan.bubble_unipath_boundaries) {
+                bubble_unipath_boundaries.emplace_back(move(boundary));
             }
-            
-            unordered_set<handle_t> processed_sides;
-            bridge_component.for_each_handle([&](const handle_t& handle) {
-                nid_t node_id = bridge_component.get_id(handle);
-                if (contact_graph.has_node(node_id) && contact_graph.has_alt(node_id)) {
-                    // we don't want to find haploid allelic sequences, we want boundaries of bubbles
-                    return;
-                }
-                for (auto side : {handle, bridge_component.flip(handle)}) {
-                    if (processed_sides.count(side)) {
-                        continue;
-                    }
-                    // check if this is the boundary of a bubble
-                    processed_sides.insert(side);
-                    
-                    vector<handle_t> neighbors;
-                    bridge_component.follow_edges(side, false, [&](const handle_t& nbr) {
-                        neighbors.push_back(nbr);
-                    });
-                    if (neighbors.size() != 2) {
-                        // these can't be the two sides of a bubble
-                        continue;
-                    }
-                    array<int, 2> neighbor_rev_count{0, 0};
-                    for (int hap : {0, 1}) {
-                        bridge_component.follow_edges(neighbors[hap], true, [&](const handle_t& prev) {
-                            ++neighbor_rev_count[hap];
-                            return neighbor_rev_count[hap] < 2;
-                        });
-                    }
-                    if (neighbor_rev_count[0] != 1 || neighbor_rev_count[1] != 1) {
-                        // you can reach the two nodes from other nodes than the boundary
-                        continue;
-                    }
-                    array<handle_t, 2> next_neighbor{as_handle(-1), as_handle(-1)};
-                    bool deg_less_than_2 = true;
-                    for (int hap : {0, 1}) {
-                        deg_less_than_2 = deg_less_than_2 && bridge_component.follow_edges(neighbors[hap], false,
-                                                                                           [&](const handle_t& next) {
-                            if (next_neighbor[hap] != as_handle(-1)) {
-                                return false;
-                            }
-                            else {
-                                next_neighbor[hap] = next;
-                                return true;
-                            }
-                        });
-                    }
-                    if (next_neighbor[0] == as_handle(-1) || next_neighbor[0] != next_neighbor[1] || !deg_less_than_2) {
-                        // they don't meet together at the following node
-                        continue;
-                    }
-                    size_t next_neighbor_rev_count = 0;
-                    bridge_component.follow_edges(next_neighbor[0], true, [&](const handle_t& prev) {
-                        ++next_neighbor_rev_count;
-                        return next_neighbor_rev_count < 3;
-                    });
-                    if (next_neighbor_rev_count > 2) {
-                        // other nodes also meet together at the following node
-                        continue;
-                    }
-                    
-                    if (!contact_graph.has_node(bridge_component.get_id(neighbors[0])) ||
-                        !contact_graph.has_node(bridge_component.get_id(neighbors[1]))) {
-                        // these can't have an assigned phase
-                        continue;
-                    }
-                    alt_component_t alt_component;
-                    contact_graph.get_alt_component(bridge_component.get_id(neighbors[0]), false, alt_component);
-                    if (alt_component.first.size() != 1 || alt_component.second.size() != 1) {
-                        // these have other homology partners outside of this motif
-                        continue;
-                    }
-                    if ((*alt_component.first.begin() != bridge_component.get_id(neighbors[0]) ||
-                         *alt_component.second.begin() != bridge_component.get_id(neighbors[1])) &&
-                        (*alt_component.second.begin() != bridge_component.get_id(neighbors[0]) ||
-                         *alt_component.first.begin() != bridge_component.get_id(neighbors[1]))) {
-                        // they aren't homology partners with each other
-                        continue;
-                    }
-                    if (contact_graph.has_node(bridge_component.get_id(next_neighbor[0])) &&
-                        contact_graph.has_alt(bridge_component.get_id(next_neighbor[0]))) {
-                        // the other boundary is phased (i.e. isn't diploid)
-                        continue;
-                    }
-                    
-                    // we've fully checked the local topology, this looks like a phased bubble
-                    
-                    chain_links.emplace_back();
-                    auto& link = chain_links.back();
-                    link.has_left_side = true;
-                    link.left_side = side;
-                    link.has_right_side = true;
-                    link.right_side = bridge_component.flip(next_neighbor[0]);
-                    
-                    // form the alleles
-                    vector<handle_t> allele_0{side, neighbors[0], next_neighbor[0]};
-                    vector<handle_t> allele_1{side, neighbors[1], next_neighbor[0]};
-                    bool order_swapped = (contact_graph.get_partition(bridge_component.get_id(neighbors[0])) > 0);
-                    link.allele_from_left[0] = (order_swapped ? move(allele_1) : move(allele_0));
-                    link.allele_from_left[1] = (order_swapped ? move(allele_0) : move(allele_1));
-                    link.hamiltonian_exists[0] = true;
-                    link.hamiltonian_exists[1] = true;
-                    
-                    // walk out the full unipath boundary (i.e. not just the inward-facing node)
-                    bubble_unipath_boundaries.push_back(walk_diploid_unipath(bridge_component, contact_graph,
-                                                                             link.left_side, true));
-                    bubble_unipath_boundaries.push_back(walk_diploid_unipath(bridge_component, contact_graph,
-                                                                             link.right_side, false));
-                    
-                    if (debug) {
-                        cerr << "found a chainable simple bubble consisting of alleles:" << endl;
-                        for (auto allele : link.allele_from_left) {
-                            for (auto handle : allele) {
-                                cerr << " " << bridge_component.get_id(handle) << (bridge_component.get_is_reverse(handle) ? "-" : "+");
-                            }
-                            cerr << endl;
-                        }
-                    }
-                    
-                    processed_sides.insert(side);
-                    for (int i = 0; i < 2; ++i) {
-                        processed_sides.insert(neighbors[i]);
-                        processed_sides.insert(bridge_component.flip(neighbors[i]));
-                    }
-                    processed_sides.insert(bridge_component.flip(next_neighbor[0]));
-                }
-            });
         }
-    });
+    }
     
     // move the unipath boundaries from the bubbles to the same list as the bridges (even though
     // they're technically not bridges)
@@ -892,6 +616,347 @@ void HamiltonianChainer::generate_chain_paths(MutablePathDeletableHandleGraph& g
     }
 }
 
+void HamiltonianChainer::analyze_bridge_component(const HandleGraph& graph,
+                                                  const HandleGraph& bridge_component,
+                                                  const vector<pair<size_t, bool>>& incident_bridges,
+                                                  const vector<vector<handle_t>>& unipath_bridges,
+                                                  const IncrementalIdMap<string>& id_map,
+                                                  const MultiContactGraph& contact_graph,
+                                                  ChainableComponentPlan& plan) const {
+    
+    if (debug) {
+        cerr << "phasing in component bordering bridges:" << endl;
+        for (const auto& bridge_idx : incident_bridges) {
+            cerr << "\trev? " << bridge_idx.second << ": ";
+            const auto& bridge = unipath_bridges[bridge_idx.first];
+            for (size_t i = 0; i < bridge.size(); ++i) {
+                if (i != 0) {
+                    cerr << ", ";
+                }
+                cerr << graph.get_id(bridge[i]) << (graph.get_is_reverse(bridge[i]) ? "-" : "+") << " (" << id_map.get_name(graph.get_id(bridge[i])) << ")";
+            }
+            cerr << endl;
+        }
+        int max_num_print = 10;
+        int num_printed = 0;
+        cerr << "component contains nodes:" << endl;
+        bool completed = bridge_component.for_each_handle([&](const handle_t& h) {
+            if (num_printed >= max_num_print) {
+                return false;
+            }
+            cerr << "\t" << graph.get_id(h) << " / " << id_map.get_name(graph.get_id(h)) << endl;
+            ++num_printed;
+            return true;
+        });
+        if (!completed) {
+            cerr << "\t... (" << (bridge_component.get_node_count() - num_printed) << " more)" << endl;
+        }
+    }
+    
+    bool found_allele_success = false;
+    if (incident_bridges.size() <= 2) {
+        if (debug) {
+            cerr << "bridge degree is " << incident_bridges.size() << ", attempting to find hamiltonian alleles" << endl;
+        }
+        
+        // this bridge component is a potentially phaseable unit in itself
+        
+        // check that the bridge component looks like it's capturing two allelic sequences
+        unordered_set<nid_t> phase_0_nodes, phase_1_nodes;
+        bool all_phasable = bridge_component.for_each_handle([&](const handle_t& handle) {
+            
+            nid_t node_id = bridge_component.get_id(handle);
+            if (phase_0_nodes.count(node_id) || phase_1_nodes.count(node_id)) {
+                // we already processed this node from another node's alt component
+                return true;
+            }
+            if (contact_graph.has_node(node_id) && contact_graph.has_alt(node_id)) {
+                alt_component_t alt_component;
+                contact_graph.get_alt_component(node_id, false, alt_component);
+                for (auto alt_set : {&alt_component.first, &alt_component.second}) {
+                    for (auto member_id : *alt_set) {
+                        if (!bridge_component.has_node(member_id)) {
+                            if (debug) {
+                                cerr << "node " << member_id << " of alt component is not present in bridge component" << endl;
+                            }
+                            // a member of this alt set is not found in the bridge component.
+                            // this makes it less likely that the bridge component represents
+                            // a pair of allelic sequences, but we'll still allow it as long as
+                            // the missing sequences are isolated nodes
+                            // TODO: this condition is motivated by patterns we've seen in
+                            // verkko graphs, but it could stand to be a bit more principled
+                            handle_t missing_node = graph.get_handle(member_id);
+                            bool no_edges = graph.follow_edges(missing_node, false, [&](const handle_t& null) {
+                                if (debug) {
+                                    cerr << "alt has an edge to " << graph.get_id(null) << endl;
+                                }
+                                return false;
+                            });
+                            no_edges = no_edges && graph.follow_edges(missing_node, true, [&](const handle_t& null) {
+                                if (debug) {
+                                    cerr << "alt has an edge to " << graph.get_id(null) << endl;
+                                }
+                                return false;
+                            });
+                            if (!no_edges) {
+                                // this bridge component is not phasable
+                                return false;
+                            }
+                        }
+                    }
+                }
+                // record the phase of the two alt sets (which also marks them as having been processed)
+                bool order_swapped = (contact_graph.get_partition(*alt_component.first.begin()) > 0);
+                for (auto alt_allele_id : (order_swapped ? alt_component.second : alt_component.first)) {
+                    if (bridge_component.has_node(alt_allele_id)) {
+                        phase_0_nodes.insert(alt_allele_id);
+                    }
+                }
+                for (auto alt_allele_id : (order_swapped ? alt_component.first : alt_component.second)) {
+                    if (bridge_component.has_node(alt_allele_id)) {
+                        phase_1_nodes.insert(alt_allele_id);
+                    }
+                }
+            }
+            return true;
+        });
+        
+        if (!all_phasable) {
+            // the nodes had alts that are outside this bridge component
+            if (debug) {
+                cerr << "skipping since all alts are not present" << endl;
+            }
+            return;
+        }
+        if (phase_1_nodes.empty() && phase_0_nodes.empty()) {
+            // there are no phased nodes in this component
+            if (debug) {
+                cerr << "skipping component is entirely unphased" << endl;
+            }
+            return;
+        }
+        
+        unordered_set<handle_t> start, end;
+        if (incident_bridges.size() >= 1) {
+            // we'll start at the inward side of the bridge, facing into to the component
+            const auto& start_bridge = unipath_bridges[incident_bridges[0].first];
+            if (incident_bridges[0].second) {
+                start.insert(graph.flip(start_bridge.front()));
+            }
+            else {
+                start.insert(start_bridge.back());
+            }
+        }
+        if (incident_bridges.size() == 2) {
+            // we'll end at the inward side of the bridge, but facing outward
+            const auto& end_bridge = unipath_bridges[incident_bridges[1].first];
+            if (incident_bridges[1].second) {
+                end.insert(end_bridge.front());
+            }
+            else {
+                end.insert(graph.flip(end_bridge.back()));
+            }
+        }
+        
+        bool resolved_hamiltonian_0;
+        auto phase_0_walks = generate_allelic_semiwalks(bridge_component,
+                                                        id_map,
+                                                        phase_0_nodes,
+                                                        phase_1_nodes,
+                                                        start, end,
+                                                        resolved_hamiltonian_0);
+        
+        bool resolved_hamiltonian_1;
+        auto phase_1_walks = generate_allelic_semiwalks(bridge_component,
+                                                        id_map,
+                                                        phase_1_nodes,
+                                                        phase_0_nodes,
+                                                        start, end,
+                                                        resolved_hamiltonian_1);
+        
+        // we'll consider this bridge component fully solved (even without unique alleles)
+        // if we found a hamiltonian path for either of the phases
+        found_allele_success = (resolved_hamiltonian_0 || resolved_hamiltonian_1);
+        
+        if (found_allele_success) {
+            // TODO: is this the right logic? should i ever add the partial alleles even if
+            // the hamiltonian isn't successful? it's hard to know when to fall back on the
+            // smaller simple bubbles contained in the component...
+            
+            // record the result of the allele identification
+            plan.links.emplace_back();
+            auto& link = plan.links.back();
+            if (!start.empty()) {
+                link.has_left_side = true;
+                link.left_side = *start.begin();
+                plan.boundary_to_link.emplace_back(link.left_side, plan.links.size() - 1);
+            }
+            if (!end.empty()) {
+                link.has_right_side = true;
+                link.right_side = bridge_component.flip(*end.begin());
+                plan.boundary_to_link.emplace_back(link.right_side, plan.links.size() - 1);
+            }
+            link.allele_from_left[0] = move(phase_0_walks.first);
+            link.allele_from_right[0] = move(phase_0_walks.second);
+            link.allele_from_left[1] = move(phase_1_walks.first);
+            link.allele_from_right[1] = move(phase_1_walks.second);
+            link.hamiltonian_exists[0] = resolved_hamiltonian_0;
+            link.hamiltonian_exists[1] = resolved_hamiltonian_1;
+            
+            if (debug) {
+                cerr << "succeeded in finding hamiltonian allele(s), added a chainable component" << endl;
+                for (auto left : {true, false}) {
+                    cerr << "from " << (left ? "left" : "right") << ":" << endl;
+                    auto alleles = left ? link.allele_from_left : link.allele_from_right;
+                    for (auto allele : alleles) {
+                        for (auto handle : allele) {
+                            cerr << " " << bridge_component.get_id(handle) << "(" << id_map.get_name(bridge_component.get_id(handle)) << ")" << (bridge_component.get_is_reverse(handle) ? "-" : "+");
+                        }
+                        cerr << endl;
+                    }
+                }
+            }
+        }
+    }
+    
+    if (incident_bridges.size() > 2 || !found_allele_success) {
+        // this bridge component has bridge degree > 2 or else the hamiltonian algorithm failed on both
+        // alleles. we could maybe find phaseable bubbles inside it using a rigid topological motif criterion
+        
+        if (debug) {
+            cerr << "no hamiltonian alleles are possible, attempting to find chainable simple bubbles" << endl;
+        }
+        
+        unordered_set<handle_t> processed_sides;
+        bridge_component.for_each_handle([&](const handle_t& handle) {
+            nid_t node_id = bridge_component.get_id(handle);
+            if (contact_graph.has_node(node_id) && contact_graph.has_alt(node_id)) {
+                // we don't want to find haploid allelic sequences, we want boundaries of bubbles
+                return;
+            }
+            for (auto side : {handle, bridge_component.flip(handle)}) {
+                if (processed_sides.count(side)) {
+                    continue;
+                }
+                // check if this is the boundary of a bubble
+                processed_sides.insert(side);
+                
+                vector<handle_t> neighbors;
+                bridge_component.follow_edges(side, false, [&](const handle_t& nbr) {
+                    neighbors.push_back(nbr);
+                });
+                if (neighbors.size() != 2) {
+                    // these can't be the two sides of a bubble
+                    continue;
+                }
+                array<int, 2> neighbor_rev_count{0, 0};
+                for (int hap : {0, 1}) {
+                    bridge_component.follow_edges(neighbors[hap], true, [&](const handle_t& prev) {
+                        ++neighbor_rev_count[hap];
+                        return neighbor_rev_count[hap] < 2;
+                    });
+                }
+                if (neighbor_rev_count[0] != 1 || neighbor_rev_count[1] != 1) {
+                    // you can reach the two nodes from other nodes than the boundary
+                    continue;
+                }
+                array<handle_t, 2> next_neighbor{as_handle(-1), as_handle(-1)};
+                bool deg_less_than_2 = true;
+                for (int hap : {0, 1}) {
+                    deg_less_than_2 = deg_less_than_2 && bridge_component.follow_edges(neighbors[hap], false,
+                                                                                       [&](const handle_t& next) {
+                        if (next_neighbor[hap] != as_handle(-1)) {
+                            return false;
+                        }
+                        else {
+                            next_neighbor[hap] = next;
+                            return true;
+                        }
+                    });
+                }
+                if (next_neighbor[0] == as_handle(-1) || next_neighbor[0] != next_neighbor[1] || !deg_less_than_2) {
+                    // they don't meet together at the following node
+                    continue;
+                }
+                size_t next_neighbor_rev_count = 0;
+                bridge_component.follow_edges(next_neighbor[0], true, [&](const handle_t& prev) {
+                    ++next_neighbor_rev_count;
+                    return next_neighbor_rev_count < 3;
+                });
+                if (next_neighbor_rev_count > 2) {
+                    // other nodes also meet together at the following node
+                    continue;
+                }
+                
+                if (!contact_graph.has_node(bridge_component.get_id(neighbors[0])) ||
+                    !contact_graph.has_node(bridge_component.get_id(neighbors[1]))) {
+                    // these can't have an assigned phase
+                    continue;
+                }
+                alt_component_t alt_component;
+                contact_graph.get_alt_component(bridge_component.get_id(neighbors[0]), false, alt_component);
+                if (alt_component.first.size() != 1 || alt_component.second.size() != 1) {
+                    // these have other homology partners outside of this motif
+                    continue;
+                }
+                if ((*alt_component.first.begin() != bridge_component.get_id(neighbors[0]) ||
+                     *alt_component.second.begin() != bridge_component.get_id(neighbors[1])) &&
+                    (*alt_component.second.begin() != bridge_component.get_id(neighbors[0]) ||
+                     *alt_component.first.begin() != bridge_component.get_id(neighbors[1]))) {
+                    // they aren't homology partners with each other
+                    continue;
+                }
+                if (contact_graph.has_node(bridge_component.get_id(next_neighbor[0])) &&
+                    contact_graph.has_alt(bridge_component.get_id(next_neighbor[0]))) {
+                    // the other boundary is phased (i.e. isn't diploid)
+                    continue;
+                }
+                
+                // we've fully checked the local topology, this looks like a phased bubble
+                
+                plan.links.emplace_back();
+                auto& link = plan.links.back();
+                link.has_left_side = true;
+                link.left_side = side;
+                link.has_right_side = true;
+                link.right_side = bridge_component.flip(next_neighbor[0]);
+                
+                // form the alleles
+                vector<handle_t> allele_0{side, neighbors[0], next_neighbor[0]};
+                vector<handle_t> allele_1{side, neighbors[1], next_neighbor[0]};
+                bool order_swapped = (contact_graph.get_partition(bridge_component.get_id(neighbors[0])) > 0);
+                link.allele_from_left[0] = (order_swapped ? move(allele_1) : move(allele_0));
+                link.allele_from_left[1] = (order_swapped ? move(allele_0) : move(allele_1));
+                link.hamiltonian_exists[0] = true;
+                link.hamiltonian_exists[1] = true;
+                
+                // walk out the full unipath boundary (i.e. not just the inward-facing node)
+                plan.bubble_unipath_boundaries.push_back(walk_diploid_unipath(bridge_component, contact_graph,
+                                                                              link.left_side, true));
+                plan.bubble_unipath_boundaries.push_back(walk_diploid_unipath(bridge_component, contact_graph,
+                                                                              link.right_side, false));
+                
+                if (debug) {
+                    cerr << "found a chainable simple bubble consisting of alleles:" << endl;
+                    for (auto allele : link.allele_from_left) {
+                        for (auto handle : allele) {
+                            cerr << " " << bridge_component.get_id(handle) << (bridge_component.get_is_reverse(handle) ? "-" : "+");
+                        }
+                        cerr << endl;
+                    }
+                }
+                
+                processed_sides.insert(side);
+                for (int i = 0; i < 2; ++i) {
+                    processed_sides.insert(neighbors[i]);
+                    processed_sides.insert(bridge_component.flip(neighbors[i]));
+                }
+                processed_sides.insert(bridge_component.flip(next_neighbor[0]));
+            }
+        });
+    }
+}
+
 string HamiltonianChainer::phase_path_name(int haplotype, int path_id) {
     return "gfase_hap_" +  to_string(haplotype) + "_" + to_string(path_id);
 }
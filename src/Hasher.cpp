@@ -60,7 +60,7 @@ const vector<uint64_t> Hasher::seeds = {
         10629356763957722439};
 
 
-uint64_t Hasher::hash(const BinarySequence<uint64_t>& kmer, size_t seed_index){
+uint64_t Hasher::hash(const SmallBinarySequence<1>& kmer, size_t seed_index){
     return MurmurHash64A(kmer.sequence.data(), int(kmer.get_byte_length()), seeds[seed_index]);
 }
 
@@ -69,14 +69,15 @@ uint64_t Hasher::hash(const BinarySequence<uint64_t>& kmer, size_t seed_index){
 /// \param sequence
 /// \param i iteration of hashing to compute, corresponding to a hash function
 void Hasher::hash_sequence(const Sequence& sequence, size_t i) {
-    BinarySequence<uint64_t> kmer;
+    // k is at most 32, so one inline word holds the kmer without any heap allocation
+    SmallBinarySequence<1> kmer;
 //    cerr << sequence.name << ' ' << sequence.size();
 
     // Forward iteration
     for (auto& c: sequence.sequence) {
         if (BinarySequence<uint64_t>::base_to_index.at(c) == 4){
             // Reset kmer and don't hash any region with non ACGT chars
-            kmer = {};
+            kmer.clear();
             continue;
         }
 
@@ -96,7 +97,7 @@ void Hasher::hash_sequence(const Sequence& sequence, size_t i) {
     for (auto iter = sequence.sequence.rbegin(); iter != sequence.sequence.rend(); iter++) {
         if (BinarySequence<uint64_t>::base_to_index.at(*iter) == 4){
             // Reset kmer and don't hash any region with non ACGT chars
-            kmer = {};
+            kmer.clear();
             continue;
         }
 
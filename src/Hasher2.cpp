@@ -1,4 +1,5 @@
 #include "Hasher2.hpp"
+#include "Instrumentation.hpp"
 
 #include <algorithm>
 #include <random>
@@ -80,7 +81,7 @@ const vector<uint64_t> Hasher2::seeds = {
         1062935676395772243};
 
 
-uint64_t Hasher2::hash(const BinarySequence<uint64_t>& kmer, size_t seed_index) const{
+uint64_t Hasher2::hash(const SmallBinarySequence<1>& kmer, size_t seed_index) const{
     return MurmurHash64A(kmer.sequence.data(), int(kmer.get_byte_length()), seeds[seed_index]);
 }
 
@@ -89,13 +90,14 @@ uint64_t Hasher2::hash(const BinarySequence<uint64_t>& kmer, size_t seed_index)
 /// \param sequence
 /// \param i iteration of hashing to compute, corresponding to a hash function
 void Hasher2::hash_sequence(const Sequence& sequence, int64_t id, const size_t hash_index) {
-    BinarySequence<uint64_t> kmer;
+    // k is at most 32, so one inline word holds the kmer without any heap allocation
+    SmallBinarySequence<1> kmer;
 
     // Forward iteration
     for (auto& c: sequence.sequence) {
         if (BinarySequence<uint64_t>::base_to_index.at(c) == 4){
             // Reset kmer and don't hash any region with non ACGT chars
-            kmer = {};
+            kmer.clear();
             continue;
         }
 
@@ -123,7 +125,7 @@ void Hasher2::hash_sequence(const Sequence& sequence, int64_t id, const size_t h
     for (auto iter = sequence.sequence.rbegin(); iter != sequence.sequence.rend(); iter++) {
         if (BinarySequence<uint64_t>::base_to_index.at(*iter) == 4){
             // Reset kmer and don't hash any region with non ACGT chars
-            kmer = {};
+            kmer.clear();
             continue;
         }
 
@@ -192,9 +194,12 @@ void Hasher2::hash(const vector<Sequence>& sequences){
         sequence_id_map.try_insert(sequence.name);
     }
 
+    auto& n_hash_iterations = Instrumentation::global().get_counter("hash_iterations");
+
     // Aggregate results
     for (size_t h=0; h<n_iterations; h++){
         cerr << "Beginning iteration: " << h << '\n';
+        n_hash_iterations.fetch_add(1, std::memory_order_relaxed);
 
         bins.clear();
         bins.resize(max_kmers_in_sequence * bins_scaling_factor);
@@ -504,7 +509,7 @@ void Hasher2::write_results(path output_directory) const{
 
             double similarity = double(score)/double(total_hashes);
 
-            overlaps_file << sequence_id_map.get_name(id) << ',' << sequence_id_map.get_name(other_id) << ',' << score << ',' << total_hashes << ',' << similarity << '\n';
+            overlaps_file << sequence_id_map.get_name_view(id) << ',' << sequence_id_map.get_name_view(other_id) << ',' << score << ',' << total_hashes << ',' << similarity << '\n';
             i++;
 
             if (i == 10){
@@ -1,6 +1,372 @@
 #include "IncrementalIdMap.hpp"
+#include "MurmurHash2.hpp"
+#include "BinaryIO.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <limits>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::numeric_limits;
+using std::exception;
+using std::out_of_range;
+using std::memcmp;
+using std::memchr;
+
 
 namespace gfase{
 
 
+const char IncrementalIdMap<string>::magic[8] = {'G','F','A','S','E','I','D','M'};
+
+
+IncrementalIdMap<string>::IncrementalIdMap(bool zero_based):
+    offsets(1, 0),
+    slots(16, 0),
+    zero_based(zero_based)
+{}
+
+
+IncrementalIdMap<string>::IncrementalIdMap(path input_path):
+    offsets(1, 0),
+    slots(16, 0),
+    zero_based(false)
+{
+    ifstream file(input_path, std::ios::binary);
+
+    if (not (file.is_open() and file.good())){
+        throw runtime_error("ERROR: could not read file: " + input_path.string());
+    }
+
+    char header[sizeof(magic)] = {};
+    file.read(header, sizeof(magic));
+    file.close();
+
+    if (memcmp(header, magic, sizeof(magic)) == 0){
+        load_binary(input_path);
+    }
+    else{
+        load_csv(input_path);
+    }
+}
+
+
+uint64_t IncrementalIdMap<string>::hash(string_view name){
+    return MurmurHash64A(name.data(), int(name.size()), seed);
+}
+
+
+size_t IncrementalIdMap<string>::find_slot(string_view name) const{
+    size_t mask = slots.size() - 1;
+    size_t i = hash(name) & mask;
+
+    // Linear probing, stops at the matching name or the first empty slot
+    while (slots[i] != 0){
+        auto index = slots[i] - 1;
+
+        if (string_view(arena.data() + offsets[index], offsets[index+1] - offsets[index]) == name){
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+
+void IncrementalIdMap<string>::grow(){
+    slots.assign(slots.size()*2, 0);
+
+    size_t mask = slots.size() - 1;
+
+    for (uint32_t index=0; index<size(); index++){
+        auto name = string_view(arena.data() + offsets[index], offsets[index+1] - offsets[index]);
+        size_t i = hash(name) & mask;
+
+        while (slots[i] != 0){
+            i = (i + 1) & mask;
+        }
+
+        slots[i] = index + 1;
+    }
+}
+
+
+int64_t IncrementalIdMap<string>::insert(string_view s) {
+    if (exists(s)){
+        throw runtime_error("Error: attempted to insert duplicate key with id: " + to_string(get_id(s)));
+    }
+
+    return do_insert(s);
+}
+
+
+int64_t IncrementalIdMap<string>::try_insert(string_view s) {
+    auto i = find_slot(s);
+
+    if (slots[i] == 0){
+        return do_insert(s);
+    }
+    else{
+        // Slots hold index + 1, which is also the one-based id
+        return int64_t(slots[i]) - zero_based;
+    }
+}
+
+
+int64_t IncrementalIdMap<string>::do_insert(string_view s) {
+    if (size() >= numeric_limits<uint32_t>::max() - 1){
+        throw runtime_error("ERROR: IncrementalIdMap cannot hold more than " + to_string(numeric_limits<uint32_t>::max() - 1) + " names");
+    }
+
+    // Keep the table at most half full
+    if (2*(size() + 1) > slots.size()){
+        grow();
+    }
+
+    auto i = find_slot(s);
+    uint32_t index = uint32_t(size());
+
+    // Make a copy of the node name string
+    arena.insert(arena.end(), s.begin(), s.end());
+    offsets.emplace_back(arena.size());
+
+    // Create a reverse mapping, unless the name is a duplicate, in which case the first id is kept
+    if (slots[i] == 0){
+        slots[i] = index + 1;
+    }
+
+    // Create an integer node ID (starting from 1, unless zero based), and return it for convenience
+    return int64_t(index) + 1 - zero_based;
+}
+
+
+string_view IncrementalIdMap<string>::get_name_view(int64_t id) const{
+    int64_t index = id - 1 + zero_based;
+
+    if (index < 0 or index >= int64_t(size())){
+        throw out_of_range("ERROR: id not in IncrementalIdMap: " + to_string(id));
+    }
+
+    return {arena.data() + offsets[index], offsets[index+1] - offsets[index]};
+}
+
+
+string IncrementalIdMap<string>::get_name(int64_t id) const{
+    return string(get_name_view(id));
+}
+
+
+int64_t IncrementalIdMap<string>::get_id(string_view name) const{
+    auto i = find_slot(name);
+
+    if (slots[i] == 0){
+        throw out_of_range("ERROR: name not in IncrementalIdMap: " + string(name));
+    }
+
+    return int64_t(slots[i]) - zero_based;
+}
+
+
+bool IncrementalIdMap<string>::exists(string_view name) const{
+    return slots[find_slot(name)] != 0;
+}
+
+
+bool IncrementalIdMap<string>::exists(int64_t id) const{
+    return (id >= 0 and id <= int64_t(size()) - zero_based);
+}
+
+
+void IncrementalIdMap<string>::for_each_name(const function<void(string_view name, int64_t id)>& f) const{
+    for (size_t index=0; index<size(); index++){
+        f({arena.data() + offsets[index], offsets[index+1] - offsets[index]}, int64_t(index) + 1 - zero_based);
+    }
+}
+
+
+size_t IncrementalIdMap<string>::size() const{
+    return offsets.size() - 1;
+}
+
+
+void IncrementalIdMap<string>::write_to_csv(path output_path) const{
+    ofstream file(output_path);
+
+    if (not (file.is_open() and file.good())){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    for_each_name([&](string_view name, int64_t id){
+        file << id << ',' << name << '\n';
+    });
+}
+
+
+void IncrementalIdMap<string>::load_csv(path csv_path){
+    ifstream file(csv_path, std::ios::binary);
+
+    if (not (file.is_open() and file.good())){
+        throw runtime_error("ERROR: could not read file: " + csv_path.string());
+    }
+
+    // Read the whole file at once, and split lines/fields without copying them
+    file.seekg(0, std::ios::end);
+    auto file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    string buffer(size_t(file_size), '\0');
+    file.read(buffer.data(), file_size);
+
+    const char* start = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+
+    size_t n_lines = 0;
+
+    // Lines that are not terminated by a newline are ignored
+    while (start < end){
+        auto stop = static_cast<const char*>(memchr(start, '\n', end - start));
+
+        if (stop == nullptr){
+            break;
+        }
+
+        string_view line(start, stop - start);
+        start = stop + 1;
+
+        auto i = line.find(',');
+        auto id_token = line.substr(0, i);
+        auto name = (i == string_view::npos) ? string_view() : line.substr(i + 1);
+
+        if (name.find(',') != string_view::npos){
+            throw runtime_error("ERROR: too many delimiters for line in file: " + csv_path.string());
+        }
+
+        if (n_lines == 0){
+            size_t id = stoll(string(id_token));
+            if (id == 0){
+                zero_based = true;
+            }
+            else if (id == 1){
+                zero_based = false;
+            }
+            else{
+                throw runtime_error("ERROR: first id is not 0 or 1: " + csv_path.string());
+            }
+
+            // The names can't take up more space than the file does
+            arena.reserve(buffer.size());
+        }
+
+        insert(name);
+        n_lines++;
+    }
+}
+
+
+void IncrementalIdMap<string>::write_to_binary(path output_path) const{
+    ofstream file(output_path, std::ios::binary);
+
+    if (not (file.is_open() and file.good())){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    // Header, all 8-byte fields
+    file.write(magic, sizeof(magic));
+    write_value_to_binary(file, version);
+    write_value_to_binary(file, uint64_t(zero_based));
+    write_value_to_binary(file, uint64_t(size()));
+    write_value_to_binary(file, uint64_t(arena.size()));
+    write_value_to_binary(file, uint64_t(slots.size()));
+
+    // The table always has an even number of slots, so every section starts on an 8-byte boundary
+    write_vector_to_binary(file, offsets);
+    write_vector_to_binary(file, slots);
+    write_vector_to_binary(file, arena);
+
+    if (not file.good()){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+}
+
+
+void IncrementalIdMap<string>::load_binary(path input_path){
+    int fd = ::open(input_path.c_str(), O_RDONLY);
+
+    if (fd == -1){
+        throw runtime_error("ERROR: could not read file: " + input_path.string());
+    }
+
+    struct stat file_stats{};
+    ::fstat(fd, &file_stats);
+    uint64_t file_size = file_stats.st_size;
+
+    char header[sizeof(magic)];
+    uint64_t file_version = 0;
+    uint64_t file_zero_based = 0;
+    uint64_t n_names = 0;
+    uint64_t arena_size = 0;
+    uint64_t n_slots = 0;
+
+    off_t offset = 0;
+
+    try {
+        if (file_size < sizeof(magic) + 5*sizeof(uint64_t)){
+            throw runtime_error("ERROR: binary id map is truncated: " + input_path.string());
+        }
+
+        pread_bytes(fd, header, sizeof(magic), offset);
+        pread_value_from_binary(fd, file_version, offset);
+        pread_value_from_binary(fd, file_zero_based, offset);
+        pread_value_from_binary(fd, n_names, offset);
+        pread_value_from_binary(fd, arena_size, offset);
+        pread_value_from_binary(fd, n_slots, offset);
+
+        if (memcmp(header, magic, sizeof(magic)) != 0 or file_version != version){
+            throw runtime_error("ERROR: file is not a binary id map of version " + to_string(version) + ": " + input_path.string());
+        }
+
+        bool valid_table = n_slots >= 2 and (n_slots & (n_slots - 1)) == 0 and n_names < n_slots and file_zero_based < 2;
+        bool valid_size = valid_table and file_size == uint64_t(offset) + (n_names + 1)*sizeof(uint64_t) + n_slots*sizeof(uint32_t) + arena_size;
+
+        if (not valid_size){
+            throw runtime_error("ERROR: binary id map is truncated or corrupt: " + input_path.string());
+        }
+
+        pread_vector_from_binary(fd, offsets, n_names + 1, offset);
+        pread_vector_from_binary(fd, slots, n_slots, offset);
+        pread_vector_from_binary(fd, arena, arena_size, offset);
+    }
+    catch (const exception& e){
+        ::close(fd);
+        throw;
+    }
+
+    ::close(fd);
+
+    if (offsets.front() != 0 or offsets.back() != arena_size){
+        throw runtime_error("ERROR: binary id map has invalid offsets: " + input_path.string());
+    }
+
+    for (size_t i=1; i<offsets.size(); i++){
+        if (offsets[i] < offsets[i-1]){
+            throw runtime_error("ERROR: binary id map has invalid offsets: " + input_path.string());
+        }
+    }
+
+    for (auto& s: slots){
+        if (s > n_names){
+            throw runtime_error("ERROR: binary id map has invalid hash table: " + input_path.string());
+        }
+    }
+
+    zero_based = bool(file_zero_based);
+}
+
+
 }
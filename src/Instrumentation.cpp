@@ -0,0 +1,295 @@
+#include "Instrumentation.hpp"
+
+#include <stdexcept>
+#include <fstream>
+#include <chrono>
+
+using std::runtime_error;
+using std::unique_lock;
+using std::lock_guard;
+using std::to_string;
+using std::ofstream;
+using std::cerr;
+
+
+namespace gfase{
+
+
+SpanRecord::SpanRecord(const string& name, size_t depth, double start):
+        name(name),
+        depth(depth),
+        start(start),
+        elapsed(0),
+        is_open(true)
+{}
+
+
+Instrumentation::Instrumentation():
+        start(steady_clock::now()),
+        stop_requested(false)
+{}
+
+
+Instrumentation::~Instrumentation(){
+    stop_progress();
+}
+
+
+Instrumentation& Instrumentation::global(){
+    static Instrumentation instrumentation;
+    return instrumentation;
+}
+
+
+double Instrumentation::get_seconds() const{
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+
+/// Fetch (or create) a counter. The reference stays valid for the lifetime of this object, so hot loops should fetch
+/// it once and then use fetch_add on it directly.
+/// \param name
+/// \return
+atomic<uint64_t>& Instrumentation::get_counter(const string& name){
+    lock_guard<mutex> lock(m);
+    return counters.try_emplace(name, 0).first->second;
+}
+
+
+void Instrumentation::increment(const string& name, uint64_t n){
+    get_counter(name).fetch_add(n, std::memory_order_relaxed);
+}
+
+
+void Instrumentation::set_gauge(const string& name, double value){
+    lock_guard<mutex> lock(m);
+    gauges[name] = value;
+}
+
+
+size_t Instrumentation::begin_span(const string& name){
+    lock_guard<mutex> lock(m);
+
+    auto index = spans.size();
+    spans.emplace_back(name, open_spans.size(), get_seconds());
+    open_spans.emplace_back(index);
+
+    return index;
+}
+
+
+void Instrumentation::end_span(size_t index){
+    lock_guard<mutex> lock(m);
+
+    // Called from destructors, so tolerate spans that were already closed or cleared
+    if (index >= spans.size() or not spans[index].is_open){
+        return;
+    }
+
+    auto& span = spans[index];
+
+    span.elapsed = get_seconds() - span.start;
+    span.is_open = false;
+
+    // Spans are usually closed innermost first, so search from the back
+    for (auto iter = open_spans.rbegin(); iter != open_spans.rend(); ++iter){
+        if (*iter == index){
+            open_spans.erase(std::next(iter).base());
+            break;
+        }
+    }
+}
+
+
+void Instrumentation::print_progress(map<string,uint64_t>& prev_counts, double interval){
+    string line = timer.elapsed();
+
+    lock_guard<mutex> lock(m);
+
+    for (size_t i=0; i<open_spans.size(); i++){
+        if (i > 0){
+            line += " > ";
+        }
+        line += spans[open_spans[i]].name;
+    }
+
+    if (not counters.empty()){
+        line += " |";
+    }
+
+    for (const auto& [name, counter]: counters){
+        auto count = counter.load(std::memory_order_relaxed);
+        auto& prev = prev_counts[name];
+
+        line += ' ' + name + '=' + to_string(count);
+
+        if (count > prev){
+            line += " (" + to_string(uint64_t(double(count - prev)/interval)) + "/s)";
+        }
+
+        prev = count;
+    }
+
+    cerr << line << '\n';
+}
+
+
+/// Print a one-line summary of the open spans and counters (with their rates) every interval_seconds, from a
+/// background thread, until stop_progress is called
+/// \param interval_seconds
+void Instrumentation::start_progress(double interval_seconds){
+    stop_progress();
+
+    if (interval_seconds <= 0){
+        return;
+    }
+
+    stop_requested = false;
+
+    progress_thread = thread([this, interval_seconds](){
+        map<string,uint64_t> prev_counts;
+        auto interval = std::chrono::duration_cast<steady_clock::duration>(duration<double>(interval_seconds));
+
+        unique_lock<mutex> lock(m);
+        while (not progress_condition.wait_for(lock, interval, [this](){ return stop_requested; })){
+            lock.unlock();
+            print_progress(prev_counts, interval_seconds);
+            lock.lock();
+        }
+    });
+}
+
+
+void Instrumentation::stop_progress(){
+    if (not progress_thread.joinable()){
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(m);
+        stop_requested = true;
+    }
+
+    progress_condition.notify_all();
+    progress_thread.join();
+}
+
+
+string escape_json(const string& s){
+    string result;
+
+    for (auto c: s){
+        if (c == '"' or c == '\\'){
+            result += '\\';
+        }
+        result += c;
+    }
+
+    return result;
+}
+
+
+void Instrumentation::write_json(path output_path) const{
+    ofstream file(output_path);
+
+    if (not file.is_open() or not file.good()){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    lock_guard<mutex> lock(m);
+
+    file << "{\n";
+    file << "  \"total_seconds\": " << get_seconds() << ",\n";
+
+    file << "  \"spans\": [";
+    for (size_t i=0; i<spans.size(); i++){
+        const auto& span = spans[i];
+
+        // Spans that are still open are reported up to now
+        auto elapsed = span.is_open ? get_seconds() - span.start : span.elapsed;
+
+        file << (i > 0 ? ",\n" : "\n");
+        file << "    {\"name\": \"" << escape_json(span.name) << "\", \"depth\": " << span.depth
+             << ", \"start\": " << span.start << ", \"seconds\": " << elapsed << '}';
+    }
+    file << "\n  ],\n";
+
+    file << "  \"counters\": {";
+    size_t i = 0;
+    for (const auto& [name, counter]: counters){
+        file << (i++ > 0 ? ",\n" : "\n");
+        file << "    \"" << escape_json(name) << "\": " << counter.load();
+    }
+    file << "\n  },\n";
+
+    file << "  \"gauges\": {";
+    i = 0;
+    for (const auto& [name, value]: gauges){
+        file << (i++ > 0 ? ",\n" : "\n");
+        file << "    \"" << escape_json(name) << "\": " << value;
+    }
+    file << "\n  }\n";
+    file << "}\n";
+}
+
+
+void Instrumentation::write_tsv(path output_path) const{
+    ofstream file(output_path);
+
+    if (not file.is_open() or not file.good()){
+        throw runtime_error("ERROR: could not write to file: " + output_path.string());
+    }
+
+    lock_guard<mutex> lock(m);
+
+    file << "type\tname\tdepth\tstart\tvalue\n";
+
+    for (const auto& span: spans){
+        auto elapsed = span.is_open ? get_seconds() - span.start : span.elapsed;
+        file << "span" << '\t' << span.name << '\t' << span.depth << '\t' << span.start << '\t' << elapsed << '\n';
+    }
+
+    for (const auto& [name, counter]: counters){
+        file << "counter" << '\t' << name << '\t' << 0 << '\t' << 0 << '\t' << counter.load() << '\n';
+    }
+
+    for (const auto& [name, value]: gauges){
+        file << "gauge" << '\t' << name << '\t' << 0 << '\t' << 0 << '\t' << value << '\n';
+    }
+}
+
+
+/// Write timing.json and timing.tsv to the output directory. Span values are in seconds.
+/// \param output_dir
+void Instrumentation::write_report(path output_dir) const{
+    write_json(output_dir / "timing.json");
+    write_tsv(output_dir / "timing.tsv");
+}
+
+
+/// Reset counters and discard all spans and gauges, e.g. between independent runs in the same process
+void Instrumentation::clear(){
+    lock_guard<mutex> lock(m);
+
+    for (auto& [name, counter]: counters){
+        counter.store(0);
+    }
+
+    gauges.clear();
+    spans.clear();
+    open_spans.clear();
+}
+
+
+ScopedSpan::ScopedSpan(const string& name, Instrumentation& instrumentation):
+        instrumentation(instrumentation),
+        index(instrumentation.begin_span(name))
+{}
+
+
+ScopedSpan::~ScopedSpan(){
+    instrumentation.end_span(index);
+}
+
+
+}
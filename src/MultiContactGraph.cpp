@@ -963,19 +963,12 @@ double MultiContactGraph::compute_total_consistency_score() const{
 }
 
 
-void MultiContactGraph::randomize_partitions(){
-    // True random number
-    std::random_device rd;
-
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,2);
-
+void MultiContactGraph::randomize_partitions(SplitMix64& rng){
     for (const auto& [id,node]: nodes){
         int8_t p;
         if (node.has_alt()){
             // Only allow {1,-1} for known bubbles
-            p = int8_t((uniform_distribution(rng) % 2));
+            p = int8_t(rng.bounded(2));
 
             if (p == 0){
                 p = -1;
@@ -985,7 +978,7 @@ void MultiContactGraph::randomize_partitions(){
         }
         else{
             // Allow {1,0,-1}
-            p = int8_t((uniform_distribution(rng) % 3) - 1);
+            p = int8_t(int(rng.bounded(3)) - 1);
 
             set_partition(id,p);
         }
@@ -1050,32 +1043,32 @@ void MultiContactGraph::get_alts_from_shasta_names(const IncrementalIdMap<string
 
     int64_t alts_found = 0;
 
-    for (auto&[name, id]: id_map.ids) {
+    id_map.for_each_name([&](string_view name, int64_t id){
         if (visited.count(int32_t(id)) > 0) {
-            continue;
+            return;
         }
 
         // Skip any "UR" prefixed nodes
         if (name.empty()){
-            continue;
+            return;
         }
         else if (name[0] == 'U'){
-            continue;
+            return;
         }
 
         // Split to find last field, which should be 0/1 for shasta PR segments
         auto i = name.find_last_of('.');
 
         if (i < 2 or i > name.size()) {
-            continue;
+            return;
         }
 
-        auto prefix = name.substr(0, i);
-        int64_t side = stoi(name.substr(i + 1));
+        string prefix(name.substr(0, i));
+        int64_t side = stoi(string(name.substr(i + 1)));
 
         // Cheap test to check for proper syntax
         if (side > 1 or side < 0) {
-            throw std::runtime_error("ERROR: shasta bubble side not 0/1: " + name);
+            throw std::runtime_error("ERROR: shasta bubble side not 0/1: " + string(name));
         }
 
         // Find complement
@@ -1099,7 +1092,7 @@ void MultiContactGraph::get_alts_from_shasta_names(const IncrementalIdMap<string
         }
 
         visited.emplace(id);
-    }
+    });
 
     double alt_proportion = double(alts_found)/double(id_map.size());
 
@@ -1232,7 +1225,7 @@ void MultiContactGraph::write_contact_map(path output_path, const IncrementalIdM
     output_file << "name_a" << ',' << "name_b" << ',' << "weight" << '\n';
 
     for_each_edge([&](const pair<int32_t, int32_t> edge, int32_t weight) {
-        output_file << id_map.get_name(edge.first) << ',' << id_map.get_name(edge.second) << ',' << weight << '\n';
+        output_file << id_map.get_name_view(edge.first) << ',' << id_map.get_name_view(edge.second) << ',' << weight << '\n';
     });
 }
 
@@ -0,0 +1,266 @@
+#include "OverlapMatcher.hpp"
+
+#include <algorithm>
+
+using std::lower_bound;
+using std::sort;
+
+
+namespace gfase {
+
+
+OverlapMatcher::OverlapMatcher(const MultiContactGraph& alignment_graph):
+        pass(0),
+        position(-1)
+{
+    alignment_graph.for_each_node([&](int32_t id){
+        ids.emplace_back(id);
+    });
+
+    sort(ids.begin(), ids.end());
+
+    lengths.resize(ids.size());
+    coverages.resize(ids.size());
+
+    for (size_t i=0; i<ids.size(); i++){
+        lengths[i] = alignment_graph.get_node_length(ids[i]);
+        coverages[i] = alignment_graph.get_node_coverage(ids[i]);
+    }
+
+    auto get_index = [&](int32_t id){
+        return uint32_t(lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+    };
+
+    vector <pair <int32_t, pair <uint32_t, uint32_t> > > weighted_edges;
+
+    // Stored edges are always {min(a,b), max(a,b)}, so the index order matches
+    alignment_graph.for_each_edge([&](const pair<int32_t,int32_t> edge, int32_t weight){
+        weighted_edges.push_back({weight, {get_index(edge.first), get_index(edge.second)}});
+    });
+
+    sort(weighted_edges.begin(), weighted_edges.end(), [](const auto& a, const auto& b){
+        if (a.first != b.first){
+            return a.first > b.first;
+        }
+        return a.second < b.second;
+    });
+
+    edges.reserve(weighted_edges.size());
+    weights.reserve(weighted_edges.size());
+
+    for (auto& [weight, e]: weighted_edges){
+        edges.emplace_back(e);
+        weights.emplace_back(weight);
+    }
+
+    is_alive.resize(edges.size(), true);
+    queued_pass.resize(edges.size(), 0);
+
+    // Count, then fill, the adjacency
+    incident_offsets.resize(ids.size() + 1, 0);
+
+    for (auto& [a,b]: edges){
+        incident_offsets[a + 1]++;
+        incident_offsets[b + 1]++;
+    }
+
+    for (size_t i=1; i<incident_offsets.size(); i++){
+        incident_offsets[i] += incident_offsets[i - 1];
+    }
+
+    cursors.assign(incident_offsets.begin(), incident_offsets.end() - 1);
+    incident_edges.resize(2*edges.size());
+
+    for (uint32_t e=0; e<edges.size(); e++){
+        incident_edges[cursors[edges[e].first]++] = e;
+        incident_edges[cursors[edges[e].second]++] = e;
+    }
+
+    cursors.assign(incident_offsets.begin(), incident_offsets.end() - 1);
+
+    // Ties are broken by the smallest neighbor id, which is the first maximum in a node's ordered neighbor set
+    for (uint32_t n=0; n<ids.size(); n++){
+        sort(incident_edges.begin() + incident_offsets[n], incident_edges.begin() + incident_offsets[n + 1], [&](uint32_t x, uint32_t y){
+            if (weights[x] != weights[y]){
+                return weights[x] > weights[y];
+            }
+            return get_other(x, n) < get_other(y, n);
+        });
+    }
+}
+
+
+uint32_t OverlapMatcher::get_other(uint32_t e, uint32_t n) const{
+    return edges[e].first == n ? edges[e].second : edges[e].first;
+}
+
+
+bool OverlapMatcher::is_covered(uint32_t n) const{
+    return coverages[n] >= lengths[n];
+}
+
+
+uint32_t OverlapMatcher::get_best_edge(uint32_t n){
+    // Coverage only grows and edges are only removed, so anything skipped here can never be the best edge again
+    auto& i = cursors[n];
+
+    while (i < incident_offsets[n + 1]){
+        auto e = incident_edges[i];
+
+        if (is_alive[e] and not is_covered(get_other(e, n))){
+            return e;
+        }
+
+        i++;
+    }
+
+    return none;
+}
+
+
+void OverlapMatcher::enqueue(uint32_t e){
+    // Edges that the current pass hasn't reached yet are still visited in this pass, otherwise they wait for the next
+    bool is_current = int64_t(e) > position;
+    uint64_t target_pass = pass + (is_current ? 1 : 2);
+
+    if (queued_pass[e] == target_pass){
+        return;
+    }
+
+    queued_pass[e] = target_pass;
+
+    if (is_current){
+        current_queue.emplace(e);
+    }
+    else{
+        next_queue.emplace(e);
+    }
+}
+
+
+void OverlapMatcher::enqueue_best_edge(uint32_t n){
+    auto e = get_best_edge(n);
+
+    if (e == none){
+        return;
+    }
+
+    // Only a mutually best edge can be accepted
+    if (get_best_edge(get_other(e, n)) == e){
+        enqueue(e);
+    }
+}
+
+
+void OverlapMatcher::match(
+        double min_similarity,
+        double overflow_tolerance,
+        double first_node_penalty,
+        const function<void(int32_t a, int32_t b, int32_t weight)>& f){
+
+    for (uint32_t n=0; n<ids.size(); n++){
+        enqueue_best_edge(n);
+    }
+
+    vector<uint32_t> accepted;
+
+    while (true){
+        while (not current_queue.empty()){
+            auto e = current_queue.top();
+            current_queue.pop();
+
+            position = e;
+
+            if (not is_alive[e]){
+                continue;
+            }
+
+            auto [x,y] = edges[e];
+            auto weight = weights[e];
+
+            uint32_t a;
+            uint32_t b;
+
+            if (lengths[x] > lengths[y]){
+                a = x;
+                b = y;
+            }
+            else{
+                a = y;
+                b = x;
+            }
+
+            auto a_coverage = coverages[a];
+            auto b_coverage = coverages[b];
+            auto a_length = lengths[a];
+            auto b_length = lengths[b];
+
+            if (is_covered(a) or is_covered(b)){
+                continue;
+            }
+
+            if (get_best_edge(a) != e or get_best_edge(b) != e){
+                continue;
+            }
+
+            auto a_cost = (a_coverage + weight) - a_length;
+            auto b_cost = (b_coverage + weight) - b_length;
+
+            // The alignment must be sane, i.e. not overhanging more than it adds for either node
+            auto a_sane = double(a_cost) < 0.5*double(weight);
+            auto b_sane = double(b_cost) < 0.5*double(weight);
+
+            // Sometimes supplementaries overlap and extend longer than the node length
+            bool a_max = double(a_coverage) + double(weight) < double(a_length)*(1.0+overflow_tolerance);
+            bool b_max = double(b_coverage) + double(weight) < double(b_length)*(1.0+overflow_tolerance);
+
+            // First node should be a significant portion of the alt's length, subsequent nodes can be smaller
+            bool a_min = double(weight) > double(a_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
+            bool b_min = double(weight) > double(b_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
+
+            if (not (a_sane and b_sane and a_max and b_max and a_min and b_min)){
+                continue;
+            }
+
+            f(ids[a], ids[b], weight);
+            accepted.emplace_back(e);
+
+            coverages[a] += weight;
+            coverages[b] += weight;
+
+            for (auto n: {a,b}){
+                if (is_covered(n)){
+                    // Neighbors that preferred this node now have a new best edge
+                    for (auto i=incident_offsets[n]; i<incident_offsets[n + 1]; i++){
+                        enqueue_best_edge(get_other(incident_edges[i], n));
+                    }
+                }
+                else{
+                    enqueue_best_edge(n);
+                }
+            }
+        }
+
+        if (accepted.empty()){
+            break;
+        }
+
+        // Accepted edges stay in the graph until the end of the pass
+        position = int64_t(edges.size());
+
+        for (auto e: accepted){
+            is_alive[e] = false;
+            enqueue_best_edge(edges[e].first);
+            enqueue_best_edge(edges[e].second);
+        }
+
+        accepted.clear();
+
+        std::swap(current_queue, next_queue);
+        position = -1;
+        pass++;
+    }
+}
+
+
+}
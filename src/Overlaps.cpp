@@ -104,6 +104,10 @@ Cigar::Cigar(const std::string& cigar_string) {
     }
 }
 
+Cigar::Cigar(std::vector<CigarOperation>::const_iterator begin, std::vector<CigarOperation>::const_iterator end):
+    operations(begin, end)
+{}
+
 string Cigar::get_string() const {
     
     string s;
@@ -169,26 +173,122 @@ Cigar::iterator Cigar::end() const {
     return operations.end();
 }
 
+Overlaps::Overlaps():
+    n_dead_operations(0)
+{}
+
+uint64_t Overlaps::get_key(const HandleGraph& graph, const edge_t& edge) {
+    uint64_t left = 2*uint64_t(graph.get_id(edge.first)) + graph.get_is_reverse(edge.first);
+    uint64_t right = 2*uint64_t(graph.get_id(edge.second)) + graph.get_is_reverse(edge.second);
+    
+    if (left > UINT32_MAX or right > UINT32_MAX) {
+        throw runtime_error("ERROR: node id too large to record overlap: " + to_string(graph.get_id(left > UINT32_MAX ? edge.first : edge.second)));
+    }
+    
+    return (left << 32) | right;
+}
+
+bool Overlaps::is_reversed(const HandleGraph& graph, handle_t a, handle_t b, uint64_t value) const {
+    bool is_canonical = graph.edge_handle(a, b).first == a;
+    return is_canonical == bool(value & reversal_flag);
+}
+
+void Overlaps::set_value(uint64_t key, uint64_t value) {
+    auto result = overlaps.emplace(key, value);
+    
+    if (not result.second) {
+        auto& existing = result.first->second;
+        
+        if (existing & arena_flag) {
+            n_dead_operations += (existing >> 40) & count_mask;
+        }
+        
+        existing = value;
+    }
+}
+
+void Overlaps::compact() {
+    vector<CigarOperation> compacted;
+    
+    for (auto& [key, value]: overlaps) {
+        if (value & arena_flag) {
+            auto start = value & offset_mask;
+            auto n = (value >> 40) & count_mask;
+            
+            value = (value & ~offset_mask) | uint64_t(compacted.size());
+            compacted.insert(compacted.end(), operations.begin() + start, operations.begin() + start + n);
+        }
+    }
+    
+    operations = move(compacted);
+    n_dead_operations = 0;
+}
+
 void Overlaps::record_overlap(const HandleGraph& graph, handle_t a, handle_t b, const string& cigar) {
+    // Skip blunt edges without parsing
+    if (cigar == "*" or cigar == "0M") {
+        return;
+    }
+    
+    // A single match operation doesn't need a Cigar to be stored
+    if (cigar.size() > 1 and cigar.size() < 11 and cigar.back() == 'M' and cigar.find_first_not_of("0123456789") == cigar.size() - 1) {
+        auto length = stoull(cigar.substr(0, cigar.size() - 1));
+        
+        if (length <= UINT32_MAX) {
+            if (length > 0) {
+                set_value(get_key(graph, graph.edge_handle(a, b)), length);
+            }
+            return;
+        }
+    }
+    
     record_overlap(graph, a, b, Cigar(cigar));
 }
 
 void Overlaps::record_overlap(const HandleGraph& graph, handle_t a, handle_t b, const Cigar& cigar) {
-    if (!cigar.empty()) {
-        overlaps[graph.edge_handle(a, b)] = cigar;
+    if (cigar.empty()) {
+        return;
+    }
+    
+    auto edge = graph.edge_handle(a, b);
+    
+    if (cigar.size() == 1 and cigar.at(0).type() == 'M') {
+        set_value(get_key(graph, edge), cigar.at(0).length());
+        return;
+    }
+    
+    if (operations.size() > offset_mask or cigar.size() > count_mask) {
+        throw runtime_error("ERROR: too many CIGAR operations to record overlap");
+    }
+    
+    uint64_t value = arena_flag | (uint64_t(cigar.size()) << 40) | uint64_t(operations.size());
+    
+    if (edge.first != a) {
+        value |= reversal_flag;
+    }
+    
+    operations.insert(operations.end(), cigar.begin(), cigar.end());
+    set_value(get_key(graph, edge), value);
+    
+    // Overwritten CIGARs leave gaps in the arena
+    if (n_dead_operations > 1024 and 2*n_dead_operations > operations.size()) {
+        compact();
     }
 }
 
 void Overlaps::remove_overlap(const HandleGraph& graph, handle_t a, handle_t b) {
-    auto it = overlaps.find(graph.edge_handle(a, b));
+    auto it = overlaps.find(get_key(graph, graph.edge_handle(a, b)));
     if (it != overlaps.end()) {
+        if (it->second & arena_flag) {
+            n_dead_operations += (it->second >> 40) & count_mask;
+        }
         overlaps.erase(it);
     }
 }
 
 
 bool Overlaps::has_overlap(const HandleGraph& graph, handle_t a, handle_t b) const {
-    return overlaps.count(graph.edge_handle(a, b));
+    return overlaps.count(get_key(graph, graph.edge_handle(a, b)));
 }
 
 bool Overlaps::is_blunt() const {
@@ -198,16 +298,58 @@ bool Overlaps::is_blunt() const {
 
 Cigar Overlaps::get_overlap(const HandleGraph& graph, handle_t a, handle_t b) const {
     Cigar cigar;
-    auto it = overlaps.find(graph.edge_handle(a, b));
+    auto it = overlaps.find(get_key(graph, graph.edge_handle(a, b)));
     if (it != overlaps.end()) {
-        if (it->first.first == a) {
-            cigar = it->second;
+        auto value = it->second;
+        
+        if (not (value & arena_flag)) {
+            vector<CigarOperation> match = {CigarOperation(uint32_t(value), 'M')};
+            cigar = Cigar(match.begin(), match.end());
         }
         else {
-            cigar = it->second.reverse();
+            auto start = operations.begin() + (value & offset_mask);
+            cigar = Cigar(start, start + ((value >> 40) & count_mask));
+            
+            if (is_reversed(graph, a, b, value)) {
+                cigar = cigar.reverse();
+            }
         }
     }
     return cigar;
 }
 
 
+pair<size_t, size_t> Overlaps::get_aligned_length(const HandleGraph& graph, handle_t a, handle_t b) const {
+    pair<size_t, size_t> lengths(0, 0);
+    auto it = overlaps.find(get_key(graph, graph.edge_handle(a, b)));
+    if (it != overlaps.end()) {
+        auto value = it->second;
+        
+        if (not (value & arena_flag)) {
+            lengths = {value, value};
+        }
+        else {
+            auto start = value & offset_mask;
+            auto n = (value >> 40) & count_mask;
+            
+            for (auto i = start; i < start + n; ++i) {
+                lengths.first += operations[i].ref_length();
+                lengths.second += operations[i].query_length();
+            }
+            
+            if (is_reversed(graph, a, b, value)) {
+                // Same restriction as Cigar::reverse, which swaps the roles of ref and query
+                for (auto i = start; i < start + n; ++i) {
+                    auto type = operations[i].type();
+                    if (type == 'S' || type == 'H' || type == 'N' || type == 'P') {
+                        throw runtime_error("Clipped or unaligned CIGARs cannot be trivially reversed");
+                    }
+                }
+                std::swap(lengths.first, lengths.second);
+            }
+        }
+    }
+    return lengths;
+}
+
+
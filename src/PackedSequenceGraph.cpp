@@ -0,0 +1,121 @@
+#include "PackedSequenceGraph.hpp"
+
+#include <stdexcept>
+
+using std::runtime_error;
+using std::to_string;
+using std::min;
+
+
+namespace gfase {
+
+
+handle_t PackedSequenceGraph::create_handle(const string& sequence) {
+    // The base class picks the id, the node itself only holds an empty sequence
+    auto handle = HashGraph::create_handle(string());
+    sequences.insert(get_id(handle), sequence);
+
+    return handle;
+}
+
+
+handle_t PackedSequenceGraph::create_handle(const string& sequence, const nid_t& id) {
+    auto handle = HashGraph::create_handle(string(), id);
+    sequences.insert(id, sequence);
+
+    return handle;
+}
+
+
+void PackedSequenceGraph::destroy_handle(const handle_t& handle) {
+    auto id = get_id(handle);
+
+    HashGraph::destroy_handle(handle);
+    sequences.remove(id);
+}
+
+
+handle_t PackedSequenceGraph::apply_orientation(const handle_t& handle) {
+    if (get_is_reverse(handle)){
+        sequences.insert(get_id(handle), get_sequence(handle));
+    }
+
+    return HashGraph::apply_orientation(handle);
+}
+
+
+vector<handle_t> PackedSequenceGraph::divide_handle(const handle_t& handle, const vector<size_t>& offsets) {
+    throw runtime_error("ERROR: divide_handle is not supported by PackedSequenceGraph, attempted on node: " + to_string(get_id(handle)));
+}
+
+
+void PackedSequenceGraph::clear() {
+    HashGraph::clear();
+    sequences.clear();
+}
+
+
+size_t PackedSequenceGraph::get_length(const handle_t& handle) const {
+    return sequences.get_length(get_id(handle));
+}
+
+
+string PackedSequenceGraph::get_sequence(const handle_t& handle) const {
+    string s;
+    decode_sequence(handle, s);
+
+    return s;
+}
+
+
+char PackedSequenceGraph::get_base(const handle_t& handle, size_t index) const {
+    auto sequence = sequences.get_view(get_id(handle));
+
+    if (get_is_reverse(handle)){
+        return PackedSequenceStore::complement[uint8_t(sequence[sequence.size() - 1 - index])];
+    }
+    else{
+        return sequence[index];
+    }
+}
+
+
+string PackedSequenceGraph::get_subsequence(const handle_t& handle, size_t index, size_t size) const {
+    auto sequence = sequences.get_view(get_id(handle));
+
+    if (index > sequence.size()){
+        throw runtime_error("ERROR: subsequence index " + to_string(index) + " is past the end of node " +
+                            to_string(get_id(handle)) + " with length " + to_string(sequence.size()));
+    }
+
+    size = min(size, sequence.size() - index);
+
+    string s;
+
+    if (get_is_reverse(handle)){
+        sequence.decode(s, sequence.size() - index - size, size, true);
+    }
+    else{
+        sequence.decode(s, index, size);
+    }
+
+    return s;
+}
+
+
+PackedSequenceView PackedSequenceGraph::get_packed_sequence(const handle_t& handle) const {
+    return sequences.get_view(get_id(handle));
+}
+
+
+void PackedSequenceGraph::decode_sequence(const handle_t& handle, string& s) const {
+    sequences.get_view(get_id(handle)).decode(s, get_is_reverse(handle));
+}
+
+
+const PackedSequenceStore& PackedSequenceGraph::get_sequence_store() const {
+    return sequences;
+}
+
+
+}
@@ -0,0 +1,389 @@
+#include "PackedSequenceStore.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using std::partition_point;
+using std::runtime_error;
+using std::to_string;
+using std::reverse;
+using std::memcpy;
+using std::min;
+
+
+namespace gfase {
+
+
+static array<uint8_t,256> make_base_to_code_table(){
+    array<uint8_t,256> table;
+    table.fill(4);
+
+    table['A'] = 0;
+    table['C'] = 1;
+    table['G'] = 2;
+    table['T'] = 3;
+    table['a'] = 0;
+    table['c'] = 1;
+    table['g'] = 2;
+    table['t'] = 3;
+
+    return table;
+}
+
+
+static array<char,256> make_complement_table(){
+    array<char,256> table;
+
+    for (size_t i=0; i<table.size(); i++){
+        table[i] = char(i);
+    }
+
+    // Includes the IUPAC ambiguity codes, anything else is its own complement
+    string forward = "ACGTRYKMBVDHacgtrykmbvdh";
+    string reverse = "TGCAYRMKVBHDtgcayrmkvbhd";
+
+    for (size_t i=0; i<forward.size(); i++){
+        table[uint8_t(forward[i])] = reverse[i];
+    }
+
+    return table;
+}
+
+
+/// For decoding 4 bases (one byte of packed codes) at a time
+static array<array<char,4>,256> make_byte_to_bases_table(){
+    array<array<char,4>,256> table;
+
+    for (size_t i=0; i<table.size(); i++){
+        for (size_t j=0; j<4; j++){
+            table[i][j] = "ACGT"[(i >> 2*j) & 3];
+        }
+    }
+
+    return table;
+}
+
+
+const array<uint8_t,256> PackedSequenceStore::base_to_code = make_base_to_code_table();
+const array<char,256> PackedSequenceStore::complement = make_complement_table();
+
+
+/// Find the first run which ends after the given position
+static vector<PackedRun>::const_iterator find_first_run(const vector<PackedRun>& runs, uint64_t position){
+    return partition_point(runs.begin(), runs.end(), [&](const PackedRun& r){
+        return r.stop() <= position;
+    });
+}
+
+
+uint64_t PackedRun::stop() const{
+    return start + length;
+}
+
+
+PackedSequenceView::PackedSequenceView(const PackedSequenceStore* store, uint64_t start, uint64_t length):
+        store(store),
+        start(start),
+        length(length)
+{}
+
+
+size_t PackedSequenceView::size() const{
+    return length;
+}
+
+
+const uint64_t* PackedSequenceView::get_words() const{
+    return store->words.data() + start/32;
+}
+
+
+uint64_t PackedSequenceView::get_bit_offset() const{
+    return 2*(start % 32);
+}
+
+
+uint8_t PackedSequenceView::get_base_index(size_t index) const{
+    auto p = start + index;
+    return (store->words[p/32] >> 2*(p % 32)) & 3;
+}
+
+
+bool PackedSequenceView::is_acgt() const{
+    auto r = find_first_run(store->exceptions, start);
+    return r == store->exceptions.end() or r->start >= start + length;
+}
+
+
+char PackedSequenceView::operator[](size_t index) const{
+    auto p = start + index;
+
+    auto r = find_first_run(store->exceptions, p);
+    if (r != store->exceptions.end() and r->start <= p){
+        return r->c;
+    }
+
+    char c = "ACGT"[get_base_index(index)];
+
+    r = find_first_run(store->lowercase, p);
+    if (r != store->lowercase.end() and r->start <= p){
+        c = char(c - 'A' + 'a');
+    }
+
+    return c;
+}
+
+
+void PackedSequenceView::decode(string& s, size_t index, size_t n, bool reverse_complement) const{
+    static const array<array<char,4>,256> byte_to_bases = make_byte_to_bases_table();
+
+    if (index + n > length){
+        throw runtime_error("ERROR: cannot decode " + to_string(n) + " bases at index " + to_string(index) +
+                            " of packed sequence with length " + to_string(length));
+    }
+
+    auto offset = s.size();
+    s.resize(offset + n);
+
+    char* output = s.data() + offset;
+    uint64_t a = start + index;
+    uint64_t b = a + n;
+
+    // One 32 base word at a time, decoded 4 bases per table lookup
+    for (uint64_t p=a; p<b; p+=32){
+        auto word = store->get_code_word(p);
+        size_t m = min(uint64_t(32), b - p);
+        size_t j = 0;
+
+        for (; j + 4 <= m; j += 4){
+            memcpy(output, byte_to_bases[(word >> 2*j) & 0xff].data(), 4);
+            output += 4;
+        }
+
+        for (; j < m; j++){
+            *output++ = "ACGT"[(word >> 2*j) & 3];
+        }
+    }
+
+    // Patch in soft masking and then exceptions
+    for (auto r = find_first_run(store->lowercase, a); r != store->lowercase.end() and r->start < b; r++){
+        for (auto p = std::max(a, r->start); p < min(b, r->stop()); p++){
+            auto& c = s[offset + p - a];
+            c = char(c - 'A' + 'a');
+        }
+    }
+
+    for (auto r = find_first_run(store->exceptions, a); r != store->exceptions.end() and r->start < b; r++){
+        for (auto p = std::max(a, r->start); p < min(b, r->stop()); p++){
+            s[offset + p - a] = r->c;
+        }
+    }
+
+    if (reverse_complement){
+        reverse(s.begin() + offset, s.end());
+
+        for (auto i=offset; i<s.size(); i++){
+            s[i] = PackedSequenceStore::complement[uint8_t(s[i])];
+        }
+    }
+}
+
+
+void PackedSequenceView::decode(string& s, bool reverse_complement) const{
+    decode(s, 0, length, reverse_complement);
+}
+
+
+PackedSequenceStore::PackedSequenceStore():
+        n_bases(0),
+        n_sequences(0),
+        n_dead_bases(0)
+{}
+
+
+void PackedSequenceStore::append_base(uint8_t code){
+    if (n_bases % 32 == 0){
+        words.emplace_back(0);
+    }
+
+    words.back() |= uint64_t(code) << 2*(n_bases % 32);
+    n_bases++;
+}
+
+
+/// Append n <= 32 bases, given as the lowest 2n bits of a word of codes
+void PackedSequenceStore::append_code_word(uint64_t word, size_t n){
+    if (n < 32){
+        word &= (uint64_t(1) << 2*n) - 1;
+    }
+
+    auto offset = n_bases % 32;
+
+    if (offset == 0){
+        words.emplace_back(word);
+    }
+    else{
+        words.back() |= word << 2*offset;
+
+        if (offset + n > 32){
+            words.emplace_back(word >> 2*(32 - offset));
+        }
+    }
+
+    n_bases += n;
+}
+
+
+/// The 32 codes which start at a position in the arena, where positions past the end read as 0
+uint64_t PackedSequenceStore::get_code_word(uint64_t position) const{
+    auto i = position/32;
+    auto offset = position % 32;
+
+    uint64_t word = words[i] >> 2*offset;
+
+    if (offset > 0 and i + 1 < words.size()){
+        word |= words[i + 1] << 2*(32 - offset);
+    }
+
+    return word;
+}
+
+
+void PackedSequenceStore::insert(int64_t id, string_view sequence){
+    if (id < 0){
+        throw runtime_error("ERROR: cannot store sequence for negative id: " + to_string(id));
+    }
+
+    remove(id);
+
+    if (size_t(id) >= records.size()){
+        records.resize(id + 1, {absent, 0});
+    }
+
+    uint64_t start = n_bases;
+
+    for (auto c: sequence){
+        auto code = base_to_code[uint8_t(c)];
+        auto p = n_bases;
+
+        if (code == 4){
+            append_base(0);
+
+            // Runs never span two sequences, so that each sequence can be moved independently
+            if (not exceptions.empty() and exceptions.back().stop() == p and exceptions.back().start >= start and exceptions.back().c == c){
+                exceptions.back().length++;
+            }
+            else{
+                exceptions.push_back({p, 1, c});
+            }
+        }
+        else {
+            append_base(code);
+
+            if (c >= 'a'){
+                if (not lowercase.empty() and lowercase.back().stop() == p and lowercase.back().start >= start){
+                    lowercase.back().length++;
+                }
+                else{
+                    lowercase.push_back({p, 1, 0});
+                }
+            }
+        }
+    }
+
+    records[id] = {start, sequence.size()};
+    n_sequences++;
+}
+
+
+void PackedSequenceStore::remove(int64_t id){
+    if (not has_sequence(id)){
+        return;
+    }
+
+    n_dead_bases += records[id].length;
+    records[id] = {absent, 0};
+    n_sequences--;
+
+    // Only worth compacting if the garbage is big in absolute and relative terms
+    if (n_dead_bases > (uint64_t(1) << 20) and n_dead_bases > n_bases - n_dead_bases){
+        compact();
+    }
+}
+
+
+void PackedSequenceStore::compact(){
+    PackedSequenceStore result;
+    result.records.resize(records.size(), {absent, 0});
+
+    for (size_t id=0; id<records.size(); id++){
+        auto& r = records[id];
+
+        if (r.start == absent){
+            continue;
+        }
+
+        uint64_t start = result.n_bases;
+
+        for (uint64_t p=0; p<r.length; p+=32){
+            result.append_code_word(get_code_word(r.start + p), min(uint64_t(32), r.length - p));
+        }
+
+        for (auto& [runs, result_runs]: {std::make_pair(&exceptions, &result.exceptions), std::make_pair(&lowercase, &result.lowercase)}){
+            for (auto run = find_first_run(*runs, r.start); run != runs->end() and run->start < r.start + r.length; run++){
+                result_runs->push_back({run->start - r.start + start, run->length, run->c});
+            }
+        }
+
+        result.records[id] = {start, r.length};
+        result.n_sequences++;
+    }
+
+    *this = std::move(result);
+}
+
+
+void PackedSequenceStore::clear(){
+    *this = PackedSequenceStore();
+}
+
+
+bool PackedSequenceStore::has_sequence(int64_t id) const{
+    return id >= 0 and size_t(id) < records.size() and records[id].start != absent;
+}
+
+
+size_t PackedSequenceStore::get_length(int64_t id) const{
+    return get_view(id).size();
+}
+
+
+PackedSequenceView PackedSequenceStore::get_view(int64_t id) const{
+    if (not has_sequence(id)){
+        throw runtime_error("ERROR: no sequence stored for id: " + to_string(id));
+    }
+
+    return {this, records[id].start, records[id].length};
+}
+
+
+void PackedSequenceStore::get_sequence(int64_t id, string& s, bool reverse_complement) const{
+    s.clear();
+    get_view(id).decode(s, reverse_complement);
+}
+
+
+size_t PackedSequenceStore::size() const{
+    return n_sequences;
+}
+
+
+size_t PackedSequenceStore::get_byte_size() const{
+    return words.capacity()*sizeof(uint64_t)
+           + (exceptions.capacity() + lowercase.capacity())*sizeof(PackedRun)
+           + records.capacity()*sizeof(Record);
+}
+
+
+}
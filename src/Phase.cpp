@@ -1,5 +1,9 @@
 #include "Phase.hpp"
 
+#include <algorithm>
+
+using std::sort;
+
 namespace gfase{
 
 
@@ -89,9 +93,11 @@ void merge_diploid_singletons(const unordered_map<string,string>& diploid_path_n
         }
     });
 
-    for (auto& item: to_be_merged){
-        chain_bipartition.merge_subgraphs(item.first, item.second);
-    }
+    // Merge all the pairs in one batch, in a defined order
+    vector <pair <size_t,size_t> > merges(to_be_merged.begin(), to_be_merged.end());
+    sort(merges.begin(), merges.end());
+
+    chain_bipartition.merge_subgraphs(merges);
 }
 
 
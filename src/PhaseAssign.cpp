@@ -1,9 +1,12 @@
 #include "PhaseAssign.hpp"
 #include "BubbleGraph.hpp"
+#include "FastaIndex.hpp"
+#include "graph_utility.hpp"
 #include "misc.hpp"
 #include "Bam.hpp"
 #include "Sam.hpp"
 
+#include <exception>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -114,73 +117,32 @@ void parse_bam_cigars(
 }
 
 
-void bin_fasta_sequence(string& name, string& sequence, int bin, ofstream& file0, ofstream& file1){
-    if (not sequence.empty()){
-        if (bin == 0){
-            file0 << '>' << name << '\n';
-            file0 << sequence << '\n';
-        }
-        else if (bin == 1){
-            file1 << '>' << name << '\n';
-            file1 << sequence << '\n';
+void bin_fasta_sequences(
+        path input_fasta_path,
+        path output_pat_fasta_path,
+        path output_mat_fasta_path,
+        const array <set <string>, 2>& phased_contigs,
+        size_t n_threads){
+
+    for (auto& name: phased_contigs[0]){
+        if (phased_contigs[1].count(name) > 0){
+            throw runtime_error("ERROR: contig assigned phase 0 and phase 1: " + name);
         }
     }
-}
-
-
-void bin_fasta_sequences(path input_fasta_path, path output_pat_fasta_path, path output_mat_fasta_path, const array <set <string>, 2>& phased_contigs){
-    ifstream input_file(input_fasta_path);
-    ofstream file0(output_pat_fasta_path);
-    ofstream file1(output_mat_fasta_path);
 
-    string name;
-    string sequence;
+    // Reuses the index written by get_query_lengths_from_fasta, if there is one
+    FastaIndex index(input_fasta_path, n_threads);
 
-    // 0=pat, 1=mat, 2=both
-    int bin = 2;
-    char c;
-
-    while (input_file.get(c)){
-        if (c == '>'){
-            bin_fasta_sequence(name, sequence, bin, file0, file1);
-
-            sequence.clear();
-            name.clear();
-
-            while (input_file.get(c)){
-                if (std::isspace(c)){
-                    // Check if this segment is phased, set flag accordingly
-                    auto count_0 = phased_contigs[0].count(name);
-                    auto count_1 = phased_contigs[1].count(name);
-
-                    if ((count_0 > 0) and (count_1 == 0)){
-                        bin = 0;
-                    }
-                    else if ((count_0 == 0) and (count_1 > 0)){
-                        bin = 1;
-                    }
-                    else if ((count_0 > 0) and (count_1 > 0)){
-                        throw runtime_error("ERROR: contig assigned phase 0 and phase 1: " + name);
-                    }
-                    else{
-                        bin = 2;
-                    }
-                    break;
-                }
-                else {
-                    name += c;
-                }
-            }
+    array<path,2> output_paths = {output_pat_fasta_path, output_mat_fasta_path};
 
-            // Skip rest of the header line which may contain space-separated data
-            input_file.ignore(std::numeric_limits<streamsize>::max(), '\n');
-        }
-        else if (c != '\n'){
-            sequence += c;
-        }
-    }
+    // Each phase is an independent pass over the index, so they can be written concurrently
+    auto write_phase = [&](size_t phase){
+        index.write_records(output_paths[phase], [&](const FastaRecord& record){
+            return phased_contigs[phase].count(record.name) > 0;
+        });
+    };
 
-    bin_fasta_sequence(name, sequence, bin, file0, file1);
+    for_each_job_in_parallel(2, n_threads, write_phase);
 }
 
 
@@ -221,7 +183,7 @@ void assign_phases(
         }
     }
 
-    get_query_lengths_from_fasta(query_path, query_lengths);
+    get_query_lengths_from_fasta(query_path, query_lengths, n_threads);
 
     // Optionally remove entries that don't contain a prefix specified by user
     vector<string> to_be_deleted;
@@ -330,7 +292,7 @@ void assign_phases(
         path pat_output_fasta_path = output_dir / "pat_sequences.fasta";
         path mat_output_fasta_path = output_dir / "mat_sequences.fasta";
 
-        bin_fasta_sequences(query_path, pat_output_fasta_path, mat_output_fasta_path, phased_contigs);
+        bin_fasta_sequences(query_path, pat_output_fasta_path, mat_output_fasta_path, phased_contigs, n_threads);
     }
 }
 
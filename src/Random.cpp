@@ -0,0 +1,27 @@
+#include "Random.hpp"
+
+#include <random>
+
+
+namespace gfase{
+
+
+SplitMix64::SplitMix64(uint64_t seed, uint64_t stream):
+        state(mix64(seed ^ mix64(stream + increment)))
+{}
+
+
+SplitMix64 SplitMix64::split(){
+    return {(*this)(), 0};
+}
+
+
+uint64_t generate_seed(){
+    // True random number
+    std::random_device rd;
+
+    return (uint64_t(rd()) << 32) ^ uint64_t(rd());
+}
+
+
+}
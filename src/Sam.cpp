@@ -4,14 +4,23 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <exception>
 #include <iostream>
+#include <charconv>
 #include <istream>
+#include <fstream>
+#include <cstring>
 #include <limits>
+#include <thread>
+#include <array>
 
 using std::numeric_limits;
+using std::exception_ptr;
 using std::runtime_error;
 using std::streamsize;
 using std::ifstream;
+using std::thread;
+using std::array;
 using std::cerr;
 using std::sort;
 using std::max;
@@ -231,66 +240,203 @@ void SamElement::for_each_cigar(const function<void(char type, uint32_t length)>
 }
 
 
-void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f){
-    ifstream file(sam_path);
+/// Parse a token from [begin,end) as an unsigned integer, throwing if it isn't one
+template <class T> T parse_sam_integer(const char* begin, const char* end, const char* field_name){
+    T value;
+    auto [ptr, error] = std::from_chars(begin, end, value);
 
-    if (not file.is_open() or not file.good()){
-        throw runtime_error("ERROR: could not read input file: " + sam_path.string());
+    if (error != std::errc() or ptr != end){
+        throw runtime_error("ERROR: could not parse " + string(field_name) + " field in SAM line: " +
+                            string(begin, end));
     }
 
-    char c;
-    size_t n_delimiters = 0;
-    int64_t n_lines = 0;
+    return value;
+}
 
-    string read_name;
-    string flag_token;
-    string ref_name;
-    string mapq_token;
 
-    char header_delimiter = '@';
+/// Parse every line in a range of SAM text, which must start at the beginning of a line and end at the end of one
+/// (or at the end of the file). Header lines are skipped. Only the first 5 fields are read (QNAME, FLAG, RNAME, POS,
+/// MAPQ). As with the BAM reader, unmapped reads ('*' in RNAME) are given an empty ref_name.
+/// \param begin
+/// \param end
+/// \param batch elements are appended to this, in the order they appear
+void parse_sam_lines(const char* begin, const char* end, vector<SamElement>& batch){
+    auto line_start = begin;
 
-    // If this is a header line, skip to the next line and increment n_lines until we are no longer on a header
-    while (file.peek() == header_delimiter){
-        cerr << string(1, char(file.peek())) << '\n';
-        file.ignore(numeric_limits<streamsize>::max(), '\n');
-        n_lines++;
-    }
+    while (line_start < end){
+        auto line_end = static_cast<const char*>(memchr(line_start, '\n', end - line_start));
 
-    while (file.get(c)){
-        if (c == '\n'){
-            n_delimiters = 0;
+        if (line_end == nullptr){
+            line_end = end;
+        }
 
-            SamElement e(read_name, ref_name, int16_t(stoi(flag_token)), int8_t(stoi(mapq_token)));
+        auto next_line = line_end + 1;
 
-            f(e);
+        // Tolerate CRLF line endings
+        if (line_end > line_start and *(line_end - 1) == '\r'){
+            line_end--;
+        }
+
+        if (line_end == line_start or *line_start == '@'){
+            line_start = next_line;
+            continue;
+        }
+
+        // Find the bounds of the first 5 fields
+        array <const char*, 6> bounds;
+        bounds[0] = line_start;
+
+        for (size_t i=1; i<bounds.size(); i++){
+            auto tab = static_cast<const char*>(memchr(bounds[i-1], '\t', line_end - bounds[i-1]));
+
+            if (tab == nullptr){
+                // The 5th field may be the last one on the line
+                if (i == bounds.size() - 1){
+                    bounds[i] = line_end + 1;
+                    break;
+                }
+
+                throw runtime_error("ERROR: SAM line has fewer than 5 fields: " + string(line_start, line_end));
+            }
 
-            read_name.clear();
-            flag_token.clear();
-            ref_name.clear();
-            mapq_token.clear();
+            bounds[i] = tab + 1;
+        }
+
+        auto& e = batch.emplace_back();
 
-            n_lines++;
+        e.query_name.assign(bounds[0], bounds[1] - 1);
+        e.flag = parse_sam_integer<uint16_t>(bounds[1], bounds[2] - 1, "FLAG");
+
+        if (not (bounds[3] - 1 - bounds[2] == 1 and *bounds[2] == '*')){
+            e.ref_name.assign(bounds[2], bounds[3] - 1);
         }
-        else if (c == '\t'){
-            n_delimiters++;
+
+        e.mapq = uint8_t(parse_sam_integer<uint16_t>(bounds[4], bounds[5] - 1, "MAPQ"));
+
+        line_start = next_line;
+    }
+}
+
+
+/// Fill a buffer with the next block of the file, ending at a line boundary. Any partial line at the end of the
+/// block is moved to `carry` so that it can be prepended to the next block.
+/// \return false if there is nothing left to parse
+bool read_sam_block(ifstream& file, size_t block_size, vector<char>& buffer, vector<char>& carry){
+    buffer.swap(carry);
+    carry.clear();
+
+    while (true){
+        auto prev_size = buffer.size();
+        buffer.resize(prev_size + block_size);
+        file.read(buffer.data() + prev_size, streamsize(block_size));
+        buffer.resize(prev_size + size_t(file.gcount()));
+
+        if (file.gcount() == 0 or not file){
+            // End of file, whatever remains is the final line(s)
+            return not buffer.empty();
         }
-        else{
-            if (n_delimiters == 0){
-                read_name += c;
+
+        // Find the last newline in the newly read data, lines longer than a block need more reads
+        for (size_t i=buffer.size(); i>prev_size; i--){
+            if (buffer[i-1] == '\n'){
+                carry.assign(buffer.begin() + i, buffer.end());
+                buffer.resize(i);
+                return true;
+            }
+        }
+    }
+}
+
+
+/// Read a SAM file in large blocks, split at line boundaries, and parse up to n_threads blocks concurrently. Batches
+/// are passed to f on the calling thread, one per block, in the order they appear in the file.
+/// \param sam_path
+/// \param f
+/// \param n_threads
+/// \param block_size number of bytes to read per block (lines are never split across blocks)
+void for_batch_in_sam_file(
+        path sam_path,
+        const function<void(vector<SamElement>& batch)>& f,
+        size_t n_threads,
+        size_t block_size){
+
+    ifstream file(sam_path, std::ios::binary);
+
+    if (not file.is_open() or not file.good()){
+        throw runtime_error("ERROR: could not read input file: " + sam_path.string());
+    }
+
+    n_threads = max(size_t(1), n_threads);
+
+    vector <vector<char> > buffers(n_threads);
+    vector <vector<SamElement> > batches(n_threads);
+    vector<char> carry;
+
+    bool done = false;
+
+    while (not done){
+        // Fill as many buffers as there are threads
+        size_t n_blocks = 0;
+        while (n_blocks < n_threads){
+            if (not read_sam_block(file, block_size, buffers[n_blocks], carry)){
+                done = true;
+                break;
             }
-            else if (n_delimiters == 1){
-                flag_token += c;
+            n_blocks++;
+        }
+
+        if (n_blocks == 0){
+            break;
+        }
+
+        auto parse = [&](size_t i){
+            batches[i].clear();
+            parse_sam_lines(buffers[i].data(), buffers[i].data() + buffers[i].size(), batches[i]);
+        };
+
+        if (n_blocks == 1){
+            parse(0);
+        }
+        else {
+            vector<thread> threads;
+            vector<exception_ptr> errors(n_blocks);
+
+            for (size_t i=0; i<n_blocks; i++){
+                threads.emplace_back([&, i](){
+                    try {
+                        parse(i);
+                    }
+                    catch (...){
+                        errors[i] = std::current_exception();
+                    }
+                });
             }
-            else if (n_delimiters == 2){
-                ref_name += c;
+
+            for (auto& t: threads){
+                t.join();
             }
-            else if (n_delimiters == 4){
-                mapq_token += c;
+
+            for (auto& e: errors){
+                if (e){
+                    std::rethrow_exception(e);
+                }
             }
         }
+
+        for (size_t i=0; i<n_blocks; i++){
+            f(batches[i]);
+        }
     }
 }
 
+
+void for_element_in_sam_file(path sam_path, const function<void(SamElement& e)>& f, size_t n_threads){
+    for_batch_in_sam_file(sam_path, [&](vector<SamElement>& batch){
+        for (auto& e: batch){
+            f(e);
+        }
+    }, n_threads);
+}
 }
 
 
@@ -0,0 +1,234 @@
+#include "StratifiedContactMap.hpp"
+#include "edge.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+using std::numeric_limits;
+using std::runtime_error;
+using std::lower_bound;
+using std::sort;
+using std::max;
+
+
+namespace gfase {
+
+
+StratifiedContactMap::StratifiedContactMap():
+        keys(),
+        offsets(1,0),
+        mapqs(),
+        counts(),
+        pending()
+{}
+
+
+uint64_t StratifiedContactMap::pack(int32_t a, int32_t b){
+    auto e = edge(a,b);
+    return (uint64_t(uint32_t(e.first)) << 32) | uint64_t(uint32_t(e.second));
+}
+
+
+pair<int32_t,int32_t> StratifiedContactMap::unpack(uint64_t key){
+    return {int32_t(uint32_t(key >> 32)), int32_t(uint32_t(key))};
+}
+
+
+void StratifiedContactMap::update(int32_t a, int32_t b, uint8_t mapq){
+    pending.emplace_back(pack(a,b), mapq);
+
+    // Merge when the buffer is comparable in size to the columns, so that the total merge cost stays linear-ish
+    if (pending.size() >= max(min_pending_size, keys.size())){
+        merge_pending();
+    }
+}
+
+
+void StratifiedContactMap::compress(){
+    if (not pending.empty()){
+        merge_pending();
+    }
+
+    pending.shrink_to_fit();
+}
+
+
+void StratifiedContactMap::merge_pending(){
+    sort(pending.begin(), pending.end());
+
+    vector<uint64_t> merged_keys;
+    vector<uint32_t> merged_offsets;
+    vector<uint8_t> merged_mapqs;
+    vector<uint32_t> merged_counts;
+
+    merged_keys.reserve(keys.size() + pending.size());
+    merged_offsets.reserve(keys.size() + pending.size() + 1);
+    merged_mapqs.reserve(mapqs.size() + pending.size());
+    merged_counts.reserve(counts.size() + pending.size());
+
+    merged_offsets.emplace_back(0);
+
+    auto add_bucket = [&](uint8_t mapq, uint32_t count){
+        // Buckets arrive in ascending order of mapq within an edge, so only the last one can be the same
+        if (merged_mapqs.size() > merged_offsets.back() and merged_mapqs.back() == mapq){
+            merged_counts.back() += count;
+        }
+        else {
+            merged_mapqs.emplace_back(mapq);
+            merged_counts.emplace_back(count);
+        }
+    };
+
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < keys.size() or j < pending.size()){
+        uint64_t key;
+
+        if (j == pending.size() or (i < keys.size() and keys[i] <= pending[j].first)){
+            key = keys[i];
+        }
+        else {
+            key = pending[j].first;
+        }
+
+        // Existing buckets and pending updates are both sorted by mapq, so merge them in order
+        size_t b = 0;
+        size_t b_stop = 0;
+
+        if (i < keys.size() and keys[i] == key){
+            b = offsets[i];
+            b_stop = offsets[i+1];
+            i++;
+        }
+
+        while (b < b_stop or (j < pending.size() and pending[j].first == key)){
+            if (j == pending.size() or pending[j].first != key or (b < b_stop and mapqs[b] <= pending[j].second)){
+                add_bucket(mapqs[b], counts[b]);
+                b++;
+            }
+            else {
+                add_bucket(pending[j].second, 1);
+                j++;
+            }
+        }
+
+        if (merged_mapqs.size() > numeric_limits<uint32_t>::max()){
+            throw runtime_error("ERROR: too many contact buckets for StratifiedContactMap");
+        }
+
+        merged_keys.emplace_back(key);
+        merged_offsets.emplace_back(uint32_t(merged_mapqs.size()));
+    }
+
+    keys = std::move(merged_keys);
+    offsets = std::move(merged_offsets);
+    mapqs = std::move(merged_mapqs);
+    counts = std::move(merged_counts);
+
+    pending.clear();
+}
+
+
+void StratifiedContactMap::throw_if_pending() const{
+    if (not pending.empty()){
+        throw runtime_error("ERROR: StratifiedContactMap queried before compress()");
+    }
+}
+
+
+size_t StratifiedContactMap::edge_count() const{
+    throw_if_pending();
+    return keys.size();
+}
+
+
+size_t StratifiedContactMap::bucket_count() const{
+    throw_if_pending();
+    return mapqs.size();
+}
+
+
+/// Binary search for an edge
+/// \return the index of the edge, or edge_count() if it doesn't exist
+size_t StratifiedContactMap::find(int32_t a, int32_t b) const{
+    throw_if_pending();
+
+    auto key = pack(a,b);
+    auto result = lower_bound(keys.begin(), keys.end(), key);
+
+    if (result == keys.end() or *result != key){
+        return keys.size();
+    }
+
+    return size_t(result - keys.begin());
+}
+
+
+void StratifiedContactMap::for_each_edge(const function<void(const pair<int32_t,int32_t>& edge, size_t index)>& f) const{
+    throw_if_pending();
+
+    for (size_t i=0; i<keys.size(); i++){
+        f(unpack(keys[i]), i);
+    }
+}
+
+
+void StratifiedContactMap::for_each_bucket(size_t index, const function<void(uint8_t mapq, uint32_t count)>& f) const{
+    throw_if_pending();
+
+    for (size_t b=offsets.at(index); b<offsets.at(index+1); b++){
+        f(mapqs[b], counts[b]);
+    }
+}
+
+
+int64_t StratifiedContactMap::get_count(size_t index, uint8_t min_mapq) const{
+    throw_if_pending();
+
+    int64_t total = 0;
+
+    // Buckets are sorted by mapq, so iterate from the top and stop once below the threshold
+    for (size_t b=offsets.at(index+1); b>offsets.at(index); b--){
+        if (mapqs[b-1] < min_mapq){
+            break;
+        }
+        total += counts[b-1];
+    }
+
+    return total;
+}
+
+
+int64_t StratifiedContactMap::get_count(int32_t a, int32_t b, uint8_t min_mapq) const{
+    auto index = find(a,b);
+
+    if (index == keys.size()){
+        return 0;
+    }
+
+    return get_count(index, min_mapq);
+}
+
+
+void StratifiedContactMap::get_reverse_cdf(size_t index, uint8_t max_mapq, vector<int64_t>& cdf) const{
+    throw_if_pending();
+
+    cdf.clear();
+    cdf.resize(size_t(max_mapq) + 1, 0);
+
+    // Accumulate each bucket at its own mapq, then sum from the top down
+    for (size_t b=offsets.at(index); b<offsets.at(index+1); b++){
+        if (mapqs[b] <= max_mapq){
+            cdf[mapqs[b]] += counts[b];
+        }
+    }
+
+    for (size_t i=cdf.size()-1; i>0; i--){
+        cdf[i-1] += cdf[i];
+    }
+}
+
+
+}
@@ -227,6 +227,45 @@ double VectorMultiContactGraph::compute_consistency_score(int32_t id, int8_t p)
 }
 
 
+/// The consistency score of a node is linear in its partition: compute_consistency_score(id, p) == p * coefficient
+/// (alts are always assigned -p). This allows the change in score for any reassignment of the node to be computed
+/// from a single pass over its neighbors: delta = (p_new - p_old) * coefficient
+/// \param id
+/// \return coefficient
+double VectorMultiContactGraph::compute_consistency_coefficient(int32_t id) const{
+    double coefficient = 0;
+
+    const auto& n = nodes.at(id);
+
+    if (n.is_null){
+        throw runtime_error("ERROR: VectorMultiContactGraph::compute_consistency_coefficient: nonexistent node ID: " + to_string(id));
+    }
+
+    for (auto& [id_other, weight]: n.neighbors) {
+        // Skip self edges if there are any
+        if (id == id_other) {
+            continue;
+        }
+
+        coefficient += double(nodes[id_other].partition) * double(weight);
+    }
+
+    for (auto alt_id: n.alts){
+        const auto& n_alt = nodes.at(alt_id);
+
+        for (auto& [id_other,weight]: n_alt.neighbors) {
+            if (alt_id == id_other) {
+                continue;
+            }
+
+            coefficient -= double(nodes[id_other].partition) * double(weight);
+        }
+    }
+
+    return coefficient;
+}
+
+
 double VectorMultiContactGraph::compute_consistency_score(int32_t id) const{
     double score = 0;
 
@@ -301,6 +340,34 @@ double VectorMultiContactGraph::compute_total_consistency_score() const{
 }
 
 
+/// Sum the scores of all edges incident to a subset of nodes. For a connected component, this is its contribution to
+/// the total consistency score.
+/// \param ids
+/// \return score
+double VectorMultiContactGraph::compute_total_consistency_score(const vector<int32_t>& ids) const{
+    double score = 0;
+
+    for (auto id_a: ids){
+        const auto& a = nodes.at(id_a);
+
+        if (a.is_null){
+            continue;
+        }
+
+        for (auto& [id_b, weight]: a.neighbors) {
+            // Count each edge once, and skip self edges if any exist
+            if (id_b <= id_a) {
+                continue;
+            }
+
+            score += get_score(a, nodes.at(id_b), weight);
+        }
+    }
+
+    return score;
+}
+
+
 double VectorMultiContactGraph::compare_total_consistency_score(const MultiContactGraph& other_graph) const{
     double score = 0;
     double score2 = 0;
@@ -346,16 +413,17 @@ double VectorMultiContactGraph::compare_total_consistency_score(const MultiConta
 }
 
 
-void VectorMultiContactGraph::randomize_partitions(){
-    // True random number
-    std::random_device rd;
+void VectorMultiContactGraph::randomize_partitions(SplitMix64& rng){
+    vector<int32_t> ids;
+    get_node_ids(ids);
 
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,2);
+    randomize_partitions(ids, rng);
+}
 
-    for (int32_t id=0; id<nodes.size(); id++){
-        const auto& node = nodes[id];
+
+void VectorMultiContactGraph::randomize_partitions(const vector<int32_t>& ids, SplitMix64& rng){
+    for (auto id: ids){
+        const auto& node = nodes.at(id);
 
         if (node.is_null){
             continue;
@@ -364,7 +432,7 @@ void VectorMultiContactGraph::randomize_partitions(){
         int8_t p;
         if (node.has_alt()){
             // Only allow {1,-1} for known bubbles
-            p = int8_t((uniform_distribution(rng) % 2));
+            p = int8_t(rng.bounded(2));
 
             if (p == 0){
                 p = -1;
@@ -374,7 +442,7 @@ void VectorMultiContactGraph::randomize_partitions(){
         }
         else{
             // Allow {1,0,-1}
-            p = int8_t((uniform_distribution(rng) % 3) - 1);
+            p = int8_t(int(rng.bounded(3)) - 1);
 
             set_partition(id,p);
         }
@@ -424,6 +492,64 @@ void VectorMultiContactGraph::get_partitions(vector <pair <int32_t,int8_t> >& pa
 }
 
 
+void VectorMultiContactGraph::get_partitions(const vector<int32_t>& ids, vector <pair <int32_t,int8_t> >& partitions) const{
+    partitions.clear();
+
+    for (auto id: ids){
+        partitions.emplace_back(id, nodes.at(id).partition);
+    }
+}
+
+
+/// Find the connected components of the graph, considering both contact edges and alts as connections. Components are
+/// independent of each other in terms of consistency scoring, so they can be optimized separately.
+/// \param components vectors of node ids, in order of discovery
+void VectorMultiContactGraph::get_connected_components(vector <vector <int32_t> >& components) const{
+    components.clear();
+
+    vector<bool> visited(nodes.size(), false);
+    vector<int32_t> stack;
+
+    for (int32_t id=0; id<int32_t(nodes.size()); id++){
+        if (nodes[id].is_null or visited[id]){
+            continue;
+        }
+
+        components.emplace_back();
+        auto& component = components.back();
+
+        visited[id] = true;
+        stack.emplace_back(id);
+
+        while (not stack.empty()){
+            auto current_id = stack.back();
+            stack.pop_back();
+
+            component.emplace_back(current_id);
+
+            const auto& node = nodes[current_id];
+
+            for (auto& [id_other, weight]: node.neighbors){
+                if (not visited[id_other]){
+                    visited[id_other] = true;
+                    stack.emplace_back(id_other);
+                }
+            }
+
+            for (auto alt_id: node.alts){
+                if (not visited[alt_id]){
+                    visited[alt_id] = true;
+                    stack.emplace_back(alt_id);
+                }
+            }
+        }
+
+        // Keep ids in ascending order for deterministic iteration
+        sort(component.begin(), component.end());
+    }
+}
+
+
 void VectorMultiContactGraph::set_partitions(const vector <pair <int32_t,int8_t> >& partitions){
     for (const auto& [n, p]: partitions){
         set_partition(n, p);
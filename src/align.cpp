@@ -1,4 +1,10 @@
 #include "align.hpp"
+#include "Instrumentation.hpp"
+#include "OverlapMatcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
 
 namespace gfase{
 
@@ -18,12 +24,33 @@ void print_minimap_alignment_block(mm_mapopt_t& map_options, mm_idx_t* mi, mm_re
 }
 
 
+void estimate_matches_from_chain(const mm_reg1_t& region, AlignmentBlock& block){
+    // Without base-level alignment, minimap2 estimates the per-base divergence from the fraction of minimizers in the
+    // region that were anchored by the chain. If that is unavailable, fall back on the bases covered by anchors.
+    double divergence;
+    if (region.div >= 0 and region.div <= 1){
+        divergence = region.div;
+    }
+    else{
+        divergence = 1.0 - double(region.mlen) / double(max(1, region.blen));
+    }
+
+    auto n_matches = uint32_t(std::round(double(region.blen) * (1.0 - divergence)));
+
+    block.n_matches = n_matches;
+    block.n_mismatches = uint32_t(region.blen) - n_matches;
+    block.n_inserts = 0;
+    block.n_deletes = 0;
+}
+
+
 void map_sequence_pair(
         const string& target_name,
         const string& target_sequence,
         const string& query_name,
         const string& query_sequence,
-        AlignmentChain& result
+        AlignmentChain& result,
+        bool base_level
         ){
     result = {};
 
@@ -50,8 +77,11 @@ void map_sequence_pair(
     mm_set_opt("asm10", &index_options, &map_options);
 
     index_options.k = 21;
-    map_options.flag |= MM_F_CIGAR; // perform alignment
-    map_options.flag |= MM_F_EQX;
+
+    if (base_level) {
+        map_options.flag |= MM_F_CIGAR; // perform alignment
+        map_options.flag |= MM_F_EQX;
+    }
 
     mm_idx_t *mi = mm_idx_str(
             index_options.w,
@@ -80,9 +110,27 @@ void map_sequence_pair(
         for (int j = 0; j < n_reg; ++j) { // traverse hits
             mm_reg1_t *r2 = &reg[j];
 
-            assert(r2->p); // with MM_F_CIGAR, this should not be NULL
+            if (base_level) {
+                assert(r2->p); // with MM_F_CIGAR, this should not be NULL
+            }
 
-            if (r2->id == r2->parent){
+            if (r2->id == r2->parent and not base_level){
+                AlignmentBlock block(
+                        r2->rs,
+                        r2->re,
+                        r2->qs,
+                        r2->qe,
+                        0,
+                        0,
+                        0,
+                        0,
+                        r2->rev);
+
+                estimate_matches_from_chain(*r2, block);
+
+                result.chain.emplace_back(block);
+            }
+            else if (r2->id == r2->parent){
                 AlignmentBlock block(
                         r2->rs,
                         r2->re,
@@ -113,9 +161,10 @@ void map_sequence_pair(
                 }
 
                 result.chain.emplace_back(block);
-
-                free(r2->p);
             }
+
+            // Secondary hits also carry an alignment when MM_F_CIGAR is set
+            free(r2->p);
         }
         free(reg);
     }
@@ -125,100 +174,191 @@ void map_sequence_pair(
 }
 
 
+AlignmentJob::AlignmentJob(int64_t id_a, int64_t id_b, uint64_t length_a, uint64_t length_b):
+        id_a(id_a),
+        id_b(id_b),
+        length_a(length_a),
+        length_b(length_b)
+{}
+
+
+AlignmentJob::AlignmentJob():
+        id_a(-1),
+        id_b(-1),
+        length_a(0),
+        length_b(0)
+{}
+
+
+double AlignmentJob::get_cost() const{
+    return double(length_a) * double(length_b);
+}
+
+
+AlignmentScheduler::AlignmentScheduler(
+        const vector<HashResult>& candidates,
+        const HandleGraph& graph,
+        const IncrementalIdMap<string>& id_map,
+        double min_similarity):
+        jobs(),
+        job_index(0),
+        n_rejected(0)
+{
+    jobs.reserve(candidates.size());
+
+    for (auto& item: candidates){
+        auto id_a = id_map.get_id(item.a);
+        auto id_b = id_map.get_id(item.b);
+
+        uint64_t length_a = graph.get_length(graph.get_handle(id_a));
+        uint64_t length_b = graph.get_length(graph.get_handle(id_b));
+
+        double size_ratio = double(length_b) / double(length_a);
+
+        if (size_ratio < min_similarity){
+            // Don't align reads with a size_ratio that would make min_similarity impossible during alignment
+            // Occasionally needed where hash similarity is not predictive due to repetitiveness
+            n_rejected++;
+            continue;
+        }
+
+        jobs.emplace_back(id_a, id_b, length_a, length_b);
+    }
+
+    // Stable, so that the order of equal cost jobs doesn't depend on the sort implementation
+    std::stable_sort(jobs.begin(), jobs.end(), [](const AlignmentJob& a, const AlignmentJob& b){
+        return a.get_cost() > b.get_cost();
+    });
+}
+
+
+bool AlignmentScheduler::next(AlignmentJob& job){
+    auto i = job_index.fetch_add(1, std::memory_order_relaxed);
+
+    if (i >= jobs.size()){
+        return false;
+    }
+
+    job = jobs[i];
+    return true;
+}
+
+
+size_t AlignmentScheduler::size() const{
+    return jobs.size();
+}
+
+
+size_t AlignmentScheduler::get_n_rejected() const{
+    return n_rejected;
+}
+
+
+AlignmentRecord::AlignmentRecord(int32_t id_a, int32_t id_b, int32_t n_matches, int32_t length_a, int32_t length_b):
+        id_a(id_a),
+        id_b(id_b),
+        n_matches(n_matches),
+        length_a(length_a),
+        length_b(length_b)
+{}
+
+
+void build_alignment_graph(vector <vector <AlignmentRecord> >& results_per_thread, MultiContactGraph& alignment_graph){
+    vector<AlignmentRecord> results;
+
+    size_t n = 0;
+    for (auto& r: results_per_thread){
+        n += r.size();
+    }
+
+    results.reserve(n);
+
+    for (auto& r: results_per_thread){
+        results.insert(results.end(), r.begin(), r.end());
+        r = {};
+    }
+
+    // Threads finish pairs in arbitrary order, so sort to make the first of any duplicate edge deterministic
+    std::sort(results.begin(), results.end(), [](const AlignmentRecord& a, const AlignmentRecord& b){
+        return std::tie(a.id_a, a.id_b) < std::tie(b.id_a, b.id_b);
+    });
+
+    for (auto& r: results){
+        alignment_graph.try_insert_node(r.id_a);
+        alignment_graph.try_insert_node(r.id_b);
+
+        alignment_graph.set_node_coverage(r.id_a, 0);
+        alignment_graph.set_node_coverage(r.id_b, 0);
+
+        alignment_graph.try_insert_edge(r.id_a, r.id_b, r.n_matches);
+
+        alignment_graph.set_node_length(r.id_a, r.length_a);
+        alignment_graph.set_node_length(r.id_b, r.length_b);
+    }
+}
+
+
 void construct_alignment_graph(
-        const vector <HashResult>& to_be_aligned,
+        AlignmentScheduler& scheduler,
         const HandleGraph& graph,
         const IncrementalIdMap<string>& id_map,
-        MultiContactGraph& alignment_graph,
+        vector<AlignmentRecord>& results,
         double min_similarity,
-        mutex& output_mutex,
-        atomic<size_t>& global_index
+        bool chain_only,
+        double refinement_margin
 ){
 
-    size_t thread_index;
-    while (global_index < to_be_aligned.size()){
-        thread_index = global_index.fetch_add(1);
+    auto& n_alignment_pairs = Instrumentation::global().get_counter("alignment_pairs");
+    auto& n_refined_pairs = Instrumentation::global().get_counter("alignment_refinements");
 
-        AlignmentChain result;
+    AlignmentJob job;
+    while (scheduler.next(job)){
+        n_alignment_pairs.fetch_add(1, std::memory_order_relaxed);
 
-        auto& item = to_be_aligned.at(thread_index);
-        auto& target_name = item.a;
-        auto& query_name = item.b;
+        AlignmentChain result;
 
-//        output_mutex.lock();
-//        cerr << global_index << ' ' << thread_index << ' ' << target_name << ' ' << query_name << '\n';
-//        output_mutex.unlock();
+        auto target_name = id_map.get_name(job.id_a);
+        auto query_name = id_map.get_name(job.id_b);
 
-        auto seq_a = graph.get_sequence(graph.get_handle(id_map.get_id(target_name)));
-        auto seq_b = graph.get_sequence(graph.get_handle(id_map.get_id(query_name)));
+        auto seq_a = graph.get_sequence(graph.get_handle(job.id_a));
+        auto seq_b = graph.get_sequence(graph.get_handle(job.id_b));
 
         // Longer length is first
         auto length_a = seq_a.size();
         auto length_b = seq_b.size();
 
-        double size_ratio = double(length_b) / double(length_a);
+        map_sequence_pair(target_name, seq_a, query_name, seq_b, result, not chain_only);
 
-        if (size_ratio < min_similarity){
-            // Don't align reads with a size_ratio that would make min_similarity impossible during alignment
-            // Occasionally needed where hash similarity is not predictive due to repetitiveness
-            continue;
-        }
+        if (chain_only and refinement_margin > 0 and not result.empty()){
+            auto estimated_matches = min(length_a, result.get_approximate_non_overlapping_matches());
+            auto estimated_coverage = double(estimated_matches) / double(length_a);
 
-        map_sequence_pair(target_name, seq_a, query_name, seq_b, result);
+            // Only pairs whose estimate is too close to the threshold to trust are worth a base-level alignment
+            if (std::abs(estimated_coverage - min_similarity) < refinement_margin){
+                map_sequence_pair(target_name, seq_a, query_name, seq_b, result, true);
+                n_refined_pairs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
 
         result.sort_chains(true);
 
         if (not result.empty()) {
-//            output_mutex.lock();
-//
-//            cerr << target_name << ' ' << query_name << '\n';
-//            for (auto& item: result.chain) {
-//                cerr << item.get_reversal_char() << '\t' << '(' << item.ref_start << ',' << item.ref_stop << ")\t("
-//                     << item.query_start << ',' << item.query_stop << ')' << '\t' << item.get_identity() << '\n';
-//            }
-//            cerr << '\n';
-//            output_mutex.unlock();
-
             // Make sure to retain the ordering by size
-            auto id_a = int32_t(id_map.get_id(target_name));
-            auto id_b = int32_t(id_map.get_id(query_name));
+            auto id_a = int32_t(job.id_a);
+            auto id_b = int32_t(job.id_b);
 
             // Clip maximum matches to the length of the longer node
             auto total_matches = min(length_a, result.get_approximate_non_overlapping_matches());
 
             auto alignment_coverage = double(total_matches) / double(length_a);
 
-//            output_mutex.lock();
-//            cerr << "total_matches: " << total_matches << '\n';
-//            cerr << "alignment_coverage: " << alignment_coverage << '\n';
-//            cerr << "length_a: " << length_a << '\n';
-//            cerr << "length_b: " << length_b << '\n';
-//            output_mutex.unlock();
-
             if (alignment_coverage < min_similarity){
                 // Skip alignments which don't have at least min_similarity matches relative to larger node
 //                cerr << "Skipping alignment with insufficient matches: " << target_name << ',' << query_name << '\n';
                 continue;
             }
 
-            output_mutex.lock();
-
-            // Update the graph
-            alignment_graph.try_insert_node(id_a);
-            alignment_graph.try_insert_node(id_b);
-
-            alignment_graph.set_node_coverage(id_a, 0);
-            alignment_graph.set_node_coverage(id_b, 0);
-
-            alignment_graph.try_insert_edge(id_a, id_b, total_matches);
-
-            alignment_graph.set_node_length(id_a, length_a);
-            alignment_graph.set_node_length(id_b, length_b);
-
-//            cerr << "adding alignment: " << target_name << ',' << query_name << ',' << length_a << ',' << length_b << ',' << total_matches << '\n';
-//            cerr << "from graph: " << alignment_graph.get_node_length(id_a) << ',' << alignment_graph.get_node_length(id_b) << '\n';
-
-            output_mutex.unlock();
+            results.emplace_back(id_a, id_b, int32_t(total_matches), int32_t(length_a), int32_t(length_b));
         }
     }
 }
@@ -254,11 +394,11 @@ void get_alignment_candidates(
             return;
         }
 
-        auto seq_a = graph.get_sequence(graph.get_handle(id_map.get_id(a)));
-        auto seq_b = graph.get_sequence(graph.get_handle(id_map.get_id(b)));
+        auto length_a = graph.get_length(graph.get_handle(id_map.get_id(a)));
+        auto length_b = graph.get_length(graph.get_handle(id_map.get_id(b)));
 
         pair<string,string> ordered_pair;
-        if (seq_a.size() > seq_b.size()){
+        if (length_a > length_b){
             ordered_pair = {a,b};
 
             auto& result = ordered_pairs[ordered_pair];
@@ -284,17 +424,30 @@ void get_alignment_candidates(
 
     cerr << "Sorting..." << '\n' << std::flush;
 
-    // Sort by descending avg length so that v long alignments aren't last by chance, to avoid wasting CPU cycles
-    sort(to_be_aligned.begin(), to_be_aligned.end(), [&](const HashResult& a, const HashResult& b){
-        auto length_a_0 = graph.get_length(graph.get_handle(id_map.get_id(a.a)));
-        auto length_a_1 = graph.get_length(graph.get_handle(id_map.get_id(a.b)));
-        auto length_b_0 = graph.get_length(graph.get_handle(id_map.get_id(b.a)));
-        auto length_b_1 = graph.get_length(graph.get_handle(id_map.get_id(b.b)));
-        auto a_avg = (length_a_0 + length_a_1) / 2;
-        auto b_avg = (length_b_0 + length_b_1) / 2;
-        return a_avg > b_avg;
+    // Sort by descending avg length so that the candidate list (and overlaps output) has a reproducible order. The
+    // lengths are looked up once per candidate rather than once per comparison.
+    vector <pair <size_t, size_t> > avg_lengths;
+    avg_lengths.reserve(to_be_aligned.size());
+
+    for (size_t i=0; i<to_be_aligned.size(); i++){
+        auto length_0 = graph.get_length(graph.get_handle(id_map.get_id(to_be_aligned[i].a)));
+        auto length_1 = graph.get_length(graph.get_handle(id_map.get_id(to_be_aligned[i].b)));
+        avg_lengths.emplace_back((length_0 + length_1) / 2, i);
+    }
+
+    std::stable_sort(avg_lengths.begin(), avg_lengths.end(), [](const pair<size_t,size_t>& a, const pair<size_t,size_t>& b){
+        return a.first > b.first;
     });
 
+    vector <HashResult> sorted_candidates;
+    sorted_candidates.reserve(to_be_aligned.size());
+
+    for (auto& [length, i]: avg_lengths){
+        sorted_candidates.emplace_back(std::move(to_be_aligned[i]));
+    }
+
+    to_be_aligned = std::move(sorted_candidates);
+
 //    for (const auto& item: to_be_aligned) {
 //        auto length_a = graph.get_length(graph.get_handle(id_map.get_id(item.a)));
 //        auto length_b = graph.get_length(graph.get_handle(id_map.get_id(item.b)));
@@ -308,7 +461,6 @@ void get_alignment_candidates(
 
 void get_best_overlaps(
         double min_similarity,
-        const IncrementalIdMap<string>& id_map,
         MultiContactGraph& alignment_graph,
         MultiContactGraph& symmetrical_alignment_graph
         ){
@@ -317,137 +469,22 @@ void get_best_overlaps(
     double overflow_tolerance = 0.15;
     double first_node_penalty = 0.10;
 
-    bool symmetrical_edges_found = true;
-    while (symmetrical_edges_found){
-        sparse_hash_set <pair <int32_t, int32_t> > symmetrical_edges;
+    OverlapMatcher matcher(alignment_graph);
 
-        alignment_graph.for_each_edge_in_order_of_weight([&](const pair<int32_t,int32_t> edge, int32_t weight){
-            int32_t a;
-            int32_t b;
+    matcher.match(min_similarity, overflow_tolerance, first_node_penalty, [&](int32_t a, int32_t b, int32_t weight){
+        symmetrical_alignment_graph.try_insert_node(a);
+        symmetrical_alignment_graph.try_insert_node(b);
 
-            int32_t x = edge.first;
-            int32_t y = edge.second;
+        symmetrical_alignment_graph.set_node_length(a, alignment_graph.get_node_length(a));
+        symmetrical_alignment_graph.set_node_length(b, alignment_graph.get_node_length(b));
 
-            auto x_length = alignment_graph.get_node_length(x);
-            auto y_length = alignment_graph.get_node_length(y);
+        symmetrical_alignment_graph.try_insert_edge(a, b, weight);
 
-            int32_t a_length;
-            int32_t b_length;
+        alignment_graph.increment_coverage(a,weight);
+        alignment_graph.increment_coverage(b,weight);
 
-            if (x_length > y_length){
-                a = x;
-                b = y;
-                a_length = x_length;
-                b_length = y_length;
-            }
-            else{
-                a = y;
-                b = x;
-                a_length = y_length;
-                b_length = x_length;
-            }
-
-            auto a_coverage = alignment_graph.get_node_coverage(a);
-            auto b_coverage = alignment_graph.get_node_coverage(b);
-
-            string a_name = id_map.get_name(a);
-            string b_name = id_map.get_name(b);
-
-//            cerr << "Testing: " << a_name << ',' << b_name << '\n';
-
-            bool a_covered = double(a_coverage) >= double(a_length);
-            bool b_covered = double(b_coverage) >= double(b_length);
-
-            if (a_covered or b_covered){
-//                cerr << "skipping covered node: " << a_covered << ',' << b_covered << '\n';
-                return;
-            }
-
-            int32_t a_best_neighbor = -1;
-            int32_t a_best_value = -1;
-            int32_t b_best_neighbor = -1;
-            int32_t b_best_value = -1;
-
-//            cerr << '\t' << "-- a --" <<'\n';
-            alignment_graph.for_each_node_neighbor(a, [&](int32_t other, const MultiNode& n){
-                bool other_covered = alignment_graph.get_node_coverage(other) >= alignment_graph.get_node_length(other);
-
-                auto w = alignment_graph.get_edge_weight(a, other);
-
-                string other_name = id_map.get_name(other);
-//                cerr << '\t' << a_name << ',' << other_name << ',' << w << '\n';
-
-                if (w > a_best_value and not other_covered){
-//                    cerr << "\tbest!" << '\n';
-                    a_best_value = w;
-                    a_best_neighbor = other;
-                }
-            });
-
-//            cerr << '\t' << "-- b --" <<'\n';
-            alignment_graph.for_each_node_neighbor(b, [&](int32_t other, const MultiNode& n){
-                bool other_covered = alignment_graph.get_node_coverage(other) >= alignment_graph.get_node_length(other);
-
-                auto w = alignment_graph.get_edge_weight(b, other);
-
-                string other_name = id_map.get_name(other);
-//                cerr << '\t' << b_name << ',' << other_name << ',' << w << '\n';
-
-                if (w > b_best_value and not other_covered){
-//                    cerr << "\tbest!" << '\n';
-                    b_best_value = w;
-                    b_best_neighbor = other;
-                }
-            });
-
-            // Cheap way to check existing overlap
-            if (b_best_neighbor == a and a_best_neighbor == b){
-                auto a_cost = (a_coverage + weight) - a_length;
-                auto b_cost = (b_coverage + weight) - b_length;
-
-                // The alignment must be sane, i.e. not overhanging more than it adds for either node
-                auto a_sane = double(a_cost) < 0.5*double(weight);
-                auto b_sane = double(b_cost) < 0.5*double(weight);
-
-                // Sometimes supplementaries overlap and extend longer than the node length
-                bool a_max = double(a_coverage) + double(weight) < double(a_length)*(1.0+overflow_tolerance);
-                bool b_max = double(b_coverage) + double(weight) < double(b_length)*(1.0+overflow_tolerance);
-
-                // First node should be a significant portion of the alt's length, subsequent nodes can be smaller
-                bool a_min = double(weight) > double(a_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
-                bool b_min = double(weight) > double(b_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
-
-//                cerr << "current coverage on node a: " << a_coverage << " (length = " << a_length << ", weight = " << weight << "), weight needed = " << double(a_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty) << '\n';
-//                cerr << "current coverage on node b: " << b_coverage << " (length = " << b_length << ", weight = " << weight << "), weight needed = " << double(b_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty) << '\n';
-//                cerr << int(a_sane) << ',' << int(b_sane) << ',' << int(not a_covered) << ',' << int(not b_covered) << ',' << int(a_max) << ',' << int(b_max) << ',' << int(a_min) << ',' << int(b_min) << '\n';
-
-                if (a_sane and b_sane and a_max and b_max and a_min and b_min){
-                    symmetrical_alignment_graph.try_insert_node(a);
-                    symmetrical_alignment_graph.try_insert_node(b);
-
-                    symmetrical_alignment_graph.set_node_length(a, a_length);
-                    symmetrical_alignment_graph.set_node_length(b, b_length);
-
-                    symmetrical_alignment_graph.try_insert_edge(a, b, weight);
-
-                    alignment_graph.increment_coverage(a,weight);
-                    alignment_graph.increment_coverage(b,weight);
-
-//                    cerr << "good edge: " << a_name << ',' << b_name << '\n';
-                    symmetrical_edges.emplace(a,b);
-                }
-            }
-        });
-
-        symmetrical_edges_found = false;
-        for (auto& [a,b]: symmetrical_edges){
-            alignment_graph.remove_edge(a,b);
-            symmetrical_edges_found = true;
-//            cerr << "removing: " << id_map.get_name(a) << ',' << id_map.get_name(b) << '\n';
-        }
-
-        symmetrical_edges.clear();
-    }
+        alignment_graph.remove_edge(a,b);
+    });
 }
 
 
@@ -1,5 +1,9 @@
 #include "chain.hpp"
 
+#include <algorithm>
+
+using std::sort;
+
 namespace gfase{
 
 void generate_ploidy_criteria_from_bubble_graph(
@@ -53,9 +57,11 @@ void merge_diploid_singletons(const BubbleGraph& bubble_graph, Bipartition& chai
         }
     });
 
-    for (auto& item: to_be_merged){
-        chain_bipartition.merge_subgraphs(item.first, item.second);
-    }
+    // Merge all the pairs in one batch, in a defined order
+    vector <pair <size_t,size_t> > merges(to_be_merged.begin(), to_be_merged.end());
+    sort(merges.begin(), merges.end());
+
+    chain_bipartition.merge_subgraphs(merges);
 }
 
 
@@ -1,11 +1,16 @@
+#include "StratifiedContactMap.hpp"
 #include "MultiContactGraph.hpp"
+#include "BamScanner.hpp"
 #include "IncrementalIdMap.hpp"
 #include "Filesystem.hpp"
 #include "CLI11.hpp"
 #include "Bam.hpp"
 #include "Sam.hpp"
 
+using gfase::StratifiedContactMap;
 using gfase::MultiContactGraph;
+using gfase::ReadChainPlugin;
+using gfase::BamScanner;
 using gfase::FullAlignmentChain;
 using gfase::FullAlignmentBlock;
 using gfase::IncrementalIdMap;
@@ -19,9 +24,11 @@ using CLI::App;
 
 #include <stdexcept>
 #include <ostream>
+#include <unordered_map>
 #include <string>
 #include <map>
 
+using std::unordered_map;
 using std::runtime_error;
 using std::ifstream;
 using std::ofstream;
@@ -41,42 +48,6 @@ using std::max;
 // Gap size?
 
 
-void for_each_read_in_bam(
-        Bam& reader,
-        const function<void(const FullAlignmentChain& read_alignments)>& f
-        ){
-    size_t l = 0;
-    string prev_query_name = "";
-    FullAlignmentChain alignments;
-
-    reader.for_alignment_in_bam([&](const FullAlignmentBlock& a){
-        if (l == 0){
-            prev_query_name = a.query_name;
-        }
-
-        if (prev_query_name != a.query_name){
-            f(alignments);
-            alignments = {};
-        }
-
-        // No information about reference contig, this alignment is unusable
-        if (a.ref_name.empty()){
-            return;
-        }
-
-        alignments.chain.emplace_back(a);
-
-        l++;
-        prev_query_name = a.query_name;
-    });
-
-    // Collect final read's contacts
-    if (not alignments.empty()){
-        f(alignments);
-    }
-}
-
-
 void for_each_item_in_phase_csv(path csv_path, const function<void(const string& name, int8_t phase)>& f){
     string line;
     string name;
@@ -173,51 +144,92 @@ void Histogram::get_reverse_cdf(vector<int32_t>& cdf) const{
 }
 
 
-class StratifiedContactMap{
+/// Accumulates the contact map and the per-read statistics for evaluate_contacts, in one pass over the BAM
+class ContactEvaluationPlugin: public ReadChainPlugin{
+    const IncrementalIdMap<string>& id_map;
+
+    // Indexes of the usable alignments in the current read chain
+    vector<size_t> indexes;
+
 public:
-    unordered_map <pair <int32_t, int32_t>, Histogram> contacts;
-    unordered_map <int32_t, int8_t> partitions;
+    StratifiedContactMap contact_map;
 
-    StratifiedContactMap()=default;
-    void update(int32_t a, int32_t b, uint8_t mapq);
-    void set_partition(int32_t id, int8_t partition);
-    void for_each_edge(const function<void(const pair<int32_t,int32_t>& edge, const Histogram& weights)>& f) const;
-    int8_t get_partition(int32_t id) const;
+    Histogram subread_lengths;
+    Histogram subread_counts;
+    Histogram gap_lengths;
+    Histogram mapqs;
+
+    size_t total_alignments;
+
+    ContactEvaluationPlugin(const IncrementalIdMap<string>& id_map);
+    void process(const FullAlignmentChain& read_alignments) override;
+    void finish() override;
 };
 
 
-void StratifiedContactMap::update(int32_t a, int32_t b, uint8_t mapq){
-    auto e = edge(a,b);
+ContactEvaluationPlugin::ContactEvaluationPlugin(const IncrementalIdMap<string>& id_map):
+        id_map(id_map),
+        subread_lengths(10000000, 50),
+        subread_counts(10000, 1),
+        gap_lengths(1000000000, 10000),
+        mapqs(100, 1),
+        total_alignments(0)
+{}
 
-    auto result = contacts.find(e);
 
-    // Make a new histogram if this edge doesn't exist yet
-    if (result == contacts.end()){
-        result = contacts.emplace(e,Histogram(60,1)).first;
+void ContactEvaluationPlugin::process(const FullAlignmentChain& read_alignments){
+    indexes.clear();
+
+    // No information about reference contig, these alignments are unusable
+    for (size_t i=0; i<read_alignments.chain.size(); i++){
+        if (not read_alignments.chain[i].ref_name.empty()){
+            indexes.emplace_back(i);
+        }
     }
 
-    // Update the (now guaranteed to exist) histogram
-    result->second.update(mapq);
-}
+    subread_counts.update(indexes.size());
+    total_alignments += indexes.size();
 
+    // Skip processing singleton chains, but note them in the chain length distribution
+    if (indexes.size() == 1){
+        return;
+    }
 
-void StratifiedContactMap::set_partition(int32_t id, int8_t partition){
-    partitions[id] = partition;
-}
+    // Iterate one triangle of the all-by-all matrix, accumulating stats for alignments and linkages
+    for (size_t i=0; i<indexes.size(); i++){
+        auto& a = read_alignments.chain[indexes[i]];
+        auto ref_id_a = int32_t(id_map.get_id(a.ref_name));
 
+        for (size_t j=i+1; j<indexes.size(); j++) {
+            auto& b = read_alignments.chain[indexes[j]];
+            auto ref_id_b = int32_t(id_map.get_id(b.ref_name));
 
-int8_t StratifiedContactMap::get_partition(int32_t id) const{
-    return partitions.at(id);
-}
+            // Update contact map
+            auto min_mapq = min(a.mapq, b.mapq);
+            contact_map.update(ref_id_a,ref_id_b,min_mapq);
 
+            // Update gap lengths
+            if (ref_id_a == ref_id_b){
+                auto a_middle = (a.ref_stop + a.ref_start)/2;
+                auto b_middle = (b.ref_stop + b.ref_start)/2;
+                auto distance = max(a_middle,b_middle) - min(a_middle,b_middle);
 
-void StratifiedContactMap::for_each_edge(const function<void(const pair<int32_t,int32_t>& edge, const Histogram& weights)>& f) const{
-    for (auto& [e,w]: contacts){
-        f(e,w);
+                gap_lengths.update(distance);
+            }
+        }
+
+        auto length = a.query_stop - a.query_start;
+        subread_lengths.update(length);
+        mapqs.update(a.mapq);
     }
 }
 
 
+void ContactEvaluationPlugin::finish(){
+    contact_map.compress();
+}
+
+
 void evaluate_contacts(path bam_path, path phase_csv, path output_dir){
     if (exists(output_dir)){
         throw runtime_error("ERROR: output directory exists already");
@@ -226,91 +238,71 @@ void evaluate_contacts(path bam_path, path phase_csv, path output_dir){
         create_directories(output_dir);
     }
 
-    Bam reader(bam_path);
     IncrementalIdMap<string> id_map;
-    StratifiedContactMap contact_map;
-
-    reader.for_ref_in_header([&](const string& ref_name, uint32_t length){
-        id_map.try_insert(ref_name);
-    });
+    unordered_map <int32_t, int8_t> partitions;
 
-    Histogram subread_lengths(10000000, 50);
-    Histogram subread_counts(10000, 1);
-    Histogram gap_lengths(1000000000, 10000);
-    Histogram mapqs(100, 1);
+    // Only the header is read here, the records are decoded once by the scanner
+    {
+        Bam reader(bam_path);
+        reader.for_ref_in_header([&](const string& ref_name, uint32_t length){
+            id_map.try_insert(ref_name);
+        });
+    }
 
     Histogram n_consistent_contacts(60,1);
     Histogram n_inconsistent_contacts(60,1);
-    size_t total_alignments = 0;
-
-    for_each_read_in_bam(reader, [&](const FullAlignmentChain& alignments){
-        subread_counts.update(alignments.chain.size());
-        total_alignments += alignments.chain.size();
-
-        // Skip processing singleton chains, but note them in the chain length distribution
-        if (alignments.chain.size() == 1){
-            return;
-        }
 
-        // Iterate one triangle of the all-by-all matrix, accumulating stats for alignments and linkages
-        for (size_t i=0; i<alignments.chain.size(); i++){
-            auto& a = alignments.chain[i];
-            auto ref_id_a = int32_t(id_map.get_id(a.ref_name));
+    ContactEvaluationPlugin evaluation(id_map);
 
-            for (size_t j=i+1; j<alignments.chain.size(); j++) {
-                auto& b = alignments.chain[j];
-                auto ref_id_b = int32_t(id_map.get_id(b.ref_name));
+    BamScanner scanner(bam_path);
+    scanner.add_plugin(evaluation);
+    scanner.scan();
 
-                // Update contact map
-                auto min_mapq = min(a.mapq, b.mapq);
-                contact_map.update(ref_id_a,ref_id_b,min_mapq);
+    const auto& contact_map = evaluation.contact_map;
+    const auto& subread_lengths = evaluation.subread_lengths;
+    const auto& subread_counts = evaluation.subread_counts;
+    const auto& gap_lengths = evaluation.gap_lengths;
+    const auto& mapqs = evaluation.mapqs;
+    auto total_alignments = evaluation.total_alignments;
 
-                // Update gap lengths
-                if (ref_id_a == ref_id_b){
-                    auto a_middle = (a.ref_stop + a.ref_start)/2;
-                    auto b_middle = (b.ref_stop + b.ref_start)/2;
-                    auto distance = max(a_middle,b_middle) - min(a_middle,b_middle);
-
-                    gap_lengths.update(distance);
-                }
-            }
-
-            auto length = a.query_stop - a.query_start;
-            subread_lengths.update(length);
-            mapqs.update(a.mapq);
-        }
-    });
+    cerr << "Found " << contact_map.edge_count() << " edges, with " << contact_map.bucket_count() << " nonzero mapq bins" << '\n';
 
     // Read phases from CSV
     for_each_item_in_phase_csv(phase_csv, [&](const string& name, int8_t phase){
         auto id = int32_t(id_map.get_id(name));
-        contact_map.set_partition(id, phase);
+        partitions[id] = phase;
     });
 
-    // Find which edges are cross-phase or not
-    contact_map.for_each_edge([&](const pair<int32_t,int32_t> e, const Histogram& weights){
-        auto p_a = contact_map.get_partition(e.first);
-        auto p_b = contact_map.get_partition(e.second);
+    // Find which edges are cross-phase or not. The sum of the per-edge reverse CDFs is the reverse CDF of the summed
+    // mapq frequencies, so only the totals per mapq need to be accumulated here.
+    Histogram consistent_mapqs(60,1);
+    Histogram inconsistent_mapqs(60,1);
 
-        vector<int32_t> reverse_cdf;
-        weights.get_reverse_cdf(reverse_cdf);
+    contact_map.for_each_edge([&](const pair<int32_t,int32_t>& e, size_t index){
+        auto p_a = partitions.at(e.first);
+        auto p_b = partitions.at(e.second);
 
         if ((p_a != 0) and (p_b != 0)){
-            if (p_a == p_b){
-                for (size_t i=0; i<reverse_cdf.size(); i++) {
-                    n_consistent_contacts.update(i, reverse_cdf[i]);
-                }
-            }
-            else{
-                for (size_t i=0; i<reverse_cdf.size(); i++) {
-                    n_inconsistent_contacts.update(i, reverse_cdf[i]);
-                }
-                auto a_name = id_map.get_name(e.first);
-                auto b_name = id_map.get_name(e.second);
-            }
+            auto& mapqs_of_type = (p_a == p_b) ? consistent_mapqs : inconsistent_mapqs;
+
+            contact_map.for_each_bucket(index, [&](uint8_t mapq, uint32_t count){
+                mapqs_of_type.update(mapq, int32_t(count));
+            });
         }
     });
 
+    vector<int32_t> reverse_cdf;
+
+    consistent_mapqs.get_reverse_cdf(reverse_cdf);
+    for (size_t i=0; i<reverse_cdf.size(); i++) {
+        n_consistent_contacts.update(i, reverse_cdf[i]);
+    }
+
+    inconsistent_mapqs.get_reverse_cdf(reverse_cdf);
+    for (size_t i=0; i<reverse_cdf.size(); i++) {
+        n_inconsistent_contacts.update(i, reverse_cdf[i]);
+    }
+
     path output_path;
 
     output_path = output_dir / "subread_lengths.csv";
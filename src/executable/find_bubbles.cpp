@@ -26,12 +26,13 @@ using handlegraph::path_handle_t;
 using handlegraph::step_handle_t;
 using handlegraph::handle_t;
 
+using std::to_string;
 using std::string;
 using std::cout;
 using std::cerr;
 
 
-void find_bubbles_in_gfa(path output_dir, path gfa_path){
+void find_bubbles_in_gfa(path output_dir, path gfa_path, size_t n_threads){
     if (exists(output_dir)){
         throw runtime_error("ERROR: output directory exists already");
     }
@@ -45,7 +46,7 @@ void find_bubbles_in_gfa(path output_dir, path gfa_path){
 
     gfa_to_handle_graph(graph, id_map, overlaps, gfa_path, false);
 
-    BubbleGraph bubble_graph(graph);
+    BubbleGraph bubble_graph(graph, n_threads);
 
     path output_path = output_dir / "bubbles.csv";
     bubble_graph.write_bandage_csv(output_path, id_map);
@@ -55,6 +56,7 @@ void find_bubbles_in_gfa(path output_dir, path gfa_path){
 int main (int argc, char* argv[]){
     path gfa_path;
     path output_dir;
+    size_t n_threads = 1;
 
     CLI::App app{"App description"};
 
@@ -70,10 +72,15 @@ int main (int argc, char* argv[]){
             "Path to (nonexistent) directory where output will be stored")
             ->required();
 
+    app.add_option(
+            "-t,--threads",
+            n_threads,
+            "(Default = " + to_string(n_threads) + ")\tMaximum number of threads to use");
+
 
     CLI11_PARSE(app, argc, argv);
 
-    find_bubbles_in_gfa(output_dir, gfa_path);
+    find_bubbles_in_gfa(output_dir, gfa_path, n_threads);
 
     return 0;
 }
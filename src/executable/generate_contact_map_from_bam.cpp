@@ -1,3 +1,4 @@
+#include "BamScanner.hpp"
 #include "BubbleGraph.hpp"
 #include "IncrementalIdMap.hpp"
 #include "Filesystem.hpp"
@@ -5,6 +6,9 @@
 #include "Sam.hpp"
 #include "Bam.hpp"
 
+using gfase::StratifiedContactPlugin;
+using gfase::MapqDistributionPlugin;
+using gfase::BamScanner;
 using gfase::BubbleGraph;
 using gfase::IncrementalIdMap;
 using gfase::unpaired_mappings_t;
@@ -24,86 +28,9 @@ using std::cerr;
 using std::min;
 using std::map;
 
-using weighted_contact_map_t = sparse_hash_map <int32_t, sparse_hash_map<int32_t, map <uint8_t, int32_t> > >;
 using mappings_per_read_t = sparse_hash_map <string, map <size_t, map <uint8_t, int64_t> > >;
 
 
-void update_contact_map(
-        vector<SamElement>& alignments,
-        weighted_contact_map_t& contact_map,
-        IncrementalIdMap<string>& id_map){
-
-    // Iterate one triangle of the all-by-all matrix, adding up mapqs for reads on both end of the pair
-    for (size_t i=0; i<alignments.size(); i++){
-//        cerr << alignments[i] << '\n';
-
-        for (size_t j=i+1; j<alignments.size(); j++) {
-            auto& a = alignments[i];
-            auto& b = alignments[j];
-
-            auto ref_id_a = id_map.try_insert(a.ref_name);
-            auto ref_id_b = id_map.try_insert(b.ref_name);
-
-            // TODO: split left and right mapq?
-            contact_map[ref_id_a][ref_id_b][min(a.mapq,b.mapq)]++;
-            contact_map[ref_id_b][ref_id_a][min(a.mapq,b.mapq)]++;
-        }
-    }
-}
-
-
-void parse_unpaired_bam_file(
-        path bam_path,
-        weighted_contact_map_t& contact_map,
-        IncrementalIdMap<string>& id_map,
-        string required_prefix,
-        int8_t min_mapq){
-
-    Bam reader(bam_path);
-
-    size_t l = 0;
-    string prev_query_name = "";
-    vector<SamElement> alignments;
-
-    reader.for_alignment_in_bam(false, [&](const SamElement& a){
-        if (l == 0){
-            prev_query_name = a.query_name;
-        }
-
-        if (prev_query_name != a.query_name){
-            if (alignments.size() > 1){
-                update_contact_map(alignments, contact_map, id_map);
-            }
-            alignments.clear();
-        }
-
-        // No information about reference contig, this alignment is unusable
-        if (a.ref_name.empty()){
-            return;
-        }
-
-        bool valid_prefix = true;
-        if (not required_prefix.empty()){
-            for (size_t i=0; i<required_prefix.size(); i++){
-                if (a.ref_name[i] != required_prefix[i]){
-                    valid_prefix = false;
-                    break;
-                }
-            }
-        }
-
-        if (valid_prefix) {
-            if (a.mapq >= min_mapq and a.is_primary()) {
-                alignments.emplace_back(a);
-            }
-        }
-
-        l++;
-        prev_query_name = a.query_name;
-    });
-}
-
-
 void remove_singleton_reads(unpaired_mappings_t& mappings){
     vector<string> to_be_deleted;
     for (auto& [name,elements]: mappings){
@@ -120,35 +47,6 @@ void remove_singleton_reads(unpaired_mappings_t& mappings){
 }
 
 
-void write_contact_map(
-        path output_path,
-        const weighted_contact_map_t& contact_map,
-        const IncrementalIdMap<string>& id_map){
-    ofstream output_file(output_path);
-
-    if (not output_file.is_open() or not output_file.good()){
-        throw std::runtime_error("ERROR: could not write to file: " + output_path.string());
-    }
-
-    for (const auto& [id,map2]: contact_map){
-        for (const auto& [id2,map3]: map2){
-            output_file << id_map.get_name(id) << ',' << id_map.get_name(id2) << ',';
-
-            auto max_key = map3.rbegin()->first;
-
-            for (const auto& [q,count]: map3) {
-                 output_file << int(q) << ':' << count;
-
-                 if (q != max_key){
-                    output_file << ' ';
-                 }
-            }
-            output_file << '\n';
-        }
-    }
-}
-
-
 void generate_contact_map_from_bam(path output_dir, path sam_path, path gfa_path, string required_prefix, int8_t min_mapq, size_t n_threads){
     if (exists(output_dir)){
         throw runtime_error("ERROR: output directory exists already");
@@ -157,24 +55,25 @@ void generate_contact_map_from_bam(path output_dir, path sam_path, path gfa_path
         create_directories(output_dir);
     }
 
-    // Id-to-name bimap for reference contigs
-    IncrementalIdMap<string> id_map(false);
-
-    // Datastructures to represent linkages from hiC
-    weighted_contact_map_t contact_map;
-    vector <vector <int32_t> > adjacency;
+    // Datastructures to represent linkages from hiC, and the mapq distribution of the same alignments
+    StratifiedContactPlugin contacts(required_prefix, min_mapq);
+    MapqDistributionPlugin mapq_distribution(false);
 
     cerr << "Loading alignments as contact map..." << '\n';
 
     if (sam_path.extension() == ".bam"){
-        parse_unpaired_bam_file(sam_path, contact_map, id_map, required_prefix, min_mapq);
+        // Both are computed concurrently from a single pass over the BAM
+        BamScanner scanner(sam_path);
+        scanner.add_plugin(contacts);
+        scanner.add_plugin(mapq_distribution);
+        scanner.scan();
     }
     else{
         throw runtime_error("ERROR: unrecognized extension for SAM/BAM input file: " + sam_path.extension().string());
     }
 
-    path output_path = output_dir / "contacts.csv";
-    write_contact_map(output_path, contact_map, id_map);
+    contacts.write_to_csv(output_dir / "contacts.csv");
+    mapq_distribution.write_to_csv(output_dir / "mapq_distribution.csv");
 }
 
 
@@ -1,11 +1,12 @@
 #include "Filesystem.hpp"
 #include "CLI11.hpp"
-#include "Bam.hpp"
+#include "BamScanner.hpp"
 #include "Sam.hpp"
 
 using gfase::for_element_in_sam_file;
 using gfase::SamElement;
-using gfase::Bam;
+using gfase::MapqDistributionPlugin;
+using gfase::BamScanner;
 
 using ghc::filesystem::path;
 using CLI::App;
@@ -22,24 +23,21 @@ using std::string;
 using std::map;
 
 
-void get_mapq_distribution(path sam_path){
-    map<int8_t,size_t> distribution;
+void get_mapq_distribution(path sam_path, size_t n_threads){
+    // The BAM input counts all alignments, the SAM input counts only primary alignments
+    MapqDistributionPlugin mapq_distribution(false);
 
     if (sam_path.extension() == ".sam") {
         for_element_in_sam_file(sam_path, [&](SamElement& e) {
             if (not e.is_not_primary()) {
-                distribution[e.mapq]++;
+                mapq_distribution.distribution[e.mapq]++;
             }
-        });
+        }, n_threads);
     }
     else if (sam_path.extension() == ".bam"){
-        Bam reader(sam_path);
-
-        size_t l = 0;
-        reader.for_alignment_in_bam(false, [&](SamElement& a) {
-            distribution[int8_t(a.mapq)]++;
-            l++;
-        });
+        BamScanner scanner(sam_path);
+        scanner.add_plugin(mapq_distribution);
+        scanner.scan();
     }
     else{
         throw runtime_error("ERROR: file format not bam or sam: " + sam_path.string());
@@ -48,20 +46,13 @@ void get_mapq_distribution(path sam_path){
     path output_path = sam_path;
     output_path.replace_extension("mapq_distribution.csv");
 
-    ofstream file(output_path);
-
-    if ((not file.is_open()) or (not file.good())){
-        throw runtime_error("ERROR: file could not be written: " + output_path.string());
-    }
-
-    for (auto& [key, frequency]: distribution){
-        file << int(key) << ',' << frequency << '\n';
-    }
+    mapq_distribution.write_to_csv(output_path);
 }
 
 
 int main (int argc, char* argv[]){
     path sam_path;
+    size_t n_threads = 1;
 
     CLI::App app{"App description"};
 
@@ -71,9 +62,14 @@ int main (int argc, char* argv[]){
             "Path to SAM containing filtered, paired HiC reads")
             ->required();
 
+    app.add_option(
+            "-t,--threads",
+            n_threads,
+            "Maximum number of threads to use for parsing SAM");
+
     CLI11_PARSE(app, argc, argv);
 
-    get_mapq_distribution(sam_path);
+    get_mapq_distribution(sam_path, n_threads);
 
     return 0;
 }
@@ -1,4 +1,5 @@
 #include "IncrementalIdMap.hpp"
+#include "PackedSequenceGraph.hpp"
 #include "gfa_to_handle.hpp"
 #include "graph_utility.hpp"
 #include "BubbleGraph.hpp"
@@ -10,6 +11,7 @@
 #include "chain.hpp"
 #include "Sam.hpp"
 #include "Bam.hpp"
+#include "Random.hpp"
 
 using gfase::for_element_in_sam_file;
 using gfase::unpaired_mappings_t;
@@ -18,6 +20,7 @@ using gfase::contact_map_t;
 
 using gfase::gfa_to_handle_graph;
 using gfase::IncrementalIdMap;
+using gfase::PackedSequenceGraph;
 using gfase::chain_phased_gfa;
 using gfase::Bipartition;
 using gfase::BubbleGraph;
@@ -25,6 +28,7 @@ using gfase::SamElement;
 using gfase::Bubble;
 using gfase::Timer;
 using gfase::Bam;
+using gfase::generate_seed;
 
 using bdsg::HashGraph;
 
@@ -74,9 +78,6 @@ using std::ref;
 using std::set;
 
 
-using weighted_contact_map_t = sparse_hash_map <int32_t, sparse_hash_map<int32_t, map <uint8_t, int32_t> > >;
-
-
 void print_mappings(const unpaired_mappings_t& mappings){
     for (const auto& [name,elements]: mappings){
         cerr << '\n';
@@ -114,20 +115,20 @@ void update_contact_map(
 }
 
 
-void parse_unpaired_bam_file(
-        path bam_path,
+/// Alignments must be grouped by read name. SAM input is parsed in parallel blocks, BAM input is read serially.
+void parse_unpaired_alignment_file(
+        path alignment_path,
         contact_map_t& contact_map,
         IncrementalIdMap<string>& id_map,
         string required_prefix,
-        int8_t min_mapq){
-
-    Bam reader(bam_path);
+        int8_t min_mapq,
+        size_t n_threads){
 
     size_t l = 0;
     string prev_query_name = "";
     vector<SamElement> alignments;
 
-    reader.for_alignment_in_bam(false, [&](const SamElement& a){
+    auto f = [&](const SamElement& a){
         if (l == 0){
             prev_query_name = a.query_name;
         }
@@ -162,7 +163,15 @@ void parse_unpaired_bam_file(
 
         l++;
         prev_query_name = a.query_name;
-    });
+    };
+
+    if (alignment_path.extension() == ".sam"){
+        for_element_in_sam_file(alignment_path, f, n_threads);
+    }
+    else {
+        Bam reader(alignment_path);
+        reader.for_alignment_in_bam(false, f);
+    }
 }
 
 
@@ -190,7 +199,8 @@ void write_config(
         path sam_path,
         string required_prefix,
         int8_t min_mapq,
-        size_t n_threads){
+        size_t n_threads,
+        uint64_t seed){
 
     path output_path = output_dir / "config.csv";
     ofstream file(output_path);
@@ -203,10 +213,19 @@ void write_config(
     file << "required_prefix" << ',' << required_prefix << '\n';
     file << "min_mapq" << ',' << int(min_mapq) << '\n';
     file << "n_threads" << ',' << n_threads << '\n';
+    file << "seed" << ',' << seed << '\n';
 }
 
 
-void phase_hic(path output_dir, path sam_path, path gfa_path, string required_prefix, int8_t min_mapq, size_t n_threads){
+void phase_hic(
+        path output_dir,
+        path sam_path,
+        path gfa_path,
+        string required_prefix,
+        int8_t min_mapq,
+        size_t n_threads,
+        uint64_t seed){
+
     Timer t;
 
     if (exists(output_dir)){
@@ -216,7 +235,9 @@ void phase_hic(path output_dir, path sam_path, path gfa_path, string required_pr
         create_directories(output_dir);
     }
 
-    write_config(output_dir, sam_path, required_prefix, min_mapq, n_threads);
+    write_config(output_dir, sam_path, required_prefix, min_mapq, n_threads, seed);
+
+    cerr << "Using seed: " << seed << '\n';
 
     // Id-to-name bimap for reference contigs
     IncrementalIdMap<string> id_map(false);
@@ -227,14 +248,14 @@ void phase_hic(path output_dir, path sam_path, path gfa_path, string required_pr
 
     cerr << t << "Loading alignments as contact map..." << '\n';
 
-    if (sam_path.extension() == ".bam"){
-        parse_unpaired_bam_file(sam_path, contact_map, id_map, required_prefix, min_mapq);
+    if (sam_path.extension() == ".bam" or sam_path.extension() == ".sam"){
+        parse_unpaired_alignment_file(sam_path, contact_map, id_map, required_prefix, min_mapq, n_threads);
     }
     else{
-        throw runtime_error("ERROR: unrecognized extension for BAM input file: " + sam_path.extension().string());
+        throw runtime_error("ERROR: unrecognized extension for SAM/BAM input file: " + sam_path.extension().string());
     }
 
-    HashGraph graph;
+    PackedSequenceGraph graph;
     // The overlaps between sequences in the GFA
     Overlaps overlaps;
 
@@ -261,7 +282,7 @@ void phase_hic(path output_dir, path sam_path, path gfa_path, string required_pr
 
     cerr << t << "Phasing " << bubble_graph.size() << " bubbles" << '\n';
 
-    phase_contacts(contact_map, id_map, bubble_graph, n_threads);
+    phase_contacts(contact_map, id_map, bubble_graph, n_threads, seed);
 
     cerr << t << "Writing phasing results to file... " << '\n';
 
@@ -287,6 +308,7 @@ int main (int argc, char* argv[]){
     string required_prefix;
     int8_t min_mapq = 0;
     size_t n_threads = 1;
+    uint64_t seed = generate_seed();
 
     CLI::App app{"App description"};
 
@@ -322,9 +344,14 @@ int main (int argc, char* argv[]){
             n_threads,
             "Maximum number of threads to use");
 
+    app.add_option(
+            "--seed",
+            seed,
+            "Seed for the phase search (default is random). Results are only reproducible with a fixed seed and a single thread");
+
     CLI11_PARSE(app, argc, argv);
 
-    phase_hic(output_dir, sam_path, gfa_path, required_prefix, min_mapq, n_threads);
+    phase_hic(output_dir, sam_path, gfa_path, required_prefix, min_mapq, n_threads, seed);
 
     return 0;
 }
@@ -1,5 +1,6 @@
 #include "MultiContactGraph.hpp"
 #include "IncrementalIdMap.hpp"
+#include "PackedSequenceGraph.hpp"
 #include "Sequence.hpp"
 #include "gfa_to_handle.hpp"
 #include "handle_to_gfa.hpp"
@@ -15,6 +16,9 @@
 #include "align.hpp"
 #include "Sam.hpp"
 #include "Bam.hpp"
+#include "BamScanner.hpp"
+#include "Random.hpp"
+#include "Instrumentation.hpp"
 
 using gfase::for_element_in_sam_file;
 using gfase::contact_map_t;
@@ -22,9 +26,15 @@ using gfase::unzip;
 
 using gfase::NonBipartiteEdgeException;
 using gfase::construct_alignment_graph;
+using gfase::for_each_job_in_parallel;
+using gfase::AdjacencyIndex;
+using gfase::AlignmentScheduler;
+using gfase::AlignmentRecord;
+using gfase::build_alignment_graph;
 using gfase::gfa_to_handle_graph;
 using gfase::handle_graph_to_gfa;
 using gfase::HamiltonianChainer;
+using gfase::PackedSequenceGraph;
 using gfase::MultiContactGraph;
 using gfase::IncrementalIdMap;
 using gfase::AbstractChainer;
@@ -35,6 +45,12 @@ using gfase::Hasher2;
 using gfase::Chainer;
 using gfase::Timer;
 using gfase::Bam;
+using gfase::ContactGraphPlugin;
+using gfase::MapqDistributionPlugin;
+using gfase::BamScanner;
+using gfase::generate_seed;
+using gfase::Instrumentation;
+using gfase::ScopedSpan;
 
 using bdsg::HashGraph;
 
@@ -87,73 +103,23 @@ using std::ref;
 using std::set;
 
 
-using weighted_contact_map_t = sparse_hash_map <int32_t, sparse_hash_map<int32_t, map <uint8_t, int32_t> > >;
-
-
-void update_contact_map(
-        vector<SamElement>& alignments,
-        contact_map_t& contact_map,
-        IncrementalIdMap<string>& id_map){
-
-    // Iterate one triangle of the all-by-all matrix, adding up mapqs for reads on both end of the pair
-    for (size_t i=0; i<alignments.size(); i++){
-//        cerr << alignments[i] << '\n';
-
-        for (size_t j=i+1; j<alignments.size(); j++) {
-            auto& a = alignments[i];
-            auto& b = alignments[j];
-
-            auto ref_id_a = id_map.try_insert(a.ref_name);
-            auto ref_id_b = id_map.try_insert(b.ref_name);
-
-            // TODO: split left and right mapq instead of taking min?
-            contact_map[ref_id_a][ref_id_b]++;
-            contact_map[ref_id_b][ref_id_a]++;
-        }
-    }
-}
-
-
+/// Build the contact graph from a BAM, and collect QC stats from the same pass
 void parse_unpaired_bam_file(
         path bam_path,
+        path output_dir,
         MultiContactGraph& contact_graph,
         IncrementalIdMap<string>& id_map,
         int8_t min_mapq){
 
-    Bam reader(bam_path);
-
-    size_t l = 0;
-    string prev_query_name = "";
-    vector<SamElement> alignments;
-
-    reader.for_alignment_in_bam(false, [&](const SamElement& a){
-        if (l == 0){
-            prev_query_name = a.query_name;
-        }
-
-        if (prev_query_name != a.query_name){
-            update_contact_map(alignments, contact_graph, id_map);
-            alignments.clear();
-        }
-
-        // No information about reference contig, this alignment is unusable
-        if (a.ref_name.empty()){
-            return;
-        }
-
-        // Only allow reads with mapq > min_mapq and not secondary
-        if (a.mapq >= min_mapq and a.is_primary()) {
-            alignments.emplace_back(a);
-        }
+    ContactGraphPlugin contact_graph_plugin(contact_graph, id_map, "", min_mapq);
+    MapqDistributionPlugin mapq_distribution(true);
 
-        l++;
-        prev_query_name = a.query_name;
-    });
+    BamScanner scanner(bam_path);
+    scanner.add_plugin(contact_graph_plugin);
+    scanner.add_plugin(mapq_distribution);
+    scanner.scan();
 
-    // Collect final read's contacts
-    if (not alignments.empty()){
-        update_contact_map(alignments, contact_graph, id_map);
-    }
+    mapq_distribution.write_to_csv(output_dir / "mapq_distribution.csv");
 }
 
 
@@ -183,7 +149,8 @@ void write_config(
         size_t core_iterations,
         size_t sample_size,
         size_t n_rounds,
-        size_t n_threads){
+        size_t n_threads,
+        uint64_t seed){
 
     path output_path = output_dir / "config.csv";
     ofstream file(output_path);
@@ -199,6 +166,7 @@ void write_config(
     file << "sample_size" << ',' << int(min_mapq) << '\n';
     file << "n_rounds" << ',' << int(min_mapq) << '\n';
     file << "n_threads" << ',' << n_threads << '\n';
+    file << "seed" << ',' << seed << '\n';
 }
 
 
@@ -215,7 +183,7 @@ void write_gfa_to_file(PathHandleGraph& graph, IncrementalIdMap<string>& id_map,
 
 
 void write_nodes_to_fasta(
-        const HandleGraph& graph,
+        const PackedSequenceGraph& graph,
         const IncrementalIdMap<string>& id_map,
         const MultiContactGraph& contact_graph,
         const AbstractChainer& chainer,
@@ -242,6 +210,9 @@ void write_nodes_to_fasta(
         throw runtime_error("ERROR: file could not be written: " + unphased_fasta_path.string());
     }
 
+    // Reused for decoding each packed sequence
+    string sequence;
+
     graph.for_each_handle([&](const handle_t& h){
         auto id = graph.get_id(h);
         auto name = id_map.get_name(id);
@@ -265,17 +236,20 @@ void write_nodes_to_fasta(
             throw runtime_error("ERROR: node in both phase chains and contact graph: " + name);
         }
 
+        sequence.clear();
+        graph.decode_sequence(h, sequence);
+
         if (partition == -1){
             phase_0_fasta << '>' << name << '\n';
-            phase_0_fasta << graph.get_sequence(h) << '\n';
+            phase_0_fasta << sequence << '\n';
         }
         else if (partition == 1){
             phase_1_fasta << '>' << name << '\n';
-            phase_1_fasta << graph.get_sequence(h) << '\n';
+            phase_1_fasta << sequence << '\n';
         }
         else{
             unphased_fasta << '>' << name << '\n';
-            unphased_fasta << graph.get_sequence(h) << '\n';
+            unphased_fasta << sequence << '\n';
         }
     });
 }
@@ -284,28 +258,39 @@ void write_nodes_to_fasta(
 void remove_adjacencies_from_candidates(
         HandleGraph& graph,
         const IncrementalIdMap<string>& id_map,
-        vector<HashResult>& to_be_aligned
+        vector<HashResult>& to_be_aligned,
+        size_t n_threads
         ){
 
-    vector <HashResult> valid_edges;
+    // Node ids in the graph are the same as in the id map, so the candidates can be tested by id
+    AdjacencyIndex adjacency(graph, n_threads);
+
+    vector<char> is_adjacent(to_be_aligned.size(), false);
+
+    const size_t chunk_size = 4096;
+    size_t n_chunks = (to_be_aligned.size() + chunk_size - 1) / chunk_size;
 
-    unordered_set <pair <string,string> > invalid_edges;
-    graph.for_each_edge([&](const edge_t& e){
-        auto a = id_map.get_name(graph.get_id(e.first));
-        auto b = id_map.get_name(graph.get_id(e.second));
-        invalid_edges.emplace(a, b);
-        invalid_edges.emplace(b, a);
+    for_each_job_in_parallel(n_chunks, n_threads, [&](size_t c){
+        size_t stop = min(to_be_aligned.size(), (c + 1)*chunk_size);
+
+        for (size_t i=c*chunk_size; i<stop; i++){
+            auto& item = to_be_aligned[i];
+            is_adjacent[i] = adjacency.has_edge(id_map.get_id(item.a), id_map.get_id(item.b));
+        }
     });
 
-    for (const auto& item: to_be_aligned){
-        pair <string,string> e = {item.a, item.b};
+    size_t n_valid = 0;
 
-        if (invalid_edges.count(e) == 0){
-            valid_edges.emplace_back(item);
+    for (size_t i=0; i<to_be_aligned.size(); i++){
+        if (not is_adjacent[i]){
+            if (n_valid != i){
+                to_be_aligned[n_valid] = std::move(to_be_aligned[i]);
+            }
+            n_valid++;
         }
     }
 
-    to_be_aligned = valid_edges;
+    to_be_aligned.resize(n_valid);
 }
 
 
@@ -319,7 +304,9 @@ void find_unlabeled_alts(
         double sample_rate = 0.04,
         size_t n_iterations = 6,
         size_t k = 22,
-        double min_hash_similarity = 0.7
+        double min_hash_similarity = 0.7,
+        bool chain_only = false,
+        double refinement_margin = 0
 ){
 
     // Hashing params
@@ -342,6 +329,9 @@ void find_unlabeled_alts(
 
     vector <HashResult> to_be_aligned;
 
+    auto& instrumentation = Instrumentation::global();
+    auto hash_span = instrumentation.begin_span("hash");
+
     get_alignment_candidates(
             graph,
             id_map,
@@ -361,15 +351,25 @@ void find_unlabeled_alts(
                             "rerunning with different homology args.");
     }
 
-    remove_adjacencies_from_candidates(graph, id_map, to_be_aligned);
+    remove_adjacencies_from_candidates(graph, id_map, to_be_aligned, n_threads);
+
+    instrumentation.end_span(hash_span);
+    instrumentation.set_gauge("alignment_candidates", double(to_be_aligned.size()));
+
+    auto align_span = instrumentation.begin_span("align");
 
     MultiContactGraph alignment_graph;
     MultiContactGraph symmetrical_alignment_graph;
 
+    // Pairs are resolved to ids/lengths and ordered by cost before any sequence is touched
+    AlignmentScheduler scheduler(to_be_aligned, graph, id_map, min_similarity);
+    instrumentation.set_gauge("alignment_rejected", double(scheduler.get_n_rejected()));
+
     // Thread-related variables
-    atomic<size_t> job_index = 0;
     vector<thread> threads;
-    mutex output_mutex;
+
+    // Each thread collects its own results, which are only combined into the graph at the end
+    vector <vector <AlignmentRecord> > results_per_thread(n_threads);
 
     mm_verbose = 0; // disable message output to stderr
 
@@ -378,13 +378,13 @@ void find_unlabeled_alts(
         try {
             threads.emplace_back(thread(
                     construct_alignment_graph,
-                    ref(to_be_aligned),
+                    ref(scheduler),
                     ref(graph),
                     ref(id_map),
-                    ref(alignment_graph),
+                    ref(results_per_thread[n]),
                     min_similarity,
-                    ref(output_mutex),
-                    ref(job_index)
+                    chain_only,
+                    refinement_margin
             ));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -397,9 +397,13 @@ void find_unlabeled_alts(
         n.join();
     }
 
-    get_best_overlaps(min_similarity, id_map, alignment_graph, symmetrical_alignment_graph);
+    build_alignment_graph(results_per_thread, alignment_graph);
+
+    get_best_overlaps(min_similarity, alignment_graph, symmetrical_alignment_graph);
     write_alignment_results_to_file(id_map, alignment_graph, symmetrical_alignment_graph, output_dir);
 
+    instrumentation.end_span(align_span);
+
     cerr << t << "Done" << '\n';
 
     vector <vector <int32_t> > adjacency;
@@ -433,11 +437,17 @@ void phase(
         bool use_homology,
         bool skip_unzip,
         bool use_hamiltonian_chainer,
+        bool use_parallel_tempering,
+        bool use_components,
         size_t n_threads,
+        uint64_t seed,
+        double progress_interval,
         double sample_rate = 0.04,
         size_t n_iterations = 6,
         size_t k = 22,
-        double min_hash_similarity = 0.7
+        double min_hash_similarity = 0.7,
+        bool chain_only_homology = false,
+        double homology_refinement_margin = 0
 ){
     Timer t;
 
@@ -455,13 +465,18 @@ void phase(
     path chained_gfa_path = output_dir / "chained.gfa";
     path unzipped_gfa_path = output_dir / "unzipped.gfa";
 
-    write_config(output_dir, gfa_path, contacts_path, min_mapq, core_iterations, sample_size, n_rounds, n_threads);
+    write_config(output_dir, gfa_path, contacts_path, min_mapq, core_iterations, sample_size, n_rounds, n_threads, seed);
+
+    cerr << "Using seed: " << seed << '\n';
+
+    auto& instrumentation = Instrumentation::global();
+    instrumentation.start_progress(progress_interval);
 
     // Id-to-name bimap for reference contigs
     IncrementalIdMap<string> id_map(false);
 
-    // How GFA is stored in memory
-    HashGraph graph;
+    // How GFA is stored in memory, with node sequences 2-bit packed
+    PackedSequenceGraph graph;
     
     // Overlaps between the sequences
     Overlaps overlaps;
@@ -472,16 +487,25 @@ void phase(
     // For finding and unzipping bubble chains
     unique_ptr<AbstractChainer> chainer;
     if (use_hamiltonian_chainer) {
-        chainer = unique_ptr<AbstractChainer>(new HamiltonianChainer());
+        auto hamiltonian_chainer = new HamiltonianChainer();
+        hamiltonian_chainer->n_threads = n_threads;
+        chainer = unique_ptr<AbstractChainer>(hamiltonian_chainer);
     }
     else {
-        chainer = unique_ptr<AbstractChainer>(new Chainer());
+        auto bubble_chainer = new Chainer();
+        bubble_chainer->n_threads = n_threads;
+        chainer = unique_ptr<AbstractChainer>(bubble_chainer);
     }
 
     cerr << t << "Loading GFA..." << '\n';
 
-    // Construct graph from GFA
-    gfa_to_handle_graph(graph, id_map, overlaps, gfa_path, false, true);
+    {
+        ScopedSpan span("load_gfa");
+
+        // Construct graph from GFA
+        gfa_to_handle_graph(graph, id_map, overlaps, gfa_path, false, true);
+        instrumentation.set_gauge("gfa_nodes", double(graph.get_node_count()));
+    }
 
     cerr << t << "Writing IDs to file..." << '\n';
 
@@ -489,8 +513,10 @@ void phase(
 
     cerr << t << "Loading alignments as contact map..." << '\n';
 
+    auto contacts_span = instrumentation.begin_span("load_contacts");
+
     if (contacts_path.extension() == ".bam"){
-        parse_unpaired_bam_file(contacts_path, contact_graph, id_map, min_mapq);
+        parse_unpaired_bam_file(contacts_path, output_dir, contact_graph, id_map, min_mapq);
     }
     else if (contacts_path.extension() == ".csv"){
         contact_graph = MultiContactGraph(contacts_path, id_map);
@@ -499,8 +525,11 @@ void phase(
         throw runtime_error("ERROR: unrecognized extension for contacts input file (must be BAM or CSV): " + contacts_path.extension().string());
     }
 
+    instrumentation.end_span(contacts_span);
+
     if (use_homology){
         cerr << t << "Finding alts with sequence homology..." << '\n';
+        ScopedSpan span("find_alts");
 
         find_unlabeled_alts(
                 graph,
@@ -512,7 +541,9 @@ void phase(
                 sample_rate,
                 n_iterations,
                 k,
-                min_hash_similarity
+                min_hash_similarity,
+                chain_only_homology,
+                homology_refinement_margin
         );
     }
     else{
@@ -546,8 +577,13 @@ void phase(
         throw runtime_error("ERROR: no inter-contig contacts detected in alignments, no usable phasing information");
     }
 
+    instrumentation.set_gauge("contact_graph_nodes", double(contact_graph.size()));
+    instrumentation.set_gauge("contact_graph_edges", double(contact_graph.edge_count()));
+
     cerr << t << "Optimizing phases..." << '\n';
 
+    auto optimize_span = instrumentation.begin_span("optimize_phases");
+
     monte_carlo_phase_contacts(
             contact_graph,
             id_map,
@@ -555,7 +591,12 @@ void phase(
             sample_size,
             n_rounds,
             n_threads,
-            output_dir);
+            output_dir,
+            use_parallel_tempering,
+            use_components,
+            seed);
+
+    instrumentation.end_span(optimize_span);
 
     cerr << t << "Writing phasing results to file... " << '\n';
 
@@ -564,15 +605,22 @@ void phase(
     
     cerr << t << "Chaining homologous sequences... " << '\n';
 
-    chainer->generate_chain_paths(graph, id_map, contact_graph);
-    chainer->write_chaining_results_to_bandage_csv(output_dir, id_map, contact_graph);
+    {
+        ScopedSpan span("chain");
+        chainer->generate_chain_paths(graph, id_map, contact_graph);
+        chainer->write_chaining_results_to_bandage_csv(output_dir, id_map, contact_graph);
+    }
 
     cerr << t << "Writing GFA... " << '\n';
 
-    write_gfa_to_file(graph, id_map, overlaps, chained_gfa_path);
+    {
+        ScopedSpan span("write_gfa");
+        write_gfa_to_file(graph, id_map, overlaps, chained_gfa_path);
+    }
 
     if (not skip_unzip) {
         cerr << t << "Unzipping chains... " << '\n';
+        ScopedSpan span("unzip");
 
         unzip(graph, id_map, overlaps, false, false);
         write_gfa_to_file(graph, id_map, overlaps, unzipped_gfa_path);
@@ -580,7 +628,13 @@ void phase(
 
     cerr << t << "Writing FASTA... " << '\n';
 
-    write_nodes_to_fasta(graph, id_map, contact_graph, *chainer, output_dir);
+    {
+        ScopedSpan span("write_fasta");
+        write_nodes_to_fasta(graph, id_map, contact_graph, *chainer, output_dir);
+    }
+
+    instrumentation.stop_progress();
+    instrumentation.write_report(output_dir);
 
     cerr << t << "Done" << '\n';
 }
@@ -598,10 +652,16 @@ int main (int argc, char* argv[]){
     bool use_homology = false;
     bool skip_unzip = false;
     bool use_simple_chainer = false;
+    bool use_parallel_tempering = false;
+    bool use_components = false;
+    uint64_t seed = generate_seed();
+    double progress_interval = 0;
     double sample_rate = 0.04;
     size_t n_iterations = 6;
     size_t k = 22;
     double min_hash_similarity = 0.7;
+    bool chain_only_homology = false;
+    double homology_refinement_margin = 0;
 
     CLI::App app{"App description"};
 
@@ -649,6 +709,11 @@ int main (int argc, char* argv[]){
             min_hash_similarity,
             "(Default = " + to_string(min_hash_similarity) + ")\tMinimum required hash similarity. This is computed as (A & B)/A, where A is the larger set.");
 
+    app.add_option(
+            "--homology_refinement_margin",
+            homology_refinement_margin,
+            "(Default = " + to_string(homology_refinement_margin) + ")\tWith --homology_chain_only, realign pairs at base level if their estimated alignment coverage is within this distance of the minimum.");
+
     app.add_option(
             "-c,--core_iterations",
             core_iterations,
@@ -669,16 +734,47 @@ int main (int argc, char* argv[]){
             n_threads,
             "(Default = " + to_string(n_threads) + ")\tMaximum number of threads to use.");
 
+    app.add_option(
+            "--seed",
+            seed,
+            "(Default = random)\tSeed for the phase optimizer. Results are reproducible for a given seed, independent of the number of threads. "
+            "The seed that was used is written to config.csv in the output directory.");
+
+    app.add_option(
+            "--progress_interval",
+            progress_interval,
+            "(Default = " + to_string(progress_interval) + ")\tIf greater than 0, print a progress line with the current stage and work counters every this many seconds. "
+            "A per-stage timing report (timing.json, timing.tsv) is always written to the output directory.");
+
     app.add_flag(
             "--use_homology",
             use_homology,
             "(Default = " + to_string(use_homology) + ")\tUse sequence homology to find alts. For whenever the GFA does not have Shasta node labels.");
 
+    app.add_flag(
+            "--homology_chain_only",
+            chain_only_homology,
+            "(Default = " + to_string(chain_only_homology) + ")\tMeasure homology from minimap2 chains only, without base-level alignment. Much faster for long alleles, "
+            "at the cost of approximate match counts.");
+
     app.add_flag(
             "--use_simple_chainer",
              use_simple_chainer,
             "(Default = " + to_string(use_simple_chainer) + ")\tBuild chains using only simple bubbles.");
 
+    auto tempering_flag = app.add_flag(
+            "--use_parallel_tempering",
+            use_parallel_tempering,
+            "(Default = " + to_string(use_parallel_tempering) + ")\tProduce each sample with a replica exchange (parallel tempering) search instead of greedy random restarts. "
+            "In this mode core_iterations is the number of sweeps per replica, and converges in far fewer iterations than the default optimizer.");
+
+    app.add_flag(
+            "--use_components",
+            use_components,
+            "(Default = " + to_string(use_components) + ")\tOptimize each connected component of the contact graph (edges and alts) independently, "
+            "largest first, with an iteration budget proportional to its size (up to core_iterations). Useful when the contact graph is fragmented.")
+            ->excludes(tempering_flag);
+
     app.add_flag(
             "--skip_unzip",
             skip_unzip,
@@ -698,11 +794,17 @@ int main (int argc, char* argv[]){
             use_homology,
             skip_unzip,
             !use_simple_chainer,
+            use_parallel_tempering,
+            use_components,
             n_threads,
+            seed,
+            progress_interval,
             sample_rate,
             n_iterations,
             k,
-            min_hash_similarity
+            min_hash_similarity,
+            chain_only_homology,
+            homology_refinement_margin
     );
 
     return 0;
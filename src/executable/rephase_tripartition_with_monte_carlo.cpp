@@ -14,6 +14,7 @@
 #include "CLI11.hpp"
 #include "Sam.hpp"
 #include "Bam.hpp"
+#include "Random.hpp"
 #include "minimap.h"
 
 #include "SvgPlot.hpp"
@@ -45,6 +46,7 @@ using gfase::Bubble;
 using gfase::Timer;
 using gfase::Node;
 using gfase::Bam;
+using gfase::generate_seed;
 
 using bdsg::HashGraph;
 using ghc::filesystem::path;
@@ -125,7 +127,8 @@ void rephase(
         path alignment_csv_path,
         path contacts_path,
         path output_dir,
-        size_t n_threads){
+        size_t n_threads,
+        uint64_t seed){
 
     if (exists(output_dir)){
         throw runtime_error("ERROR: output directory exists already");
@@ -147,6 +150,8 @@ void rephase(
     size_t sample_size = 30;
     size_t n_rounds = 2;
 
+    cerr << "Using seed: " << seed << '\n';
+
     monte_carlo_phase_contacts(
             contact_graph,
             id_map,
@@ -154,7 +159,10 @@ void rephase(
             sample_size,
             n_rounds,
             n_threads,
-            output_dir);
+            output_dir,
+            false,
+            false,
+            seed);
 
     path contacts_output_path = output_dir / "contacts.csv";
     path phases_output_path = output_dir / "phases.csv";
@@ -172,6 +180,7 @@ int main (int argc, char* argv[]){
     path contacts_path;
     path output_dir;
     size_t n_threads = 1;
+    uint64_t seed = generate_seed();
 
     CLI::App app{"App description"};
 
@@ -204,9 +213,14 @@ int main (int argc, char* argv[]){
             n_threads,
             "Maximum number of threads to use");
 
+    app.add_option(
+            "--seed",
+            seed,
+            "Seed for the phase optimizer (default is random). Results are reproducible for a given seed, independent of the number of threads");
+
     CLI11_PARSE(app, argc, argv);
 
-    rephase(ids_csv_path, alignment_csv_path, contacts_path, output_dir, n_threads);
+    rephase(ids_csv_path, alignment_csv_path, contacts_path, output_dir, n_threads, seed);
 
     return 0;
 }
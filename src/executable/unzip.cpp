@@ -1,4 +1,5 @@
 #include "IncrementalIdMap.hpp"
+#include "PackedSequenceGraph.hpp"
 #include "gfa_to_handle.hpp"
 #include "handle_to_gfa.hpp"
 #include "graph_utility.hpp"
@@ -11,6 +12,7 @@
 #include <string>
 
 using gfase::IncrementalIdMap;
+using gfase::PackedSequenceGraph;
 using gfase::for_each_connected_component;
 using gfase::split_connected_components;
 using gfase::handle_graph_to_gfa;
@@ -31,7 +33,7 @@ using std::cerr;
 
 
 void unzip_gfa(path gfa_path){
-    HashGraph graph;
+    PackedSequenceGraph graph;
     IncrementalIdMap<string> id_map;
     Overlaps overlaps;
 
@@ -70,7 +70,7 @@ void gfa_to_handle_graph(
         
         if (overlaps.has_overlap(graph, a, b)) {
             // check CIGAR validity
-            auto lens = overlaps.get_overlap(graph, a, b).aligned_length();
+            auto lens = overlaps.get_aligned_length(graph, a, b);
             if (malformed_cigar_warnings < malformed_cigar_warn_limit &&
                 (lens.first > graph.get_length(a) || lens.second > graph.get_length(b))) {
                 
@@ -1,5 +1,26 @@
 #include "graph_utility.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+using std::numeric_limits;
+using std::runtime_error;
+using std::exception_ptr;
+using std::lower_bound;
+using std::lock_guard;
+using std::exception;
+using std::to_string;
+using std::atomic;
+using std::thread;
+using std::mutex;
+using std::sort;
+using std::min;
+
 namespace gfase {
 
 
@@ -253,6 +274,462 @@ tuple<nid_t,nid_t,bool> try_translate_id(const HandleGraph& source_graph,
 }
 
 
+void for_each_job_in_parallel(size_t n_jobs, size_t n_threads, const function<void(size_t i)>& f){
+    atomic<size_t> job_index(0);
+    exception_ptr error;
+    mutex error_mutex;
+
+    auto worker = [&](){
+        size_t i = job_index.fetch_add(1);
+
+        while (i < n_jobs){
+            try {
+                f(i);
+            }
+            catch (...){
+                lock_guard<mutex> lock(error_mutex);
+                if (not error){
+                    error = std::current_exception();
+                }
+
+                // Skip the remaining jobs
+                job_index = n_jobs;
+                return;
+            }
+
+            i = job_index.fetch_add(1);
+        }
+    };
+
+    vector<thread> threads;
+
+    // Launch threads
+    for (size_t i=1; i<min(n_threads, n_jobs); i++){
+        try {
+            threads.emplace_back(thread(worker));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    worker();
+
+    // Wait for threads to finish
+    for (auto& t: threads){
+        t.join();
+    }
+
+    if (error){
+        std::rethrow_exception(error);
+    }
+}
+
+
+// Union-find over dense node indexes which can be updated by many threads at once. A union links the larger root under
+// the smaller one with a CAS, so the root of every set always converges on its smallest index regardless of the order
+// in which the threads interleave.
+class ConcurrentDisjointSets {
+    vector <atomic<uint32_t> > parents;
+
+public:
+    explicit ConcurrentDisjointSets(size_t size):
+            parents(size)
+    {
+        for (size_t i=0; i<size; i++){
+            parents[i].store(uint32_t(i), std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t find(uint32_t i){
+        while (true){
+            uint32_t p = parents[i].load();
+
+            if (p == i){
+                return i;
+            }
+
+            // Path halving, it doesn't matter if another thread wins the race
+            uint32_t gp = parents[p].load();
+            if (gp != p){
+                parents[i].compare_exchange_weak(p, gp);
+            }
+
+            i = gp;
+        }
+    }
+
+    void unite(uint32_t a, uint32_t b){
+        while (true){
+            a = find(a);
+            b = find(b);
+
+            if (a == b){
+                return;
+            }
+
+            if (a > b){
+                std::swap(a, b);
+            }
+
+            // Only succeeds if b is still a root, otherwise retry from the new roots
+            uint32_t expected = b;
+            if (parents[b].compare_exchange_strong(expected, a)){
+                return;
+            }
+        }
+    }
+};
+
+
+void find_connected_components(const HandleGraph& graph, vector <vector <nid_t> >& components, size_t n_threads){
+    components.clear();
+
+    vector<nid_t> ids;
+    ids.reserve(graph.get_node_count());
+
+    graph.for_each_handle([&](const handle_t& h){
+        ids.emplace_back(graph.get_id(h));
+    });
+
+    if (ids.empty()){
+        return;
+    }
+
+    if (ids.size() > numeric_limits<uint32_t>::max()){
+        throw runtime_error("ERROR: too many nodes for connected component search: " + to_string(ids.size()));
+    }
+
+    sort(ids.begin(), ids.end());
+
+    // Most graphs are loaded with consecutive ids, in which case the index is just an offset
+    bool is_contiguous = (ids.back() - ids.front() + 1 == nid_t(ids.size()));
+
+    auto get_index = [&](nid_t id){
+        if (is_contiguous){
+            return uint32_t(id - ids.front());
+        }
+        return uint32_t(lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+    };
+
+    ConcurrentDisjointSets sets(ids.size());
+
+    // Small enough to balance the load, large enough that the atomic isn't contended
+    const size_t chunk_size = 4096;
+    size_t n_chunks = (ids.size() + chunk_size - 1) / chunk_size;
+
+    // Stage 1: label. Every edge is seen from both of its ends, but only needs to be united once.
+    for_each_job_in_parallel(n_chunks, n_threads, [&](size_t c){
+        size_t stop = min(ids.size(), (c + 1)*chunk_size);
+
+        for (size_t i=c*chunk_size; i<stop; i++){
+            auto h = graph.get_handle(ids[i]);
+
+            graph.follow_edges(h, false, [&](const handle_t& other){
+                auto other_id = graph.get_id(other);
+                if (other_id > ids[i]){
+                    sets.unite(uint32_t(i), get_index(other_id));
+                }
+            });
+
+            graph.follow_edges(h, true, [&](const handle_t& other){
+                auto other_id = graph.get_id(other);
+                if (other_id > ids[i]){
+                    sets.unite(uint32_t(i), get_index(other_id));
+                }
+            });
+        }
+    });
+
+    // Stage 2: number the components in order of their roots (smallest member), then bucket the ids, which are visited
+    // in ascending order so that each component is sorted
+    vector<uint32_t> component_of(ids.size());
+    vector<size_t> sizes;
+
+    for (size_t i=0; i<ids.size(); i++){
+        auto root = sets.find(uint32_t(i));
+
+        if (root == i){
+            component_of[i] = uint32_t(sizes.size());
+            sizes.emplace_back(0);
+        }
+        else{
+            component_of[i] = component_of[root];
+        }
+
+        sizes[component_of[i]]++;
+    }
+
+    components.resize(sizes.size());
+
+    for (size_t c=0; c<sizes.size(); c++){
+        components[c].reserve(sizes[c]);
+    }
+
+    for (size_t i=0; i<ids.size(); i++){
+        components[component_of[i]].emplace_back(ids[i]);
+    }
+}
+
+
+AdjacencyIndex::AdjacencyIndex(const HandleGraph& graph, size_t n_threads):
+        is_contiguous(true)
+{
+    ids.reserve(graph.get_node_count());
+
+    graph.for_each_handle([&](const handle_t& h){
+        ids.emplace_back(graph.get_id(h));
+    });
+
+    sort(ids.begin(), ids.end());
+
+    is_contiguous = ids.empty() or (ids.back() - ids.front() + 1 == nid_t(ids.size()));
+
+    degrees.resize(ids.size(), 0);
+    offsets.resize(ids.size() + 1, 0);
+
+    const size_t chunk_size = 4096;
+    size_t n_chunks = (ids.size() + chunk_size - 1) / chunk_size;
+
+    // Stage 1: count edges on both sides of each node, which is an upper bound on its number of distinct neighbors
+    for_each_job_in_parallel(n_chunks, n_threads, [&](size_t c){
+        size_t stop = min(ids.size(), (c + 1)*chunk_size);
+
+        for (size_t i=c*chunk_size; i<stop; i++){
+            auto h = graph.get_handle(ids[i]);
+            degrees[i] = uint32_t(graph.get_degree(h, false) + graph.get_degree(h, true));
+        }
+    });
+
+    for (size_t i=0; i<ids.size(); i++){
+        offsets[i + 1] = offsets[i] + degrees[i];
+    }
+
+    neighbors.resize(offsets.back());
+
+    // Stage 2: fill, sort and deduplicate each node's range, and record how much of it is used
+    for_each_job_in_parallel(n_chunks, n_threads, [&](size_t c){
+        size_t stop = min(ids.size(), (c + 1)*chunk_size);
+
+        for (size_t i=c*chunk_size; i<stop; i++){
+            auto h = graph.get_handle(ids[i]);
+            auto begin = neighbors.begin() + offsets[i];
+            auto iter = begin;
+
+            for (bool go_left: {false, true}){
+                graph.follow_edges(h, go_left, [&](const handle_t& other){
+                    *iter = graph.get_id(other);
+                    ++iter;
+                });
+            }
+
+            sort(begin, iter);
+            degrees[i] = uint32_t(std::unique(begin, iter) - begin);
+        }
+    });
+}
+
+
+size_t AdjacencyIndex::get_index(nid_t id) const{
+    if (ids.empty() or id < ids.front() or id > ids.back()){
+        return ids.size();
+    }
+
+    if (is_contiguous){
+        return size_t(id - ids.front());
+    }
+
+    auto result = lower_bound(ids.begin(), ids.end(), id);
+
+    if (*result != id){
+        return ids.size();
+    }
+
+    return size_t(result - ids.begin());
+}
+
+
+bool AdjacencyIndex::has_node(nid_t id) const{
+    return get_index(id) < ids.size();
+}
+
+
+bool AdjacencyIndex::has_edge(nid_t a, nid_t b) const{
+    auto i = get_index(a);
+
+    if (i == ids.size()){
+        return false;
+    }
+
+    auto begin = neighbors.begin() + offsets[i];
+    auto end = begin + degrees[i];
+
+    return std::binary_search(begin, end, b);
+}
+
+
+size_t AdjacencyIndex::get_degree(nid_t id) const{
+    auto i = get_index(id);
+
+    if (i == ids.size()){
+        throw runtime_error("ERROR: node not in adjacency index: " + to_string(id));
+    }
+
+    return degrees[i];
+}
+
+
+size_t AdjacencyIndex::size() const{
+    return ids.size();
+}
+
+
+// Visit each edge that has at least one end in a component exactly once, as (left, right) in the orientation that it is
+// found from the node with the smaller id. The component must be sorted.
+static void for_each_edge_in_component(
+        const HandleGraph& graph,
+        const vector<nid_t>& component,
+        const function<void(const handle_t& handle_a, const handle_t& handle_b)>& f){
+
+    vector<edge_t> self_edges;
+
+    for (auto id: component){
+        auto h = graph.get_handle(id);
+        self_edges.clear();
+
+        auto visit = [&](const handle_t& handle_a, const handle_t& handle_b, nid_t other_id){
+            if (other_id > id){
+                f(handle_a, handle_b);
+            }
+            else if (other_id == id){
+                // A self edge can be found from both sides of the node, so it is deduplicated by its canonical form
+                auto e = graph.edge_handle(handle_a, handle_b);
+                if (std::find(self_edges.begin(), self_edges.end(), e) == self_edges.end()){
+                    self_edges.emplace_back(e);
+                    f(handle_a, handle_b);
+                }
+            }
+        };
+
+        graph.follow_edges(h, false, [&](const handle_t& next){
+            visit(h, next, graph.get_id(next));
+        });
+
+        graph.follow_edges(h, true, [&](const handle_t& prev){
+            visit(prev, h, graph.get_id(prev));
+        });
+    }
+}
+
+
+// Copy one component into a new graph, with a new id map. Only reads from the source graph, so any number of components
+// can be extracted concurrently.
+static void extract_component(
+        const PathHandleGraph& graph,
+        const IncrementalIdMap<string>& id_map,
+        const Overlaps& overlaps,
+        const vector<nid_t>& component,
+        HashGraph& component_graph,
+        IncrementalIdMap<string>& component_id_map,
+        Overlaps& component_overlaps){
+
+    unordered_set<string> paths_to_be_copied;
+
+    // Destination ids, in the same (sorted) order as the component, so that translation is a binary search rather than
+    // a lookup by name
+    vector<nid_t> other_ids;
+    other_ids.reserve(component.size());
+
+    // Duplicate all the nodes
+    for (auto id: component){
+        auto h = graph.get_handle(id);
+        auto other_id = component_id_map.insert(id_map.get_name(id));
+
+        component_graph.create_handle(graph.get_sequence(h), other_id);
+        other_ids.emplace_back(other_id);
+
+        graph.for_each_step_on_handle(h, [&](const step_handle_t s){
+            paths_to_be_copied.emplace(graph.get_path_name(graph.get_path_handle_of_step(s)));
+        });
+    }
+
+    auto translate = [&](const handle_t& h){
+        auto i = lower_bound(component.begin(), component.end(), graph.get_id(h)) - component.begin();
+        return component_graph.get_handle(other_ids[i], graph.get_is_reverse(h));
+    };
+
+    // Duplicate all the edges
+    for_each_edge_in_component(graph, component, [&](const handle_t& handle_a, const handle_t& handle_b){
+        auto other_handle_a = translate(handle_a);
+        auto other_handle_b = translate(handle_b);
+
+        component_graph.create_edge(other_handle_a, other_handle_b);
+
+        if (overlaps.has_overlap(graph, handle_a, handle_b)) {
+            component_overlaps.record_overlap(component_graph, other_handle_a, other_handle_b,
+                                              overlaps.get_overlap(graph, handle_a, handle_b));
+        }
+    });
+
+    // Duplicate all the paths
+    for (auto& path_name: paths_to_be_copied){
+        auto p = graph.get_path_handle(path_name);
+        auto other_p = component_graph.create_path_handle(path_name);
+
+        graph.for_each_step_in_path(p, [&](const step_handle_t& s){
+            component_graph.append_step(other_p, translate(graph.get_handle_of_step(s)));
+        });
+    }
+}
+
+
+void split_connected_components(
+        MutablePathDeletableHandleGraph& graph,
+        IncrementalIdMap<string>& id_map,
+        Overlaps& overlaps,
+        vector<HashGraph>& graphs,
+        vector<IncrementalIdMap<string> >& id_maps,
+        vector<Overlaps>& comp_overlaps,
+        bool delete_visited_components,
+        size_t n_threads) {
+
+    vector <vector <nid_t> > components;
+    find_connected_components(graph, components, n_threads);
+
+    // Allocate new elements in the vectors for all components up front, so each thread only touches its own elements
+    auto offset = graphs.size();
+    graphs.resize(offset + components.size());
+    id_maps.resize(offset + components.size());
+    comp_overlaps.resize(offset + components.size());
+
+    for_each_job_in_parallel(components.size(), n_threads, [&](size_t c){
+        extract_component(
+                graph,
+                id_map,
+                overlaps,
+                components[c],
+                graphs[offset + c],
+                id_maps[offset + c],
+                comp_overlaps[offset + c]);
+    });
+
+    if (delete_visited_components) {
+        for (auto& component: components) {
+            for (auto n: component) {
+                auto h = graph.get_handle(n);
+                graph.follow_edges(h, true, [&](const handle_t& prev) {
+                    overlaps.remove_overlap(graph, prev, h);
+                });
+                graph.follow_edges(h, false, [&](const handle_t& next) {
+                    overlaps.remove_overlap(graph, h, next);
+                });
+                graph.destroy_handle(h);
+            }
+        }
+    }
+}
+
+
 void split_connected_components(
         MutablePathDeletableHandleGraph& graph,
         IncrementalIdMap<string>& id_map,
@@ -415,205 +892,56 @@ void split_connected_components(
 void split_connected_components(
         MutablePathDeletableHandleGraph& graph,
         IncrementalIdMap<string>& id_map,
-        Overlaps& overlaps,
         vector<HashGraph>& graphs,
-        vector<IncrementalIdMap<string> >& id_maps,
-        vector<Overlaps>& comp_overlaps,
-        bool delete_visited_components) {
+        bool delete_visited_components,
+        size_t n_threads) {
 
-    unordered_set<nid_t> all_nodes;
+    vector <vector <nid_t> > components;
+    find_connected_components(graph, components, n_threads);
 
-    graph.for_each_handle([&](const handle_t& h) {
-        auto n = graph.get_id(h);
-        all_nodes.emplace(n);
-    });
+    auto offset = graphs.size();
+    graphs.resize(offset + components.size());
 
-    while (not all_nodes.empty()) {
-        graphs.emplace_back();
-        id_maps.emplace_back();
-        comp_overlaps.emplace_back();
+    for_each_job_in_parallel(components.size(), n_threads, [&](size_t c){
+        auto& component = components[c];
+        auto& component_graph = graphs[offset + c];
 
         unordered_set<string> paths_to_be_copied;
-        unordered_set<nid_t> to_be_deleted;
-
-        auto start_node = *all_nodes.begin();
-
-        // Duplicate all the nodes
-        for_node_in_bfs(graph, start_node, [&](const handle_t& h) {
-            auto s = graph.get_sequence(h);
-            nid_t id;
-            nid_t other_id;
-            tie(id, other_id) = translate_id(graph, id_map, graphs.back(), id_maps.back(), h);
 
-            assert(not graphs.back().has_node(other_id));
-            graphs.back().create_handle(s, other_id);
+        // Duplicate all the nodes, reusing the ID from the source graph
+        for (auto id: component){
+            auto h = graph.get_handle(id);
+            component_graph.create_handle(graph.get_sequence(h), id);
 
             graph.for_each_step_on_handle(h, [&](const step_handle_t s){
                 paths_to_be_copied.emplace(graph.get_path_name(graph.get_path_handle_of_step(s)));
             });
-
-            if (delete_visited_components) {
-                to_be_deleted.emplace(id);
-            }
-
-            if (id != start_node) {
-                all_nodes.erase(id);
-            }
-        });
-
-        // Duplicate all the edges
-        for_edge_in_bfs(graph, start_node, [&](const handle_t& handle_a, const handle_t& handle_b) {
-            nid_t id_a;
-            nid_t other_id_a;
-            tie(id_a, other_id_a) = translate_id(graph, id_map, graphs.back(), id_maps.back(), handle_a);
-
-            nid_t id_b;
-            nid_t other_id_b;
-            tie(id_b, other_id_b) = translate_id(graph, id_map, graphs.back(), id_maps.back(), handle_b);
-
-            bool reversal_a = graph.get_is_reverse(handle_a);
-            bool reversal_b = graph.get_is_reverse(handle_b);
-
-            auto other_handle_a = graphs.back().get_handle(other_id_a, reversal_a);
-            auto other_handle_b = graphs.back().get_handle(other_id_b, reversal_b);
-
-            assert(not graphs.back().has_edge(other_handle_a, other_handle_b));
-            graphs.back().create_edge(other_handle_a, other_handle_b);
-            
-            if (overlaps.has_overlap(graph, handle_a, handle_b)) {
-                comp_overlaps.back().record_overlap(graphs.back(), other_handle_a, other_handle_b,
-                                                    overlaps.get_overlap(graph, handle_a, handle_b));
-            }
-        });
-
-        // Duplicate all the paths
-        for (auto& path_name: paths_to_be_copied){
-            auto p = graph.get_path_handle(path_name);
-
-            assert(not graphs.back().has_path(path_name));
-            auto other_p = graphs.back().create_path_handle(path_name);
-
-            graph.for_each_step_in_path(p, [&](const step_handle_t& s){
-                auto h = graph.get_handle_of_step(s);
-
-                nid_t id;
-                nid_t other_id;
-                tie(id, other_id) = translate_id(graph, id_map, graphs.back(), id_maps.back(), h);
-
-                auto other_h = graph.get_handle(other_id, graph.get_is_reverse(h));
-
-                graphs.back().append_step(other_p, other_h);
-            });
         }
 
-        if (graphs.back().get_node_count() == 0){
-            throw runtime_error("connected component with start name " + id_map.get_name(start_node) + " creates empty graph");
-        }
-
-        all_nodes.erase(start_node);
-
-        if (delete_visited_components) {
-            for (auto& n: to_be_deleted) {
-                auto h = graph.get_handle(n);
-                graph.follow_edges(h, true, [&](const handle_t& prev) {
-                    overlaps.remove_overlap(graph, prev, h);
-                });
-                graph.follow_edges(h, false, [&](const handle_t& next) {
-                    overlaps.remove_overlap(graph, h, next);
-                });
-                graph.destroy_handle(h);
-            }
-        }
-    }
-}
-
-
-void split_connected_components(
-        MutablePathDeletableHandleGraph& graph,
-        IncrementalIdMap<string>& id_map,
-        vector<HashGraph>& graphs,
-        bool delete_visited_components) {
-
-    unordered_set<nid_t> all_nodes;
-
-    graph.for_each_handle([&](const handle_t& h) {
-        auto n = graph.get_id(h);
-        all_nodes.emplace(n);
-    });
-
-    while (not all_nodes.empty()) {
-        graphs.emplace_back();
-
-        unordered_set<string> paths_to_be_copied;
-        unordered_set<nid_t> to_be_deleted;
-
-        auto start_node = *all_nodes.begin();
-
-        // Duplicate all the nodes
-        for_node_in_bfs(graph, start_node, [&](const handle_t& h) {
-            auto s = graph.get_sequence(h);
-            nid_t id = graph.get_id(h);
-
-            // Reuse the ID from the source graph, force the new graph to have the same ID
-            assert(not graphs.back().has_node(id));
-            graphs.back().create_handle(s, id);
-
-            graph.for_each_step_on_handle(h, [&](const step_handle_t s){
-                paths_to_be_copied.emplace(graph.get_path_name(graph.get_path_handle_of_step(s)));
-            });
-
-            if (delete_visited_components) {
-                to_be_deleted.emplace(id);
-            }
-
-            if (id != start_node) {
-                all_nodes.erase(id);
-            }
-        });
-
         // Duplicate all the edges
-        for_edge_in_bfs(graph, start_node, [&](const handle_t& handle_a, const handle_t& handle_b) {
-            nid_t id_a = graph.get_id(handle_a);
-            nid_t id_b = graph.get_id(handle_b);
+        for_each_edge_in_component(graph, component, [&](const handle_t& handle_a, const handle_t& handle_b){
+            auto other_handle_a = component_graph.get_handle(graph.get_id(handle_a), graph.get_is_reverse(handle_a));
+            auto other_handle_b = component_graph.get_handle(graph.get_id(handle_b), graph.get_is_reverse(handle_b));
 
-            bool reversal_a = graph.get_is_reverse(handle_a);
-            bool reversal_b = graph.get_is_reverse(handle_b);
-
-            auto other_handle_a = graphs.back().get_handle(id_a, reversal_a);
-            auto other_handle_b = graphs.back().get_handle(id_b, reversal_b);
-
-            assert(not graphs.back().has_edge(other_handle_a, other_handle_b));
-            graphs.back().create_edge(other_handle_a, other_handle_b);
+            component_graph.create_edge(other_handle_a, other_handle_b);
         });
 
         // Duplicate all the paths
         for (auto& path_name: paths_to_be_copied){
             auto p = graph.get_path_handle(path_name);
-
-            assert(not graphs.back().has_path(path_name));
-            auto other_p = graphs.back().create_path_handle(path_name);
+            auto other_p = component_graph.create_path_handle(path_name);
 
             graph.for_each_step_in_path(p, [&](const step_handle_t& s){
                 auto h = graph.get_handle_of_step(s);
-
-                nid_t id = graph.get_id(h);
-
-                auto other_h = graph.get_handle(id, graph.get_is_reverse(h));
-
-                graphs.back().append_step(other_p, other_h);
+                component_graph.append_step(other_p, component_graph.get_handle(graph.get_id(h), graph.get_is_reverse(h)));
             });
         }
+    });
 
-        if (graphs.back().get_node_count() == 0){
-            throw runtime_error("connected component with start name " + id_map.get_name(start_node) + " creates empty graph");
-        }
-
-        all_nodes.erase(start_node);
-
-        if (delete_visited_components) {
-            for (auto& n: to_be_deleted) {
-                auto h = graph.get_handle(n);
-                graph.destroy_handle(h);
+    if (delete_visited_components) {
+        for (auto& component: components) {
+            for (auto n: component) {
+                graph.destroy_handle(graph.get_handle(n));
             }
         }
     }
@@ -624,54 +952,40 @@ void write_connected_components_to_gfas(
         const MutablePathDeletableHandleGraph& graph,
         const IncrementalIdMap<string>& id_map,
         const Overlaps& overlaps,
-        path output_directory) {
+        path output_directory,
+        size_t n_threads) {
 
-    unordered_set<nid_t> all_nodes;
-
-    graph.for_each_handle([&](const handle_t& h) {
-        auto n = graph.get_id(h);
-        all_nodes.emplace(n);
-    });
+    vector <vector <nid_t> > components;
+    find_connected_components(graph, components, n_threads);
 
-    size_t i = 0;
-    while (not all_nodes.empty()) {
-//        cerr << "NEW CONNECTED COMPONENT" << '\n';
-        string filename_prefix = output_directory / ("component_" + to_string(i));
+    // Each component has its own file, so they can be written concurrently without any locking
+    for_each_job_in_parallel(components.size(), n_threads, [&](size_t c){
+        string filename_prefix = output_directory / ("component_" + to_string(c));
         ofstream file(filename_prefix + ".gfa");
 
-        unordered_set<string> paths_to_be_copied;
-        unordered_set<nid_t> to_be_deleted;
-
-        auto start_node = *all_nodes.begin();
+        if (not file.is_open() or not file.good()){
+            throw runtime_error("ERROR: could not write to file: " + filename_prefix + ".gfa");
+        }
 
-        // Duplicate all the nodes
-        for_node_in_bfs(graph, start_node, [&](const handle_t& h) {
-            auto id = graph.get_id(h);
-            if (id != start_node){
-                all_nodes.erase(id);
-            }
+        unordered_set<string> paths_to_be_copied;
 
+        for (auto id: components[c]){
+            auto h = graph.get_handle(id);
             write_node_to_gfa(graph, id_map, h, file);
 
             graph.for_each_step_on_handle(h, [&](const step_handle_t s){
                 paths_to_be_copied.emplace(graph.get_path_name(graph.get_path_handle_of_step(s)));
             });
+        }
 
-        });
-
-        // Duplicate all the edges
-        for_edge_in_bfs(graph, start_node, [&](const handle_t& handle_a, const handle_t& handle_b) {
+        for_each_edge_in_component(graph, components[c], [&](const handle_t& handle_a, const handle_t& handle_b){
             write_edge_to_gfa(graph, id_map, overlaps, {handle_a, handle_b}, file);
         });
 
-        // Duplicate all the paths
         for (auto& path_name: paths_to_be_copied){
             write_path_to_gfa(graph, id_map, graph.get_path_handle(path_name), file);
         }
-
-        all_nodes.erase(start_node);
-        i++;
-    }
+    });
 }
 
 
@@ -922,7 +1236,7 @@ void unzip(MutablePathDeletableHandleGraph& graph, IncrementalIdMap<string>& id_
             }
             else if (overlaps.has_overlap(graph, previous, h)) {
                 // we only add the part that wasn't overlapped
-                size_t length_overlapped = overlaps.get_overlap(graph, previous, h).aligned_length().second;
+                size_t length_overlapped = overlaps.get_aligned_length(graph, previous, h).second;
                 path_sequence += sequence.substr(min(length_overlapped, sequence.size()), sequence.size());
             }
             else {
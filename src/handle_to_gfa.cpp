@@ -28,7 +28,7 @@ void write_node_to_gfa(const HandleGraph& graph, const handle_t& node, ostream&
 
 
 void write_node_to_gfa(const HandleGraph& graph, const IncrementalIdMap<string>& id_map, const handle_t& node, ostream& output_file){
-    output_file << "S\t" << id_map.get_name(graph.get_id(node)) << '\t' << graph.get_sequence(node) << '\n';
+    output_file << "S\t" << id_map.get_name_view(graph.get_id(node)) << '\t' << graph.get_sequence(node) << '\n';
 }
 
 
@@ -40,8 +40,8 @@ void write_edge_to_gfa(const HandleGraph& graph, const Overlaps& overlaps, const
 
 
 void write_edge_to_gfa(const HandleGraph& graph, const IncrementalIdMap<string>& id_map, const Overlaps& overlaps, const edge_t& edge, ostream& output_file){
-    output_file << "L\t" << id_map.get_name(graph.get_id(edge.first)) << '\t' << get_reversal_character(graph, edge.first) << '\t'
-                << id_map.get_name(graph.get_id(edge.second)) << '\t' << get_reversal_character(graph, edge.second) << '\t'
+    output_file << "L\t" << id_map.get_name_view(graph.get_id(edge.first)) << '\t' << get_reversal_character(graph, edge.first) << '\t'
+                << id_map.get_name_view(graph.get_id(edge.second)) << '\t' << get_reversal_character(graph, edge.second) << '\t'
                 << overlaps.get_overlap(graph, edge.first, edge.second).get_string() << '\n';
 }
 
@@ -55,7 +55,7 @@ void write_path_to_gfa(const PathHandleGraph& graph, const IncrementalIdMap<stri
 
     graph.for_each_step_in_path(path, [&](const step_handle_t& s){
         auto h = graph.get_handle_of_step(s);
-        auto name = id_map.get_name(graph.get_id(h));
+        auto name = id_map.get_name_view(graph.get_id(h));
 
         output_file << name << (graph.get_is_reverse(h) ? '-' : '+');
         if (i < n_steps - 1){
@@ -1,4 +1,5 @@
 #include "misc.hpp"
+#include "FastaIndex.hpp"
 #include <map>
 
 using std::map;
@@ -90,32 +91,16 @@ path sam_to_sorted_bam(path sam_path, size_t n_threads, bool remove_sam){
 }
 
 
-void get_query_lengths_from_fasta(path fasta_path, map<string,size_t>& query_lengths){
-    ifstream file(fasta_path);
+void get_query_lengths_from_fasta(path fasta_path, map<string,size_t>& query_lengths, size_t n_threads){
+    FastaIndex index(fasta_path, n_threads);
 
-    auto iter = query_lengths.end();
+    index.for_each_record([&](const FastaRecord& record){
+        auto r = query_lengths.emplace(record.name, record.length);
 
-    string name;
-    string line;
-
-    while (getline(file, line)){
-        if (line[0] == '>'){
-            // Trim any trailing tokens from the fasta header, keep only the name
-            name = line.substr(1, line.find_first_of(" \t\n") - 1);
-
-            auto r = query_lengths.emplace(name,0);
-
-            if (r.second) {
-                iter = r.first;
-            }
-            else{
-                throw runtime_error("ERROR: failed to insert duplicate name into contig lengths: " + name);
-            }
-        }
-        else {
-            iter->second += line.size() - (isspace(line.back()));
+        if (not r.second){
+            throw runtime_error("ERROR: failed to insert duplicate name into contig lengths: " + record.name);
         }
-    }
+    });
 }
 
 
@@ -1,9 +1,12 @@
 #include "optimize.hpp"
 #include "binomial.hpp"
+#include "Instrumentation.hpp"
 
 #include <thread>
 #include <ostream>
+#include <random>
 #include <queue>
+#include <cmath>
 
 using std::thread;
 using std::priority_queue;
@@ -17,6 +20,7 @@ using std::queue;
 using std::cerr;
 using std::min;
 using std::max;
+using std::cref;
 using std::ref;
 
 namespace gfase{
@@ -94,34 +98,48 @@ void OrientationDistribution::write_contact_map(path output_path, const Incremen
 }
 
 
-void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterations){
-    vector <pair <int32_t,int8_t> > best_partitions;
-    double best_score = std::numeric_limits<double>::min();
-
+void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterations, SplitMix64& rng){
     vector<int32_t> ids = {};
     contact_graph.get_node_ids(ids);
 
-    contact_graph.randomize_partitions();
-    contact_graph.get_partitions(best_partitions);
+    random_phase_search(contact_graph, ids, m_iterations, rng);
+}
+
 
-    // True random number
-    std::random_device rd;
+/// Greedy search with random perturbation, restricted to a subset of nodes. If the subset is a connected component of
+/// the contact graph (edges and alts) then no other nodes are read or written, so components can be searched
+/// concurrently on the same graph.
+/// \param contact_graph
+/// \param ids nodes which will be randomized, perturbed, and scored
+/// \param m_iterations
+/// \param rng
+void random_phase_search(
+        VectorMultiContactGraph& contact_graph,
+        const vector<int32_t>& ids,
+        size_t m_iterations,
+        SplitMix64& rng){
+
+    if (ids.empty()){
+        return;
+    }
+
+    vector <pair <int32_t,int8_t> > best_partitions;
+    double best_score = std::numeric_limits<double>::min();
 
-    // Pseudorandom generator with true random seed
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<int> uniform_distribution(0,int(ids.size()-1));
+    contact_graph.randomize_partitions(ids, rng);
+    contact_graph.get_partitions(ids, best_partitions);
 
     double total_score;
 
     for (size_t m=0; m<m_iterations; m++) {
         // Randomly perturb
         for (size_t i=0; i<((ids.size()/30) + 1); i++) {
-            auto r = ids.at(uniform_distribution(rng));
+            auto r = ids[rng.bounded(ids.size())];
 
             int8_t p;
             if (contact_graph.has_alt(r)){
                 // Only allow {1,-1}
-                p = int8_t((uniform_distribution(rng) % 2));
+                p = int8_t(rng.bounded(2));
 
                 if (p == 0){
                     p = -1;
@@ -129,14 +147,14 @@ void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterat
             }
             else{
                 // Allow {1,0,-1}
-                p = int8_t((uniform_distribution(rng) % 3) - 1);
+                p = int8_t(int(rng.bounded(3)) - 1);
             }
 
             contact_graph.set_partition(r, p);
         }
 
         for (size_t i=0; i<ids.size()*3; i++) {
-            auto n = ids.at(uniform_distribution(rng));
+            auto n = ids[rng.bounded(ids.size())];
 
             if (contact_graph.edge_count(n) == 0){
                 continue;
@@ -183,11 +201,11 @@ void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterat
             contact_graph.set_partition(n, p_max);
         }
 
-        total_score = contact_graph.compute_total_consistency_score();
+        total_score = contact_graph.compute_total_consistency_score(ids);
 
         if (total_score > best_score) {
             best_score = total_score;
-            contact_graph.get_partitions(best_partitions);
+            contact_graph.get_partitions(ids, best_partitions);
         }
         else {
             contact_graph.set_partitions(best_partitions);
@@ -207,6 +225,205 @@ void random_phase_search(VectorMultiContactGraph& contact_graph, size_t m_iterat
 }
 
 
+/// Metropolis sweeps for a single replica at a fixed temperature. Each proposal reassigns one node (and implicitly its
+/// alts) and is scored by the change in its local consistency, so a sweep costs O(edges) instead of O(n * edges).
+/// \param contact_graph replica to be mutated
+/// \param ids nodes which may be proposed for reassignment
+/// \param temperature
+/// \param n_sweeps each sweep is ids.size() proposals
+/// \param rng
+void temper_replica(
+        VectorMultiContactGraph& contact_graph,
+        const vector<int32_t>& ids,
+        double temperature,
+        size_t n_sweeps,
+        SplitMix64& rng){
+
+    for (size_t s=0; s<n_sweeps; s++) {
+        for (size_t i=0; i<ids.size(); i++) {
+            auto n = ids[rng.bounded(ids.size())];
+
+            auto p_prev = contact_graph.get_partition(n);
+            int8_t p;
+
+            if (contact_graph.has_alt(n)){
+                // Only allow {1,-1}
+                p = int8_t(-p_prev);
+            }
+            else{
+                // Choose one of the two other states in {1,0,-1}
+                p = int8_t(((p_prev + 2 + int(rng.bounded(2))) % 3) - 1);
+            }
+
+            auto delta = double(p - p_prev) * contact_graph.compute_consistency_coefficient(n);
+
+            if (delta >= 0 or rng.uniform() < exp(delta/temperature)){
+                contact_graph.set_partition(n, p);
+            }
+        }
+    }
+}
+
+
+void temper_replicas_with_threads(
+        vector<VectorMultiContactGraph>& replicas,
+        vector<SplitMix64>& rngs,
+        vector<double>& scores,
+        const vector<double>& temperatures,
+        const vector<size_t>& replica_of_temperature,
+        const vector<int32_t>& ids,
+        atomic<size_t>& job_index){
+
+    auto t = job_index.fetch_add(1);
+
+    while (t < temperatures.size()){
+        auto r = replica_of_temperature[t];
+
+        temper_replica(replicas[r], ids, temperatures[t], 1, rngs[r]);
+        scores[r] = replicas[r].compute_total_consistency_score();
+
+        t = job_index.fetch_add(1);
+    }
+}
+
+
+/// Replica exchange (parallel tempering) search. Replicas are annealed independently at a geometric ladder of
+/// temperatures, and after every sweep, neighboring temperatures attempt to exchange states with the standard
+/// Metropolis criterion on their total consistency scores. The best state observed in any replica is written back to
+/// the contact graph.
+/// \param contact_graph graph to be phased, its current partitions are used as the starting state for all replicas
+/// \param n_sweeps number of sweeps (ids.size() proposals per replica) to perform
+/// \param rng each replica is given its own stream split from this generator, so results don't depend on n_threads
+/// \param n_replicas number of temperatures in the ladder
+/// \param min_temperature coldest temperature, in units of the mean edge weight
+/// \param max_temperature hottest temperature, in units of the mean edge weight
+/// \param n_threads replicas are swept concurrently, so there is no benefit of n_threads > n_replicas
+void parallel_tempering_phase_search(
+        VectorMultiContactGraph& contact_graph,
+        size_t n_sweeps,
+        SplitMix64& rng,
+        size_t n_replicas,
+        double min_temperature,
+        double max_temperature,
+        size_t n_threads){
+
+    if (n_replicas == 0){
+        throw runtime_error("ERROR: parallel_tempering_phase_search: n_replicas must be greater than 0");
+    }
+
+    vector<int32_t> ids;
+    vector<int32_t> all_ids;
+    contact_graph.get_node_ids(all_ids);
+
+    // Nodes without edges or alts can't affect the score
+    for (auto id: all_ids){
+        if (contact_graph.edge_count(id) > 0 or contact_graph.has_alt(id)){
+            ids.emplace_back(id);
+        }
+    }
+
+    if (ids.empty()){
+        return;
+    }
+
+    // Normalize temperatures by the mean edge weight so that the defaults are independent of coverage
+    double total_weight = 0;
+    size_t n_edges = 0;
+    contact_graph.for_each_edge([&](const pair<int32_t,int32_t> edge, int32_t weight){
+        total_weight += weight;
+        n_edges++;
+    });
+
+    double scale = (n_edges > 0 and total_weight > 0) ? total_weight/double(n_edges) : 1;
+
+    // Geometric temperature ladder, coldest first
+    vector<double> temperatures(n_replicas);
+    for (size_t t=0; t<n_replicas; t++){
+        double x = (n_replicas > 1) ? double(t)/double(n_replicas-1) : 0;
+        temperatures[t] = scale * min_temperature * pow(max_temperature/min_temperature, x);
+    }
+
+    vector<VectorMultiContactGraph> replicas(n_replicas, contact_graph);
+    vector<SplitMix64> rngs;
+    vector<double> scores(n_replicas, contact_graph.compute_total_consistency_score());
+    vector<size_t> replica_of_temperature(n_replicas);
+
+    for (size_t r=0; r<n_replicas; r++){
+        rngs.emplace_back(rng.split());
+        replica_of_temperature[r] = r;
+    }
+
+    auto exchange_rng = rng.split();
+
+    double best_score = scores[0];
+    vector <pair <int32_t,int8_t> > best_partitions;
+    contact_graph.get_partitions(best_partitions);
+
+    for (size_t s=0; s<n_sweeps; s++){
+        atomic<size_t> job_index = 0;
+
+        if (n_threads > 1) {
+            vector<thread> threads;
+
+            // Launch threads
+            for (uint64_t i=0; i<min(n_threads, n_replicas); i++){
+                try {
+                    threads.emplace_back(thread(
+                            temper_replicas_with_threads,
+                            ref(replicas),
+                            ref(rngs),
+                            ref(scores),
+                            cref(temperatures),
+                            cref(replica_of_temperature),
+                            cref(ids),
+                            ref(job_index)
+                    ));
+                } catch (const exception &e) {
+                    cerr << e.what() << "\n";
+                    exit(1);
+                }
+            }
+
+            // Wait for threads to finish
+            for (auto& t: threads){
+                t.join();
+            }
+        }
+        else{
+            temper_replicas_with_threads(replicas, rngs, scores, temperatures, replica_of_temperature, ids, job_index);
+        }
+
+        for (size_t r=0; r<n_replicas; r++){
+            if (scores[r] > best_score){
+                best_score = scores[r];
+                replicas[r].get_partitions(best_partitions);
+            }
+        }
+
+        // Attempt exchanges between neighboring temperatures, alternating even and odd pairs
+        for (size_t t=s%2; t+1<n_replicas; t+=2){
+            auto& a = replica_of_temperature[t];
+            auto& b = replica_of_temperature[t+1];
+
+            auto log_p = (1/temperatures[t] - 1/temperatures[t+1]) * (scores[b] - scores[a]);
+
+            if (log_p >= 0 or exchange_rng.uniform() < exp(log_p)){
+                std::swap(a,b);
+            }
+        }
+    }
+
+    contact_graph.set_partitions(best_partitions);
+
+    // Finish with a zero temperature quench of the best state, since it was only sampled at a nonzero temperature
+    temper_replica(contact_graph, ids, 0, 2, exchange_rng);
+
+    if (contact_graph.compute_total_consistency_score() < best_score){
+        contact_graph.set_partitions(best_partitions);
+    }
+}
+
+
 void flip_component(alt_component_t& c){
     auto temp = c.second;
     c.second = c.first;
@@ -216,11 +433,72 @@ void flip_component(alt_component_t& c){
 
 void sample_with_threads(vector<VectorMultiContactGraph>& contact_graphs_per_thread,
                          size_t core_iterations,
+                         bool use_parallel_tempering,
+                         uint64_t seed,
                          atomic<size_t>& job_index){
     auto i = job_index.fetch_add(1);
 
+    auto& n_samples = Instrumentation::global().get_counter("samples");
+
     while (i < contact_graphs_per_thread.size()){
-        random_phase_search(contact_graphs_per_thread[i], core_iterations);
+        // Streams are keyed by sample, not by thread, so the result does not depend on the scheduling
+        SplitMix64 rng(seed, i);
+
+        if (use_parallel_tempering){
+            // Each sample is one independent replica ladder, started from a random state, in this thread
+            contact_graphs_per_thread[i].randomize_partitions(rng);
+            parallel_tempering_phase_search(contact_graphs_per_thread[i], core_iterations, rng);
+        }
+        else {
+            random_phase_search(contact_graphs_per_thread[i], core_iterations, rng);
+        }
+
+        n_samples.fetch_add(1, std::memory_order_relaxed);
+        i = job_index.fetch_add(1);
+    }
+}
+
+
+/// Number of iterations of random_phase_search to spend on a connected component. Small components converge in a
+/// handful of iterations, so the budget grows with the component size, up to the full core_iterations.
+/// \param component_size number of nodes in the component
+/// \param core_iterations the budget for the largest components
+/// \return iterations
+size_t get_component_iterations(size_t component_size, size_t core_iterations){
+    return min(core_iterations, max(size_t(3), component_size));
+}
+
+
+/// Each job is one (component, sample) pair. Components are disjoint, so jobs for different components of the same
+/// sample can run concurrently on the same graph.
+/// \param contact_graphs_per_thread one graph per sample
+/// \param components connected components, ideally in descending order of size so that the largest jobs start first
+/// \param core_iterations
+/// \param seed each job draws from its own stream, indexed by job
+/// \param job_index
+void sample_components_with_threads(
+        vector<VectorMultiContactGraph>& contact_graphs_per_thread,
+        const vector <vector <int32_t> >& components,
+        size_t core_iterations,
+        uint64_t seed,
+        atomic<size_t>& job_index){
+
+    auto n_samples = contact_graphs_per_thread.size();
+    auto n_jobs = components.size()*n_samples;
+
+    auto& n_component_jobs = Instrumentation::global().get_counter("component_jobs");
+
+    auto i = job_index.fetch_add(1);
+
+    while (i < n_jobs){
+        const auto& component = components[i / n_samples];
+        auto& contact_graph = contact_graphs_per_thread[i % n_samples];
+
+        SplitMix64 rng(seed, i);
+
+        random_phase_search(contact_graph, component, get_component_iterations(component.size(), core_iterations), rng);
+        n_component_jobs.fetch_add(1, std::memory_order_relaxed);
+
         i = job_index.fetch_add(1);
     }
 }
@@ -231,27 +509,65 @@ void sample_orientation_distribution(
         MultiContactGraph& contact_graph,
         size_t sample_size,
         size_t n_threads,
-        size_t core_iterations
+        size_t core_iterations,
+        bool use_parallel_tempering,
+        bool use_components,
+        uint64_t seed
         ){
 
     vector<thread> threads;
     vector<int32_t> ids = {};
 
-    contact_graph.randomize_partitions();
+    SplitMix64 rng(seed);
+
+    contact_graph.randomize_partitions(rng);
     contact_graph.get_node_ids(ids);
 
     vector<VectorMultiContactGraph> contact_graphs_per_thread(sample_size,contact_graph);
     atomic<size_t> job_index = 0;
 
+    vector <vector <int32_t> > components;
+
+    if (use_components){
+        contact_graphs_per_thread.front().get_connected_components(components);
+
+        // Schedule the largest components first, so that the small ones fill in the gaps at the end
+        sort(components.begin(), components.end(), [&](const vector<int32_t>& a, const vector<int32_t>& b){
+            // Ties are broken by id so that the job order, and therefore the job streams, are reproducible
+            return a.size() > b.size() or (a.size() == b.size() and a.front() < b.front());
+        });
+
+        if (not components.empty()) {
+            cerr << "Found " << components.size() << " connected components, largest: " << components.front().size() << '\n';
+        }
+    }
+
+    // All threads share one seed, and derive a stream per job from it
+    auto sample_seed = rng();
+
     // Launch threads
     for (uint64_t i=0; i<n_threads; i++){
         try {
-            threads.emplace_back(thread(
-                    sample_with_threads,
-                    ref(contact_graphs_per_thread),
-                    core_iterations,
-                    ref(job_index)
-            ));
+            if (use_components){
+                threads.emplace_back(thread(
+                        sample_components_with_threads,
+                        ref(contact_graphs_per_thread),
+                        cref(components),
+                        core_iterations,
+                        sample_seed,
+                        ref(job_index)
+                ));
+            }
+            else {
+                threads.emplace_back(thread(
+                        sample_with_threads,
+                        ref(contact_graphs_per_thread),
+                        core_iterations,
+                        use_parallel_tempering,
+                        sample_seed,
+                        ref(job_index)
+                ));
+            }
         } catch (const exception &e) {
             cerr << e.what() << "\n";
             exit(1);
@@ -283,6 +599,121 @@ void sample_orientation_distribution(
 }
 
 
+void compute_consistency_scores_with_threads(
+        const VectorMultiContactGraph& contact_graph,
+        const vector<int32_t>& ids,
+        vector<double>& consistency_scores,
+        atomic<size_t>& job_index){
+
+    // Each job is a contiguous block of ids, so that the atomic is not contended once per node
+    const size_t block_size = 1024;
+
+    auto i = job_index.fetch_add(1);
+
+    while (i*block_size < ids.size()){
+        auto stop = min(ids.size(), (i+1)*block_size);
+
+        for (size_t j=i*block_size; j<stop; j++){
+            auto id = ids[j];
+            consistency_scores[id] = contact_graph.compute_consistency_score(id);
+        }
+
+        i = job_index.fetch_add(1);
+    }
+}
+
+
+/// Compute the consistency score of every node once, so that it can be reused without recomputing O(degree) sums
+/// \param contact_graph
+/// \param consistency_scores indexed by node id, nonexistent ids are left as 0
+/// \param n_threads
+void compute_consistency_scores(
+        const VectorMultiContactGraph& contact_graph,
+        vector<double>& consistency_scores,
+        size_t n_threads){
+
+    vector<int32_t> ids;
+    contact_graph.get_node_ids(ids);
+
+    consistency_scores.clear();
+
+    if (ids.empty()){
+        return;
+    }
+
+    // Ids are returned in ascending order
+    consistency_scores.resize(ids.back() + 1, 0);
+
+    vector<thread> threads;
+    atomic<size_t> job_index = 0;
+
+    // Launch threads
+    for (uint64_t i=0; i<n_threads; i++){
+        try {
+            threads.emplace_back(thread(
+                    compute_consistency_scores_with_threads,
+                    cref(contact_graph),
+                    cref(ids),
+                    ref(consistency_scores),
+                    ref(job_index)
+            ));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    // Wait for threads to finish
+    for (auto& t: threads){
+        t.join();
+    }
+}
+
+
+/// Sort edges in descending order of their max orientation count, and break ties using the mean consistency score of
+/// the two nodes involved (higher first). Node consistencies are computed once up front instead of per comparison.
+/// \param contact_graph
+/// \param ordered_edges
+/// \param n_threads
+void rank_orientation_edges(
+        const VectorMultiContactGraph& contact_graph,
+        vector <pair <orientation_edge_t, orientation_weight_t> >& ordered_edges,
+        size_t n_threads){
+
+    vector<double> consistency_scores;
+    compute_consistency_scores(contact_graph, consistency_scores, n_threads);
+
+    // Build composite keys, keeping the index of the edge they were computed from
+    vector <pair <orientation_rank_t, size_t> > ranks;
+    ranks.reserve(ordered_edges.size());
+
+    for (size_t i=0; i<ordered_edges.size(); i++){
+        const auto& [edge, weights] = ordered_edges[i];
+
+        auto ordinal = max(weights[0], weights[1]);
+        auto consistency = (consistency_scores.at(edge.first) + consistency_scores.at(edge.second)) / 2;
+
+        ranks.push_back({{ordinal, consistency}, i});
+    }
+
+    sort(ranks.begin(), ranks.end(), [&](
+            const pair <orientation_rank_t, size_t>& a,
+            const pair <orientation_rank_t, size_t>& b
+            ){
+        return a.first > b.first;
+    });
+
+    vector <pair <orientation_edge_t, orientation_weight_t> > result;
+    result.reserve(ordered_edges.size());
+
+    for (const auto& [rank, i]: ranks){
+        result.emplace_back(ordered_edges[i]);
+    }
+
+    ordered_edges = std::move(result);
+}
+
+
 void monte_carlo_phase_contacts(
         MultiContactGraph& contact_graph,
         const IncrementalIdMap<string>& id_map,
@@ -290,9 +721,15 @@ void monte_carlo_phase_contacts(
         size_t sample_size,
         size_t n_rounds,
         size_t n_threads,
-        path output_dir
+        path output_dir,
+        bool use_parallel_tempering,
+        bool use_components,
+        uint64_t seed
         ){
 
+    // Each round is seeded from its own stream, so that the rounds are independent of each other
+    SplitMix64 rng(seed);
+
     // Keep the original graph for scoring purposes (some bubbles will be merged later)
     MultiContactGraph unmerged_contact_graph = contact_graph;
 
@@ -300,17 +737,25 @@ void monte_carlo_phase_contacts(
     unordered_set<orientation_edge_t> visited_edges;
     vector <pair <int32_t,int8_t> > phase_state;
 
+    auto& n_sampling_rounds = Instrumentation::global().get_counter("sampling_rounds");
+
     for (size_t i=0; i<n_rounds; i++){
         // Initialize DS for tracking results of repeated samples from the converged graph
         OrientationDistribution orientation_distribution(contact_graph);
 
         cerr << "---- " << i << " ----" << '\n';
+        ScopedSpan span("sampling_round_" + to_string(i));
         sample_orientation_distribution(
                 orientation_distribution,
                 contact_graph,
                 sample_size,
                 n_threads,
-                core_iterations);
+                core_iterations,
+                use_parallel_tempering,
+                use_components,
+                rng());
+
+        n_sampling_rounds.fetch_add(1, std::memory_order_relaxed);
 
         // Convert to non-mutable graph for efficiency of optimization
         VectorMultiContactGraph vector_contact_graph(contact_graph);
@@ -334,30 +779,8 @@ void monte_carlo_phase_contacts(
             }
         }
 
-        // Order by edge weight
-        sort(ordered_edges.begin(), ordered_edges.end(), [&](
-                const pair<orientation_edge_t,orientation_weight_t>& a,
-                const pair<orientation_edge_t,orientation_weight_t>& b
-                ){
-
-            auto a_ordinal = max(a.second[0], a.second[1]);
-            auto b_ordinal = max(b.second[0], b.second[1]);
-
-            bool result = a_ordinal > b_ordinal;
-
-            if (a_ordinal == b_ordinal){
-                auto a0_consistency = vector_contact_graph.compute_consistency_score(a.first.first);
-                auto a1_consistency = vector_contact_graph.compute_consistency_score(a.first.second);
-                auto b0_consistency = vector_contact_graph.compute_consistency_score(b.first.first);
-                auto b1_consistency = vector_contact_graph.compute_consistency_score(b.first.second);
-                auto a_avg = (a0_consistency + a1_consistency) / 2;
-                auto b_avg = (b0_consistency + b1_consistency) / 2;
-
-                result = a_avg > b_avg;
-            }
-
-            return result;
-        });
+        // Order by edge weight, breaking ties by the consistency of each edge's nodes
+        rank_orientation_edges(vector_contact_graph, ordered_edges, n_threads);
 
         auto top_result = ordered_edges.front().second;
         auto max_weight = max(top_result[0],top_result[1]);
@@ -417,12 +840,16 @@ void monte_carlo_phase_contacts(
 
     // Perform finishing convergence on the most merged graph, with more iterations
     cerr << "Final phase:" << '\n';
+    ScopedSpan span("final_sampling_round");
     sample_orientation_distribution(
             orientation_distribution,
             contact_graph,
             sample_size,
             n_threads,
-            3*core_iterations);
+            3*core_iterations,
+            use_parallel_tempering,
+            use_components,
+            rng());
 
     // Store best result for future use
     vector <pair <int32_t,int8_t> > best_partitions;
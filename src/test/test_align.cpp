@@ -0,0 +1,178 @@
+#include "MultiContactGraph.hpp"
+#include "IncrementalIdMap.hpp"
+#include "Hasher2.hpp"
+#include "align.hpp"
+#include "Sam.hpp"
+
+using gfase::estimate_matches_from_chain;
+using gfase::construct_alignment_graph;
+using gfase::build_alignment_graph;
+using gfase::AlignmentScheduler;
+using gfase::MultiContactGraph;
+using gfase::IncrementalIdMap;
+using gfase::AlignmentRecord;
+using gfase::AlignmentBlock;
+using gfase::HashResult;
+
+#include "bdsg/hash_graph.hpp"
+
+using bdsg::HashGraph;
+
+#include <stdexcept>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <map>
+
+using std::runtime_error;
+using std::to_string;
+using std::mt19937;
+using std::string;
+using std::vector;
+using std::cerr;
+using std::map;
+
+
+void test_estimate(int32_t mlen, int32_t blen, float div, uint32_t expected_matches, uint32_t expected_mismatches){
+    mm_reg1_t region{};
+    region.qs = 100;
+    region.qe = 100 + blen;
+    region.rs = 2000;
+    region.re = 2000 + blen;
+    region.mlen = mlen;
+    region.blen = blen;
+    region.div = div;
+
+    // Stale counts must be overwritten
+    AlignmentBlock block(region.rs, region.re, region.qs, region.qe, 7, 7, 7, 7, true);
+
+    estimate_matches_from_chain(region, block);
+
+    if (block.n_matches != expected_matches or block.n_mismatches != expected_mismatches){
+        throw runtime_error("FAIL: estimated " + to_string(block.n_matches) + " matches and " +
+                            to_string(block.n_mismatches) + " mismatches, expected " + to_string(expected_matches) +
+                            " and " + to_string(expected_mismatches) + " for mlen=" + to_string(mlen) + " blen=" +
+                            to_string(blen) + " div=" + to_string(div));
+    }
+
+    if (block.n_inserts != 0 or block.n_deletes != 0){
+        throw runtime_error("FAIL: estimated block has indels");
+    }
+
+    if (block.ref_start != region.rs or block.ref_stop != region.re or
+        block.query_start != region.qs or block.query_stop != region.qe or not block.is_reverse){
+        throw runtime_error("FAIL: estimate modified the span of the block");
+    }
+}
+
+
+string random_sequence(mt19937& generator, size_t length){
+    string s;
+    for (size_t i=0; i<length; i++){
+        s += "ACGT"[generator() % 4];
+    }
+
+    return s;
+}
+
+
+void align_toy_graph(bool chain_only, MultiContactGraph& alignment_graph, IncrementalIdMap<string>& id_map){
+    mt19937 generator(11);
+
+    // b is a trimmed copy of a with a substitution every 200bp, c is unrelated
+    auto a = random_sequence(generator, 20000);
+    auto b = a.substr(100, 19800);
+    auto c = random_sequence(generator, 15000);
+
+    for (size_t i=0; i<b.size(); i+=200){
+        b[i] = (b[i] == 'A') ? 'C' : 'A';
+    }
+
+    HashGraph graph;
+    for (auto& [name, sequence]: {std::pair<string,string>("a", a), {"b", b}, {"c", c}}){
+        auto id = id_map.try_insert(name);
+        graph.create_handle(sequence, id);
+    }
+
+    vector<HashResult> candidates = {
+            {"a", "b", 0.9, 0.9},
+            {"a", "c", 0.9, 0.9}
+    };
+
+    double min_similarity = 0.5;
+
+    AlignmentScheduler scheduler(candidates, graph, id_map, min_similarity);
+
+    vector <vector <AlignmentRecord> > results(1);
+    construct_alignment_graph(scheduler, graph, id_map, results[0], min_similarity, chain_only, 0);
+
+    build_alignment_graph(results, alignment_graph);
+}
+
+
+void test_chain_only_edges(){
+    MultiContactGraph base_level_graph;
+    MultiContactGraph chain_only_graph;
+    IncrementalIdMap<string> base_level_ids(false);
+    IncrementalIdMap<string> chain_only_ids(false);
+
+    align_toy_graph(false, base_level_graph, base_level_ids);
+    align_toy_graph(true, chain_only_graph, chain_only_ids);
+
+    map <pair<string,string>, int32_t> base_level_edges;
+    map <pair<string,string>, int32_t> chain_only_edges;
+
+    base_level_graph.for_each_edge([&](const pair<int32_t,int32_t> edge, int32_t weight){
+        base_level_edges[{base_level_ids.get_name(edge.first), base_level_ids.get_name(edge.second)}] = weight;
+    });
+
+    chain_only_graph.for_each_edge([&](const pair<int32_t,int32_t> edge, int32_t weight){
+        chain_only_edges[{chain_only_ids.get_name(edge.first), chain_only_ids.get_name(edge.second)}] = weight;
+    });
+
+    if (base_level_edges.size() != 1){
+        throw runtime_error("FAIL: expected 1 base level edge, found " + to_string(base_level_edges.size()));
+    }
+
+    if (chain_only_edges.size() != base_level_edges.size()){
+        throw runtime_error("FAIL: chain only alignment found " + to_string(chain_only_edges.size()) +
+                            " edges, base level found " + to_string(base_level_edges.size()));
+    }
+
+    for (auto& [edge, weight]: base_level_edges){
+        auto result = chain_only_edges.find(edge);
+
+        if (result == chain_only_edges.end()){
+            throw runtime_error("FAIL: chain only alignment is missing edge " + edge.first + "," + edge.second);
+        }
+
+        // The estimate only has to be close enough to give the same decision at the similarity threshold
+        if (std::abs(result->second - weight) > 0.02*weight){
+            throw runtime_error("FAIL: chain only matches " + to_string(result->second) + " differ from base level " +
+                                to_string(weight) + " for edge " + edge.first + "," + edge.second);
+        }
+    }
+}
+
+
+int main(){
+    cerr << "TESTING estimate_matches_from_chain:" << '\n';
+
+    // From minimap2's divergence estimate
+    test_estimate(400, 1000, 0.1, 900, 100);
+    test_estimate(1000, 1000, 0, 1000, 0);
+
+    // Divergence unavailable, fall back on anchored bases
+    test_estimate(750, 1000, -1, 750, 250);
+    test_estimate(0, 0, -1, 0, 0);
+
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING chain only alignment graph matches base level:" << '\n';
+    test_chain_only_edges();
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
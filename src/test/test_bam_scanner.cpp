@@ -0,0 +1,190 @@
+#include "MultiContactGraph.hpp"
+#include "BamScanner.hpp"
+#include "Filesystem.hpp"
+#include "Bam.hpp"
+
+using ghc::filesystem::path;
+using gfase::MapqDistributionPlugin;
+using gfase::ContactGraphPlugin;
+using gfase::MultiContactGraph;
+using gfase::FullAlignmentChain;
+using gfase::IncrementalIdMap;
+using gfase::ReadChainPlugin;
+using gfase::BamScanner;
+using gfase::SamElement;
+using gfase::Bam;
+
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <map>
+
+using std::runtime_error;
+using std::to_string;
+using std::string;
+using std::cerr;
+using std::map;
+
+
+class ThrowingPlugin: public ReadChainPlugin{
+    size_t n = 0;
+public:
+    void process(const FullAlignmentChain& read_alignments) override{
+        if (++n == 3){
+            throw runtime_error("expected failure");
+        }
+    }
+};
+
+
+/// Counts the records which arrive with a decoded CIGAR
+class CigarCountPlugin: public ReadChainPlugin{
+    bool cigar_needed;
+public:
+    size_t n_records = 0;
+    size_t n_with_cigar = 0;
+
+    CigarCountPlugin(bool cigar_needed): cigar_needed(cigar_needed){}
+
+    void process(const FullAlignmentChain& read_alignments) override{
+        for (const auto& a: read_alignments.chain){
+            n_records++;
+            n_with_cigar += not a.cigars.empty();
+        }
+    }
+
+    bool needs_cigar() const override{
+        return cigar_needed;
+    }
+};
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+
+    path relative_bam_path = "data/test.bam";
+    path bam_path = project_directory / relative_bam_path;
+
+    // Reference results, computed with a separate pass per analysis
+    map<uint8_t,size_t> expected_mapqs;
+    MultiContactGraph expected_graph;
+    IncrementalIdMap<string> expected_id_map(false);
+    {
+        Bam reader(bam_path);
+        string prev_query_name;
+        vector<SamElement> alignments;
+
+        reader.for_alignment_in_bam(false, [&](SamElement& a){
+            expected_mapqs[a.mapq]++;
+
+            if (a.query_name != prev_query_name){
+                update_contact_map(alignments, expected_graph, expected_id_map);
+                alignments.clear();
+            }
+
+            if (not a.ref_name.empty() and a.is_primary()){
+                alignments.emplace_back(a);
+            }
+
+            prev_query_name = a.query_name;
+        });
+
+        update_contact_map(alignments, expected_graph, expected_id_map);
+    }
+
+    cerr << "TESTING single pass scan with multiple plugins:" << '\n';
+
+    for (size_t batch_size: {1, 7, 4096}){
+        MultiContactGraph contact_graph;
+        IncrementalIdMap<string> id_map(false);
+
+        ContactGraphPlugin contact_graph_plugin(contact_graph, id_map, "", 0);
+        MapqDistributionPlugin mapq_distribution(false);
+
+        BamScanner scanner(bam_path, batch_size, 2);
+        scanner.add_plugin(contact_graph_plugin);
+        scanner.add_plugin(mapq_distribution);
+        scanner.scan();
+
+        if (mapq_distribution.distribution != expected_mapqs){
+            throw runtime_error("FAIL: mapq distribution differs, batch_size=" + to_string(batch_size));
+        }
+
+        if (contact_graph.size() != expected_graph.size() or contact_graph.edge_count() != expected_graph.edge_count()){
+            throw runtime_error("FAIL: contact graph differs, batch_size=" + to_string(batch_size));
+        }
+
+        contact_graph.for_each_edge([&](const pair<int32_t,int32_t> edge, int32_t weight){
+            auto a = int32_t(expected_id_map.get_id(id_map.get_name(edge.first)));
+            auto b = int32_t(expected_id_map.get_id(id_map.get_name(edge.second)));
+
+            if (expected_graph.get_edge_weight(a,b) != weight){
+                throw runtime_error("FAIL: edge weight differs, batch_size=" + to_string(batch_size));
+            }
+        });
+    }
+
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING CIGARs are only decoded when a plugin needs them:" << '\n';
+    {
+        size_t n_with_cigar = 0;
+
+        for (bool cigar_needed: {false, true}){
+            MultiContactGraph contact_graph;
+            IncrementalIdMap<string> id_map(false);
+
+            ContactGraphPlugin contact_graph_plugin(contact_graph, id_map, "", 0);
+            CigarCountPlugin cigar_count(cigar_needed);
+
+            BamScanner scanner(bam_path);
+            scanner.add_plugin(contact_graph_plugin);
+            scanner.add_plugin(cigar_count);
+            scanner.scan();
+
+            if (cigar_needed){
+                n_with_cigar = cigar_count.n_with_cigar;
+            }
+            else if (cigar_count.n_with_cigar != 0){
+                throw runtime_error("FAIL: CIGARs decoded although no plugin needs them");
+            }
+
+            if (contact_graph.size() != expected_graph.size() or contact_graph.edge_count() != expected_graph.edge_count()){
+                throw runtime_error("FAIL: contact graph differs, cigar_needed=" + to_string(cigar_needed));
+            }
+        }
+
+        if (n_with_cigar == 0){
+            throw runtime_error("FAIL: no CIGARs decoded although a plugin needs them");
+        }
+    }
+
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING plugin failure:" << '\n';
+    {
+        ThrowingPlugin throwing_plugin;
+        MapqDistributionPlugin mapq_distribution(false);
+
+        BamScanner scanner(bam_path, 1, 1);
+        scanner.add_plugin(mapq_distribution);
+        scanner.add_plugin(throwing_plugin);
+
+        bool caught = false;
+        try {
+            scanner.scan();
+        }
+        catch (const runtime_error& e){
+            caught = (string(e.what()) == "expected failure");
+        }
+
+        if (not caught){
+            throw runtime_error("FAIL: plugin exception was not propagated");
+        }
+    }
+
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "BinarySequence.hpp"
 #include "Filesystem.hpp"
+#include "Timer.hpp"
 #include "CLI11.hpp"
 
 #include <fstream>
@@ -8,7 +9,9 @@
 
 #include <string>
 
+using gfase::SmallBinarySequence;
 using gfase::BinarySequence;
+using gfase::Timer;
 
 using ghc::filesystem::path;
 
@@ -33,12 +36,10 @@ void strip_trailing_space(string& line){
 }
 
 
-void test_performance(path kmer_file_path){
+template <class T> void load_kmers(path kmer_file_path, unordered_set<T>& kmers){
     ifstream file(kmer_file_path);
     string line;
 
-    unordered_set <BinarySequence <uint64_t> > kmers;
-
     while (getline(file, line)){
         if (line[0] == '>'){
             continue;
@@ -51,6 +52,73 @@ void test_performance(path kmer_file_path){
 }
 
 
+/// Roll a kmer over the concatenation of all the kmers in the file, resetting on every header like the hashers do
+/// on non-ACGT characters, and return a checksum of the hashes
+template <class T> size_t roll_kmers(path kmer_file_path, size_t k){
+    ifstream file(kmer_file_path);
+    string line;
+
+    size_t checksum = 0;
+    T kmer;
+
+    while (getline(file, line)){
+        if (line[0] == '>'){
+            kmer = {};
+            continue;
+        }
+
+        strip_trailing_space(line);
+
+        for (auto c: line){
+            if (kmer.length < k){
+                kmer.push_back(c);
+            }
+            else{
+                kmer.shift(c);
+                checksum ^= std::hash<T>()(kmer);
+            }
+        }
+    }
+
+    return checksum;
+}
+
+
+void test_performance(path kmer_file_path){
+    Timer t;
+
+    unordered_set <BinarySequence <uint64_t> > kmers;
+    load_kmers(kmer_file_path, kmers);
+
+    cerr << "BinarySequence<uint64_t> load: " << t << '\n';
+    t.reset();
+
+    unordered_set <SmallBinarySequence<2> > small_kmers;
+    load_kmers(kmer_file_path, small_kmers);
+
+    cerr << "SmallBinarySequence<2> load: " << t << '\n';
+
+    if (kmers.size() != small_kmers.size()){
+        throw runtime_error("FAIL: SmallBinarySequence set size " + std::to_string(small_kmers.size()) + " does not match BinarySequence set size " + std::to_string(kmers.size()));
+    }
+
+    // The hashers are limited to k <= 32, where both types must give identical hashes
+    size_t k = 31;
+
+    t.reset();
+    auto a = roll_kmers <BinarySequence<uint64_t> >(kmer_file_path, k);
+    cerr << "BinarySequence<uint64_t> rolling hash: " << t << '\n';
+
+    t.reset();
+    auto b = roll_kmers <SmallBinarySequence<1> >(kmer_file_path, k);
+    cerr << "SmallBinarySequence<1> rolling hash: " << t << '\n';
+
+    if (a != b){
+        throw runtime_error("FAIL: SmallBinarySequence rolling hashes do not match BinarySequence");
+    }
+}
+
+
 int main (int argc, char* argv[]){
     path kmer_file_path;
 
@@ -0,0 +1,175 @@
+#include "IncrementalIdMap.hpp"
+#include "Bipartition.hpp"
+#include "hash_graph.hpp"
+
+using gfase::IncrementalIdMap;
+using gfase::Bipartition;
+using bdsg::HashGraph;
+
+#include <unordered_set>
+#include <stdexcept>
+#include <iostream>
+#include <vector>
+
+using std::unordered_set;
+using std::runtime_error;
+using std::to_string;
+using std::vector;
+using std::cerr;
+
+
+/// Build a chain of diploid bubbles: 1 -> (2,3) -> 4 -> (5,6) -> 7 ... and collect the ids of the bubble sides
+void build_bubble_chain(
+        HashGraph& graph,
+        IncrementalIdMap<string>& id_map,
+        size_t n_bubbles,
+        vector <pair <nid_t, nid_t> >& bubbles,
+        unordered_set<nid_t>& diploid_nodes){
+
+    auto create_node = [&](){
+        auto id = id_map.insert(to_string(id_map.size()));
+        return graph.create_handle("A", id);
+    };
+
+    auto prev = create_node();
+
+    for (size_t i=0; i<n_bubbles; i++){
+        auto a = create_node();
+        auto b = create_node();
+        auto next = create_node();
+
+        graph.create_edge(prev, a);
+        graph.create_edge(prev, b);
+        graph.create_edge(a, next);
+        graph.create_edge(b, next);
+
+        bubbles.emplace_back(graph.get_id(a), graph.get_id(b));
+        diploid_nodes.emplace(graph.get_id(a));
+        diploid_nodes.emplace(graph.get_id(b));
+
+        prev = next;
+    }
+}
+
+
+void test_merge_bubble_sides(){
+    HashGraph graph;
+    IncrementalIdMap<string> id_map;
+    vector <pair <nid_t, nid_t> > bubbles;
+    unordered_set<nid_t> diploid_nodes;
+
+    size_t n_bubbles = 1000;
+    build_bubble_chain(graph, id_map, n_bubbles, bubbles, diploid_nodes);
+
+    Bipartition bipartition(graph, id_map, diploid_nodes);
+    bipartition.partition();
+
+    // Every bubble side and every node between bubbles is its own subgraph
+    if (bipartition.size() != graph.get_node_count()){
+        throw runtime_error("FAIL: expected one subgraph per node, found " + to_string(bipartition.size()));
+    }
+
+    vector <pair <size_t,size_t> > merges;
+    for (auto& [a,b]: bubbles){
+        merges.emplace_back(bipartition.get_subgraph_index_of_parent_node(a), bipartition.get_subgraph_index_of_parent_node(b));
+    }
+
+    bipartition.merge_subgraphs(merges);
+
+    if (bipartition.size() != graph.get_node_count() - n_bubbles){
+        throw runtime_error("FAIL: wrong number of subgraphs after merging: " + to_string(bipartition.size()));
+    }
+
+    for (auto& [a,b]: bubbles){
+        auto index = bipartition.get_subgraph_index_of_parent_node(a);
+
+        if (bipartition.get_subgraph_index_of_parent_node(b) != index){
+            throw runtime_error("FAIL: bubble sides not in the same subgraph after merging");
+        }
+
+        if (bipartition.get_subgraph_size(index) != 2){
+            throw runtime_error("FAIL: merged bubble subgraph does not have 2 nodes");
+        }
+
+        // Both sides of the bubble have an edge on the left and right, and they should all be reachable from the
+        // metagraph edges of the merged subgraph
+        for (bool go_left: {true, false}){
+            size_t n_edges = 0;
+            bipartition.follow_subgraph_edges(index, go_left, [&](const handle_t& h){
+                n_edges++;
+            });
+
+            if (n_edges != 2){
+                throw runtime_error("FAIL: merged subgraph has " + to_string(n_edges) + " parent edges on one side");
+            }
+        }
+    }
+}
+
+
+void test_merge_whole_partition(){
+    HashGraph graph;
+    IncrementalIdMap<string> id_map;
+    vector <pair <nid_t, nid_t> > bubbles;
+    unordered_set<nid_t> diploid_nodes;
+
+    size_t n_bubbles = 1000;
+    build_bubble_chain(graph, id_map, n_bubbles, bubbles, diploid_nodes);
+
+    Bipartition bipartition(graph, id_map, diploid_nodes);
+    bipartition.partition();
+
+    // Merge every bubble side into the first one, in a long chain of merges which each refer to the previous one
+    vector <pair <size_t,size_t> > merges;
+    size_t prev_index = bipartition.get_subgraph_index_of_parent_node(bubbles[0].first);
+
+    for (auto& [a,b]: bubbles){
+        for (auto id: {a,b}){
+            auto index = bipartition.get_subgraph_index_of_parent_node(id);
+            merges.emplace_back(prev_index, index);
+            prev_index = index;
+        }
+    }
+
+    bipartition.merge_subgraphs(merges);
+
+    auto first_index = bipartition.get_subgraph_index_of_parent_node(bubbles[0].first);
+
+    for (auto id: diploid_nodes){
+        if (bipartition.get_subgraph_index_of_parent_node(id) != first_index){
+            throw runtime_error("FAIL: node not merged into the first subgraph: " + to_string(id));
+        }
+    }
+
+    if (bipartition.get_subgraph_size(first_index) != diploid_nodes.size()){
+        throw runtime_error("FAIL: merged subgraph has " + to_string(bipartition.get_subgraph_size(first_index)) + " nodes");
+    }
+
+    if (bipartition.size() != n_bubbles + 2){
+        throw runtime_error("FAIL: wrong number of subgraphs after merging: " + to_string(bipartition.size()));
+    }
+
+    size_t n_edges = 0;
+    for (bool go_left: {true, false}){
+        bipartition.follow_subgraph_edges(first_index, go_left, [&](const handle_t& h){
+            n_edges++;
+        });
+    }
+
+    if (n_edges != 4*n_bubbles){
+        throw runtime_error("FAIL: merged subgraph has " + to_string(n_edges) + " parent edges");
+    }
+}
+
+
+int main(){
+    cerr << "TESTING merging of bubble sides:" << '\n';
+    test_merge_bubble_sides();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING merging of a whole partition:" << '\n';
+    test_merge_whole_partition();
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
@@ -73,8 +73,41 @@ void run_test(string& data_file,
     }
 }
 
+// bridges should be found in every connected component, and a self loop should keep its node from being a bridge
+void test_loops_and_disconnected_components() {
+    
+    HashGraph graph;
+    
+    handle_t a = graph.create_handle("A");
+    handle_t b = graph.create_handle("C");
+    handle_t c = graph.create_handle("G");
+    handle_t d = graph.create_handle("T");
+    handle_t e = graph.create_handle("A");
+    
+    graph.create_edge(a, b);
+    graph.create_edge(b, b);
+    graph.create_edge(b, c);
+    graph.create_edge(d, e);
+    
+    set<nid_t> bridges;
+    for (auto bridge : bridge_nodes(graph)) {
+        if (graph.get_is_reverse(bridge)) {
+            throw runtime_error("ERROR: bridge returned in reverse orientation");
+        }
+        bridges.insert(graph.get_id(bridge));
+    }
+    
+    set<nid_t> correct_bridges{graph.get_id(a), graph.get_id(c), graph.get_id(d), graph.get_id(e)};
+    
+    if (bridges != correct_bridges) {
+        throw runtime_error("ERROR: incorrect bridges detected in graph with self loop and multiple components");
+    }
+}
+
 int main(){
 
+    test_loops_and_disconnected_components();
+
     {
         string file = "data/simple_chain.gfa";
         set<string> correct_names{"i", "j", "k", "l", "m"};
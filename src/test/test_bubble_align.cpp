@@ -6,6 +6,9 @@
 #include "align.hpp"
 
 using gfase::construct_alignment_graph;
+using gfase::AlignmentScheduler;
+using gfase::AlignmentRecord;
+using gfase::build_alignment_graph;
 using gfase::gfa_to_handle_graph;
 using gfase::MultiContactGraph;
 using gfase::HashResult;
@@ -70,23 +73,27 @@ void infer_bubbles_from_alignment(
     MultiContactGraph alignment_graph;
     MultiContactGraph symmetrical_alignment_graph;
 
+    // Pairs are resolved to ids/lengths and ordered by cost before any sequence is touched
+    AlignmentScheduler scheduler(to_be_aligned, graph, id_map, min_ab_over_a);
+
     // Thread-related variables
-    atomic<size_t> job_index = 0;
     vector<thread> threads;
-    mutex output_mutex;
+
+    // Each thread collects its own results, which are only combined into the graph at the end
+    vector <vector <AlignmentRecord> > results_per_thread(n_threads);
 
     // Launch threads
     for (uint64_t n=0; n<n_threads; n++){
         try {
             threads.emplace_back(thread(
                     construct_alignment_graph,
-                    ref(to_be_aligned),
+                    ref(scheduler),
                     ref(graph),
                     ref(id_map),
-                    ref(alignment_graph),
+                    ref(results_per_thread[n]),
                     min_ab_over_a,
-                    ref(output_mutex),
-                    ref(job_index)
+                    false,
+                    0
             ));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -99,7 +106,9 @@ void infer_bubbles_from_alignment(
         n.join();
     }
 
-    get_best_overlaps(min_ab_over_a, id_map, alignment_graph, symmetrical_alignment_graph);
+    build_alignment_graph(results_per_thread, alignment_graph);
+
+    get_best_overlaps(min_ab_over_a, alignment_graph, symmetrical_alignment_graph);
     write_alignment_results_to_file(id_map, alignment_graph, symmetrical_alignment_graph, output_dir);
 
     cerr << t << "Done" << '\n';
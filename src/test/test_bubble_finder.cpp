@@ -0,0 +1,164 @@
+#include "BubbleFinder.hpp"
+#include "BubbleGraph.hpp"
+#include "hash_graph.hpp"
+
+using gfase::for_each_neighborhood_in_parallel;
+using gfase::get_neighborhood_chunk_count;
+using gfase::find_diploid_bubbles;
+using gfase::NodeNeighborhood;
+using gfase::BubbleGraph;
+using gfase::SmallIdSet;
+using bdsg::HashGraph;
+
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::runtime_error;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::cerr;
+
+
+/// Build a chain of diploid bubbles: 1 -> (2,3) -> 4 -> (5,6) -> 7 ... and return the expected bubble pairs. A hub node
+/// with many neighbors is attached to the end of the chain so that the neighbor sets overflow their inline storage.
+vector <pair <nid_t, nid_t> > build_bubble_chain(HashGraph& graph, nid_t n_bubbles){
+    vector <pair <nid_t, nid_t> > expected;
+
+    auto prev = graph.create_handle("A", 1);
+
+    for (nid_t i=0; i<n_bubbles; i++){
+        nid_t id = 3*i + 2;
+
+        auto a = graph.create_handle("A", id);
+        auto b = graph.create_handle("C", id + 1);
+        auto next = graph.create_handle("G", id + 2);
+
+        graph.create_edge(prev, a);
+        graph.create_edge(prev, b);
+        graph.create_edge(a, next);
+        graph.create_edge(b, next);
+
+        expected.emplace_back(id, id + 1);
+        prev = next;
+    }
+
+    auto hub = graph.create_handle("T");
+    graph.create_edge(prev, hub);
+
+    for (size_t i=0; i<10; i++){
+        graph.create_edge(hub, graph.create_handle("T"));
+    }
+
+    return expected;
+}
+
+
+void test_small_id_set(){
+    SmallIdSet s;
+
+    for (nid_t id: {7, 3, 9, 3, 1, 12, 5, 7, 2}){
+        s.insert(id);
+    }
+
+    vector<nid_t> expected = {1, 2, 3, 5, 7, 9, 12};
+    vector<nid_t> result(s.begin(), s.end());
+
+    if (result != expected){
+        throw runtime_error("FAIL: SmallIdSet not sorted/unique after overflow");
+    }
+
+    s.clear();
+    s.insert(4);
+
+    if (s.size() != 1 or s.front() != 4){
+        throw runtime_error("FAIL: SmallIdSet clear after overflow");
+    }
+
+    SmallIdSet other;
+    other.insert(4);
+
+    if (s != other){
+        throw runtime_error("FAIL: SmallIdSet equality between spilled and inline sets");
+    }
+}
+
+
+int main(){
+    cerr << "TESTING SmallIdSet:" << '\n';
+    test_small_id_set();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING find_diploid_bubbles:" << '\n';
+
+    HashGraph graph;
+    auto expected = build_bubble_chain(graph, 10000);
+
+    for (size_t n_threads: {1, 2, 8}){
+        vector <pair <nid_t, nid_t> > result;
+        find_diploid_bubbles(graph, result, n_threads);
+
+        if (result != expected){
+            throw runtime_error("FAIL: unexpected bubbles with n_threads=" + to_string(n_threads)
+                                + ", found " + to_string(result.size()) + " expected " + to_string(expected.size()));
+        }
+
+        BubbleGraph bubble_graph(graph, n_threads);
+
+        if (bubble_graph.size() != expected.size()){
+            throw runtime_error("FAIL: unexpected BubbleGraph size with n_threads=" + to_string(n_threads));
+        }
+
+        for (size_t b=0; b<expected.size(); b++){
+            auto bubble = bubble_graph.at(b);
+
+            if (bubble.ids[0] != expected[b].first or bubble.ids[1] != expected[b].second){
+                throw runtime_error("FAIL: bubble ids not deterministic with n_threads=" + to_string(n_threads));
+            }
+        }
+    }
+
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING for_each_neighborhood_in_parallel visits every node once:" << '\n';
+
+    vector<size_t> counts_per_chunk(get_neighborhood_chunk_count(graph), 0);
+    for_each_neighborhood_in_parallel(graph, 4, [&](const NodeNeighborhood& n, size_t chunk_index){
+        counts_per_chunk[chunk_index]++;
+    });
+
+    size_t total = 0;
+    for (auto c: counts_per_chunk){
+        total += c;
+    }
+
+    if (total != graph.get_node_count()){
+        throw runtime_error("FAIL: visited " + to_string(total) + " of " + to_string(graph.get_node_count()) + " nodes");
+    }
+
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING for_each_neighborhood_in_parallel rethrows callback errors:" << '\n';
+
+    bool caught = false;
+    try {
+        for_each_neighborhood_in_parallel(graph, 4, [&](const NodeNeighborhood& n, size_t chunk_index){
+            if (n.id == 5000){
+                throw runtime_error("expected failure");
+            }
+        });
+    }
+    catch (const runtime_error& e){
+        caught = (string(e.what()) == "expected failure");
+    }
+
+    if (not caught){
+        throw runtime_error("FAIL: callback exception was not propagated");
+    }
+
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
@@ -7,10 +7,12 @@
 #include "Chainer.hpp"
 #include "CLI11.hpp"
 
+using gfase::ChainTraversalContext;
 using gfase::gfa_to_handle_graph;
 using gfase::MultiContactGraph;
 using gfase::IncrementalIdMap;
 using gfase::Chainer;
+using gfase::chain_t;
 
 using bdsg::HashGraph;
 
@@ -27,6 +29,7 @@ using CLI::App;
 #include <limits>
 #include <vector>
 #include <array>
+#include <queue>
 #include <set>
 
 using std::numeric_limits;
@@ -42,6 +45,7 @@ using std::shuffle;
 using std::string;
 using std::vector;
 using std::array;
+using std::queue;
 using std::pair;
 using std::stoi;
 using std::cerr;
@@ -111,6 +115,281 @@ void chain(path output_dir, path gfa_path){
 }
 
 
+/// Two bubble chains, 1 -> (2,3) -> 4 -> (5,6) -> 7 and 8 -> (9,10) -> 11, where node 4 is stored in reverse
+void build_flipped_chains(HashGraph& graph, IncrementalIdMap<string>& id_map){
+    for (nid_t id=1; id<=11; id++){
+        graph.create_handle(id == 4 ? "ACCG" : "A", id_map.insert(to_string(id)));
+    }
+
+    auto h = [&](nid_t id){ return graph.get_handle(id, id == 4); };
+
+    vector <pair <nid_t,nid_t> > edges = {{1,2}, {1,3}, {2,4}, {3,4}, {4,5}, {4,6}, {5,7}, {6,7}, {8,9}, {8,10}, {9,11}, {10,11}};
+
+    for (auto& [a,b]: edges){
+        graph.create_edge(h(a), h(b));
+    }
+}
+
+
+/// Reference for the chain search as it was before ChainTraversalContext: a fresh hash set of visited nodes per chain
+void get_chain_reference(const HandleGraph& graph, const ChainTraversalContext& annotation, nid_t start_node, chain_t& chain){
+    unordered_set<nid_t> visited;
+    queue <set <nid_t> > q;
+
+    auto enqueue = [&](nid_t id){
+        auto i = annotation.get_index(id);
+
+        if (annotation.get_ploidy(i) > 0){
+            q.emplace();
+            q.back().emplace(id);
+
+            if (annotation.get_ploidy(i) == 2){
+                auto alt = annotation.get_id(annotation.get_alt(i));
+                visited.emplace(alt);
+                q.back().emplace(alt);
+            }
+        }
+    };
+
+    for (bool go_left: {true, false}){
+        enqueue(start_node);
+
+        while (not q.empty()){
+            auto item = q.front();
+            q.pop();
+
+            if (go_left){
+                chain.emplace_front(item);
+            }
+            else if (item.count(start_node) == 0){
+                chain.emplace_back(item);
+            }
+
+            graph.follow_edges(graph.get_handle(*item.begin()), go_left, [&](const handle_t& other){
+                auto id = graph.get_id(other);
+
+                if (visited.emplace(id).second){
+                    enqueue(id);
+                }
+            });
+        }
+    }
+}
+
+
+/// Reference for harmonize_chain_orientations as it was before ChainTraversalContext
+void harmonize_reference(MutableHandleGraph& graph, const ChainTraversalContext& annotation){
+    auto is_chainable = [&](nid_t id){
+        return annotation.get_ploidy(annotation.get_index(id)) > 0;
+    };
+
+    // Collected first, because the graph is reoriented along the way
+    vector<nid_t> ids;
+    graph.for_each_handle([&](const handle_t& handle){
+        ids.emplace_back(graph.get_id(handle));
+    });
+
+    set<nid_t> visited;
+
+    for (auto start: ids){
+        if (visited.count(start) or not is_chainable(start)){
+            continue;
+        }
+
+        // Undirected subgraph of chainable nodes
+        set<nid_t> subgraph = {start};
+        queue<nid_t> q;
+        q.push(start);
+
+        while (not q.empty()){
+            auto id = q.front();
+            q.pop();
+
+            for (bool go_left: {true, false}){
+                graph.follow_edges(graph.get_handle(id), go_left, [&](const handle_t& other){
+                    auto other_id = graph.get_id(other);
+
+                    if (is_chainable(other_id) and subgraph.emplace(other_id).second){
+                        q.push(other_id);
+                    }
+                });
+            }
+        }
+
+        visited.insert(subgraph.begin(), subgraph.end());
+
+        // Orientations relative to the smallest node, within the subgraph
+        array <set <nid_t>, 2> orientations;
+        set <pair <nid_t,bool> > visited_handles;
+        queue<handle_t> oriented_q;
+
+        auto start_handle = graph.get_handle(*subgraph.begin());
+        oriented_q.push(start_handle);
+        visited_handles.emplace(*subgraph.begin(), false);
+
+        while (not oriented_q.empty()){
+            auto h = oriented_q.front();
+            oriented_q.pop();
+
+            orientations[graph.get_is_reverse(h)].emplace(graph.get_id(h));
+
+            for (bool go_left: {true, false}){
+                graph.follow_edges(h, go_left, [&](const handle_t& other){
+                    auto key = pair<nid_t,bool>(graph.get_id(other), graph.get_is_reverse(other));
+
+                    if (subgraph.count(key.first) and visited_handles.emplace(key).second){
+                        oriented_q.push(other);
+                    }
+                });
+            }
+        }
+
+        if (not orientations[0].empty() and not orientations[1].empty()){
+            bool smaller_index = orientations[0].size() > orientations[1].size();
+
+            for (auto id: orientations[smaller_index]){
+                graph.apply_orientation(graph.get_handle(id, true));
+            }
+        }
+    }
+}
+
+
+/// Two traversals in a row on the same context must not see each other's visited stamps
+void test_context_reuse(){
+    HashGraph graph;
+    IncrementalIdMap<string> id_map;
+    build_flipped_chains(graph, id_map);
+
+    Chainer chainer;
+    chainer.find_chainable_nodes(graph, id_map);
+
+    ChainTraversalContext context(graph);
+    chainer.index_chainable_nodes(context);
+
+    for (nid_t start: {1, 8, 1, 2, 7, 7, 11}){
+        chain_t chain;
+        chainer.get_chain(graph, context, start, chain);
+
+        ChainTraversalContext fresh_context(graph);
+        chainer.index_chainable_nodes(fresh_context);
+
+        chain_t expected;
+        chainer.get_chain(graph, fresh_context, start, expected);
+
+        if (chain.empty() or chain != expected){
+            throw runtime_error("FAIL: chain from node " + to_string(start) + " differs when the context is reused");
+        }
+    }
+
+    vector <set <nid_t> > previous;
+
+    for (size_t i=0; i<2; i++){
+        vector <set <nid_t> > subgraphs;
+        array <vector <uint32_t>, 2> orientations;
+
+        chainer.for_each_chain_subgraph(graph, context, [&](const uint32_t* begin, const uint32_t* end){
+            subgraphs.emplace_back();
+
+            for (auto iter = begin; iter != end; ++iter){
+                subgraphs.back().emplace(context.get_id(*iter));
+            }
+
+            // Starts its own epoch, between the spans of the enclosing traversal
+            chainer.get_oriented_subgraph(graph, context, begin, end, orientations);
+
+            if (orientations[0].size() + orientations[1].size() != size_t(end - begin)){
+                throw runtime_error("FAIL: oriented subgraph does not cover its span");
+            }
+        });
+
+        vector <set <nid_t> > expected = {{1,2,3,4,5,6,7}, {8,9,10,11}};
+
+        if (subgraphs != expected){
+            throw runtime_error("FAIL: unexpected chain subgraphs in traversal " + to_string(i));
+        }
+
+        if (i > 0 and subgraphs != previous){
+            throw runtime_error("FAIL: chain subgraphs differ when the context is reused");
+        }
+
+        previous = subgraphs;
+    }
+}
+
+
+/// Orientations and chains must match the previous implementation when one node of a chain is stored in reverse
+void test_flipped_node(){
+    HashGraph graph;
+    HashGraph reference_graph;
+    IncrementalIdMap<string> id_map;
+    IncrementalIdMap<string> reference_id_map;
+
+    build_flipped_chains(graph, id_map);
+    build_flipped_chains(reference_graph, reference_id_map);
+
+    Chainer chainer;
+    chainer.find_chainable_nodes(graph, id_map);
+
+    ChainTraversalContext annotation(reference_graph);
+    chainer.index_chainable_nodes(annotation);
+
+    chainer.harmonize_chain_orientations(graph);
+    harmonize_reference(reference_graph, annotation);
+
+    for (nid_t id=1; id<=11; id++){
+        if (graph.get_sequence(graph.get_handle(id)) != reference_graph.get_sequence(reference_graph.get_handle(id))){
+            throw runtime_error("FAIL: orientation of node " + to_string(id) + " differs from the reference");
+        }
+    }
+
+    if (graph.get_sequence(graph.get_handle(4)) != "CGGT"){
+        throw runtime_error("FAIL: flipped node was not reoriented");
+    }
+
+    // Chains may be found in a different order than before, but each one must be identical
+    set<chain_t> chains;
+    chainer.for_each_chain(graph, [&](chain_t& chain){
+        chains.emplace(chain);
+    });
+
+    set<chain_t> reference_chains;
+    set<nid_t> visited;
+
+    reference_graph.for_each_handle([&](const handle_t& h){
+        auto id = reference_graph.get_id(h);
+
+        if (visited.count(id)){
+            return;
+        }
+
+        chain_t chain;
+        get_chain_reference(reference_graph, annotation, id, chain);
+
+        for (auto& item: chain){
+            visited.insert(item.begin(), item.end());
+        }
+
+        if (not chain.empty()){
+            reference_chains.emplace(chain);
+        }
+    });
+
+    set<chain_t> expected = {
+            {{1}, {2,3}, {4}, {5,6}, {7}},
+            {{8}, {9,10}, {11}}
+    };
+
+    if (chains != reference_chains){
+        throw runtime_error("FAIL: chains differ from the reference");
+    }
+
+    if (chains != expected){
+        throw runtime_error("FAIL: unexpected chains after harmonizing orientations");
+    }
+}
+
+
 int main (int argc, char* argv[]){
     path gfa_path;
     path output_dir;
@@ -120,18 +399,27 @@ int main (int argc, char* argv[]){
     app.add_option(
             "-g,--gfa",
             gfa_path,
-            "Path to GFA containing assembly graph to be phased")
-            ->required();
+            "Path to GFA containing assembly graph to be phased");
 
     app.add_option(
             "-o,--output_dir",
             output_dir,
-            "Path to (nonexistent) directory where output will be stored")
-            ->required();
+            "Path to (nonexistent) directory where output will be stored");
 
     CLI11_PARSE(app, argc, argv);
 
-    chain(output_dir, gfa_path);
+    cerr << "TESTING reuse of a ChainTraversalContext:" << '\n';
+    test_context_reuse();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING chains with a flipped node against the previous implementation:" << '\n';
+    test_flipped_node();
+    cerr << "PASS" << '\n';
+
+    // Optionally chain a GFA as well
+    if (not gfa_path.empty() and not output_dir.empty()){
+        chain(output_dir, gfa_path);
+    }
 
     return 0;
 }
@@ -12,6 +12,8 @@ using gfase::IncrementalIdMap;
 using gfase::handle_graph_to_gfa;
 using gfase::for_each_connected_component;
 using gfase::split_connected_components;
+using gfase::find_connected_components;
+using gfase::AdjacencyIndex;
 using gfase::print_graph_paths;
 using gfase::plot_graph;
 
@@ -86,6 +88,74 @@ int main(){
         throw runtime_error("FAIL: cc3 not found");
     }
 
+    // Components are ordered by their smallest id, which follows the order of the GFA
+    vector <unordered_set<string> > expected_components = {cc1, cc2, cc3};
+    vector<size_t> expected_edge_counts = {4, 1, 1};
+
+    for (size_t n_threads: {1, 4}) {
+        vector <vector <nid_t> > components;
+        find_connected_components(graph, components, n_threads);
+
+        vector<HashGraph> graphs;
+        vector <IncrementalIdMap<string> > id_maps;
+        vector<Overlaps> component_overlaps;
+
+        split_connected_components(graph, id_map, overlaps, graphs, id_maps, component_overlaps, false, n_threads);
+
+        if (components.size() != expected_components.size() or graphs.size() != expected_components.size()){
+            throw runtime_error("FAIL: wrong number of components with n_threads=" + to_string(n_threads));
+        }
+
+        for (size_t i=0; i<components.size(); i++){
+            unordered_set<string> cc;
+            unordered_set<string> split_cc;
+
+            for (auto& n: components[i]){
+                cc.emplace(id_map.get_name(n));
+            }
+
+            graphs[i].for_each_handle([&](const handle_t& h){
+                split_cc.emplace(id_maps[i].get_name(graphs[i].get_id(h)));
+            });
+
+            if (cc != expected_components[i] or split_cc != expected_components[i]){
+                throw runtime_error("FAIL: component " + to_string(i) + " does not match truth set with n_threads=" + to_string(n_threads));
+            }
+
+            if (graphs[i].get_edge_count() != expected_edge_counts[i]){
+                throw runtime_error("FAIL: component " + to_string(i) + " has wrong number of edges");
+            }
+
+            if (graphs[i].get_path_count() != 1){
+                throw runtime_error("FAIL: component " + to_string(i) + " has wrong number of paths");
+            }
+        }
+
+        // Every pair of nodes is adjacent in the index iff an edge joins them on either side
+        AdjacencyIndex adjacency(graph, n_threads);
+
+        graph.for_each_handle([&](const handle_t& a){
+            unordered_set<nid_t> neighbors;
+
+            for (bool go_left: {false, true}){
+                graph.follow_edges(a, go_left, [&](const handle_t& b){
+                    neighbors.emplace(graph.get_id(b));
+                });
+            }
+
+            if (adjacency.get_degree(graph.get_id(a)) != neighbors.size()){
+                throw runtime_error("FAIL: wrong degree in adjacency index for node " + id_map.get_name(graph.get_id(a)));
+            }
+
+            graph.for_each_handle([&](const handle_t& b){
+                if (adjacency.has_edge(graph.get_id(a), graph.get_id(b)) != (neighbors.count(graph.get_id(b)) > 0)){
+                    throw runtime_error("FAIL: adjacency index disagrees with graph for " + id_map.get_name(graph.get_id(a))
+                                        + "," + id_map.get_name(graph.get_id(b)));
+                }
+            });
+        });
+    }
+
     vector<HashGraph> connected_component_graphs;
     vector <IncrementalIdMap<string> > connected_component_ids;
     vector<Overlaps> connected_component_overlaps;
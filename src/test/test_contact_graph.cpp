@@ -5,6 +5,7 @@ using gfase::Node;
 using gfase::ContactGraph;
 using gfase::IncrementalIdMap;
 using gfase::random_phase_search;
+using gfase::SplitMix64;
 
 #include <iostream>
 
@@ -243,8 +244,10 @@ void test_optimization(){
     cerr << "-- validating alts --" << '\n';
     g.validate_alts();
 
+    SplitMix64 rng(0);
+
     g.get_node_ids(ids);
-    g.randomize_partitions();
+    g.randomize_partitions(rng);
     g.get_partitions(best_partitions);
 
     cerr << "-- validating alts --" << '\n';
@@ -252,7 +255,7 @@ void test_optimization(){
 
     cerr << g.compute_consistency_score(2) << '\n';
 
-    random_phase_search(g, ids, best_partitions, best_score, job_index, phase_mutex, m_iterations);
+    random_phase_search(g, ids, best_partitions, best_score, job_index, phase_mutex, m_iterations, rng.split());
 
     g.set_partitions(best_partitions);
     cerr << "After optimization:" << '\n';
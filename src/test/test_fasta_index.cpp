@@ -0,0 +1,208 @@
+#include "FastaIndex.hpp"
+
+using gfase::FastaRecord;
+using gfase::FastaIndex;
+using ghc::filesystem::last_write_time;
+using ghc::filesystem::remove;
+using ghc::filesystem::exists;
+
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <map>
+
+using std::runtime_error;
+using std::stringstream;
+using std::to_string;
+using std::ifstream;
+using std::ofstream;
+using std::mt19937;
+using std::cerr;
+using std::map;
+
+
+void write_file(path file_path, const string& s){
+    ofstream file(file_path, std::ios::binary);
+    file << s;
+}
+
+
+string read_file(path file_path){
+    ifstream file(file_path, std::ios::binary);
+    stringstream s;
+    s << file.rdbuf();
+    return s.str();
+}
+
+
+void clear_index(path fasta_path){
+    auto fai_path = FastaIndex::get_fai_path(fasta_path);
+    if (exists(fai_path)){
+        remove(fai_path);
+    }
+}
+
+
+void test_lengths(const FastaIndex& index, const map<string,size_t>& expected){
+    if (index.size() != expected.size()){
+        throw runtime_error("FAIL: index has " + to_string(index.size()) + " records, expected " + to_string(expected.size()));
+    }
+
+    for (auto& [name, length]: expected){
+        if (not index.has_record(name)){
+            throw runtime_error("FAIL: record not found: " + name);
+        }
+
+        if (index.get_record(name).length != length){
+            throw runtime_error("FAIL: record " + name + " has length " + to_string(index.get_record(name).length)
+                                + ", expected " + to_string(length));
+        }
+    }
+}
+
+
+void test_wrapped_fasta(){
+    path fasta_path = "test_fasta_index.fasta";
+    path output_path = "test_fasta_index_subset.fasta";
+
+    // Wrapped lines, an empty record, CRLF line endings, and no newline at the end of the file
+    write_file(fasta_path,
+               ">a some description\nACGT\nACGT\nAC\n"
+               ">b\n\n"
+               ">c\tdescription\nACG\r\nTT\r\n"
+               ">d\nAAAA\nCC");
+
+    map<string,size_t> expected = {{"a",10}, {"b",0}, {"c",5}, {"d",6}};
+    string expected_subset = ">a\nACGT\nACGT\nAC\n>c\nACG\r\nTT\r\n>d\nAAAA\nCC\n";
+
+    auto fai_path = FastaIndex::get_fai_path(fasta_path);
+
+    for (size_t n_threads: {1, 2, 8}){
+        clear_index(fasta_path);
+
+        FastaIndex index(fasta_path, n_threads);
+        test_lengths(index, expected);
+
+        if (not exists(fai_path)){
+            throw runtime_error("FAIL: .fai not written for uniform FASTA");
+        }
+
+        // Loaded from the .fai this time
+        FastaIndex loaded_index(fasta_path, n_threads);
+        test_lengths(loaded_index, expected);
+
+        index.for_each_record([&](const FastaRecord& a){
+            auto& b = loaded_index.get_record(a.name);
+
+            if (a.offset != b.offset or a.line_bases != b.line_bases or a.line_width != b.line_width){
+                throw runtime_error("FAIL: .fai round trip does not match for record: " + a.name);
+            }
+        });
+
+        for (auto i: {&index, &loaded_index}){
+            i->write_records(output_path, [&](const FastaRecord& r){
+                return r.name != "x";
+            });
+
+            auto result = read_file(output_path);
+
+            if (result != expected_subset){
+                throw runtime_error("FAIL: unexpected output from write_records:\n" + result);
+            }
+        }
+    }
+
+    // Rewrite the FASTA so that the existing index is stale
+    write_file(fasta_path, ">e\nACGTACGT\n");
+    last_write_time(fasta_path, last_write_time(fai_path) + std::chrono::seconds(1));
+
+    FastaIndex rebuilt_index(fasta_path);
+    test_lengths(rebuilt_index, {{"e",8}});
+
+    // Lines of varying width can't be described by a .fai, but can still be indexed and copied
+    clear_index(fasta_path);
+    write_file(fasta_path, ">x\nAC\nACGT\n\n>y\nA\n");
+
+    FastaIndex nonuniform_index(fasta_path);
+    test_lengths(nonuniform_index, {{"x",6}, {"y",1}});
+
+    if (exists(fai_path)){
+        throw runtime_error("FAIL: .fai written for FASTA with varying line widths");
+    }
+
+    nonuniform_index.write_records(output_path, [&](const FastaRecord& r){
+        return r.name == "x";
+    });
+
+    if (read_file(output_path) != ">x\nAC\nACGT\n"){
+        throw runtime_error("FAIL: unexpected output from write_records for FASTA with varying line widths");
+    }
+
+    // Names must be unique
+    write_file(fasta_path, ">x\nA\n>x\nC\n");
+
+    bool threw = false;
+    try {
+        FastaIndex duplicate_index(fasta_path, 1, false);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+
+    if (not threw){
+        throw runtime_error("FAIL: duplicate record names not detected");
+    }
+}
+
+
+void test_random_fasta(){
+    path fasta_path = "test_fasta_index_random.fasta";
+
+    mt19937 generator(42);
+    std::uniform_int_distribution<size_t> length_distribution(0, 300);
+    std::uniform_int_distribution<size_t> width_distribution(1, 80);
+
+    map<string,size_t> expected;
+    string fasta;
+
+    for (size_t i=0; i<2000; i++){
+        string name = "contig_" + to_string(i);
+        auto length = length_distribution(generator);
+        auto width = width_distribution(generator);
+
+        expected.emplace(name, length);
+
+        fasta += '>' + name + " len=" + to_string(length) + '\n';
+
+        for (size_t j=0; j<length; j++){
+            fasta += "ACGT"[generator() % 4];
+
+            if ((j + 1) % width == 0 or j + 1 == length){
+                fasta += '\n';
+            }
+        }
+    }
+
+    write_file(fasta_path, fasta);
+
+    for (size_t n_threads: {1, 3, 16}){
+        FastaIndex index(fasta_path, n_threads, false);
+        test_lengths(index, expected);
+    }
+}
+
+
+int main(){
+    cerr << "TESTING FastaIndex on small FASTA:" << '\n';
+    test_wrapped_fasta();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING FastaIndex on random FASTA with multiple threads:" << '\n';
+    test_random_fasta();
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
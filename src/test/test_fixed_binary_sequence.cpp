@@ -9,6 +9,7 @@
 
 using gfase::get_reverse_complement;
 using gfase::FixedBinarySequence;
+using gfase::extract_kmers;
 using gfase::BinarySequence;
 using gfase::KmerSets;
 using std::unordered_set;
@@ -31,7 +32,106 @@ template <class T, size_t T2> void print_bucket_info(unordered_set <FixedBinaryS
 }
 
 
+void test_extract_kmers(const string& s, size_t k){
+    vector <FixedBinarySequence<uint64_t,2> > kmers;
+    vector <size_t> positions;
+    extract_kmers(s, k, kmers, positions);
+
+    size_t n = 0;
+    for (size_t i=0; i + k <= s.size(); i++){
+        auto kmer = s.substr(i, k);
+
+        if (kmer.find_first_not_of("ACGT") != string::npos){
+            continue;
+        }
+
+        if (n >= kmers.size() or positions[n] != i or not (kmers[n] == FixedBinarySequence<uint64_t,2>(kmer))){
+            throw runtime_error("FAIL: extracted kmer does not match " + kmer + " at " + to_string(i) + " for k=" + to_string(k));
+        }
+
+        n++;
+    }
+
+    if (n != kmers.size()){
+        throw runtime_error("FAIL: extracted " + to_string(kmers.size()) + " kmers, expected " + to_string(n) + " for k=" + to_string(k));
+    }
+}
+
+
+/// Packed kernels (bulk encode, word-wise reverse complement, shift, kmer extraction) against per-base encoding
+void test_packed_kernels(){
+    cerr << "TESTING: packed kernels against per-base encoding" << '\n';
+
+    for (size_t i=0; i<4096; i++) {
+        size_t length = 1 + rand() % 55;
+        string random_sequence;
+
+        for (size_t j = 0; j < length; j++) {
+            random_sequence += FixedBinarySequence<int,4>::index_to_base[rand() % 4];
+        }
+
+        // Deque input goes through the generic per-base constructor
+        deque<char> d(random_sequence.begin(), random_sequence.end());
+
+        FixedBinarySequence<uint64_t,2> bs(random_sequence);
+        FixedBinarySequence<uint64_t,2> bs_per_base(d);
+
+        if (not (bs == bs_per_base)){
+            throw runtime_error("FAIL: bulk encoding does not match per-base encoding for " + random_sequence);
+        }
+
+        string rc_sequence;
+        get_reverse_complement(random_sequence, rc_sequence, random_sequence.size());
+
+        FixedBinarySequence<uint64_t,2> rc;
+        bs.get_reverse_complement(rc, length);
+
+        if (not (rc == FixedBinarySequence<uint64_t,2>(rc_sequence))){
+            throw runtime_error("FAIL: packed reverse complement does not match for " + random_sequence);
+        }
+
+        // Shift is not limited to kmers which fill the array
+        FixedBinarySequence<uint8_t,16> shifted(random_sequence);
+        shifted.shift('G', length);
+
+        if (not (shifted == FixedBinarySequence<uint8_t,16>(random_sequence.substr(1) + 'G'))){
+            throw runtime_error("FAIL: shifted kmer does not match for " + random_sequence);
+        }
+    }
+
+    test_extract_kmers("ACGTTGCANNACGTAGGTCAAAGCTNA", 5);
+
+    // Longer sequences go through the 32 base block encoder, so place Ns inside a block and on either side of a block
+    // boundary, and extract kmers up to the full capacity of the array
+    string long_sequence;
+    for (size_t i=0; i<200; i++){
+        long_sequence += FixedBinarySequence<int,4>::index_to_base[rand() % 4];
+    }
+
+    vector <string> long_sequences = {long_sequence, long_sequence, long_sequence, long_sequence, long_sequence};
+    long_sequences[1][45] = 'N';
+    long_sequences[2][32] = 'N';
+    long_sequences[2][64] = 'N';
+    long_sequences[3][31] = 'N';
+    long_sequences[3][96] = 'N';
+    long_sequences[3][160] = 'n';
+    long_sequences[4][10] = 'N';
+    long_sequences[4][75] = 'N';
+    long_sequences[4][140] = 'N';
+
+    for (auto& s: long_sequences){
+        for (size_t k: {1, 5, 21, 31, 32, 33, 63, 64}){
+            test_extract_kmers(s, k);
+        }
+    }
+
+    cerr << "PASS" << '\n';
+}
+
+
 int main(){
+    test_packed_kernels();
+
     string s = "ATATATATATAT";
 
     {
@@ -32,11 +32,12 @@ using std::set;
 using std::vector;
 using std::pair;
 
-void run_test(string& data_file,
-              const set<string>& phase_0_nodes,
-              const set<string>& phase_1_nodes,
-              const set<pair<string, string>> alt_pairs,
-              const vector<vector<pair<string, bool>>>& correct_phase_paths) {
+void run_test_with_threads(string& data_file,
+                           const set<string>& phase_0_nodes,
+                           const set<string>& phase_1_nodes,
+                           const set<pair<string, string>> alt_pairs,
+                           const vector<vector<pair<string, bool>>>& correct_phase_paths,
+                           size_t n_threads) {
     
     path script_path = __FILE__;
     path project_directory = script_path.parent_path().parent_path().parent_path();
@@ -123,6 +124,7 @@ void run_test(string& data_file,
     
     HamiltonianChainer chainer;
     chainer.min_haploid_proportion = 0.0; // we don't want this heuristic for these tests
+    chainer.n_threads = n_threads;
     chainer.generate_chain_paths(graph, id_map, contact_graph);
     
     vector<vector<handle_t>> identified_phase_handle_paths;
@@ -152,7 +154,19 @@ void run_test(string& data_file,
                 cerr << endl;
             }
         }
-        throw runtime_error(("ERROR: incorrect phase paths detected in GFA " + data_file).c_str());
+        throw runtime_error(("ERROR: incorrect phase paths detected in GFA " + data_file + " with "
+                             + std::to_string(n_threads) + " thread(s)").c_str());
+    }
+}
+
+void run_test(string& data_file,
+              const set<string>& phase_0_nodes,
+              const set<string>& phase_1_nodes,
+              const set<pair<string, string>> alt_pairs,
+              const vector<vector<pair<string, bool>>>& correct_phase_paths) {
+    // the result should not depend on the number of threads
+    for (size_t n_threads : {1, 4}) {
+        run_test_with_threads(data_file, phase_0_nodes, phase_1_nodes, alt_pairs, correct_phase_paths, n_threads);
     }
 }
 
@@ -4,6 +4,20 @@
 using gfase::IncrementalIdMap;
 using std::cerr;
 
+
+void test_equal(const IncrementalIdMap<string>& a, const IncrementalIdMap<string>& b){
+    if (a.size() != b.size() or a.zero_based != b.zero_based){
+        throw runtime_error("FAIL: id maps differ in size or base");
+    }
+
+    a.for_each_name([&](string_view name, int64_t id){
+        if (b.get_name_view(id) != name or b.get_id(name) != id){
+            throw runtime_error("FAIL: id maps differ for name: " + string(name));
+        }
+    });
+}
+
+
 int main(){
     {
         IncrementalIdMap<string> id_map(true);
@@ -17,9 +31,11 @@ int main(){
 
         IncrementalIdMap<string> id_map_2(output_path);
 
-        for (const auto&[name, id]: id_map_2.ids) {
+        id_map_2.for_each_name([&](string_view name, int64_t id){
             cerr << id << ',' << name << '\n';
-        }
+        });
+
+        test_equal(id_map, id_map_2);
     }
 
     {
@@ -34,10 +50,44 @@ int main(){
 
         IncrementalIdMap<string> id_map_2(output_path);
 
-        for (const auto&[name, id]: id_map_2.ids) {
+        id_map_2.for_each_name([&](string_view name, int64_t id){
             cerr << id << ',' << name << '\n';
+        });
+
+        test_equal(id_map, id_map_2);
+    }
+
+    {
+        // Enough names to resize the hash table several times, including an empty one
+        IncrementalIdMap<string> id_map(false);
+
+        id_map.insert("");
+        for (size_t i=0; i<10000; i++){
+            auto id = id_map.insert("PR." + to_string(i) + ".0");
+
+            if (id_map.try_insert("PR." + to_string(i) + ".0") != id){
+                throw runtime_error("FAIL: try_insert did not return existing id for: PR." + to_string(i) + ".0");
+            }
         }
+
+        if (id_map.exists("PR.10000.0") or not id_map.exists("PR.9999.0") or id_map.get_name(1) != ""){
+            throw runtime_error("FAIL: incorrect name lookup");
+        }
+
+        path output_path = "test_id_map.bin";
+        id_map.write_to_binary(output_path);
+
+        IncrementalIdMap<string> id_map_2(output_path);
+        test_equal(id_map, id_map_2);
+
+        // Inserting into a loaded map must work as usual
+        auto id = id_map_2.insert("extra");
+        if (id_map_2.get_id("extra") != id or id_map_2.get_name(id) != "extra"){
+            throw runtime_error("FAIL: could not insert into loaded binary id map");
+        }
+
+        cerr << "PASS binary round trip of " << id_map.size() << " names" << '\n';
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,76 @@
+#include "Instrumentation.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using gfase::Instrumentation;
+using gfase::ScopedSpan;
+
+using std::runtime_error;
+using std::stringstream;
+using std::to_string;
+using std::ifstream;
+using std::thread;
+using std::vector;
+using std::cerr;
+
+
+int main() {
+    Instrumentation instrumentation;
+    instrumentation.start_progress(0.1);
+
+    {
+        ScopedSpan outer("outer", instrumentation);
+
+        vector<thread> threads;
+
+        for (size_t t=0; t<4; t++){
+            threads.emplace_back([&](){
+                auto& counter = instrumentation.get_counter("items");
+
+                for (size_t i=0; i<100000; i++){
+                    counter.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        for (auto& t: threads){
+            t.join();
+        }
+
+        ScopedSpan inner("inner", instrumentation);
+        instrumentation.set_gauge("n_threads", 4);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+
+    instrumentation.stop_progress();
+
+    auto count = instrumentation.get_counter("items").load();
+    if (count != 400000){
+        throw runtime_error("FAIL: expected 400000 items, counted " + to_string(count));
+    }
+
+    path output_dir = ghc::filesystem::temp_directory_path();
+    instrumentation.write_report(output_dir);
+
+    ifstream file(output_dir / "timing.tsv");
+    stringstream result;
+    result << file.rdbuf();
+
+    cerr << result.str();
+
+    // Inner span is nested one level inside the outer span
+    for (string expected: {"span\touter\t0\t", "span\tinner\t1\t", "counter\titems\t0\t0\t400000", "gauge\tn_threads\t0\t0\t4"}){
+        if (result.str().find(expected) == string::npos){
+            throw runtime_error("FAIL: timing.tsv is missing: " + expected);
+        }
+    }
+
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "VectorMultiContactGraph.hpp"
+#include "MultiContactGraph.hpp"
+#include "optimize.hpp"
+#include "Timer.hpp"
+
+using gfase::parallel_tempering_phase_search;
+using gfase::VectorMultiContactGraph;
+using gfase::get_component_iterations;
+using gfase::random_phase_search;
+using gfase::MultiContactGraph;
+using gfase::OrientationDistribution;
+using gfase::sample_orientation_distribution;
+using gfase::SplitMix64;
+using gfase::Timer;
+
+#include <stdexcept>
+#include <iostream>
+#include <random>
+
+using std::runtime_error;
+using std::to_string;
+using std::cerr;
+using std::pair;
+
+
+/// Build a random graph of n_nodes/2 bubbles with random contacts between them
+MultiContactGraph construct_random_graph(int32_t n_nodes, size_t n_edges, int32_t max_weight){
+    MultiContactGraph g;
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int32_t> id_distribution(1,n_nodes);
+    std::uniform_int_distribution<int32_t> weight_distribution(1,max_weight);
+
+    for (int32_t id=1; id<=n_nodes; id++){
+        g.insert_node(id);
+    }
+
+    for (int32_t id=1; id+1<=n_nodes; id+=2){
+        g.add_alt(id, id+1);
+    }
+
+    for (size_t e=0; e<n_edges; e++){
+        auto a = id_distribution(rng);
+        auto b = id_distribution(rng);
+
+        if (a == b or g.of_same_component(a,b)){
+            continue;
+        }
+
+        g.try_insert_edge(a, b, weight_distribution(rng));
+    }
+
+    return g;
+}
+
+
+int main(){
+    cerr << "TESTING consistency coefficient:" << '\n';
+    {
+        auto g = construct_random_graph(400, 3000, 20);
+        VectorMultiContactGraph v(g);
+        SplitMix64 rng(0);
+        v.randomize_partitions(rng);
+
+        vector<int32_t> ids;
+        v.get_node_ids(ids);
+
+        for (auto id: ids){
+            for (int8_t p: {-1,0,1}){
+                auto expected = v.compute_consistency_score(id, p);
+                auto result = double(p)*v.compute_consistency_coefficient(id);
+
+                if (expected != result){
+                    throw runtime_error("FAIL: node " + to_string(id) + " p=" + to_string(p) + " expected " +
+                                        to_string(expected) + " but got " + to_string(result));
+                }
+            }
+        }
+
+        cerr << "PASS" << '\n';
+    }
+    cerr << "TESTING parallel tempering vs greedy random search:" << '\n';
+    {
+        auto g = construct_random_graph(2000, 20000, 20);
+        VectorMultiContactGraph v(g);
+        SplitMix64 rng(0);
+        v.randomize_partitions(rng);
+
+        auto greedy = v;
+        auto tempered = v;
+
+        Timer t;
+        random_phase_search(greedy, 200, rng);
+        cerr << t << "greedy score: " << greedy.compute_total_consistency_score() << '\n';
+
+        t.reset();
+        parallel_tempering_phase_search(tempered, 50, rng, 8, 1.0, 10.0, 4);
+        cerr << t << "parallel tempering score: " << tempered.compute_total_consistency_score() << '\n';
+
+        // Both searches are seeded, so this comparison is deterministic
+        auto greedy_score = greedy.compute_total_consistency_score();
+        auto tempered_score = tempered.compute_total_consistency_score();
+
+        if (tempered_score < greedy_score){
+            throw runtime_error("FAIL: parallel tempering score " + to_string(tempered_score) +
+                                " is lower than greedy score " + to_string(greedy_score));
+        }
+
+        cerr << "PASS" << '\n';
+    }
+
+    cerr << "TESTING connected components:" << '\n';
+    {
+        // Many small islands of 3 bubbles each, with contacts only inside each island
+        MultiContactGraph g;
+
+        int32_t n_islands = 500;
+        for (int32_t i=0; i<n_islands; i++){
+            int32_t start = i*6 + 1;
+
+            for (int32_t id=start; id<start+6; id++){
+                g.insert_node(id);
+            }
+
+            g.add_alt(start, start+1);
+            g.add_alt(start+2, start+3);
+            g.add_alt(start+4, start+5);
+
+            g.try_insert_edge(start, start+2, 10);
+            g.try_insert_edge(start+2, start+4, 10);
+            g.try_insert_edge(start+1, start+5, 3);
+        }
+
+        VectorMultiContactGraph v(g);
+
+        vector <vector <int32_t> > components;
+        v.get_connected_components(components);
+
+        if (components.size() != size_t(n_islands)){
+            throw runtime_error("FAIL: expected " + to_string(n_islands) + " components, found " + to_string(components.size()));
+        }
+
+        auto global = v;
+        auto local = v;
+
+        SplitMix64 rng(0);
+
+        Timer t;
+        random_phase_search(global, 200, rng);
+        cerr << t << "global score: " << global.compute_total_consistency_score() << '\n';
+
+        t.reset();
+        for (auto& component: components){
+            random_phase_search(local, component, get_component_iterations(component.size(), 200), rng);
+        }
+        cerr << t << "per component score: " << local.compute_total_consistency_score() << '\n';
+
+        // Each island has a perfectly consistent solution
+        if (local.compute_total_consistency_score() != 23*n_islands){
+            throw runtime_error("FAIL: per component search did not converge");
+        }
+
+        cerr << "PASS" << '\n';
+    }
+
+    cerr << "TESTING reproducibility of seeded sampling:" << '\n';
+    {
+        auto g = construct_random_graph(1000, 8000, 20);
+
+        // Same seed must give identical results regardless of the number of threads, in every sampling mode
+        for (auto [use_parallel_tempering, use_components]: {pair(false,false), pair(true,false), pair(false,true)}){
+            vector <vector <pair <int32_t,int8_t> > > results;
+
+            for (size_t n_threads: {1,4}){
+                auto h = g;
+                OrientationDistribution orientation_distribution(h);
+                sample_orientation_distribution(orientation_distribution, h, 8, n_threads, 20, use_parallel_tempering, use_components, 1337);
+
+                results.emplace_back();
+                h.get_partitions(results.back());
+            }
+
+            if (results[0] != results[1]){
+                throw runtime_error("FAIL: results differ between thread counts, use_parallel_tempering=" +
+                                    to_string(use_parallel_tempering) + " use_components=" + to_string(use_components));
+            }
+        }
+
+        cerr << "PASS" << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "MultiContactGraph.hpp"
+#include "OverlapMatcher.hpp"
+
+using gfase::MultiContactGraph;
+using gfase::OverlapMatcher;
+using gfase::MultiNode;
+
+#include <unordered_set>
+#include <stdexcept>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <tuple>
+
+using std::unordered_set;
+using std::runtime_error;
+using std::to_string;
+using std::mt19937;
+using std::vector;
+using std::tuple;
+using std::cerr;
+
+
+double min_similarity = 0.05;
+double overflow_tolerance = 0.15;
+double first_node_penalty = 0.10;
+
+
+/// The original multi-pass implementation of get_best_overlaps, which rescans every edge in every pass
+void get_best_overlaps_by_rescanning(MultiContactGraph& alignment_graph, vector <tuple <int32_t,int32_t,int32_t> >& matches){
+    bool symmetrical_edges_found = true;
+    while (symmetrical_edges_found){
+        vector <pair <int32_t, int32_t> > symmetrical_edges;
+
+        alignment_graph.for_each_edge_in_order_of_weight([&](const pair<int32_t,int32_t> edge, int32_t weight){
+            int32_t a;
+            int32_t b;
+
+            int32_t x = edge.first;
+            int32_t y = edge.second;
+
+            auto x_length = alignment_graph.get_node_length(x);
+            auto y_length = alignment_graph.get_node_length(y);
+
+            int32_t a_length;
+            int32_t b_length;
+
+            if (x_length > y_length){
+                a = x;
+                b = y;
+                a_length = x_length;
+                b_length = y_length;
+            }
+            else{
+                a = y;
+                b = x;
+                a_length = y_length;
+                b_length = x_length;
+            }
+
+            auto a_coverage = alignment_graph.get_node_coverage(a);
+            auto b_coverage = alignment_graph.get_node_coverage(b);
+
+            bool a_covered = double(a_coverage) >= double(a_length);
+            bool b_covered = double(b_coverage) >= double(b_length);
+
+            if (a_covered or b_covered){
+                return;
+            }
+
+            int32_t a_best_neighbor = -1;
+            int32_t a_best_value = -1;
+            int32_t b_best_neighbor = -1;
+            int32_t b_best_value = -1;
+
+            alignment_graph.for_each_node_neighbor(a, [&](int32_t other, const MultiNode& n){
+                bool other_covered = alignment_graph.get_node_coverage(other) >= alignment_graph.get_node_length(other);
+                auto w = alignment_graph.get_edge_weight(a, other);
+
+                if (w > a_best_value and not other_covered){
+                    a_best_value = w;
+                    a_best_neighbor = other;
+                }
+            });
+
+            alignment_graph.for_each_node_neighbor(b, [&](int32_t other, const MultiNode& n){
+                bool other_covered = alignment_graph.get_node_coverage(other) >= alignment_graph.get_node_length(other);
+                auto w = alignment_graph.get_edge_weight(b, other);
+
+                if (w > b_best_value and not other_covered){
+                    b_best_value = w;
+                    b_best_neighbor = other;
+                }
+            });
+
+            if (b_best_neighbor == a and a_best_neighbor == b){
+                auto a_cost = (a_coverage + weight) - a_length;
+                auto b_cost = (b_coverage + weight) - b_length;
+
+                auto a_sane = double(a_cost) < 0.5*double(weight);
+                auto b_sane = double(b_cost) < 0.5*double(weight);
+
+                bool a_max = double(a_coverage) + double(weight) < double(a_length)*(1.0+overflow_tolerance);
+                bool b_max = double(b_coverage) + double(weight) < double(b_length)*(1.0+overflow_tolerance);
+
+                bool a_min = double(weight) > double(a_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
+                bool b_min = double(weight) > double(b_length)*(min_similarity + int(a_coverage == 0)*first_node_penalty);
+
+                if (a_sane and b_sane and a_max and b_max and a_min and b_min){
+                    alignment_graph.increment_coverage(a,weight);
+                    alignment_graph.increment_coverage(b,weight);
+
+                    matches.emplace_back(a, b, weight);
+                    symmetrical_edges.emplace_back(a,b);
+                }
+            }
+        });
+
+        symmetrical_edges_found = not symmetrical_edges.empty();
+
+        for (auto& [a,b]: symmetrical_edges){
+            alignment_graph.remove_edge(a,b);
+        }
+    }
+}
+
+
+/// Nodes have random lengths, and edges have distinct weights (the rescanning order of equal weights is arbitrary)
+void build_random_alignment_graph(MultiContactGraph& graph, mt19937& generator, int32_t n_nodes, size_t n_edges){
+    std::uniform_int_distribution<int32_t> length_distribution(1000, 20000);
+    std::uniform_int_distribution<int32_t> node_distribution(0, n_nodes - 1);
+    std::uniform_real_distribution<double> fraction_distribution(0.05, 1.2);
+
+    for (int32_t id=0; id<n_nodes; id++){
+        graph.try_insert_node(id);
+        graph.set_node_length(id, length_distribution(generator));
+        graph.set_node_coverage(id, 0);
+    }
+
+    unordered_set<int32_t> used_weights;
+
+    for (size_t i=0; i<n_edges; i++){
+        auto a = node_distribution(generator);
+        auto b = node_distribution(generator);
+
+        if (a == b or graph.has_edge(a,b)){
+            continue;
+        }
+
+        auto shorter = std::min(graph.get_node_length(a), graph.get_node_length(b));
+        auto weight = int32_t(double(shorter)*fraction_distribution(generator));
+
+        while (used_weights.count(weight) > 0){
+            weight++;
+        }
+
+        used_weights.emplace(weight);
+        graph.try_insert_edge(a, b, weight);
+    }
+}
+
+
+int main(){
+    mt19937 generator(13);
+
+    cerr << "TESTING OverlapMatcher against rescanning implementation:" << '\n';
+
+    size_t n_matches = 0;
+
+    for (size_t trial=0; trial<300; trial++){
+        int32_t n_nodes = 2 + int32_t(generator() % 200);
+        size_t n_edges = generator() % (4*size_t(n_nodes) + 1);
+
+        // Some trials are dense, so that many passes are needed
+        if (trial % 10 == 0){
+            n_edges = size_t(n_nodes)*size_t(n_nodes);
+        }
+
+        MultiContactGraph reference_graph;
+        build_random_alignment_graph(reference_graph, generator, n_nodes, n_edges);
+
+        MultiContactGraph graph = reference_graph;
+
+        vector <tuple <int32_t,int32_t,int32_t> > expected;
+        get_best_overlaps_by_rescanning(reference_graph, expected);
+
+        vector <tuple <int32_t,int32_t,int32_t> > result;
+
+        OverlapMatcher matcher(graph);
+        matcher.match(min_similarity, overflow_tolerance, first_node_penalty, [&](int32_t a, int32_t b, int32_t weight){
+            result.emplace_back(a, b, weight);
+        });
+
+        if (result != expected){
+            throw runtime_error("FAIL: trial " + to_string(trial) + " found " + to_string(result.size())
+                                + " matches, expected " + to_string(expected.size()));
+        }
+
+        n_matches += result.size();
+    }
+
+    if (n_matches == 0){
+        throw runtime_error("FAIL: no matches found in any trial");
+    }
+
+    cerr << "PASS (" << n_matches << " matches)" << '\n';
+
+    return 0;
+}
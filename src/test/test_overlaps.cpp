@@ -259,6 +259,50 @@ int main(){
         }
     }
     
+    // asymmetric overlaps recorded against the canonical orientation of the edge
+    {
+        HashGraph graph;
+        Overlaps overlaps;
+
+        for (nid_t id = 1; id <= 4; ++id) {
+            graph.create_handle("ACGTACGTACGT", id);
+        }
+
+        vector<tuple<handle_t, handle_t, string>> records{
+            {graph.get_handle(2), graph.get_handle(1), "2M1I3M"},
+            {graph.get_handle(1), graph.get_handle(3, true), "4M2D"},
+            {graph.get_handle(4, true), graph.get_handle(2, true), "6M"},
+            {graph.get_handle(3), graph.get_handle(4), "0M"}
+        };
+
+        for (auto& r : records) {
+            graph.create_edge(get<0>(r), get<1>(r));
+            overlaps.record_overlap(graph, get<0>(r), get<1>(r), get<2>(r));
+        }
+
+        assert(not overlaps.has_overlap(graph, graph.get_handle(3), graph.get_handle(4)));
+
+        for (auto& r : records) {
+            Cigar cigar(get<2>(r));
+            auto a = get<0>(r);
+            auto b = get<1>(r);
+
+            assert(overlaps.get_overlap(graph, a, b).get_string() == cigar.get_string());
+            assert(overlaps.get_overlap(graph, graph.flip(b), graph.flip(a)).get_string() == cigar.reverse().get_string());
+            assert(overlaps.get_aligned_length(graph, a, b) == cigar.aligned_length());
+            assert(overlaps.get_aligned_length(graph, graph.flip(b), graph.flip(a)) == cigar.reverse().aligned_length());
+        }
+
+        // overwrite and remove
+        overlaps.record_overlap(graph, graph.get_handle(2), graph.get_handle(1), "5M");
+        assert(overlaps.get_overlap(graph, graph.get_handle(1, true), graph.get_handle(2, true)).get_string() == "5M");
+
+        overlaps.remove_overlap(graph, graph.get_handle(3), graph.get_handle(1, true));
+        assert(not overlaps.has_overlap(graph, graph.get_handle(1), graph.get_handle(3, true)));
+        assert(overlaps.get_overlap(graph, graph.get_handle(1), graph.get_handle(3, true)).empty());
+    }
+    cerr << "Passed overlap orientation tests!" << endl;
+
     cerr << "All tests passed!" << endl;
     return 0;
 }
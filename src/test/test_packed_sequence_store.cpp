@@ -0,0 +1,301 @@
+#include "PackedSequenceStore.hpp"
+#include "PackedSequenceGraph.hpp"
+
+using gfase::PackedSequenceStore;
+using gfase::PackedSequenceGraph;
+using gfase::PackedSequenceView;
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+
+using std::runtime_error;
+using std::to_string;
+using std::mt19937;
+using std::string;
+using std::vector;
+using std::pair;
+using std::cerr;
+using std::map;
+
+
+/// Written out separately from PackedSequenceStore::complement, so that a wrong entry in that table can't go unnoticed
+char get_complement(char c){
+    static const string bases =       "ACGTRYKMBVDHNacgtrykmbvdhn";
+    static const string complements = "TGCAYRMKVBHDNtgcayrmkvbhdn";
+
+    auto i = bases.find(c);
+
+    return (i == string::npos) ? c : complements[i];
+}
+
+
+string get_reverse_complement(string s){
+    std::reverse(s.begin(), s.end());
+
+    for (auto& c: s){
+        c = get_complement(c);
+    }
+
+    return s;
+}
+
+
+/// Plain ACGT, arbitrary characters, and soft-masked sequence with runs of N
+string generate_sequence(mt19937& generator){
+    static const string alphabet = "ACGTACGTACGTacgtNNNRYn-*";
+
+    size_t length = generator() % (generator() % 3 == 0 ? 5000 : 100);
+    size_t mode = generator() % 3;
+
+    string s;
+
+    for (size_t i=0; i<length; i++){
+        if (mode == 0){
+            s += "ACGT"[generator() % 4];
+        }
+        else if (mode == 1){
+            s += alphabet[generator() % alphabet.size()];
+        }
+        else{
+            s += ((i/50) % 2) ? 'N' : "acgt"[generator() % 4];
+        }
+    }
+
+    return s;
+}
+
+
+void test_store(){
+    mt19937 generator(3);
+
+    PackedSequenceStore store;
+    map<int64_t,string> expected;
+
+    // Enough replacements and removals to trigger compaction of the arena
+    for (size_t i=0; i<50000; i++){
+        int64_t id = generator() % 500;
+        auto operation = generator() % 10;
+
+        if (operation < 6){
+            auto s = generate_sequence(generator);
+            store.insert(id, s);
+            expected[id] = s;
+        }
+        else if (operation < 8){
+            store.remove(id);
+            expected.erase(id);
+        }
+        else if (expected.count(id) > 0){
+            auto& s = expected.at(id);
+            auto view = store.get_view(id);
+
+            string result;
+            view.decode(result);
+
+            if (result != s){
+                throw runtime_error("FAIL: decoded sequence does not match for id " + to_string(id));
+            }
+
+            store.get_sequence(id, result, true);
+
+            if (result != get_reverse_complement(s)){
+                throw runtime_error("FAIL: decoded reverse complement does not match for id " + to_string(id));
+            }
+
+            if (s.empty()){
+                continue;
+            }
+
+            size_t index = generator() % s.size();
+            size_t n = generator() % (s.size() - index + 1);
+
+            // Decoding appends
+            result = "x";
+            view.decode(result, index, n);
+
+            if (result != "x" + s.substr(index, n)){
+                throw runtime_error("FAIL: decoded subsequence does not match for id " + to_string(id));
+            }
+
+            if (view[index] != s[index]){
+                throw runtime_error("FAIL: base does not match for id " + to_string(id));
+            }
+
+            auto p = view.get_bit_offset()/2 + index;
+            if (((view.get_words()[p/32] >> 2*(p % 32)) & 3) != view.get_base_index(index)){
+                throw runtime_error("FAIL: packed words do not match base index for id " + to_string(id));
+            }
+
+            if (view.is_acgt() != (s.find_first_not_of("ACGTacgt") == string::npos)){
+                throw runtime_error("FAIL: incorrect is_acgt for id " + to_string(id));
+            }
+        }
+
+        if (store.size() != expected.size()){
+            throw runtime_error("FAIL: store has " + to_string(store.size()) + " sequences, expected " + to_string(expected.size()));
+        }
+    }
+
+    for (auto& [id, s]: expected){
+        string result;
+        store.get_sequence(id, result);
+
+        if (result != s){
+            throw runtime_error("FAIL: final sequence does not match for id " + to_string(id));
+        }
+    }
+}
+
+
+/// Reverse strand of lowercase and IUPAC codes, which is where PackedSequenceGraph differs from HashGraph
+void test_complement(){
+    vector <pair <string,string> > cases = {
+            {"ACGTRYKMn", "nKMRYACGT"},
+            {"acgtrykmbvdh", "dhbvkmryacgt"},
+            {"BDHVNSW", "WSNBDHV"},
+            {"ACGT-*NNacgt", "acgtNN*-ACGT"},
+            {"", ""}
+    };
+
+    PackedSequenceStore store;
+    PackedSequenceGraph graph;
+
+    for (size_t i=0; i<cases.size(); i++){
+        auto& [forward, reverse] = cases[i];
+        auto id = nid_t(i + 1);
+
+        store.insert(id, forward);
+        graph.create_handle(forward, id);
+
+        string result;
+        store.get_sequence(id, result, true);
+
+        if (result != reverse){
+            throw runtime_error("FAIL: store reverse complement of " + forward + " is " + result + ", expected " + reverse);
+        }
+
+        auto h = graph.get_handle(id, true);
+
+        if (graph.get_sequence(h) != reverse){
+            throw runtime_error("FAIL: graph reverse strand of " + forward + " is " + graph.get_sequence(h) + ", expected " + reverse);
+        }
+
+        for (size_t j=0; j<reverse.size(); j++){
+            if (graph.get_base(h, j) != reverse[j] or graph.get_subsequence(h, j, 3) != reverse.substr(j, 3)){
+                throw runtime_error("FAIL: graph reverse strand bases of " + forward + " do not match " + reverse);
+            }
+        }
+
+        if (get_reverse_complement(forward) != reverse){
+            throw runtime_error("FAIL: test helper reverse complement of " + forward + " does not match " + reverse);
+        }
+    }
+}
+
+
+/// Expected sequences are tracked explicitly, and for nodes which are plain uppercase ACGTN also compared to a HashGraph.
+/// For other bases the reverse strand uses PackedSequenceStore::complement (IUPAC aware, case preserving) where
+/// libhandlegraph maps non-ACGTN bases to N.
+void test_graph(){
+    mt19937 generator(7);
+
+    PackedSequenceGraph graph;
+    HashGraph expected_graph;
+    map<nid_t,string> expected;
+
+    for (nid_t id=1; id<200; id++){
+        auto s = generate_sequence(generator);
+        graph.create_handle(s, id);
+        expected_graph.create_handle(s, id);
+        expected[id] = s;
+    }
+
+    for (nid_t id=1; id<200; id+=2){
+        graph.create_edge(graph.get_handle(id), graph.get_handle(id+1, true));
+        expected_graph.create_edge(expected_graph.get_handle(id), expected_graph.get_handle(id+1, true));
+    }
+
+    for (nid_t id=1; id<200; id+=3){
+        graph.apply_orientation(graph.get_handle(id, true));
+        expected_graph.apply_orientation(expected_graph.get_handle(id, true));
+        expected[id] = get_reverse_complement(expected[id]);
+    }
+
+    for (nid_t id=1; id<200; id+=5){
+        graph.destroy_handle(graph.get_handle(id));
+        expected_graph.destroy_handle(expected_graph.get_handle(id));
+        expected.erase(id);
+    }
+
+    if (graph.get_node_count() != expected.size() or graph.get_node_count() != expected_graph.get_node_count()){
+        throw runtime_error("FAIL: graph node count does not match");
+    }
+
+    size_t n_compared = 0;
+
+    for (auto& [id, forward]: expected){
+        if (forward.find_first_not_of("ACGTN") != string::npos){
+            continue;
+        }
+
+        for (auto reversal: {false, true}){
+            if (graph.get_sequence(graph.get_handle(id, reversal)) != expected_graph.get_sequence(expected_graph.get_handle(id, reversal))){
+                throw runtime_error("FAIL: graph sequence does not match HashGraph for node " + to_string(id));
+            }
+        }
+
+        n_compared++;
+    }
+
+    if (n_compared == 0){
+        throw runtime_error("FAIL: no uppercase ACGTN nodes to compare against HashGraph");
+    }
+
+    for (auto& [id, forward]: expected){
+        if (not graph.has_node(id)){
+            throw runtime_error("FAIL: graph is missing node " + to_string(id));
+        }
+
+        for (auto reversal: {false, true}){
+            auto a = graph.get_handle(id, reversal);
+            auto s = reversal ? get_reverse_complement(forward) : forward;
+
+            if (graph.get_length(a) != s.size() or graph.get_sequence(a) != s){
+                throw runtime_error("FAIL: graph sequence does not match for node " + to_string(id));
+            }
+
+            if (s.empty()){
+                continue;
+            }
+
+            size_t index = generator() % s.size();
+            size_t n = generator() % (s.size() + 10);
+
+            if (graph.get_base(a, index) != s[index] or graph.get_subsequence(a, index, n) != s.substr(index, n)){
+                throw runtime_error("FAIL: graph subsequence does not match for node " + to_string(id));
+            }
+        }
+    }
+}
+
+
+int main(){
+    cerr << "TESTING PackedSequenceStore against unpacked sequences:" << '\n';
+    test_store();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING reverse complement of IUPAC and lowercase bases:" << '\n';
+    test_complement();
+    cerr << "PASS" << '\n';
+
+    cerr << "TESTING PackedSequenceGraph against unpacked sequences and HashGraph:" << '\n';
+    test_graph();
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
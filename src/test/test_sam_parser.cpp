@@ -0,0 +1,99 @@
+#include "Sam.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+
+using gfase::for_element_in_sam_file;
+using gfase::for_batch_in_sam_file;
+using gfase::SamElement;
+
+using std::runtime_error;
+using std::to_string;
+using std::ofstream;
+using std::cerr;
+
+
+int main(){
+    path sam_path = ghc::filesystem::temp_directory_path() / "test_sam_parser.sam";
+
+    vector <SamElement> expected;
+
+    {
+        ofstream file(sam_path);
+        file << "@HD\tVN:1.6\tSO:queryname\n";
+        file << "@SQ\tSN:ref_a\tLN:1000\n";
+
+        for (size_t i=0; i<1000; i++){
+            string query_name = "read_" + to_string(i/2);
+            string ref_name = (i % 7 == 0) ? "*" : "ref_" + to_string(i % 3);
+            uint16_t flag = uint16_t(i % 4096);
+            uint8_t mapq = uint8_t(i % 256);
+
+            // Some lines are much longer than the block size used below
+            string sequence(i % 50 == 0 ? 500 : 10, 'A');
+
+            file << query_name << '\t' << flag << '\t' << ref_name << '\t' << i << '\t' << int(mapq) << "\t10M\t*\t0\t0\t" << sequence << "\t*\n";
+
+            if (ref_name == "*"){
+                ref_name.clear();
+            }
+
+            expected.emplace_back(query_name, ref_name, flag, mapq);
+        }
+
+        // Final line has only the first 5 fields and no trailing newline
+        file << "last\t16\tref_x\t1\t60";
+        string query_name = "last";
+        string ref_name = "ref_x";
+        expected.emplace_back(query_name, ref_name, 16, 60);
+    }
+
+    cerr << "TESTING chunked SAM parser:" << '\n';
+
+    for (size_t n_threads: {1,3}){
+        for (size_t block_size: {64, 1000, 1 << 24}){
+            vector <SamElement> result;
+            size_t n_batches = 0;
+
+            for_batch_in_sam_file(sam_path, [&](vector<SamElement>& batch){
+                for (auto& e: batch){
+                    result.emplace_back(e);
+                }
+                n_batches++;
+            }, n_threads, block_size);
+
+            if (result.size() != expected.size()){
+                throw runtime_error("FAIL: expected " + to_string(expected.size()) + " elements, found " + to_string(result.size()));
+            }
+
+            for (size_t i=0; i<result.size(); i++){
+                auto& a = result[i];
+                auto& b = expected[i];
+
+                if (a.query_name != b.query_name or a.ref_name != b.ref_name or a.flag != b.flag or a.mapq != b.mapq){
+                    cerr << a << '\n' << b << '\n';
+                    throw runtime_error("FAIL: element " + to_string(i) + " differs, n_threads=" + to_string(n_threads) +
+                                        " block_size=" + to_string(block_size));
+                }
+            }
+
+            cerr << "n_threads=" << n_threads << " block_size=" << block_size << " n_batches=" << n_batches << '\n';
+        }
+    }
+
+    size_t n = 0;
+    for_element_in_sam_file(sam_path, [&](SamElement& e){
+        n++;
+    }, 2);
+
+    if (n != expected.size()){
+        throw runtime_error("FAIL: for_element_in_sam_file visited " + to_string(n) + " elements");
+    }
+
+    ghc::filesystem::remove(sam_path);
+
+    cerr << "PASS" << '\n';
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "StratifiedContactMap.hpp"
+#include "edge.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <random>
+#include <map>
+
+using gfase::StratifiedContactMap;
+using gfase::edge;
+
+using std::runtime_error;
+using std::to_string;
+using std::cerr;
+using std::map;
+
+
+int main(){
+    cerr << "TESTING stratified contact map vs nested map:" << '\n';
+
+    StratifiedContactMap contact_map;
+    map <pair<int32_t,int32_t>, map<uint8_t,int64_t> > expected;
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int32_t> id_distribution(0,300);
+    std::uniform_int_distribution<int> mapq_distribution(0,60);
+
+    // Enough updates to cause several intermediate merges
+    size_t n_updates = 5'000'000;
+
+    for (size_t i=0; i<n_updates; i++){
+        auto a = id_distribution(rng);
+        auto b = id_distribution(rng);
+        auto mapq = uint8_t(mapq_distribution(rng));
+
+        contact_map.update(a, b, mapq);
+        expected[edge(a,b)][mapq]++;
+    }
+
+    contact_map.compress();
+
+    if (contact_map.edge_count() != expected.size()){
+        throw runtime_error("FAIL: expected " + to_string(expected.size()) + " edges, found " + to_string(contact_map.edge_count()));
+    }
+
+    vector<int64_t> cdf;
+
+    // Edges are iterated in sorted order, same as the std::map
+    auto iter = expected.begin();
+    contact_map.for_each_edge([&](const pair<int32_t,int32_t>& e, size_t index){
+        if (e != iter->first){
+            throw runtime_error("FAIL: edge order differs at index " + to_string(index));
+        }
+
+        auto bucket = iter->second.begin();
+        contact_map.for_each_bucket(index, [&](uint8_t mapq, uint32_t count){
+            if (bucket == iter->second.end() or bucket->first != mapq or bucket->second != count){
+                throw runtime_error("FAIL: buckets differ for edge " + to_string(e.first) + "," + to_string(e.second));
+            }
+            bucket++;
+        });
+
+        contact_map.get_reverse_cdf(index, 60, cdf);
+
+        for (int q=0; q<=60; q++){
+            int64_t total = 0;
+            for (auto& [mapq,count]: iter->second){
+                if (mapq >= q){
+                    total += count;
+                }
+            }
+
+            if (cdf[q] != total or contact_map.get_count(e.first, e.second, uint8_t(q)) != total){
+                throw runtime_error("FAIL: reverse CDF differs for edge " + to_string(e.first) + "," + to_string(e.second));
+            }
+        }
+
+        iter++;
+    });
+
+    if (contact_map.find(1000,1001) != contact_map.edge_count() or contact_map.get_count(1000,1001) != 0){
+        throw runtime_error("FAIL: nonexistent edge was found");
+    }
+
+    cerr << "PASS" << '\n';
+
+    return 0;
+}